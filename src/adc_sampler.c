@@ -0,0 +1,234 @@
+/* adc_sampler.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+
+#include "fanpico.h"
+
+
+/*
+ * Free running ADC sampling using DMA.
+ *
+ * ADC is run in round-robin mode over all sensor inputs (and internal
+ * temperature sensor). Two DMA channels keep copying samples from ADC
+ * FIFO into a buffer: data channel writes samples into the buffer and
+ * control channel restarts data channel from start of the buffer.
+ * Buffer holds 'oversample' samples for each input, so samples for
+ * each input are always at fixed positions in the buffer.
+ */
+
+#define ADC_CLOCK_HZ       48000000
+#define ADC_SAMPLER_WINDOW 500  /* ms, time span of samples in buffer */
+
+static int data_ch = -1;
+static int ctrl_ch = -1;
+static volatile uint16_t *buffer = NULL;
+static volatile uint16_t *buffer_addr = NULL;
+static uint buffer_len = 0;
+static uint8_t channels[NUM_ADC_CHANNELS];
+static uint channel_count = 0;
+static uint oversample = 0;
+static uint64_t t_filled = 0;
+
+
+void adc_sampler_stop()
+{
+	if (oversample == 0)
+		return;
+
+	adc_run(false);
+	dma_channel_abort(ctrl_ch);
+	dma_channel_abort(data_ch);
+	/* Data channel may have triggered control channel before abort */
+	dma_channel_abort(ctrl_ch);
+	dma_channel_abort(data_ch);
+	adc_set_round_robin(0);
+	adc_fifo_setup(false, false, 0, false, false);
+	adc_fifo_drain();
+
+	free((void*)buffer);
+	buffer = NULL;
+	oversample = 0;
+}
+
+
+/* Start sampling all sensor inputs. Each input is sampled 'count' times
+ * during sampling window.
+ */
+bool adc_sampler_start(uint count)
+{
+	dma_channel_config c;
+	uint32_t mask = 0;
+	float div;
+	uint i, rate, period;
+
+	adc_sampler_stop();
+
+	if (count < 1)
+		return false;
+
+	if (data_ch < 0) {
+		data_ch = dma_claim_unused_channel(false);
+		ctrl_ch = dma_claim_unused_channel(false);
+		if (data_ch < 0 || ctrl_ch < 0) {
+			log_msg(LOG_ERR, "adc_sampler_start(): no DMA channels available");
+			/* Release the channel we got (if any) */
+			if (data_ch >= 0)
+				dma_channel_unclaim(data_ch);
+			if (ctrl_ch >= 0)
+				dma_channel_unclaim(ctrl_ch);
+			data_ch = ctrl_ch = -1;
+			return false;
+		}
+	}
+
+	/* Build list of inputs to sample (round-robin goes in ascending order) */
+	for (i = 0; i < SENSOR_COUNT; i++)
+		mask |= (1 << sensor_adc_map[i]);
+	mask |= (1 << ADC_TEMPERATURE_CHANNEL_NUM);
+	channel_count = 0;
+	for (i = 0; i < NUM_ADC_CHANNELS; i++) {
+		if (mask & (1 << i))
+			channels[channel_count++] = i;
+	}
+
+	buffer_len = channel_count * count;
+	if (!(buffer = calloc(buffer_len, sizeof(uint16_t)))) {
+		log_msg(LOG_ERR, "adc_sampler_start(): not enough memory");
+		return false;
+	}
+	buffer_addr = buffer;
+
+	/* Sample at rate that fills the buffer in ADC_SAMPLER_WINDOW */
+	rate = buffer_len * 1000 / ADC_SAMPLER_WINDOW;
+	div = (rate > 0 ? (float)ADC_CLOCK_HZ / rate - 1 : 65535);
+	if (div < 96)
+		div = 0;  /* run at full speed (500ksps) */
+	else if (div > 65535)
+		div = 65535;
+	period = (div > 0 ? div + 1 : 96);  /* ADC clock cycles per sample */
+
+	/* Data channel: copy samples from ADC FIFO into the buffer */
+	c = dma_channel_get_default_config(data_ch);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+	channel_config_set_read_increment(&c, false);
+	channel_config_set_write_increment(&c, true);
+	channel_config_set_dreq(&c, DREQ_ADC);
+	channel_config_set_chain_to(&c, ctrl_ch);
+	dma_channel_configure(data_ch, &c, buffer, &adc_hw->fifo, buffer_len, false);
+
+	/* Control channel: restart data channel from beginning of buffer */
+	c = dma_channel_get_default_config(ctrl_ch);
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+	channel_config_set_read_increment(&c, false);
+	channel_config_set_write_increment(&c, false);
+	dma_channel_configure(ctrl_ch, &c, &dma_hw->ch[data_ch].al2_write_addr_trig,
+			&buffer_addr, 1, false);
+
+	adc_run(false);
+	adc_fifo_setup(true, true, 1, false, false);
+	adc_set_clkdiv(div);
+	adc_select_input(channels[0]);
+	adc_set_round_robin(mask);
+	adc_fifo_drain();
+
+	oversample = count;
+	t_filled = time_us_64() + (uint64_t)buffer_len * period * 1000000 / ADC_CLOCK_HZ;
+	dma_channel_start(data_ch);
+	adc_run(true);
+
+	log_msg(LOG_INFO, "ADC sampling started: %u inputs, %ux oversampling, %u samples/s",
+		channel_count, count, ADC_CLOCK_HZ / period);
+
+	return true;
+}
+
+
+/* Return number of samples in the buffer (full rounds over all inputs
+ * only). Buffer is partially filled for a short while after start.
+ */
+static uint samples_available()
+{
+	uint len;
+
+	if (time_us_64() >= t_filled)
+		return buffer_len;
+
+	len = ((uintptr_t)dma_hw->ch[data_ch].write_addr - (uintptr_t)buffer)
+		/ sizeof(uint16_t);
+	if (len > buffer_len)
+		len = buffer_len;
+	return len - len % channel_count;
+}
+
+
+/* Return true if sampling has been started, but there is not yet
+ * at least one sample for every input. Direct ADC reads must not be
+ * used while sampling is running.
+ */
+bool adc_sampler_warming_up()
+{
+	if (oversample == 0)
+		return false;
+	return (samples_available() < channel_count);
+}
+
+
+/* Return average (raw) reading of given ADC input.
+ * Returns false if input is not being sampled, or if there are no
+ * samples yet (see adc_sampler_warming_up()).
+ */
+bool adc_sampler_read(uint input, float *value)
+{
+	uint32_t sum = 0;
+	uint len, n = 0;
+	int idx = -1;
+
+	if (oversample == 0)
+		return false;
+
+	for (uint i = 0; i < channel_count; i++) {
+		if (channels[i] == input) {
+			idx = i;
+			break;
+		}
+	}
+	if (idx < 0)
+		return false;
+
+	if ((len = samples_available()) < channel_count)
+		return false;
+
+	for (uint i = idx; i < len; i += channel_count) {
+		sum += buffer[i];
+		n++;
+	}
+	*value = (float)sum / n;
+
+	return true;
+}
+
+
+/* eof :-) */
@@ -0,0 +1,187 @@
+/* benchmark.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "hardware/structs/systick.h"
+
+#include "fanpico.h"
+
+#define BENCH_ROUNDS 1000
+
+#define SYSTICK_MAX       0x00ffffff
+#define SYSTICK_ENABLE    0x00000001
+#define SYSTICK_CLKSOURCE 0x00000004  /* count processor clock cycles */
+
+
+/*
+ * On-target microbenchmarks of control loop functions (CPU cycles per call).
+ *
+ * Cycles are counted using SysTick timer (available on both RP2040 and
+ * RP2350), with interrupts disabled around each call. Timer overhead
+ * (measured using an empty function) is subtracted from the results.
+ *
+ * Control loop calculations (calculate_pwm_duty(), calculate_tacho_freq())
+ * use copy of fan1 and mbfan1 configuration without filters (filter state
+ * is owned by the control loop), with fan1 following sensor1.
+ */
+
+struct bench_ctx {
+	const struct sensor_input *sensor;
+	const struct thermistor_lut *lut;
+	struct fanpico_control_config *config;
+	struct fanpico_state *state;
+};
+
+typedef double (bench_func_t)(const struct bench_ctx *ctx, int n);
+
+struct bench_entry {
+	const char *name;
+	bench_func_t *func;
+};
+
+volatile double bench_sink;
+
+
+static double bench_empty(const struct bench_ctx *ctx, int n)
+{
+	return n;
+}
+
+static double bench_thermistor_temp(const struct bench_ctx *ctx, int n)
+{
+	return thermistor_temp(200 + (n & 2047), ctx->sensor);
+}
+
+static double bench_thermistor_lut_temp(const struct bench_ctx *ctx, int n)
+{
+	return thermistor_lut_temp(ctx->lut, 200 + (n & 2047));
+}
+
+static double bench_calculate_pwm_duty(const struct bench_ctx *ctx, int n)
+{
+	ctx->state->temp[0] = 15.0f + (n & 511) * 0.1f;
+	return calculate_pwm_duty(ctx->state, ctx->config, 0);
+}
+
+static double bench_calculate_tacho_freq(const struct bench_ctx *ctx, int n)
+{
+	for (int i = 0; i < FAN_COUNT; i++)
+		ctx->state->fan_freq[i] = 10.0f + (n & 1023) * 0.2f;
+	return calculate_tacho_freq(ctx->state, ctx->config, 0);
+}
+
+static const struct bench_entry bench_entries[] = {
+	{ "thermistor_temp", bench_thermistor_temp },
+	{ "thermistor_lut_temp", bench_thermistor_lut_temp },
+	{ "calculate_pwm_duty", bench_calculate_pwm_duty },
+	{ "calculate_tacho_freq", bench_calculate_tacho_freq },
+};
+
+
+/* Run function BENCH_ROUNDS times, return average (and minimum)
+ * number of cycles per call.
+ */
+static uint32_t bench_cycles(bench_func_t *func, const struct bench_ctx *ctx, uint32_t *min)
+{
+	uint64_t total = 0;
+	uint32_t irq_status, start, cycles;
+
+	*min = UINT32_MAX;
+	for (int n = 0; n < BENCH_ROUNDS; n++) {
+		irq_status = save_and_disable_interrupts();
+		start = systick_hw->cvr;
+		bench_sink = func(ctx, n);
+		cycles = (start - systick_hw->cvr) & SYSTICK_MAX;
+		restore_interrupts(irq_status);
+
+		total += cycles;
+		if (cycles < *min)
+			*min = cycles;
+	}
+
+	return total / BENCH_ROUNDS;
+}
+
+
+/* Run all benchmarks and print results (as CSV) to stdout. */
+int run_benchmarks()
+{
+	struct bench_ctx ctx;
+	struct sensor_input sensor;
+	struct fanpico_control_config *config;
+	struct fanpico_state *state;
+	uint32_t overhead, avg, min;
+
+	/* Use thermistor parameters from first sensor */
+	memcpy(&sensor, &cfg->sensors[0], sizeof(sensor));
+	config = calloc(1, sizeof(struct fanpico_control_config));
+	state = calloc(1, sizeof(struct fanpico_state));
+	if (!config || !state) {
+		free(config);
+		free(state);
+		return 1;
+	}
+	thermistor_lut_build(&config->thermistor_lut[0], &sensor);
+	memcpy(config->sensors, cfg->sensors, sizeof(config->sensors));
+	memcpy(&config->fans[0], &cfg->fans[0], sizeof(config->fans[0]));
+	memcpy(&config->mbfans[0], &cfg->mbfans[0], sizeof(config->mbfans[0]));
+	config->fans[0].s_type = PWM_SENSOR;
+	config->fans[0].s_id = 0;
+	config->fans[0].filter.stages = 0;
+	config->mbfans[0].filter.stages = 0;
+	for (int i = 0; i < FAN_COUNT; i++)
+		config->fans[i].rpm_factor = 2;
+	pwl_maps_compile(&config->maps, config);
+
+	ctx.sensor = &sensor;
+	ctx.lut = &config->thermistor_lut[0];
+	ctx.config = config;
+	ctx.state = state;
+
+	/* Count down from SYSTICK_MAX (wraps every ~100ms) */
+	systick_hw->csr = 0;
+	systick_hw->rvr = SYSTICK_MAX;
+	systick_hw->cvr = 0;
+	systick_hw->csr = SYSTICK_CLKSOURCE | SYSTICK_ENABLE;
+
+	bench_cycles(bench_empty, &ctx, &overhead);
+
+	printf("function,cycles_avg,cycles_min\n");
+	for (int i = 0; i < sizeof(bench_entries) / sizeof(bench_entries[0]); i++) {
+		avg = bench_cycles(bench_entries[i].func, &ctx, &min);
+		printf("%s,%lu,%lu\n", bench_entries[i].name,
+			(avg > overhead ? avg - overhead : 0),
+			(min > overhead ? min - overhead : 0));
+	}
+
+	systick_hw->csr = 0;
+	free(state);
+	free(config);
+
+	return 0;
+}
+
+
+/* eof :-) */
@@ -38,6 +38,7 @@
 #include "b64/ccommon.h"
 #include "fanpico.h"
 #include "command_util.h"
+#include "tacho_estimator.h"
 #include "pico_sensor_lib.h"
 #include "lfs.h"
 #ifdef WIFI_SUPPORT
@@ -65,6 +66,7 @@ const struct error_t error_codes[] = {
 };
 
 int last_error_num = 0;
+static struct sched_latency_stats command_stats;
 
 const struct fanpico_state *st = NULL;
 struct fanpico_config *conf = NULL;
@@ -534,6 +536,13 @@ int cmd_fan_pwm_coef(const char *cmd, const char *args, int query, struct prev_c
 				"fan%d: PWM Coefficient", 0.0, 1000.0);
 }
 
+int cmd_fan_pwm_slew(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
+{
+	return array_float_setting(cmd, args, query, prev_cmd, 0, conf->fans, FAN_COUNT,
+				sizeof(conf->fans[0]), offsetof(struct fan_output, pwm_slew),
+				"fan%d: PWM Slew Rate", 0.0, 1000.0);
+}
+
 int cmd_fan_pwm_map(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
 {
 	int fan, i, count;
@@ -569,7 +578,10 @@ int cmd_fan_pwm_map(const char *cmd, const char *args, int query, struct prev_cm
 		}
 		if ((count >= 4) && (count % 2 == 0)) {
 			new_map.points = count / 2;
-			*map = new_map;
+			if (map_points_fit(conf, map->points, new_map.points))
+				*map = new_map;
+			else
+				ret = 3;
 		} else {
 			log_msg(LOG_WARNING, "fan%d: invalid new map: %s", fan + 1, args);
 			ret = 2;
@@ -584,10 +596,8 @@ int cmd_fan_filter(const char *cmd, const char *args, int query, struct prev_cmd
 {
 	int fan;
 	int ret = 0;
-	char *tok, *saveptr, *param;
+	char *tok;
 	struct fan_output *f;
-	enum signal_filter_types new_filter;
-	void *new_ctx;
 
 	fan = get_prev_cmd_index(prev_cmd, 0) - 1;
 	if (fan < 0 || fan >= FAN_COUNT)
@@ -595,31 +605,12 @@ int cmd_fan_filter(const char *cmd, const char *args, int query, struct prev_cmd
 
 	f = &conf->fans[fan];
 	if (query) {
-		printf("%s", filter2str(f->filter));
-		tok = filter_print_args(f->filter, f->filter_ctx);
-		if (tok) {
-			printf(",%s\n", tok);
-			free(tok);
-		} else {
-			printf(",\n");
-		}
-	} else {
-		if (!(param = strdup(args)))
+		if (!(tok = filter_chain_print(&f->filter)))
 			return 2;
-		if ((tok = strtok_r(param, ",", &saveptr)) != NULL) {
-			new_filter = str2filter(tok);
-			tok += strlen(tok) + 1;
-			new_ctx = filter_parse_args(new_filter, tok);
-			if (new_filter == FILTER_NONE || new_ctx != NULL) {
-				f->filter = new_filter;
-				if (f->filter_ctx)
-					free(f->filter_ctx);
-				f->filter_ctx = new_ctx;
-			} else {
-				ret = 1;
-			}
-		}
-		free(param);
+		printf("%s\n", tok);
+		free(tok);
+	} else {
+		ret = filter_chain_set(conf, &f->filter, args);
 	}
 
 	return ret;
@@ -706,15 +697,25 @@ int cmd_fan_source(const char *cmd, const char *args, int query, struct prev_cmd
 			if ((tok = strtok_r(NULL, ",", &saveptr)) != NULL) {
 				val = atoi(tok) - d_n;
 				if (valid_pwm_source_ref(type, val)) {
-					d_o = (conf->fans[fan].s_type != PWM_FIXED ? 1 : 0);
-					log_msg(LOG_NOTICE, "fan%d: change source %s,%u --> %s,%u",
-						fan + 1,
-						pwm_source2str(conf->fans[fan].s_type),
-						conf->fans[fan].s_id + d_o,
-						pwm_source2str(type),
-						val + d_n);
+					enum pwm_source_types old_type = conf->fans[fan].s_type;
+					uint16_t old_id = conf->fans[fan].s_id;
+
 					conf->fans[fan].s_type = type;
 					conf->fans[fan].s_id = val;
+					if (check_control_graph(conf)) {
+						d_o = (old_type != PWM_FIXED ? 1 : 0);
+						log_msg(LOG_NOTICE, "fan%d: change source %s,%u --> %s,%u",
+							fan + 1,
+							pwm_source2str(old_type),
+							old_id + d_o,
+							pwm_source2str(type),
+							val + d_n);
+					} else {
+						/* New source would create a loop */
+						conf->fans[fan].s_type = old_type;
+						conf->fans[fan].s_id = old_id;
+						ret = 2;
+					}
 				} else {
 					log_msg(LOG_WARNING, "fan%d: invalid source: %s",
 						fan + 1, args);
@@ -736,6 +737,20 @@ int cmd_fan_tacho_hys(const char *cmd, const char *args, int query, struct prev_
 				"fan%d: Tachometer Hysteresis", 0.0, 10000.0);
 }
 
+int cmd_fan_tacho_periods(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
+{
+	return array_uint8_setting(cmd, args, query, prev_cmd, 1, conf->fans, FAN_COUNT,
+				sizeof(conf->fans[0]), offsetof(struct fan_output, tacho_periods),
+				"fan%d: Tachometer Periods", 1, TACHO_EST_MAX_PERIODS);
+}
+
+int cmd_fan_tacho_timeout(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
+{
+	return array_uint16_setting(cmd, args, query, prev_cmd, 1, conf->fans, FAN_COUNT,
+				sizeof(conf->fans[0]), offsetof(struct fan_output, tacho_timeout),
+				"fan%d: Tachometer Timeout", 100, 10000);
+}
+
 int cmd_fan_pwm_hys(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
 {
 	return array_float_setting(cmd, args, query, prev_cmd, 1, conf->fans, FAN_COUNT,
@@ -782,6 +797,43 @@ int cmd_fan_tacho(const char *cmd, const char *args, int query, struct prev_cmd_
 	return 1;
 }
 
+int cmd_fan_status(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
+{
+	int fan;
+
+	if (!query)
+		return 1;
+
+	fan = get_prev_cmd_index(prev_cmd, 0) - 1;
+	if (fan >= 0 && fan < FAN_COUNT) {
+		printf("%s\n", fan_status2str(st->fan_status[fan]));
+		return 0;
+	}
+
+	return 1;
+}
+
+int cmd_fan_age(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
+{
+	int fan;
+	uint64_t t;
+
+	if (!query)
+		return 1;
+
+	fan = get_prev_cmd_index(prev_cmd, 0) - 1;
+	if (fan >= 0 && fan < FAN_COUNT) {
+		t = to_us_since_boot(st->fan_freq_updated[fan]);
+		if (t == 0)
+			return 2;
+		printf("%lld\n", absolute_time_diff_us(st->fan_freq_updated[fan],
+							get_absolute_time()) / 1000);
+		return 0;
+	}
+
+	return 1;
+}
+
 int cmd_fan_pwm(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
 {
 	int fan;
@@ -900,7 +952,10 @@ int cmd_mbfan_rpm_map(const char *cmd, const char *args, int query, struct prev_
 		}
 		if ((count >= 4) && (count % 2 == 0)) {
 			new_map.points = count / 2;
-			*map = new_map;
+			if (map_points_fit(conf, map->points, new_map.points))
+				*map = new_map;
+			else
+				ret = 3;
 		} else {
 			log_msg(LOG_WARNING, "mbfan%d: invalid new map: %s", fan + 1, args);
 			ret = 2;
@@ -1112,6 +1167,23 @@ int cmd_mbfan_pwm(const char *cmd, const char *args, int query, struct prev_cmd_
 	return 1;
 }
 
+int cmd_mbfan_pwm_freq(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
+{
+	int fan;
+	float f;
+
+	if (query) {
+		fan = get_prev_cmd_index(prev_cmd, 0) - 1;
+		if (fan >= 0 && fan < MBFAN_COUNT) {
+			f = st->mbfan_pwm_freq[fan];
+			log_msg(LOG_DEBUG, "mbfan%d pwm frequency = %fHz", fan + 1, f);
+			printf("%.0f\n", f);
+			return 0;
+		}
+	}
+	return 1;
+}
+
 int cmd_mbfan_read(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
 {
 	int fan;
@@ -1144,10 +1216,8 @@ int cmd_mbfan_filter(const char *cmd, const char *args, int query, struct prev_c
 {
 	int mbfan;
 	int ret = 0;
-	char *tok, *saveptr, *param;
+	char *tok;
 	struct mb_input *m;
-	enum signal_filter_types new_filter;
-	void *new_ctx;
 
 	mbfan = get_prev_cmd_index(prev_cmd, 0) - 1;
 	if (mbfan < 0 || mbfan >= MBFAN_COUNT)
@@ -1155,31 +1225,12 @@ int cmd_mbfan_filter(const char *cmd, const char *args, int query, struct prev_c
 
 	m = &conf->mbfans[mbfan];
 	if (query) {
-		printf("%s", filter2str(m->filter));
-		tok = filter_print_args(m->filter, m->filter_ctx);
-		if (tok) {
-			printf(",%s\n", tok);
-			free(tok);
-		} else {
-			printf(",\n");
-		}
-	} else {
-		if (!(param = strdup(args)))
+		if (!(tok = filter_chain_print(&m->filter)))
 			return 2;
-		if ((tok = strtok_r(param, ",", &saveptr)) != NULL) {
-			new_filter = str2filter(tok);
-			tok += strlen(tok) + 1;
-			new_ctx = filter_parse_args(new_filter, tok);
-			if (new_filter == FILTER_NONE || new_ctx != NULL) {
-				m->filter = new_filter;
-				if (m->filter_ctx)
-					free(m->filter_ctx);
-				m->filter_ctx = new_ctx;
-			} else {
-				ret = 1;
-			}
-		}
-		free(param);
+		printf("%s\n", tok);
+		free(tok);
+	} else {
+		ret = filter_chain_set(conf, &m->filter, args);
 	}
 
 	return ret;
@@ -1227,6 +1278,12 @@ int  cmd_adc_vref(const char *cmd, const char *args, int query, struct prev_cmd_
 			&conf->adc_vref, 0.0, 100.0, "ADC Reference Voltage");
 }
 
+int cmd_adc_oversample(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
+{
+	return uint16_setting(cmd, args, query, prev_cmd,
+			&conf->adc_oversample, 1, ADC_MAX_OVERSAMPLE, "ADC Oversampling");
+}
+
 int cmd_sensor_beta_coef(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
 {
 	return array_float_setting(cmd, args, query, prev_cmd, 0, conf->sensors, SENSOR_COUNT,
@@ -1269,7 +1326,10 @@ int cmd_sensor_temp_map(const char *cmd, const char *args, int query, struct pre
 		}
 		if ((count >= 4) && (count % 2 == 0)) {
 			new_map.points = count / 2;
-			*map = new_map;
+			if (map_points_fit(conf, map->points, new_map.points))
+				*map = new_map;
+			else
+				ret = 3;
 		} else {
 			log_msg(LOG_WARNING, "sensor%d: invalid new map: %s", sensor + 1, args);
 			ret = 2;
@@ -1308,10 +1368,8 @@ int cmd_sensor_filter(const char *cmd, const char *args, int query, struct prev_
 {
 	int sensor;
 	int ret = 0;
-	char *tok, *saveptr, *param;
+	char *tok;
 	struct sensor_input *s;
-	enum signal_filter_types new_filter;
-	void *new_ctx;
 
 	sensor = get_prev_cmd_index(prev_cmd, 0) - 1;
 	if (sensor < 0 || sensor >= SENSOR_COUNT)
@@ -1319,31 +1377,12 @@ int cmd_sensor_filter(const char *cmd, const char *args, int query, struct prev_
 
 	s = &conf->sensors[sensor];
 	if (query) {
-		printf("%s", filter2str(s->filter));
-		tok = filter_print_args(s->filter, s->filter_ctx);
-		if (tok) {
-			printf(",%s\n", tok);
-			free(tok);
-		} else {
-			printf(",\n");
-		}
-	} else {
-		if (!(param = strdup(args)))
+		if (!(tok = filter_chain_print(&s->filter)))
 			return 2;
-		if ((tok = strtok_r(param, ",", &saveptr)) != NULL) {
-			new_filter = str2filter(tok);
-			tok += strlen(tok) + 1;
-			new_ctx = filter_parse_args(new_filter, tok);
-			if (new_filter == FILTER_NONE || new_ctx != NULL) {
-				s->filter = new_filter;
-				if (s->filter_ctx)
-					free(s->filter_ctx);
-				s->filter_ctx = new_ctx;
-			} else {
-				ret = 1;
-			}
-		}
-		free(param);
+		printf("%s\n", tok);
+		free(tok);
+	} else {
+		ret = filter_chain_set(conf, &s->filter, args);
 	}
 
 	return ret;
@@ -1458,15 +1497,25 @@ int cmd_vsensor_source(const char *cmd, const char *args, int query, struct prev
 					}
 				}
 				if (count >= 2) {
-					log_msg(LOG_NOTICE, "vsensor%d: set source to %s%s",
-						sensor + 1,
-						vsmode2str(vsmode),
-						temp_str);
+					uint8_t old_mode = v->mode;
+					uint8_t old_sensors[VSENSOR_SOURCE_MAX_COUNT];
+
+					memcpy(old_sensors, v->sensors, sizeof(old_sensors));
 					v->mode = vsmode;
 					for(i = 0; i < SENSOR_COUNT; i++) {
 						v->sensors[i] = selected[i];
 					}
-					ret = 0;
+					if (check_control_graph(conf)) {
+						log_msg(LOG_NOTICE, "vsensor%d: set source to %s%s",
+							sensor + 1,
+							vsmode2str(vsmode),
+							temp_str);
+						ret = 0;
+					} else {
+						/* New sources would create a loop */
+						v->mode = old_mode;
+						memcpy(v->sensors, old_sensors, sizeof(old_sensors));
+					}
 				}
 			}
 		}
@@ -1511,7 +1560,10 @@ int cmd_vsensor_temp_map(const char *cmd, const char *args, int query, struct pr
 		}
 		if ((count >= 4) && (count % 2 == 0)) {
 			new_map.points = count / 2;
-			*map = new_map;
+			if (map_points_fit(conf, map->points, new_map.points))
+				*map = new_map;
+			else
+				ret = 3;
 		} else {
 			log_msg(LOG_WARNING, "vsensor%d: invalid new map: %s", sensor + 1, args);
 			ret = 2;
@@ -1588,10 +1640,8 @@ int cmd_vsensor_filter(const char *cmd, const char *args, int query, struct prev
 {
 	int sensor;
 	int ret = 0;
-	char *tok, *saveptr, *param;
+	char *tok;
 	struct vsensor_input *s;
-	enum signal_filter_types new_filter;
-	void *new_ctx;
 
 	sensor = get_prev_cmd_index(prev_cmd, 0) - 1;
 	if (sensor < 0 || sensor >= VSENSOR_COUNT)
@@ -1599,31 +1649,12 @@ int cmd_vsensor_filter(const char *cmd, const char *args, int query, struct prev
 
 	s = &conf->vsensors[sensor];
 	if (query) {
-		printf("%s", filter2str(s->filter));
-		tok = filter_print_args(s->filter, s->filter_ctx);
-		if (tok) {
-			printf(",%s\n", tok);
-			free(tok);
-		} else {
-			printf(",\n");
-		}
-	} else {
-		if (!(param = strdup(args)))
+		if (!(tok = filter_chain_print(&s->filter)))
 			return 2;
-		if ((tok = strtok_r(param, ",", &saveptr)) != NULL) {
-			new_filter = str2filter(tok);
-			tok += strlen(tok) + 1;
-			new_ctx = filter_parse_args(new_filter, tok);
-			if (new_filter == FILTER_NONE || new_ctx != NULL) {
-				s->filter = new_filter;
-				if (s->filter_ctx)
-					free(s->filter_ctx);
-				s->filter_ctx = new_ctx;
-			} else {
-				ret = 1;
-			}
-		}
-		free(param);
+		printf("%s\n", tok);
+		free(tok);
+	} else {
+		ret = filter_chain_set(conf, &s->filter, args);
 	}
 
 	return ret;
@@ -1867,6 +1898,12 @@ int cmd_mqtt_duty_interval(const char *cmd, const char *args, int query, struct
 			&conf->mqtt_duty_interval, 0, (86400 * 30), "MQTT Publish PWM Interval");
 }
 
+int cmd_mqtt_perf_interval(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
+{
+	return uint32_setting(cmd, args, query, prev_cmd,
+			&conf->mqtt_perf_interval, 0, (86400 * 30), "MQTT Publish PERF Interval");
+}
+
 int cmd_mqtt_allow_scpi(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
 {
 	return bool_setting(cmd, args, query, prev_cmd,
@@ -1950,6 +1987,13 @@ int cmd_mqtt_mbfan_duty_topic(const char *cmd, const char *args, int query, stru
 			sizeof(conf->mqtt_mbfan_duty_topic), "MQTT MBFan PWM Topic", NULL);
 }
 
+int cmd_mqtt_perf_topic(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
+{
+	return string_setting(cmd, args, query, prev_cmd,
+			conf->mqtt_perf_topic,
+			sizeof(conf->mqtt_perf_topic), "MQTT Perf Topic", NULL);
+}
+
 int cmd_mqtt_ha_discovery(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
 {
 	return string_setting(cmd, args, query, prev_cmd,
@@ -2777,6 +2821,165 @@ int cmd_memtest(const char *cmd, const char *args, int query, struct prev_cmd_t
 	return 0;
 }
 
+int cmd_perf(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
+{
+	if (!query) {
+		/* Reset statistics */
+		reset_perf_stats();
+		log_msg(LOG_NOTICE, "Task statistics reset.");
+		return 0;
+	}
+
+	printf("core,task,runs,exec_avg,exec_max,late_max\n");
+	for (int core = 0; core < 2; core++) {
+		const scheduler_t *s = get_scheduler(core);
+
+		for (int i = 0; i < s->count; i++) {
+			const struct sched_task_stats *st = &s->tasks[i].stats;
+			uint32_t runs = st->runs;
+
+			printf("%d,%s,%lu,%llu,%lu,%lu\n",
+				core,
+				s->tasks[i].task->name,
+				runs,
+				(runs > 0 ? st->exec_total / runs : 0),
+				st->exec_max,
+				st->late_max);
+		}
+	}
+
+	const struct sched_latency_stats *l = get_output_latency();
+	const struct sched_latency_stats *c = get_command_stats();
+	printf("\nevent,count,avg,max,last\n");
+	printf("output,%lu,%llu,%lu,%lu\n",
+		l->count,
+		(l->count > 0 ? l->total / l->count : 0),
+		l->max,
+		l->last);
+	printf("command,%lu,%llu,%lu,%lu\n",
+		c->count,
+		(c->count > 0 ? c->total / c->count : 0),
+		c->max,
+		c->last);
+
+	char method[16];
+	printf("\nfan,tacho_input\n");
+	for (int i = 0; i < FAN_COUNT; i++)
+		printf("%d,%s\n", i + 1, tacho_input_method(i, method, sizeof(method)));
+
+	printf("\ncore,log_dropped\n");
+	printf("1,%lu\n", log_deferred_dropped());
+
+	printf("\ncore,task,type");
+	for (int i = 0; i < SCHED_HIST_BUCKETS; i++) {
+		uint32_t limit = sched_hist_bucket_limit(i);
+		if (limit > 0)
+			printf(",<%lu", limit);
+		else
+			printf(",>=%lu", sched_hist_bucket_limit(i - 1));
+	}
+	printf("\n");
+	for (int core = 0; core < 2; core++) {
+		const scheduler_t *s = get_scheduler(core);
+
+		for (int i = 0; i < s->count; i++) {
+			const struct sched_task_stats *st = &s->tasks[i].stats;
+
+			printf("%d,%s,exec", core, s->tasks[i].task->name);
+			for (int j = 0; j < SCHED_HIST_BUCKETS; j++)
+				printf(",%lu", st->exec_hist[j]);
+			printf("\n%d,%s,late", core, s->tasks[i].task->name);
+			for (int j = 0; j < SCHED_HIST_BUCKETS; j++)
+				printf(",%lu", st->late_hist[j]);
+			printf("\n");
+		}
+	}
+	printf("1,output,latency");
+	for (int j = 0; j < SCHED_HIST_BUCKETS; j++)
+		printf(",%lu", l->hist[j]);
+	printf("\n0,command,exec");
+	for (int j = 0; j < SCHED_HIST_BUCKETS; j++)
+		printf(",%lu", c->hist[j]);
+	printf("\n");
+
+	return 0;
+}
+
+int cmd_perf_bench(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
+{
+	if (!query)
+		return 1;
+
+	return (run_benchmarks() ? 2 : 0);
+}
+
+int cmd_history(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
+{
+	struct history_query q;
+	int params[3] = { 0, 0, 1 };
+	char *arg, *tok, *saveptr;
+	char buf[32];
+	uint channels = history_channels();
+	int i = 0;
+
+	if (!query) {
+		history_clear();
+		log_msg(LOG_NOTICE, "History cleared.");
+		return 0;
+	}
+
+	/* Optional arguments: <start>[,<end>[,<step>]] */
+	if (args && strlen(args) > 0) {
+		if (!(arg = strdup(args)))
+			return 2;
+		tok = strtok_r(arg, ",", &saveptr);
+		while (tok && i < 3) {
+			if (!str_to_int(tok, &params[i++], 10)) {
+				free(arg);
+				return 1;
+			}
+			tok = strtok_r(NULL, ",", &saveptr);
+		}
+		free(arg);
+		if (params[2] < 1)
+			return 1;
+	}
+
+	printf("uptime_ms");
+	for (uint ch = 0; ch < channels; ch++)
+		printf(",%s", history_channel_name(ch, buf, sizeof(buf)));
+	printf("\n");
+
+	history_query_init(&q, params[0], params[1], params[2]);
+	while (history_query_next(&q)) {
+		printf("%llu", q.it.t);
+		for (uint ch = 0; ch < channels; ch++)
+			printf(",%s", history_value_str(ch, q.it.values[ch], buf, sizeof(buf)));
+		printf("\n");
+#if WATCHDOG_ENABLED
+		if (q.matched % 256 == 0)
+			watchdog_update();
+#endif
+	}
+
+	return 0;
+}
+
+int cmd_history_info(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
+{
+	if (!query)
+		return 1;
+
+	print_history_info();
+	return 0;
+}
+
+int cmd_history_interval(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
+{
+	return uint32_setting(cmd, args, query, prev_cmd,
+			&conf->history_interval, 0, 86400, "History Interval");
+}
+
 int cmd_onewire(const char *cmd, const char *args, int query, struct prev_cmd_t *prev_cmd)
 {
 	return bool_setting(cmd, args, query, prev_cmd,
@@ -2917,6 +3120,7 @@ const struct cmd_t mqtt_interval_commands[] = {
 	{ "VSENsor",   4, NULL,              cmd_mqtt_vsensor_interval },
 	{ "RPM",       3, NULL,              cmd_mqtt_rpm_interval },
 	{ "PWM",       3, NULL,              cmd_mqtt_duty_interval },
+	{ "PERF",      4, NULL,              cmd_mqtt_perf_interval },
 	{ 0, 0, 0, 0 }
 };
 
@@ -2932,6 +3136,7 @@ const struct cmd_t mqtt_topic_commands[] = {
 	{ "FANPWM",    6, NULL,              cmd_mqtt_fan_duty_topic },
 	{ "MBFANRPM",  8, NULL,              cmd_mqtt_mbfan_rpm_topic },
 	{ "MBFANPWM",  8, NULL,              cmd_mqtt_mbfan_duty_topic },
+	{ "PERF",      4, NULL,              cmd_mqtt_perf_topic },
 	{ 0, 0, 0, 0 }
 };
 
@@ -3021,6 +3226,12 @@ const struct cmd_t tls_commands[] = {
 
 
 
+const struct cmd_t history_commands[] = {
+	{ "INFO",      4, NULL,              cmd_history_info },
+	{ "INTerval",  3, NULL,              cmd_history_interval },
+	{ 0, 0, 0, 0 }
+};
+
 const struct cmd_t i2c_commands[] = {
 	{ "SCAN",      4, NULL,              cmd_i2c_scan },
 	{ "SPEED",     5, NULL,              cmd_i2c_speed },
@@ -3034,7 +3245,18 @@ const struct cmd_t onewire_commands[] = {
 };
 #endif
 
+const struct cmd_t perf_commands[] = {
+	{ "BENCHmark", 5, NULL,              cmd_perf_bench },
+	{ 0, 0, 0, 0 }
+};
+
+const struct cmd_t adc_commands[] = {
+	{ "OVERsample",4, NULL,              cmd_adc_oversample },
+	{ 0, 0, 0, 0 }
+};
+
 const struct cmd_t system_commands[] = {
+	{ "ADC",       3, adc_commands,      NULL },
 	{ "BOARD",     5, NULL,              cmd_board },
 	{ "DEBUG",     5, NULL,              cmd_debug }, /* Obsolete ? */
 	{ "DISPlay",   4, display_commands,  cmd_display_type },
@@ -3042,6 +3264,7 @@ const struct cmd_t system_commands[] = {
 	{ "ERRor",     3, NULL,              cmd_err },
 	{ "FANS",      4, NULL,              cmd_fans },
 	{ "FLASH",     5, NULL,              cmd_flash },
+	{ "HISTory",   4, history_commands,  cmd_history },
 	{ "I2C",       3, i2c_commands,      cmd_i2c },
 	{ "LED",       3, NULL,              cmd_led },
 	{ "LFS",       3, lfs_commands,      cmd_lfs },
@@ -3053,6 +3276,7 @@ const struct cmd_t system_commands[] = {
 #if ONEWIRE_SUPPORT
 	{ "ONEWIRE",   7, onewire_commands,  cmd_onewire },
 #endif
+	{ "PERF",      4, perf_commands,     cmd_perf },
 	{ "PSRAM",     5, NULL,              cmd_psram },
 	{ "SENSORS",   7, NULL,              cmd_sensors },
 	{ "SERIAL",    6, NULL,              cmd_serial },
@@ -3083,6 +3307,12 @@ const struct cmd_t fan_hyst_commands[] = {
 	{ 0, 0, 0, 0 }
 };
 
+const struct cmd_t fan_tacho_commands[] = {
+	{ "PERiods",   3, NULL,              cmd_fan_tacho_periods },
+	{ "TIMEout",   4, NULL,              cmd_fan_tacho_timeout },
+	{ 0, 0, 0, 0 }
+};
+
 const struct cmd_t fan_c_commands[] = {
 	{ "FILTER",    6, NULL,              cmd_fan_filter },
 	{ "MAXpwm",    3, NULL,              cmd_fan_max_pwm },
@@ -3090,10 +3320,12 @@ const struct cmd_t fan_c_commands[] = {
 	{ "NAME",      4, NULL,              cmd_fan_name },
 	{ "PWMCoeff",  4, NULL,              cmd_fan_pwm_coef },
 	{ "PWMMap",    4, NULL,              cmd_fan_pwm_map },
+	{ "PWMSlew",   4, NULL,              cmd_fan_pwm_slew },
 	{ "RPMFactor", 4, NULL,              cmd_fan_rpm_factor },
 	{ "RPMMOde",   5, NULL,              cmd_fan_rpm_mode },
 	{ "SOUrce",    3, NULL,              cmd_fan_source },
 	{ "HYSTeresis",4, fan_hyst_commands, NULL },
+	{ "TACho",     3, fan_tacho_commands, NULL },
 	{ 0, 0, 0, 0 }
 };
 
@@ -3149,14 +3381,17 @@ const struct cmd_t config_commands[] = {
 };
 
 const struct cmd_t fan_commands[] = {
+	{ "AGE",       3, NULL,              cmd_fan_age },
 	{ "PWM",       3, NULL,              cmd_fan_pwm },
 	{ "Read",      1, NULL,              cmd_fan_read },
 	{ "RPM",       3, NULL,              cmd_fan_rpm },
+	{ "STATus",    4, NULL,              cmd_fan_status },
 	{ "TACho",     3, NULL,              cmd_fan_tacho },
 	{ 0, 0, 0, 0 }
 };
 
 const struct cmd_t mbfan_commands[] = {
+	{ "PWMFreq",   4, NULL,              cmd_mbfan_pwm_freq },
 	{ "PWM",       3, NULL,              cmd_mbfan_pwm },
 	{ "Read",      1, NULL,              cmd_mbfan_read },
 	{ "RPM",       3, NULL,              cmd_mbfan_rpm },
@@ -3231,12 +3466,14 @@ void process_command(const struct fanpico_state *state, struct fanpico_config *c
 	char *saveptr, *cmd;
 	struct prev_cmd_t cmd_stack;
 	const struct cmd_t *cmd_level = commands;
+	uint64_t t_start;
 
 	if (!state || !config || !command)
 		return;
 
 	st = state;
 	conf = config;
+	t_start = time_us_64();
 
 
 	cmd = strtok_r(command, ";", &saveptr);
@@ -3251,6 +3488,19 @@ void process_command(const struct fanpico_state *state, struct fanpico_config *c
 		}
 		cmd = strtok_r(NULL, ";", &saveptr);
 	}
+
+	sched_latency_add(&command_stats, time_us_64() - t_start);
+}
+
+/**
+ * Return execution time statistics of processed commands
+ * (from all sources: console, telnet, ssh and mqtt).
+ *
+ * @return pointer to statistics
+ */
+struct sched_latency_stats* get_command_stats()
+{
+	return &command_stats;
 }
 
 /**
@@ -46,6 +46,134 @@
 
 #include "command_util.h"
 
+/* Lookup index for (larger) command levels, to avoid scanning entries
+   linearly with strncasecmp() for every (sub)command. Index is built
+   on first use of each level from the cmd_t tables (instead of generating
+   a trie or perfect hash at build time), so command tables stay plain
+   C arrays and firmware build needs no code generator.
+
+   Index uses CMD_INDEX_LEVELS * 136 bytes of RAM (~1.6KB). Builds with
+   all features have 11 levels with CMD_INDEX_MIN_ENTRIES or more entries
+   (largest is SYStem with 38 entries). */
+
+#define CMD_INDEX_LEVELS       12  /* max number of levels to index */
+#define CMD_INDEX_SIZE        128  /* hash slots per level (power of two) */
+#ifndef CMD_INDEX_MIN_ENTRIES
+#define CMD_INDEX_MIN_ENTRIES   8  /* smaller levels are scanned linearly */
+#endif
+
+struct cmd_index {
+	const struct cmd_t *level;
+	uint32_t lengths; /* bitmask of min_match values used in this level */
+	uint8_t slot[CMD_INDEX_SIZE]; /* entry number + 1 (0 = empty slot) */
+};
+
+static struct cmd_index cmd_index[CMD_INDEX_LEVELS];
+static uint cmd_index_count = 0;
+
+
+/* Hash first 'len' characters (case-insensitive) of string. If string is
+   shorter, hash includes the terminating null to match strncasecmp(). */
+static uint32_t cmd_hash(const char *s, uint len)
+{
+	uint32_t h = 2166136261U;
+
+	for (uint i = 0; i < len; i++) {
+		uint8_t c = toupper((unsigned char)s[i]);
+		h = (h ^ c) * 16777619U;
+		if (!c)
+			break;
+	}
+
+	return h;
+}
+
+
+static const struct cmd_index* cmd_level_index(const struct cmd_t *level)
+{
+	struct cmd_index *idx;
+	uint count = 0;
+
+	for (uint i = 0; i < cmd_index_count; i++) {
+		if (cmd_index[i].level == level)
+			return &cmd_index[i];
+	}
+	if (cmd_index_count >= CMD_INDEX_LEVELS)
+		return NULL;
+
+	while (level[count].cmd) {
+		uint m = level[count].min_match;
+		if (m < 1 || m > 31)
+			return NULL;
+		count++;
+	}
+	if (count < CMD_INDEX_MIN_ENTRIES || count > CMD_INDEX_SIZE / 2)
+		return NULL;
+
+	idx = &cmd_index[cmd_index_count++];
+	memset(idx, 0, sizeof(*idx));
+	idx->level = level;
+	for (uint i = 0; i < count; i++) {
+		uint m = level[i].min_match;
+		uint32_t h = cmd_hash(level[i].cmd, m);
+
+		idx->lengths |= (1UL << m);
+		while (idx->slot[h & (CMD_INDEX_SIZE - 1)])
+			h++;
+		idx->slot[h & (CMD_INDEX_SIZE - 1)] = i + 1;
+	}
+
+	return idx;
+}
+
+
+/**
+ * Find command from given command level.
+ *
+ * Matching is same as comparing each entry (in order) using
+ * strncasecmp() with entry's min_match length, and returns first
+ * matching entry.
+ *
+ * @param level command level (array of commands)
+ * @param s command string
+ *
+ * @return index of matching command (or -1 if no match found)
+ */
+static int find_cmd(const struct cmd_t *level, const char *s)
+{
+	const struct cmd_index *idx = cmd_level_index(level);
+	int found = -1;
+
+	if (!idx) {
+		for (int i = 0; level[i].cmd; i++) {
+			if (!strncasecmp(s, level[i].cmd, level[i].min_match))
+				return i;
+		}
+		return -1;
+	}
+
+	for (uint m = 1; m < 32; m++) {
+		if (!(idx->lengths & (1UL << m)))
+			continue;
+		uint32_t h = cmd_hash(s, m);
+		uint8_t e;
+		/* Entries are inserted in order, so first match found
+		   for given length is also the first in the command level. */
+		while ((e = idx->slot[h++ & (CMD_INDEX_SIZE - 1)])) {
+			e--;
+			if (level[e].min_match == m
+				&& !strncasecmp(s, level[e].cmd, m)) {
+				if (found < 0 || e < found)
+					found = e;
+				break;
+			}
+		}
+	}
+
+	return found;
+}
+
+
 /**
  * Process (SCPI) command and execute associated command function.
  *
@@ -79,31 +207,28 @@ const struct cmd_t* run_cmd(char *cmd, const struct cmd_t *commands, const struc
 		while (sub && strlen(sub) > 0) {
 			s = sub;
 			sub = NULL;
-			i = 0;
-			while (cmd_level[i].cmd) {
-				if (!strncasecmp(s, cmd_level[i].cmd, cmd_level[i].min_match)) {
-					sub = strtok_r(NULL, ":", &saveptr2);
-					if (cmd_level[i].subcmds && sub && strlen(sub) > 0) {
-						/* Match for subcommand...*/
-						if (cmd_stack->depth < MAX_CMD_DEPTH)
-							cmd_stack->cmds[cmd_stack->depth++] = s;
-						cmd_level = cmd_level[i].subcmds;
-					} else if (cmd_level[i].func) {
-						/* Match for command */
-						query = (s[strlen(s)-1] == '?' ? 1 : 0);
-						arg = t + cmd_len + 1;
-						if (!query)
-							mutex_enter_blocking(config_mutex);
-						res = cmd_level[i].func(s,
-								(total_len > cmd_len+1 ? arg : ""),
-								query,
-								cmd_stack);
-						if (!query)
-							mutex_exit(config_mutex);
+			if ((i = find_cmd(cmd_level, s)) >= 0) {
+				sub = strtok_r(NULL, ":", &saveptr2);
+				if (cmd_level[i].subcmds && sub && strlen(sub) > 0) {
+					/* Match for subcommand...*/
+					if (cmd_stack->depth < MAX_CMD_DEPTH)
+						cmd_stack->cmds[cmd_stack->depth++] = s;
+					cmd_level = cmd_level[i].subcmds;
+				} else if (cmd_level[i].func) {
+					/* Match for command */
+					query = (s[strlen(s)-1] == '?' ? 1 : 0);
+					arg = t + cmd_len + 1;
+					if (!query)
+						mutex_enter_blocking(config_mutex);
+					res = cmd_level[i].func(s,
+							(total_len > cmd_len+1 ? arg : ""),
+							query,
+							cmd_stack);
+					if (!query) {
+						update_control_config_generation();
+						mutex_exit(config_mutex);
 					}
-					break;
 				}
-				i++;
 			}
 		}
 	}
@@ -32,6 +32,7 @@
 #endif
 
 #include "fanpico.h"
+#include "tacho_estimator.h"
 
 /* Default configuration embedded using  default_config.s */
 extern const char fanpico_default_config[];
@@ -42,6 +43,12 @@ const struct fanpico_config *cfg = &fanpico_config;
 auto_init_mutex(config_mutex_inst);
 mutex_t *config_mutex = &config_mutex_inst;
 
+/* Control config generation, incremented every time configuration
+   used by the control loop changes. */
+static volatile uint32_t control_config_gen = 0;
+static uint32_t control_config_crc = 0;
+
+
 int str2pwm_source(const char *s)
 {
 	int ret = PWM_FIXED;
@@ -270,20 +277,37 @@ static cJSON* pwm_map2json(const struct pwm_map *map)
 }
 
 
-static void json2filter(cJSON *item, enum signal_filter_types *filter, void **filter_ctx)
+static void json2filter_stage(cJSON *item, struct filter_chain *chain)
 {
+	const char *name = cJSON_GetStringValue(cJSON_GetObjectItem(item, "name"));
 	cJSON *args;
 
-	*filter = str2filter(cJSON_GetStringValue(cJSON_GetObjectItem(item, "name")));
-	if ((args = cJSON_GetObjectItem(item, "args")) && *filter != FILTER_NONE) {
-		*filter_ctx =  filter_parse_args(*filter, cJSON_GetStringValue(args));
-		if (!*filter_ctx)
-			*filter = FILTER_NONE;
+	if (!name || !(args = cJSON_GetObjectItem(item, "args")))
+		return;
+	if (filter_chain_add(chain, str2filter(name), cJSON_GetStringValue(args)))
+		log_msg(LOG_NOTICE, "Invalid filter: %s", name);
+}
+
+
+/* Filter is either a single filter object, or an array of filter objects
+ * (filter chain).
+ */
+static void json2filter(cJSON *item, struct filter_chain *chain)
+{
+	cJSON *stage;
+
+	memset(chain, 0, sizeof(*chain));
+	if (cJSON_IsArray(item)) {
+		cJSON_ArrayForEach(stage, item) {
+			json2filter_stage(stage, chain);
+		}
+	} else {
+		json2filter_stage(item, chain);
 	}
 }
 
 
-static cJSON* filter2json(enum signal_filter_types filter, void *filter_ctx)
+static cJSON* filter_stage2json(enum signal_filter_types filter, const float *args)
 {
 	cJSON *o;
 	char *s;
@@ -292,7 +316,7 @@ static cJSON* filter2json(enum signal_filter_types filter, void *filter_ctx)
 		return NULL;
 
 	cJSON_AddItemToObject(o, "name", cJSON_CreateString(filter2str(filter)));
-	if ((s = filter_print_args(filter, filter_ctx))) {
+	if ((s = filter_print_args(filter, args))) {
 		cJSON_AddItemToObject(o, "args", cJSON_CreateString(s));
 		free(s);
 	}
@@ -301,6 +325,27 @@ static cJSON* filter2json(enum signal_filter_types filter, void *filter_ctx)
 }
 
 
+static cJSON* filter2json(const struct filter_chain *chain)
+{
+	cJSON *a;
+
+	/* Use (backwards compatible) single object unless there are multiple filters */
+	if (chain->stages == 0)
+		return filter_stage2json(FILTER_NONE, NULL);
+	if (chain->stages == 1)
+		return filter_stage2json(chain->stage[0].filter, chain->stage[0].args);
+
+	if ((a = cJSON_CreateArray()) == NULL)
+		return NULL;
+	for (int i = 0; i < chain->stages; i++) {
+		cJSON_AddItemToArray(a, filter_stage2json(chain->stage[i].filter,
+								chain->stage[i].args));
+	}
+
+	return a;
+}
+
+
 static void json2tacho_map(cJSON *item, struct tacho_map *map)
 {
 	cJSON *row;
@@ -619,8 +664,7 @@ void clear_config(struct fanpico_config *cfg)
 		s->temp_offset = 0.0;
 		s->temp_coefficient = 0.0;
 		s->map.points = 0;
-		s->filter = FILTER_NONE;
-		s->filter_ctx = NULL;
+		memset(&s->filter, 0, sizeof(s->filter));
 	}
 
 	for (i = 0; i < VSENSOR_MAX_COUNT; i++) {
@@ -640,8 +684,7 @@ void clear_config(struct fanpico_config *cfg)
 		vs->map.temp[0][1] = 0.0;
 		vs->map.temp[1][0] = 50.0;
 		vs->map.temp[1][1] = 100.0;
-		vs->filter = FILTER_NONE;
-		vs->filter_ctx = NULL;
+		memset(&vs->filter, 0, sizeof(vs->filter));
 
 		cfg->vtemp[i] = 0.0;
 		cfg->vhumidity[i] = 0.0;
@@ -657,6 +700,7 @@ void clear_config(struct fanpico_config *cfg)
 		f->min_pwm = 0;
 		f->max_pwm = 0;
 		f->pwm_coefficient = 0.0;
+		f->pwm_slew = 0.0;
 		f->s_type = PWM_FIXED;
 		f->s_id = 0;
 		f->map.points = 0;
@@ -664,10 +708,11 @@ void clear_config(struct fanpico_config *cfg)
 		f->lra_low = 1000;
 		f->lra_high = 0;
 		f->rpm_factor = 2;
-		f->filter = FILTER_NONE;
-		f->filter_ctx = NULL;
+		memset(&f->filter, 0, sizeof(f->filter));
 		f->tacho_hyst = FAN_TACHO_HYSTERESIS;
 		f->pwm_hyst = FAN_PWM_HYSTERESIS;
+		f->tacho_periods = FAN_TACHO_PERIODS;
+		f->tacho_timeout = FAN_TACHO_TIMEOUT;
 	}
 
 	for (i = 0; i < MBFAN_MAX_COUNT; i++) {
@@ -684,8 +729,7 @@ void clear_config(struct fanpico_config *cfg)
 		m->s_type = TACHO_FIXED;
 		m->s_id = 0;
 		m->map.points = 0;
-		m->filter = FILTER_NONE;
-		m->filter_ctx = NULL;
+		memset(&m->filter, 0, sizeof(m->filter));
 		for (j = 0; j < FAN_MAX_COUNT; j++)
 			m->sources[j] = 0;
 	}
@@ -696,6 +740,8 @@ void clear_config(struct fanpico_config *cfg)
 	cfg->onewire_active = false;
 	cfg->i2c_speed = I2C_DEFAULT_SPEED;
 	cfg->adc_vref = ADC_REF_VOLTAGE;
+	cfg->adc_oversample = ADC_OVERSAMPLE;
+	cfg->history_interval = DEFAULT_HISTORY_INTERVAL;
 	cfg->led_mode = 0;
 	strncopy(cfg->name, "fanpico1", sizeof(cfg->name));
 	strncopy(cfg->display_type, "default", sizeof(cfg->display_type));
@@ -747,11 +793,13 @@ void clear_config(struct fanpico_config *cfg)
 	cfg->mqtt_fan_duty_topic[0] = 0;
 	cfg->mqtt_mbfan_rpm_topic[0] = 0;
 	cfg->mqtt_mbfan_duty_topic[0] = 0;
+	cfg->mqtt_perf_topic[0] = 0;
 	cfg->mqtt_status_interval = DEFAULT_MQTT_STATUS_INTERVAL;
 	cfg->mqtt_temp_interval = DEFAULT_MQTT_TEMP_INTERVAL;
 	cfg->mqtt_vsensor_interval = DEFAULT_MQTT_TEMP_INTERVAL;
 	cfg->mqtt_rpm_interval = DEFAULT_MQTT_RPM_INTERVAL;
 	cfg->mqtt_duty_interval = DEFAULT_MQTT_DUTY_INTERVAL;
+	cfg->mqtt_perf_interval = DEFAULT_MQTT_PERF_INTERVAL;
 	cfg->mqtt_ha_discovery_prefix[0] = 0;
 	cfg->telnet_active = false;
 	cfg->telnet_auth = true;
@@ -846,6 +894,10 @@ cJSON *config_to_json(const struct fanpico_config *cfg)
 	cJSON_AddItemToObject(config, "onewire_active", cJSON_CreateNumber(cfg->onewire_active));
 	cJSON_AddItemToObject(config, "i2c_speed", cJSON_CreateNumber(cfg->i2c_speed));
 	cJSON_AddItemToObject(config, "adc_vref", cJSON_CreateNumber(cfg->adc_vref)); //Zitt
+	if (cfg->adc_oversample != ADC_OVERSAMPLE)
+		NUM_TO_JSON("adc_oversample", cfg->adc_oversample);
+	if (cfg->history_interval != DEFAULT_HISTORY_INTERVAL)
+		NUM_TO_JSON("history_interval", cfg->history_interval);
 	STRING_TO_JSON("display_type", cfg->display_type);
 	STRING_TO_JSON("display_theme", cfg->display_theme);
 	STRING_TO_JSON("display_logo", cfg->display_logo);
@@ -896,6 +948,8 @@ cJSON *config_to_json(const struct fanpico_config *cfg)
 		NUM_TO_JSON("mqtt_rpm_interval", cfg->mqtt_rpm_interval);
 	if (cfg->mqtt_duty_interval != DEFAULT_MQTT_DUTY_INTERVAL)
 		NUM_TO_JSON("mqtt_duty_interval", cfg->mqtt_duty_interval);
+	if (cfg->mqtt_perf_interval != DEFAULT_MQTT_PERF_INTERVAL)
+		NUM_TO_JSON("mqtt_perf_interval", cfg->mqtt_perf_interval);
 	BITMASK_TO_JSON("mqtt_temp_mask", cfg->mqtt_temp_mask, SENSOR_MAX_COUNT);
 	BITMASK_TO_JSON("mqtt_vtemp_mask", cfg->mqtt_vtemp_mask, VSENSOR_MAX_COUNT);
 	BITMASK_TO_JSON("mqtt_vhumidity_mask", cfg->mqtt_vhumidity_mask, VSENSOR_MAX_COUNT);
@@ -912,6 +966,7 @@ cJSON *config_to_json(const struct fanpico_config *cfg)
 	STRING_TO_JSON("mqtt_fan_duty_topic", cfg->mqtt_fan_duty_topic);
 	STRING_TO_JSON("mqtt_mbfan_rpm_topic", cfg->mqtt_mbfan_rpm_topic);
 	STRING_TO_JSON("mqtt_mbfan_duty_topic", cfg->mqtt_mbfan_duty_topic);
+	STRING_TO_JSON("mqtt_perf_topic", cfg->mqtt_perf_topic);
 	STRING_TO_JSON("mqtt_ha_discovery_prefix", cfg->mqtt_ha_discovery_prefix);
 	if (cfg->telnet_active)
 		NUM_TO_JSON("telnet_active", cfg->telnet_active);
@@ -978,15 +1033,18 @@ cJSON *config_to_json(const struct fanpico_config *cfg)
 		cJSON_AddItemToObject(o, "min_pwm", cJSON_CreateNumber(f->min_pwm));
 		cJSON_AddItemToObject(o, "max_pwm", cJSON_CreateNumber(f->max_pwm));
 		cJSON_AddItemToObject(o, "pwm_coefficient", cJSON_CreateNumber(f->pwm_coefficient));
+		cJSON_AddItemToObject(o, "pwm_slew", cJSON_CreateNumber(f->pwm_slew));
 		cJSON_AddItemToObject(o, "source_type", cJSON_CreateString(pwm_source2str(f->s_type)));
 		cJSON_AddItemToObject(o, "source_id", cJSON_CreateNumber(f->s_id));
 		cJSON_AddItemToObject(o, "pwm_map", pwm_map2json(&f->map));
-		cJSON_AddItemToObject(o, "filter", filter2json(f->filter, f->filter_ctx));
+		cJSON_AddItemToObject(o, "filter", filter2json(&f->filter));
 		cJSON_AddItemToObject(o, "rpm_mode", cJSON_CreateString(rpm_mode2str(f->rpm_mode)));
 		cJSON_AddItemToObject(o, "rpm_factor", cJSON_CreateNumber(f->rpm_factor));
 		cJSON_AddItemToObject(o, "lra_low", cJSON_CreateNumber(f->lra_low));
 		cJSON_AddItemToObject(o, "lra_high", cJSON_CreateNumber(f->lra_high));
 		cJSON_AddItemToObject(o, "tach_hyst", cJSON_CreateNumber(f->tacho_hyst));
+		cJSON_AddItemToObject(o, "tach_periods", cJSON_CreateNumber(f->tacho_periods));
+		cJSON_AddItemToObject(o, "tach_timeout", cJSON_CreateNumber(f->tacho_timeout));
 		cJSON_AddItemToObject(o, "pwm_hyst", cJSON_CreateNumber(f->pwm_hyst));
 		cJSON_AddItemToArray(fans, o);
 	}
@@ -1017,7 +1075,7 @@ cJSON *config_to_json(const struct fanpico_config *cfg)
 		if (m->s_type == TACHO_MIN || m->s_type == TACHO_MAX || m->s_type == TACHO_AVG)
 			cJSON_AddItemToObject(o, "sources", tacho_sources2json(m->sources));
 		cJSON_AddItemToObject(o, "rpm_map", tacho_map2json(&m->map));
-		cJSON_AddItemToObject(o, "filter", filter2json(m->filter, m->filter_ctx));
+		cJSON_AddItemToObject(o, "filter", filter2json(&m->filter));
 		cJSON_AddItemToArray(mbfans, o);
 	}
 	cJSON_AddItemToObject(config, "mbfans", mbfans);
@@ -1046,7 +1104,7 @@ cJSON *config_to_json(const struct fanpico_config *cfg)
 			cJSON_AddItemToObject(o, "beta_coefficient",
 					cJSON_CreateNumber(s->beta_coefficient));
 		}
-		cJSON_AddItemToObject(o, "filter", filter2json(s->filter, s->filter_ctx));
+		cJSON_AddItemToObject(o, "filter", filter2json(&s->filter));
 		cJSON_AddItemToArray(sensors, o);
 	}
 	cJSON_AddItemToObject(config, "sensors", sensors);
@@ -1079,7 +1137,7 @@ cJSON *config_to_json(const struct fanpico_config *cfg)
 		} else {
 			cJSON_AddItemToObject(o, "sensors", vsensors2json(s->sensors));
 		}
-		cJSON_AddItemToObject(o, "filter", filter2json(s->filter, s->filter_ctx));
+		cJSON_AddItemToObject(o, "filter", filter2json(&s->filter));
 		cJSON_AddItemToArray(vsensors, o);
 	}
 	cJSON_AddItemToObject(config, "vsensors", vsensors);
@@ -1168,6 +1226,10 @@ int json_to_config(cJSON *config, struct fanpico_config *cfg)
 	JSON_TO_NUM(config, "onewire_active", cfg->onewire_active);
 	JSON_TO_NUM(config, "i2c_speed", cfg->i2c_speed);
 	JSON_TO_NUM(config, "adc_vref", cfg->adc_vref);
+	JSON_TO_NUM(config, "adc_oversample", cfg->adc_oversample);
+	if (cfg->adc_oversample < 1 || cfg->adc_oversample > ADC_MAX_OVERSAMPLE)
+		cfg->adc_oversample = ADC_OVERSAMPLE;
+	JSON_TO_NUM(config, "history_interval", cfg->history_interval);
 	JSON_TO_STRING(config, "display_type", cfg->display_type);
 	JSON_TO_STRING(config, "display_theme", cfg->display_theme);
 	JSON_TO_STRING(config, "display_logo", cfg->display_logo);
@@ -1211,6 +1273,7 @@ int json_to_config(cJSON *config, struct fanpico_config *cfg)
 	JSON_TO_NUM(config, "mqtt_vsensor_interval", cfg->mqtt_vsensor_interval);
 	JSON_TO_NUM(config, "mqtt_rpm_interval", cfg->mqtt_rpm_interval);
 	JSON_TO_NUM(config, "mqtt_duty_interval", cfg->mqtt_duty_interval);
+	JSON_TO_NUM(config, "mqtt_perf_interval", cfg->mqtt_perf_interval);
 	JSON_TO_BITMASK(config, "mqtt_temp_mask", cfg->mqtt_temp_mask, SENSOR_MAX_COUNT);
 	JSON_TO_BITMASK(config, "mqtt_vtemp_mask", cfg->mqtt_vtemp_mask, VSENSOR_MAX_COUNT);
 	JSON_TO_BITMASK(config, "mqtt_vhumidity_mask", cfg->mqtt_vhumidity_mask, VSENSOR_MAX_COUNT);
@@ -1227,6 +1290,7 @@ int json_to_config(cJSON *config, struct fanpico_config *cfg)
 	JSON_TO_STRING(config, "mqtt_fan_duty_topic", cfg->mqtt_fan_duty_topic);
 	JSON_TO_STRING(config, "mqtt_mbfan_rpm_topic", cfg->mqtt_mbfan_rpm_topic);
 	JSON_TO_STRING(config, "mqtt_mbfan_duty_topic", cfg->mqtt_mbfan_duty_topic);
+	JSON_TO_STRING(config, "mqtt_perf_topic", cfg->mqtt_perf_topic);
 	JSON_TO_STRING(config, "mqtt_ha_discovery_prefix", cfg->mqtt_ha_discovery_prefix);
 
 	JSON_TO_NUM(config, "telnet_active", cfg->telnet_active);
@@ -1276,10 +1340,19 @@ int json_to_config(cJSON *config, struct fanpico_config *cfg)
 			JSON_TO_NUM(item, "min_pwm", f->min_pwm);
 			JSON_TO_NUM(item, "max_pwm", f->max_pwm);
 			JSON_TO_NUM(item, "pwm_coefficient", f->pwm_coefficient);
+			JSON_TO_NUM(item, "pwm_slew", f->pwm_slew);
+			if (f->pwm_slew < 0.0)
+				f->pwm_slew = 0.0;
 			JSON_TO_NUM(item, "rpm_factor", f->rpm_factor);
 			JSON_TO_NUM(item, "lra_low", f->lra_low);
 			JSON_TO_NUM(item, "lra_high", f->lra_high);
 			JSON_TO_NUM(item, "tach_hyst", f->tacho_hyst);
+			JSON_TO_NUM(item, "tach_periods", f->tacho_periods);
+			if (f->tacho_periods < 1 || f->tacho_periods > TACHO_EST_MAX_PERIODS)
+				f->tacho_periods = FAN_TACHO_PERIODS;
+			JSON_TO_NUM(item, "tach_timeout", f->tacho_timeout);
+			if (f->tacho_timeout < 100)
+				f->tacho_timeout = FAN_TACHO_TIMEOUT;
 			JSON_TO_NUM(item, "pwm_hyst", f->pwm_hyst);
 			JSON_TO_NUM(item, "source_id", f->s_id);
 			if ((r = cJSON_GetObjectItem(item, "source_type")))
@@ -1289,7 +1362,7 @@ int json_to_config(cJSON *config, struct fanpico_config *cfg)
 			if ((r = cJSON_GetObjectItem(item, "pwm_map")))
 				json2pwm_map(r, &f->map);
 			if ((r = cJSON_GetObjectItem(item, "filter")))
-				json2filter(r, &f->filter, &f->filter_ctx);
+				json2filter(r, &f->filter);
 		}
 	}
 
@@ -1317,7 +1390,7 @@ int json_to_config(cJSON *config, struct fanpico_config *cfg)
 			if ((r = cJSON_GetObjectItem(item, "rpm_map")))
 				json2tacho_map(r, &m->map);
 			if ((r = cJSON_GetObjectItem(item, "filter")))
-				json2filter(r, &m->filter, &m->filter_ctx);
+				json2filter(r, &m->filter);
 		}
 	}
 
@@ -1340,7 +1413,7 @@ int json_to_config(cJSON *config, struct fanpico_config *cfg)
 			if ((r = cJSON_GetObjectItem(item, "temp_map")))
 				json2temp_map(r, &s->map);
 			if ((r = cJSON_GetObjectItem(item, "filter")))
-				json2filter(r, &s->filter, &s->filter_ctx);
+				json2filter(r, &s->filter);
 		}
 	}
 
@@ -1371,14 +1444,110 @@ int json_to_config(cJSON *config, struct fanpico_config *cfg)
 			if ((r = cJSON_GetObjectItem(item, "temp_map")))
 				json2temp_map(r, &s->map);
 			if ((r = cJSON_GetObjectItem(item, "filter")))
-				json2filter(r, &s->filter, &s->filter_ctx);
+				json2filter(r, &s->filter);
 		}
 	}
 
+	filter_config_check(cfg);
+
 	return 0;
 }
 
 
+static uint32_t control_config_checksum(const struct fanpico_config *config)
+{
+	uint32_t crc;
+
+	crc = xcrc32((const unsigned char*)config->sensors, sizeof(config->sensors), 0);
+	crc = xcrc32((const unsigned char*)config->vsensors, sizeof(config->vsensors), crc);
+	crc = xcrc32((const unsigned char*)config->fans, sizeof(config->fans), crc);
+	crc = xcrc32((const unsigned char*)config->mbfans, sizeof(config->mbfans), crc);
+	crc = xcrc32((const unsigned char*)&config->onewire_active,
+		sizeof(config->onewire_active), crc);
+	crc = xcrc32((const unsigned char*)&config->adc_vref, sizeof(config->adc_vref), crc);
+	crc = xcrc32((const unsigned char*)&config->adc_oversample,
+		sizeof(config->adc_oversample), crc);
+
+	return crc;
+}
+
+
+/* Precompile scaling and thermistor lookup tables used by the control
+ * loop (maps are compiled into control loop configuration, see
+ * get_control_config()).
+ */
+static void compile_control_config(struct fanpico_config *config)
+{
+	for (int i = 0; i < FAN_COUNT; i++)
+		fan_output_compile(&config->fans[i]);
+	for (int i = 0; i < MBFAN_COUNT; i++)
+		mb_input_compile(&config->mbfans[i]);
+	for (int i = 0; i < SENSOR_COUNT; i++) {
+		struct sensor_input *s = &config->sensors[i];
+
+		sensor_input_compile(s);
+		if (s->type != TEMP_INTERNAL
+			&& thermistor_lut_build(&config->thermistor_lut[i], s))
+			log_msg(LOG_INFO, "sensor%d: built thermistor lookup table", i + 1);
+	}
+}
+
+
+/* Check if control loop configuration has changed since last call,
+ * and increment control config generation if it has.
+ * Must be called while holding config_mutex.
+ */
+void update_control_config_generation()
+{
+	uint32_t crc;
+
+	compile_control_config(&fanpico_config);
+	crc = control_config_checksum(cfg);
+
+	if (crc != control_config_crc) {
+		control_config_crc = crc;
+		control_config_gen++;
+		log_msg(LOG_DEBUG, "control config generation: %lu", control_config_gen);
+	}
+}
+
+
+uint32_t control_config_generation()
+{
+	return control_config_gen;
+}
+
+
+/* Copy control loop configuration from (full) configuration.
+ * Must be called while holding config_mutex.
+ */
+void get_control_config(struct fanpico_control_config *ctrl, const struct fanpico_config *config)
+{
+	memcpy(ctrl->sensors, config->sensors, sizeof(ctrl->sensors));
+	memcpy(ctrl->vsensors, config->vsensors, sizeof(ctrl->vsensors));
+	memcpy(ctrl->fans, config->fans, sizeof(ctrl->fans));
+	memcpy(ctrl->mbfans, config->mbfans, sizeof(ctrl->mbfans));
+	memcpy(ctrl->thermistor_lut, config->thermistor_lut, sizeof(ctrl->thermistor_lut));
+	ctrl->onewire_active = config->onewire_active;
+	ctrl->adc_vref = config->adc_vref;
+	ctrl->adc_oversample = config->adc_oversample;
+	build_control_graph(&ctrl->graph, ctrl->vsensors, ctrl->fans);
+	pwl_maps_compile(&ctrl->maps, ctrl);
+}
+
+
+/* Copy (non-config) virtual sensor inputs updated on core0.
+ * Must be called while holding config_mutex.
+ */
+void get_control_config_inputs(struct fanpico_control_config *ctrl, const struct fanpico_config *config)
+{
+	memcpy(ctrl->vtemp, config->vtemp, sizeof(ctrl->vtemp));
+	memcpy(ctrl->vhumidity, config->vhumidity, sizeof(ctrl->vhumidity));
+	memcpy(ctrl->vpressure, config->vpressure, sizeof(ctrl->vpressure));
+	memcpy(ctrl->vtemp_updated, config->vtemp_updated, sizeof(ctrl->vtemp_updated));
+}
+
+
 void read_config(bool use_default_config)
 {
 	const char *default_config = fanpico_default_config;
@@ -1424,11 +1593,15 @@ void read_config(bool use_default_config)
 	if (json_to_config(config, &fanpico_config) < 0) {
 		log_msg(LOG_ERR, "Error parsing JSON configuration");
 	}
+	if (!check_control_graph(&fanpico_config)) {
+		log_msg(LOG_WARNING, "Invalid source configuration, using default evaluation order");
+	}
 	if (use_default_config) {
 		/* Enable more verbose logging if in "safe-mode" ... */
 		set_log_level(LOG_INFO);
 		fanpico_config.local_echo = true;
 	}
+	update_control_config_generation();
 	mutex_exit(config_mutex);
 
 	cJSON_Delete(config);
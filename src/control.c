@@ -0,0 +1,359 @@
+/* control.c
+   Copyright (C) 2021-2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "pico/stdlib.h"
+
+#include "fanpico.h"
+
+
+/*
+ * Control loop tasks (run on FANPICO_CONTROL_CORE). Tasks read inputs
+ * (tachometer, PWM and temperature signals), and update outputs (fan PWM
+ * and motherboard tachometer signals) that depend on them.
+ *
+ * All state is passed in struct control_context, so these can be
+ * run (and tested) outside of the firmware as well.
+ */
+
+/* Sensors with a filter are sampled at fixed (slower) rate, so that
+ * filter settings (like SMA window size) keep their original meaning.
+ */
+#define TEMP_FILTER_INTERVAL 2000  /* ms */
+
+/* How often to retry starting ADC sampler (if it failed to start). */
+#define ADC_SAMPLER_RETRY_INTERVAL 10000  /* ms */
+
+
+void control_init(struct control_context *ctx, struct fanpico_state *state,
+		struct fanpico_control_config *config)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->state = state;
+	ctx->config = config;
+}
+
+
+static void input_event(struct control_context *ctx, uint32_t *mask, int i)
+{
+	struct input_events *ev = &ctx->events;
+
+	if (!ev->mbfan && !ev->sensor && !ev->vsensor && !ev->fan)
+		ev->t_first = time_us_64();
+	*mask |= (1UL << i);
+}
+
+
+static bool update_fan_output(struct fanpico_state *state, const struct fanpico_control_config *config, int i)
+{
+	float hyst = config->fans[i].pwm_hyst;
+
+	state->fan_duty[i] = calculate_pwm_duty(state, config, i);
+	if (check_for_change(state->fan_duty_prev[i], state->fan_duty[i], hyst)) {
+		log_msg(LOG_INFO, "fan%d: Set output PWM %.1f%% --> %.1f%%",
+			i+1,
+			state->fan_duty_prev[i],
+			state->fan_duty[i]);
+		state->fan_duty_prev[i] = state->fan_duty[i];
+		set_pwm_duty_cycle(i, state->fan_duty[i]);
+		return true;
+	}
+	return false;
+}
+
+
+static bool update_mbfan_output(struct fanpico_state *state, const struct fanpico_control_config *config, int i)
+{
+	state->mbfan_freq[i] = calculate_tacho_freq(state, config, i);
+	if (check_for_change(state->mbfan_freq_prev[i], state->mbfan_freq[i], 1.0)) {
+		log_msg(LOG_INFO, "mbfan%d: Set output Tacho %.2fHz --> %.2fHz",
+			i+1,
+			state->mbfan_freq_prev[i],
+			state->mbfan_freq[i]);
+		state->mbfan_freq_prev[i] = state->mbfan_freq[i];
+		if (config->mbfans[i].rpm_mode == RMODE_TACHO) {
+			set_tacho_output_freq(i, state->mbfan_freq[i]);
+		} else {
+			int rpm = state->mbfan_freq[i] * 60 / config->mbfans[i].rpm_factor;
+			bool lra = (rpm < config->mbfans[i].lra_treshold ? true : false);
+			set_lra_output(i, config->mbfans[i].lra_invert ? !lra : lra);
+		}
+		return true;
+	}
+	return false;
+}
+
+
+void update_outputs(struct control_context *ctx)
+{
+	struct fanpico_state *state = ctx->state;
+	const struct fanpico_control_config *config = ctx->config;
+
+	/* Update fan PWM signals (in dependency order) */
+	for (int n = 0; n < FAN_COUNT; n++) {
+		update_fan_output(state, config, config->graph.fan_order[n]);
+	}
+	update_pwm_outputs(config);
+
+	/* Update mb tacho signals */
+	for (int i = 0; i < MBFAN_COUNT; i++) {
+		update_mbfan_output(state, config, i);
+	}
+}
+
+
+/* Update only outputs that depend on inputs that have changed.
+ *
+ * Outputs with a filter are skipped (left for periodic update), since
+ * filters expect to be sampled at regular intervals.
+ */
+static void update_outputs_on_events(struct control_context *ctx)
+{
+	struct fanpico_state *state = ctx->state;
+	const struct fanpico_control_config *config = ctx->config;
+	struct input_events *ev = &ctx->events;
+	uint32_t changed = 0;
+	bool updated = false;
+
+	if (!ev->mbfan && !ev->sensor && !ev->vsensor && !ev->fan)
+		return;
+
+	for (int n = 0; n < FAN_COUNT; n++) {
+		int i = config->graph.fan_order[n];
+		const struct fan_output *fan = &config->fans[i];
+		uint32_t mask = 0;
+
+		if (fan->filter.stages > 0)
+			continue;
+
+		switch (fan->s_type) {
+		case PWM_MB:
+			mask = ev->mbfan;
+			break;
+		case PWM_SENSOR:
+			mask = ev->sensor;
+			break;
+		case PWM_VSENSOR:
+			mask = ev->vsensor;
+			break;
+		case PWM_FAN:
+			/* Fans are processed in dependency order, so source fan has been updated already */
+			mask = changed;
+			break;
+		default:
+			continue;
+		}
+		if (!(mask & (1UL << fan->s_id)))
+			continue;
+		if (update_fan_output(state, config, i)) {
+			changed |= (1UL << i);
+			updated = true;
+		}
+	}
+	if (changed)
+		update_pwm_outputs(config);
+
+	if (ev->fan) {
+		for (int i = 0; i < MBFAN_COUNT; i++) {
+			const struct mb_input *mbfan = &config->mbfans[i];
+			uint32_t sources = 0;
+
+			if (mbfan->s_type == TACHO_FAN) {
+				sources = (1UL << mbfan->s_id);
+			} else if (mbfan->s_type != TACHO_FIXED) {
+				for (int j = 0; j < FAN_COUNT; j++) {
+					if (mbfan->sources[j])
+						sources |= (1UL << j);
+				}
+			}
+			if (ev->fan & sources) {
+				if (update_mbfan_output(state, config, i))
+					updated = true;
+			}
+		}
+	}
+
+	if (updated)
+		sched_latency_add(&ctx->output_latency, time_us_64() - ev->t_first);
+	memset(ev, 0, sizeof(*ev));
+}
+
+
+int control_read_tacho_task(void *arg)
+{
+	struct control_context *ctx = arg;
+
+	/* Tachometer inputs from Fans */
+	read_tacho_inputs(ctx->config);
+	return 0;
+}
+
+
+int control_tacho_freq_task(void *arg)
+{
+	struct control_context *ctx = arg;
+	uint32_t changed;
+
+	/* Calculate frequencies from input tachometer signals peridocially */
+	log_msg(LOG_DEBUG, "Updating tacho input signals.");
+	changed = update_tacho_input_freq(ctx->state, ctx->config);
+	for (int i = 0; i < FAN_COUNT; i++) {
+		if (changed & (1UL << i))
+			input_event(ctx, &ctx->events.fan, i);
+	}
+	update_outputs_on_events(ctx);
+	return 0;
+}
+
+
+int control_read_pwm_task(void *arg)
+{
+	struct control_context *ctx = arg;
+	struct fanpico_state *state = ctx->state;
+
+	/* PWM input signals (duty cycles) from "motherboard". */
+	if (!get_pwm_duty_cycles(ctx->config))
+		return 0;
+
+	/* New measurement available */
+	for (int i = 0; i < MBFAN_COUNT; i++) {
+		state->mbfan_duty[i] = roundf(mbfan_pwm_duty[i] * 10) / 10.0;
+		state->mbfan_duty_updated[i] = mbfan_pwm_duty_updated;
+		state->mbfan_pwm_freq[i] = roundf(mbfan_pwm_freq[i]);
+		if (check_for_change(state->mbfan_duty_prev[i], state->mbfan_duty[i], 1.5)) {
+			log_msg(LOG_INFO, "mbfan%d: Input PWM change %.1f%% --> %.1f%%",
+				i+1,
+				state->mbfan_duty_prev[i],
+				state->mbfan_duty[i]);
+			state->mbfan_duty_prev[i] = state->mbfan_duty[i];
+			input_event(ctx, &ctx->events.mbfan, i);
+		}
+	}
+	update_outputs_on_events(ctx);
+	return 0;
+}
+
+
+int control_temp_task(void *arg)
+{
+	struct control_context *ctx = arg;
+	struct fanpico_control_config *config = ctx->config;
+	struct fanpico_state *state = ctx->state;
+	uint64_t now = time_us_64();
+	bool filter_due = false;
+
+	/* Start (or restart) free running ADC sampling if needed */
+	if (config->adc_oversample != ctx->adc_oversample && now >= ctx->adc_retry) {
+		if (adc_sampler_start(config->adc_oversample)) {
+			ctx->adc_oversample = config->adc_oversample;
+		} else {
+			log_msg(LOG_WARNING, "ADC sampling failed to start (retry in %u s), using direct ADC reads",
+				ADC_SAMPLER_RETRY_INTERVAL / 1000);
+			ctx->adc_oversample = 0;
+			ctx->adc_retry = now + ADC_SAMPLER_RETRY_INTERVAL * 1000;
+		}
+	}
+
+	/* No readings available until sampler has sampled every input once */
+	if (adc_sampler_warming_up())
+		return 0;
+
+	if (now >= ctx->filter_next) {
+		ctx->filter_next += TEMP_FILTER_INTERVAL * 1000;
+		if (ctx->filter_next <= now)
+			ctx->filter_next = now + TEMP_FILTER_INTERVAL * 1000;
+		filter_due = true;
+	}
+
+	/* Read temperature sensors periodically */
+	log_msg(LOG_DEBUG, "Read temperature sensors");
+	for (int i = 0; i < SENSOR_COUNT; i++) {
+		if (config->sensors[i].filter.stages > 0 && !filter_due)
+			continue;
+		state->temp_updated[i] = get_absolute_time();
+		state->temp[i] = get_temperature(i, config);
+		if (check_for_change(state->temp_prev[i], state->temp[i], 0.5)) {
+			log_msg(LOG_INFO, "sensor%d: Temperature change %.1fC --> %.1fC",
+				i+1,
+				state->temp_prev[i],
+				state->temp[i]);
+			state->temp_prev[i] = state->temp[i];
+			input_event(ctx, &ctx->events.sensor, i);
+		}
+	}
+
+	/* Update virtual sensors (in dependency order) */
+	log_msg(LOG_DEBUG, "Update virtual sensors");
+	for (int n = 0; n < VSENSOR_COUNT; n++) {
+		int i = config->graph.vsensor_order[n];
+		if (config->vsensors[i].filter.stages > 0 && !filter_due)
+			continue;
+		state->vtemp[i] = get_vsensor(i, config, state);
+		if (check_for_change(state->vtemp_prev[i], state->vtemp[i], 0.5)) {
+			log_msg(LOG_INFO, "vsensor%d: Temperature change %.1fC --> %.1fC",
+				i+1,
+				state->vtemp_prev[i],
+				state->vtemp[i]);
+			state->vtemp_prev[i] = state->vtemp[i];
+			input_event(ctx, &ctx->events.vsensor, i);
+		}
+	}
+
+	update_outputs_on_events(ctx);
+	return 0;
+}
+
+
+int control_outputs_task(void *arg)
+{
+	/* Periodic refresh of all outputs (backstop for event driven updates) */
+	log_msg(LOG_DEBUG, "Updating output signals.");
+	update_outputs(arg);
+	return 0;
+}
+
+
+int control_fan_monitor_task(void *arg)
+{
+	struct control_context *ctx = arg;
+
+	/* Detect stalled (or otherwise failed) fans */
+	if (fan_monitor_update(ctx->state, ctx->config)) {
+		/* Let fans that follow a failed fan react immediately */
+		update_outputs(ctx);
+	}
+	return 0;
+}
+
+
+int control_pwm_out_task(void *arg)
+{
+	struct control_context *ctx = arg;
+
+	/* Step slew rate limited PWM outputs towards their targets */
+	update_pwm_outputs(ctx->config);
+	return 0;
+}
+
+
+/* eof :-) */
@@ -0,0 +1,156 @@
+/* control_graph.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "fanpico.h"
+
+
+/*
+ * Control graph: evaluation order for virtual sensors and fan outputs.
+ *
+ * Virtual sensors can use other virtual sensors as their source, and fans
+ * can use other fans as their (PWM) source. Evaluating these in
+ * topological order (dependencies first) makes changes propagate through
+ * any chain of references in a single pass.
+ *
+ * Virtual sensors never depend on fans, so sensors and fans are sorted
+ * separately (all virtual sensors get evaluated before fan outputs).
+ */
+
+
+/* Sort nodes in topological order (using Kahn's algorithm). If multiple nodes
+ * are ready, lowest index is picked first, so that order is same as index
+ * order when there are no dependencies.
+ *
+ * Returns 0 on success, or -(n + 1) where n is first node found to be part
+ * of (or depending on) a cycle.
+ */
+static int topo_sort(const uint32_t *deps, int count, uint8_t *order)
+{
+	uint32_t done = 0;
+	int n = 0;
+	int i;
+
+	while (n < count) {
+		for (i = 0; i < count; i++) {
+			if (!(done & (1UL << i)) && (deps[i] & ~done) == 0)
+				break;
+		}
+		if (i >= count) {
+			for (i = 0; i < count; i++) {
+				if (!(done & (1UL << i)))
+					return -(i + 1);
+			}
+		}
+		order[n++] = i;
+		done |= (1UL << i);
+	}
+
+	return 0;
+}
+
+
+static void default_order(uint8_t *order, int count)
+{
+	for (int i = 0; i < count; i++)
+		order[i] = i;
+}
+
+
+/* Build evaluation order for virtual sensors and fans.
+ *
+ * Returns 0 on success. On error (dependency loop found), evaluation
+ * order is set to index order and return value indicates the first node
+ * in the loop: -(n + 1) for vsensor n, or -(VSENSOR_MAX_COUNT + n + 1)
+ * for fan n.
+ */
+int build_control_graph(struct control_graph *graph, const struct vsensor_input *vsensors,
+			const struct fan_output *fans)
+{
+	uint32_t deps[VSENSOR_MAX_COUNT > FAN_MAX_COUNT ? VSENSOR_MAX_COUNT : FAN_MAX_COUNT];
+	int res;
+
+	/* Virtual sensor dependencies */
+	for (int i = 0; i < VSENSOR_COUNT; i++) {
+		const struct vsensor_input *v = &vsensors[i];
+
+		deps[i] = 0;
+		if (v->mode == VSMODE_MANUAL || v->mode == VSMODE_ONEWIRE || v->mode == VSMODE_I2C)
+			continue;
+		for (int j = 0; j < VSENSOR_SOURCE_MAX_COUNT && v->sensors[j]; j++) {
+			int s = v->sensors[j] - 101;
+			if (s >= 0 && s < VSENSOR_COUNT)
+				deps[i] |= (1UL << s);
+		}
+	}
+	if ((res = topo_sort(deps, VSENSOR_COUNT, graph->vsensor_order)) < 0) {
+		default_order(graph->vsensor_order, VSENSOR_COUNT);
+		default_order(graph->fan_order, FAN_COUNT);
+		graph->valid = false;
+		return res;
+	}
+
+	/* Fan dependencies */
+	for (int i = 0; i < FAN_COUNT; i++) {
+		const struct fan_output *f = &fans[i];
+
+		deps[i] = 0;
+		if (f->s_type == PWM_FAN && f->s_id < FAN_COUNT)
+			deps[i] |= (1UL << f->s_id);
+	}
+	if ((res = topo_sort(deps, FAN_COUNT, graph->fan_order)) < 0) {
+		default_order(graph->fan_order, FAN_COUNT);
+		graph->valid = false;
+		return res - VSENSOR_MAX_COUNT;
+	}
+
+	graph->valid = true;
+	return 0;
+}
+
+
+/* Check configuration for dependency loops (and log error if found).
+ * Returns true if configuration is valid.
+ */
+bool check_control_graph(const struct fanpico_config *config)
+{
+	struct control_graph graph;
+	int res;
+
+	if ((res = build_control_graph(&graph, config->vsensors, config->fans)) == 0)
+		return true;
+
+	res = -res - 1;
+	if (res < VSENSOR_MAX_COUNT) {
+		log_msg(LOG_ERR, "vsensor%d: source dependency loop detected", res + 1);
+	} else {
+		log_msg(LOG_ERR, "fan%d: source dependency loop detected",
+			res - VSENSOR_MAX_COUNT + 1);
+	}
+
+	return false;
+}
+
+
+/* eof :-) */
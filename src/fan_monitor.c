@@ -0,0 +1,227 @@
+/* fan_monitor.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "pico/stdlib.h"
+
+#include "fanpico.h"
+
+#define FAN_MON_BINS            11    /* Duty cycle bins: 0%, 10%, ..., 100% */
+#define FAN_MON_LEARN_RATE      0.05  /* Learning rate of the duty-to-speed curve */
+#define FAN_MON_LEARNED         10    /* Updates before a bin is used for expected speed */
+#define FAN_MON_CONVERGED       250   /* Updates before a bin is frozen (baseline) */
+#define FAN_MON_SETTLE          5000  /* ms, time for fan speed to settle after duty change */
+#define FAN_MON_DUTY_CHANGE     1.0   /* %, ignore smaller duty cycle changes */
+#define FAN_MON_MIN_FREQ        1.0   /* Hz, fans slower than this are not monitored */
+#define FAN_MON_STALL_PERIODS   3     /* Missing pulses before fan is considered stalled */
+#define FAN_MON_STALL_MIN       50    /* ms, minimum time without pulses for stall */
+#define FAN_MON_DEGRADED_LOW    60    /* % of expected speed, fan is degraded below this */
+#define FAN_MON_DEGRADED_HIGH   75    /* % of expected speed, fan recovers above this */
+#define FAN_MON_DEGRADED_TIME   2000  /* ms, time below limit before fan is degraded */
+#define FAN_MON_FAULT_FACTOR    2.0   /* Max speed relative to expected speed */
+#define FAN_MON_MAX_FREQ        1000  /* Hz, tachometer signal faster than this is a fault */
+
+
+/*
+ * Fan stall and anomaly detection.
+ *
+ * Expected fan speed at given duty cycle is learned (while fan is
+ * operating normally) into a piecewise-linear duty-to-speed curve.
+ * Time since last tachometer pulse is then compared against the
+ * expected pulse period, to detect a stalled fan within a few
+ * missing pulses.
+ *
+ * Once a bin of the curve has converged it is frozen, so that the
+ * curve stays as a baseline of the healthy fan (instead of following
+ * a fan that is slowly degrading).
+ */
+
+struct fan_monitor {
+	float curve[FAN_MON_BINS];  /* Learned tachometer frequency (Hz) at each bin */
+	float weight[FAN_MON_BINS]; /* Accumulated (weighted) updates of each bin */
+	float duty;                 /* Current duty cycle */
+	float duty_prev;            /* Duty cycle before last change */
+	uint64_t duty_changed;      /* Time of last duty cycle change (us) */
+	uint64_t slow_since;        /* Time fan started running too slow (us) */
+};
+
+static struct fan_monitor fan_mon[FAN_MAX_COUNT];
+
+
+const char* fan_status2str(enum fan_status status)
+{
+	switch (status) {
+	case FAN_STATUS_OK:
+		return "OK";
+	case FAN_STATUS_STALL:
+		return "STALL";
+	case FAN_STATUS_DEGRADED:
+		return "DEGRADED";
+	case FAN_STATUS_FAULT:
+		return "FAULT";
+	}
+	return "UNKNOWN";
+}
+
+
+/* Return expected tachometer frequency at given duty cycle,
+ * or 0 if it is not known (yet). Bins used must have at least
+ * 'min_weight' updates.
+ */
+static float expected_freq(const struct fan_monitor *m, float duty, float min_weight)
+{
+	float pos = fminf(fmaxf(duty, 0.0), 100.0) * (FAN_MON_BINS - 1) / 100.0;
+	int lo = floorf(pos);
+	int hi = (lo < FAN_MON_BINS - 1 ? lo + 1 : lo);
+	float w = pos - lo;
+
+	if (m->weight[lo] < min_weight || (w > 0 && m->weight[hi] < min_weight))
+		return 0.0;
+
+	return m->curve[lo] + w * (m->curve[hi] - m->curve[lo]);
+}
+
+
+/* Update duty-to-speed curve with new (steady state) measurement.
+ * Measurement error is distributed to the two bins around the duty cycle
+ * (weighted by distance), so that the curve converges towards measured
+ * speeds at any duty cycle. Converged bins are not updated anymore.
+ */
+static void learn_freq(struct fan_monitor *m, float duty, float freq)
+{
+	float pos = fminf(fmaxf(duty, 0.0), 100.0) * (FAN_MON_BINS - 1) / 100.0;
+	int lo = floorf(pos);
+	int hi = (lo < FAN_MON_BINS - 1 ? lo + 1 : lo);
+	float w = pos - lo;
+	float err;
+
+	/* Initialize bins on first measurement */
+	if (m->weight[lo] == 0)
+		m->curve[lo] = freq;
+	if (m->weight[hi] == 0)
+		m->curve[hi] = freq;
+
+	err = freq - (m->curve[lo] + w * (m->curve[hi] - m->curve[lo]));
+	if (m->weight[lo] < FAN_MON_CONVERGED) {
+		m->curve[lo] += FAN_MON_LEARN_RATE * (1.0 - w) * err;
+		m->weight[lo] += 1.0 - w;
+	}
+	if (hi != lo && m->weight[hi] < FAN_MON_CONVERGED) {
+		m->curve[hi] += FAN_MON_LEARN_RATE * w * err;
+		m->weight[hi] += w;
+	}
+}
+
+
+static enum fan_status check_fan(struct fan_monitor *m, int i, enum fan_status status,
+				float duty, float freq, uint64_t now)
+{
+	bool settled;
+	float expected;
+
+	/* Track duty cycle changes */
+	if (fabsf(duty - m->duty) >= FAN_MON_DUTY_CHANGE) {
+		m->duty_prev = m->duty;
+		m->duty = duty;
+		m->duty_changed = now;
+	}
+	settled = (now - m->duty_changed >= FAN_MON_SETTLE * 1000);
+
+	/* Tachometer signal faster than what fan can possibly run, or
+	   (once speed has settled) much faster than the baseline speed at
+	   current duty cycle. Fan leaves FAULT state when signal is
+	   plausible again. */
+	expected = expected_freq(m, m->duty, FAN_MON_CONVERGED);
+	if (freq > FAN_MON_MAX_FREQ
+		|| (settled && expected > 0 && freq > expected * FAN_MON_FAULT_FACTOR))
+		return FAN_STATUS_FAULT;
+
+	/* While fan speed is changing, expect the slower of old and new speed */
+	expected = expected_freq(m, m->duty, FAN_MON_LEARNED);
+	if (!settled)
+		expected = fminf(expected, expected_freq(m, m->duty_prev, FAN_MON_LEARNED));
+
+	if (expected >= FAN_MON_MIN_FREQ) {
+		uint64_t timeout = FAN_MON_STALL_PERIODS * 1000000.0 / expected;
+
+		if (timeout < FAN_MON_STALL_MIN * 1000)
+			timeout = FAN_MON_STALL_MIN * 1000;
+		if (tacho_input_stalled(i, now, timeout))
+			return FAN_STATUS_STALL;
+
+		if (settled) {
+			float pct = freq * 100.0 / expected;
+
+			if (pct < FAN_MON_DEGRADED_LOW) {
+				if (!m->slow_since)
+					m->slow_since = now;
+				if (now - m->slow_since >= FAN_MON_DEGRADED_TIME * 1000)
+					return FAN_STATUS_DEGRADED;
+			} else {
+				m->slow_since = 0;
+			}
+			if (status == FAN_STATUS_DEGRADED && pct < FAN_MON_DEGRADED_HIGH)
+				return FAN_STATUS_DEGRADED;
+		}
+	}
+
+	/* Learn expected speed only while fan is operating normally
+	   (fan not running at this duty cycle is not monitored) */
+	if (settled && status == FAN_STATUS_OK && m->slow_since == 0
+		&& freq >= FAN_MON_MIN_FREQ)
+		learn_freq(m, m->duty, freq);
+
+	return FAN_STATUS_OK;
+}
+
+
+/* Update status of all fans. Returns bitmask of fans whose status changed.
+ */
+uint32_t fan_monitor_update(struct fanpico_state *state, const struct fanpico_control_config *config)
+{
+	uint64_t now = time_us_64();
+	uint32_t changed = 0;
+
+	for (int i = 0; i < FAN_COUNT; i++) {
+		enum fan_status status = FAN_STATUS_OK;
+
+		/* Locked Rotor Alarm signal does not provide fan speed */
+		if (config->fans[i].rpm_mode == RMODE_TACHO)
+			status = check_fan(&fan_mon[i], i, state->fan_status[i],
+					state->fan_duty[i], state->fan_freq[i], now);
+
+		if (status != state->fan_status[i]) {
+			log_msg(status == FAN_STATUS_OK ? LOG_NOTICE : LOG_WARNING,
+				"fan%d: Status change %s --> %s", i + 1,
+				fan_status2str(state->fan_status[i]),
+				fan_status2str(status));
+			state->fan_status[i] = status;
+			changed |= (1UL << i);
+		}
+	}
+
+	return changed;
+}
+
+
+/* eof :-) */
@@ -36,12 +36,15 @@
 #include "hardware/gpio.h"
 #include "hardware/pwm.h"
 #include "hardware/clocks.h"
+#include "hardware/sync.h"
 #include "hardware/watchdog.h"
 #include "hardware/vreg.h"
+#include "cJSON.h"
 
 #include "fanpico.h"
 #include "command_util.h"
 #include "psram.h"
+#include "seqlock.h"
 
 
 #ifdef FANPICO_PSRAM_PIN
@@ -53,11 +56,13 @@
  #endif
 #endif
 
-static struct fanpico_state core1_state;
-static struct fanpico_config core1_config;
-static struct fanpico_state transfer_state;
-static struct fanpico_state system_state;
-const struct fanpico_state *fanpico_state = &system_state;
+static struct fanpico_state ctrl_state;
+static struct fanpico_control_config ctrl_config;
+static uint32_t ctrl_config_gen;
+static struct fanpico_state transfer_state[2];
+static seqlock_t transfer_lock;
+static struct fanpico_state system_state[2];
+const struct fanpico_state *fanpico_state = &system_state[0];
 static struct fanpico_fw_settings system_settings;
 const struct fanpico_fw_settings *fw_settings = &system_settings;
 
@@ -74,8 +79,6 @@ struct persistent_memory_block *persistent_mem = &persistent_memory;
 
 auto_init_mutex(pmem_mutex_inst);
 mutex_t *pmem_mutex = &pmem_mutex_inst;
-auto_init_mutex(state_mutex_inst);
-mutex_t *state_mutex = &state_mutex_inst;
 bool rebooted_by_watchdog = false;
 
 static char input_buf[1024];
@@ -244,6 +247,7 @@ static void setup()
 			time_t_to_str(buf, sizeof(buf), timespec_to_time_t(&ts)));
 	}
 
+	history_init();
 	setup_i2c_bus((struct fanpico_config *)cfg);
 	display_init();
 	network_init();
@@ -283,6 +287,7 @@ static void setup()
 	for (i = 0; i < FAN_COUNT; i++) {
 		set_pwm_duty_cycle(i, 0);
 	}
+	update_pwm_outputs(NULL);
 
 	/* Configure Tacho pins... */
 	setup_tacho_outputs();
@@ -303,7 +308,9 @@ static void clear_state(struct fanpico_state *s)
 
 	for (i = 0; i < MBFAN_MAX_COUNT; i++) {
 		s->mbfan_duty[i] = 0.0;
+		s->mbfan_pwm_freq[i] = 0.0;
 		s->mbfan_duty_prev[i] = 0.0;
+		s->mbfan_duty_updated[i] = from_us_since_boot(0);
 		s->mbfan_freq[i] = 0.0;
 		s->mbfan_freq_prev[i] = 0.0;
 	}
@@ -312,15 +319,19 @@ static void clear_state(struct fanpico_state *s)
 		s->fan_duty_prev[i] = 0.0;
 		s->fan_freq[i] = 0.0;
 		s->fan_freq_prev[i] = 0.0;
+		s->fan_freq_updated[i] = from_us_since_boot(0);
+		s->fan_status[i] = FAN_STATUS_OK;
 	}
 	for (i = 0; i < SENSOR_MAX_COUNT; i++) {
 		s->temp[i] = 0.0;
 		s->temp_prev[i] = 0.0;
+		s->temp_updated[i] = from_us_since_boot(0);
 	}
 	for (i = 0; i < VSENSOR_MAX_COUNT; i++) {
 		s->vtemp[i] = 0.0;
 		s->vtemp_prev[i] = 0.0;
 		s->vtemp_updated[i] = from_us_since_boot(0);
+		s->vtemp_sampled[i] = from_us_since_boot(0);
 		s->vpressure[i] = -1.0;
 		s->vhumidity[i] = -1.0;
 	}
@@ -329,72 +340,435 @@ static void clear_state(struct fanpico_state *s)
 
 
 /* update_system_state()
- *  System state gets updated by core1 periodically (using state_mutex)
- *  to intermediate buffer transfer_state.
- *  This function updates system state from that buffer.
+ *  System state gets published by control loop periodically (lock-free)
+ *  using transfer_lock. This function updates system state from
+ *  latest published snapshot (if any new snapshot is available).
+ *
+ *  System state is double buffered as well, so that any code holding
+ *  a pointer to previous state (fanpico_state) still sees consistent
+ *  data while the other buffer is being updated.
  */
-
 static void update_system_state()
 {
-	if (mutex_enter_timeout_us(state_mutex, 1000)) {
-		memcpy(&system_state, &transfer_state, sizeof(system_state));
-		mutex_exit(state_mutex);
+	static uint32_t last_seq = 0;
+	struct fanpico_state *next;
+
+	if (seqlock_sequence(&transfer_lock) == last_seq)
+		return;
+
+	next = (fanpico_state == &system_state[0] ? &system_state[1] : &system_state[0]);
+	last_seq = seqlock_read(&transfer_lock, next);
+	__dmb();
+	fanpico_state = next;
+}
+
+
+static struct control_context control_ctx;
+static volatile bool output_latency_reset = false;
+
+
+/* Latency from input change detection to output (PWM/tacho) update. */
+struct sched_latency_stats* get_output_latency()
+{
+	return &control_ctx.output_latency;
+}
+
+
+static int control_onewire_task(void *arg)
+{
+	struct control_context *ctx = (struct control_context*)arg;
+	/* Read 1-Wire temperature sensors */
+	int delay;
+
+	if (!ctx->config->onewire_active)
+		return 0;
+	delay = onewire_read_temps(ctx->config, ctx->state);
+	return (delay > 0 ? delay : -1);
+}
+
+
+static int control_config_task(void *arg)
+{
+	struct control_context *ctx = (struct control_context*)arg;
+	bool changed = false;
+
+	/* Attempt to update config from core0 */
+	if (mutex_enter_timeout_us(config_mutex, 100)) {
+		uint32_t gen = control_config_generation();
+		if (gen != ctrl_config_gen) {
+			/* Control config has changed since last sync */
+			log_msg(LOG_DEBUG, "control: sync config (generation %lu)", gen);
+			get_control_config(ctx->config, cfg);
+			ctrl_config_gen = gen;
+			changed = true;
+		}
+		get_control_config_inputs(ctx->config, cfg);
+		mutex_exit(config_mutex);
+
+		/* Rebuild filter state for channels with changed filters */
+		if (changed)
+			filter_state_update(ctx->config);
 	} else {
-		log_msg(LOG_INFO, "update_system_state(): failed to get system_mutex");
+		log_msg(LOG_DEBUG, "failed to get config_mutex");
 	}
+	return 0;
 }
 
 
-static void update_outputs(struct fanpico_state *state, const struct fanpico_config *config)
+static int control_state_task(void *arg)
 {
-	int i;
+	struct control_context *ctx = (struct control_context*)arg;
 
-	/* Update fan PWM signals */
-	for (i = 0; i < FAN_COUNT; i++) {
-		float hyst = cfg->fans[i].pwm_hyst;
-		state->fan_duty[i] = calculate_pwm_duty(state, config, i);
-		if (check_for_change(state->fan_duty_prev[i], state->fan_duty[i], hyst)) {
-			log_msg(LOG_INFO, "fan%d: Set output PWM %.1f%% --> %.1f%%",
-				i+1,
-				state->fan_duty_prev[i],
-				state->fan_duty[i]);
-			state->fan_duty_prev[i] = state->fan_duty[i];
-			set_pwm_duty_cycle(i, state->fan_duty[i]);
+	/* Publish system state to core0 (never blocks) */
+	seqlock_write(&transfer_lock, ctx->state);
+
+	/* Clear statistics if requested (see reset_perf_stats()) */
+	if (output_latency_reset) {
+		memset(&ctx->output_latency, 0, sizeof(ctx->output_latency));
+		output_latency_reset = false;
+	}
+	return 0;
+}
+
+
+static int core0_network_task(void *ctx)
+{
+	network_poll();
+	return 0;
+}
+
+
+static int core0_pmem_task(void *ctx)
+{
+	log_msg(LOG_DEBUG, "update persistent mem start");
+	update_persistent_memory();
+	//log_msg(LOG_DEBUG, "update persistent mem end");
+	return 0;
+}
+
+
+static int core0_led_task(void *ctx)
+{
+	static uint8_t led_state = 0;
+	static int64_t led_max_delta = 0;
+	uint8_t old_led_state = led_state;
+	absolute_time_t t_led_start;
+	int64_t delta;
+
+	if (cfg->led_mode == 0) {
+		/* Slow blinking */
+		led_state = (led_state > 0 ? 0 : 1);
+	} else if (cfg->led_mode == 1) {
+		/* Always on */
+		led_state = 1;
+	} else {
+		/* Always off */
+		led_state = 0;
+	}
+	if (led_state != old_led_state) {
+		log_msg(LOG_DEBUG, "toggle LED start: %u", led_state);
+		t_led_start = get_absolute_time();
+		if (rp2_is_picow()) {
+#ifdef LIB_PICO_CYW43_ARCH
+			cyw43_arch_lwip_begin();
+			cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, led_state);
+			cyw43_arch_lwip_end();
+#endif
+		} else {
+#if LED_PIN > 0
+			gpio_put(LED_PIN, led_state);
+#endif
+		}
+
+		log_msg(LOG_DEBUG, "toggle LED end");
+		delta = absolute_time_diff_us(t_led_start, get_absolute_time());
+		if (delta > led_max_delta) {
+			led_max_delta = delta;
+			log_msg(LOG_INFO, "core0: max_led_gpio_time=%lld", led_max_delta);
 		}
 	}
+	return 0;
+}
+
+
+static int core0_display_task(void *ctx)
+{
+	log_msg(LOG_DEBUG, "update display start");
+	display_status(fanpico_state, cfg);
+	log_msg(LOG_DEBUG, "update display end");
+	return 0;
+}
+
 
-	/* Update mb tacho signals */
-	for (i = 0; i < MBFAN_COUNT; i++) {
-		state->mbfan_freq[i] = calculate_tacho_freq(state, config, i);
-		if (check_for_change(state->mbfan_freq_prev[i], state->mbfan_freq[i], 1.0)) {
-			log_msg(LOG_INFO, "mbfan%d: Set output Tacho %.2fHz --> %.2fHz",
-				i+1,
-				state->mbfan_freq_prev[i],
-				state->mbfan_freq[i]);
-			state->mbfan_freq_prev[i] = state->mbfan_freq[i];
-			if (cfg->mbfans[i].rpm_mode == RMODE_TACHO) {
-				set_tacho_output_freq(i, state->mbfan_freq[i]);
-			} else {
-				int rpm = state->mbfan_freq[i] * 60 / cfg->mbfans[i].rpm_factor;
-				bool lra = (rpm < cfg->mbfans[i].lra_treshold ? true : false);
-				set_lra_output(i, cfg->mbfans[i].lra_invert ? !lra : lra);
+static int core0_i2c_task(void *ctx)
+{
+	/* Poll I2C Temperature Sensors */
+	int delay;
+
+	//log_msg(LOG_DEBUG, "I2C sensor poll start");
+	delay = i2c_read_temps((struct fanpico_config*)cfg);
+	//log_msg(LOG_DEBUG, "I2C sensor poll end");
+	return (delay > 0 ? delay : -1);
+}
+
+
+static int core0_console_task(void *ctx)
+{
+	static int i_ptr = 0;
+	int c;
+
+	/* Process any (user) input */
+	while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+		//log_msg(LOG_DEBUG, "character received: %02x", c);
+		if (c == 0xff || c == 0x00)
+			continue;
+		if (c == 0x7f || c == 0x08) {
+			if (i_ptr > 0) i_ptr--;
+			if (cfg->local_echo) printf("\b \b");
+			continue;
+		}
+		if (c == 10 || c == 13 || i_ptr >= sizeof(input_buf) - 1) {
+			if (cfg->local_echo) printf("\r\n");
+			input_buf[i_ptr] = 0;
+			if (i_ptr > 0) {
+				log_msg(LOG_DEBUG,"user command start");
+				process_command(fanpico_state, (struct fanpico_config *)cfg, input_buf);
+				log_msg(LOG_DEBUG,"user command end");
+				i_ptr = 0;
 			}
+			continue;
+		}
+		input_buf[i_ptr++] = c;
+		if (cfg->local_echo) printf("%c", c);
+	}
+	return 0;
+}
+
+
+static int core0_history_task(void *ctx)
+{
+	if (cfg->history_interval < 1)
+		return 1000;
+
+	history_sample();
+	return cfg->history_interval * 1000;
+}
+
+
+static int core0_log_task(void *ctx)
+{
+	/* Output log messages from core1 (come back soon, if there are more) */
+	if (log_process_deferred(8) >= 8)
+		return 1;
+	return 0;
+}
+
+
+static int core0_watchdog_task(void *ctx)
+{
+#if WATCHDOG_ENABLED
+	log_msg(LOG_DEBUG,"watchdog update");
+	watchdog_update();
+#endif
+	return 0;
+}
+
+
+/* Periodic tasks for both cores (in priority order).
+ * Task returning a positive value overrides its default period
+ * for the next run, negative return value disables the task.
+ *
+ * Control loop tasks get all their state (control state and config)
+ * through control_ctx, and run on FANPICO_CONTROL_CORE (set at build
+ * time, default is core1). They must all run on the same core, as
+ * they share control_ctx and filter state. Rest of the tasks work on
+ * cfg/fanpico_state and on peripherals owned by core0 (USB console,
+ * WiFi, I2C and display). At most SCHED_MAX_TASKS tasks per core
+ * (extra tasks are not run, and an error is logged).
+ *
+ * Shortest period (10ms) sets how often cores wake up from WFE.
+ * Tacho and PWM input measurements are PIO/DMA/PWM slice driven,
+ * so polling them every 10ms is frequent enough (tacho sample buffer
+ * holds ~80ms, PWM input counters wrap in no less than 50ms).
+ */
+#define CTRL FANPICO_CONTROL_CORE
+
+static const struct sched_task system_tasks[] = {
+	/* name,         core, period, func */
+	{ "tacho_read",  CTRL,   10, control_read_tacho_task, &control_ctx },
+	{ "pwm_read",    CTRL,   10, control_read_pwm_task, &control_ctx },
+	{ "tacho_freq",  CTRL,  250, control_tacho_freq_task, &control_ctx },
+	{ "temp",        CTRL,  250, control_temp_task, &control_ctx },
+	{ "onewire",     CTRL, 5000, control_onewire_task, &control_ctx },
+	{ "outputs",     CTRL,  500, control_outputs_task, &control_ctx },
+	{ "pwm_out",     CTRL,   20, control_pwm_out_task, &control_ctx },
+	{ "fan_monitor", CTRL,   20, control_fan_monitor_task, &control_ctx },
+	{ "config",      CTRL, 1000, control_config_task, &control_ctx },
+	{ "state",       CTRL,  500, control_state_task, &control_ctx },
+	{ "network",        0,   50, core0_network_task, NULL },
+	{ "console",        0,   10, core0_console_task, NULL },
+	{ "pmem",           0, 1000, core0_pmem_task, NULL },
+	{ "led",            0, 1000, core0_led_task, NULL },
+	{ "display",        0, 1000, core0_display_task, NULL },
+	{ "i2c",            0, 1000, core0_i2c_task, NULL },
+	{ "history",        0, 1000, core0_history_task, NULL },
+	{ "watchdog",       0, 1000, core0_watchdog_task, NULL },
+	{ "log",            0,   20, core0_log_task, NULL },
+};
+#define SYSTEM_TASK_COUNT (sizeof(system_tasks) / sizeof(system_tasks[0]))
+#undef CTRL
+
+static scheduler_t core0_sched;
+static scheduler_t core1_sched;
+
+
+static uint64_t sched_clock()
+{
+	return time_us_64();
+}
+
+
+static void core_sched_init(scheduler_t *s, uint8_t core)
+{
+	int count = sched_task_count(system_tasks, SYSTEM_TASK_COUNT, core);
+
+	if (core == FANPICO_CONTROL_CORE) {
+		/* Setup done on the core running the control loop */
+		setup_tacho_input_interrupts();
+		filter_state_update(&ctrl_config);
+		log_msg(LOG_INFO, "core%u: running control loop", core);
+	}
+
+	if (sched_init(s, system_tasks, SYSTEM_TASK_COUNT, core, sched_clock) < count)
+		log_msg(LOG_ERR, "core%u: too many tasks (%d), only first %d scheduled",
+			core, count, SCHED_MAX_TASKS);
+}
+
+
+scheduler_t *get_scheduler(uint8_t core)
+{
+	return (core == 0 ? &core0_sched : &core1_sched);
+}
+
+
+/* Clear performance statistics. Statistics updated by the other core
+ * (or control loop) are cleared by it (soon after this call).
+ */
+void reset_perf_stats()
+{
+	sched_reset_stats(&core0_sched);
+	sched_reset_stats(&core1_sched);
+	output_latency_reset = true;
+	memset(get_command_stats(), 0, sizeof(struct sched_latency_stats));
+}
+
+
+static cJSON* hist2json(const uint32_t *hist)
+{
+	cJSON *array;
+
+	if (!(array = cJSON_CreateArray()))
+		return NULL;
+	for (int i = 0; i < SCHED_HIST_BUCKETS; i++)
+		cJSON_AddItemToArray(array, cJSON_CreateNumber(hist[i]));
+
+	return array;
+}
+
+
+static cJSON* latency2json(const struct sched_latency_stats *l)
+{
+	cJSON *o;
+
+	if (!(o = cJSON_CreateObject()))
+		return NULL;
+	cJSON_AddItemToObject(o, "count", cJSON_CreateNumber(l->count));
+	cJSON_AddItemToObject(o, "avg", cJSON_CreateNumber(
+				(l->count > 0 ? l->total / l->count : 0)));
+	cJSON_AddItemToObject(o, "max", cJSON_CreateNumber(l->max));
+	cJSON_AddItemToObject(o, "last", cJSON_CreateNumber(l->last));
+	cJSON_AddItemToObject(o, "hist", hist2json(l->hist));
+
+	return o;
+}
+
+
+/* Generate JSON report of task execution statistics for given core
+ * (or both cores if core < 0). Returned buffer must be freed by the caller.
+ *
+ * Note, statistics for core1 tasks are being updated concurrently,
+ * so counters for a task may not be exactly in sync.
+ */
+char* json_perf_stats(int core, bool pretty)
+{
+	cJSON *json, *array, *o;
+	char *buf;
+
+	if (!(json = cJSON_CreateObject()))
+		return NULL;
+
+	if (!(array = cJSON_CreateArray()))
+		goto panic;
+	for (int i = 0; i < SCHED_HIST_BUCKETS; i++)
+		cJSON_AddItemToArray(array, cJSON_CreateNumber(sched_hist_bucket_limit(i)));
+	cJSON_AddItemToObject(json, "hist_limits", array);
+
+	if (core < 0 || core == 0) {
+		if (!(o = latency2json(get_command_stats())))
+			goto panic;
+		cJSON_AddItemToObject(json, "command_exec", o);
+	}
+	if (core < 0 || core == 1) {
+		if (!(o = latency2json(get_output_latency())))
+			goto panic;
+		cJSON_AddItemToObject(json, "output_latency", o);
+		cJSON_AddItemToObject(json, "log_dropped",
+				cJSON_CreateNumber(log_deferred_dropped()));
+	}
+
+	if (!(array = cJSON_CreateArray()))
+		goto panic;
+	cJSON_AddItemToObject(json, "tasks", array);
+	for (int c = 0; c < 2; c++) {
+		const scheduler_t *s = get_scheduler(c);
+
+		if (core >= 0 && core != c)
+			continue;
+		for (int i = 0; i < s->count; i++) {
+			const struct sched_task_state *t = &s->tasks[i];
+			const struct sched_task_stats *st = &t->stats;
+			uint32_t runs = st->runs;
+
+			if (!(o = cJSON_CreateObject()))
+				goto panic;
+			cJSON_AddItemToObject(o, "name", cJSON_CreateString(t->task->name));
+			cJSON_AddItemToObject(o, "core", cJSON_CreateNumber(c));
+			cJSON_AddItemToObject(o, "active", cJSON_CreateBool(t->active));
+			cJSON_AddItemToObject(o, "runs", cJSON_CreateNumber(runs));
+			cJSON_AddItemToObject(o, "exec_avg", cJSON_CreateNumber(
+						(runs > 0 ? st->exec_total / runs : 0)));
+			cJSON_AddItemToObject(o, "exec_max", cJSON_CreateNumber(st->exec_max));
+			cJSON_AddItemToObject(o, "late_max", cJSON_CreateNumber(st->late_max));
+			cJSON_AddItemToObject(o, "exec_hist", hist2json(st->exec_hist));
+			cJSON_AddItemToObject(o, "late_hist", hist2json(st->late_hist));
+			cJSON_AddItemToArray(array, o);
 		}
 	}
+
+	if (!(buf = (pretty ? cJSON_Print(json) : cJSON_PrintUnformatted(json))))
+		goto panic;
+	cJSON_Delete(json);
+	return buf;
+
+panic:
+	cJSON_Delete(json);
+	return NULL;
 }
 
 
 static void core1_main()
 {
-	struct fanpico_config *config = &core1_config;
-	struct fanpico_state *state = &core1_state;
-	absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(t_temp, 0);
-	absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(t_onewire_temp, 0);
-	absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(t_tacho, 0);
-	absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(t_poll_pwm, 0);
-	absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(t_set_outputs, 0);
-	absolute_time_t t_last, t_now, t_config, t_state;
-	int onewire_delay = 5000;
+	uint64_t t_start, next;
 	int64_t max_delta = 0;
 	int64_t delta;
 
@@ -404,123 +778,36 @@ static void core1_main()
 	/* Allow core0 to pause this core... */
 	multicore_lockout_victim_init();
 
-	setup_tacho_input_interrupts();
-
-	t_state = t_config = t_last = get_absolute_time();
+	core_sched_init(&core1_sched, 1);
 
 	while (1) {
-		t_now = get_absolute_time();
-		delta = absolute_time_diff_us(t_last, t_now);
-		t_last = t_now;
+		t_start = time_us_64();
+		next = sched_run(&core1_sched);
+		delta = time_us_64() - t_start;
 
 		if (delta > max_delta) {
 			max_delta = delta;
 			log_msg(LOG_INFO, "core1: max_loop_time=%lld", max_delta);
 		}
 
-		/* Tachometer inputs from Fans */
-		read_tacho_inputs();
-		if (time_passed(&t_tacho, 1000)) {
-			/* Calculate frequencies from input tachometer signals peridocially */
-			log_msg(LOG_DEBUG, "Updating tacho input signals.");
-			update_tacho_input_freq(state);
-		}
-
-		/* PWM input signals (duty cycles) from "motherboard". */
-		get_pwm_duty_cycles(config);
-		if (time_passed(&t_poll_pwm, 200)) {
-			//log_msg(LOG_DEBUG, "Read PWM inputs");
-			for (int i = 0; i < MBFAN_COUNT; i++) {
-				state->mbfan_duty[i] = roundf(mbfan_pwm_duty[i]);
-				if (check_for_change(state->mbfan_duty_prev[i], state->mbfan_duty[i], 1.5)) {
-					log_msg(LOG_INFO, "mbfan%d: Input PWM change %.1f%% --> %.1f%%",
-						i+1,
-						state->mbfan_duty_prev[i],
-						state->mbfan_duty[i]);
-					state->mbfan_duty_prev[i] = state->mbfan_duty[i];
-				}
-			}
-		}
-
-		/* Read temperature sensors periodically */
-		if (time_passed(&t_temp, 2000)) {
-			log_msg(LOG_DEBUG, "Read temperature sensors");
-			for (int i = 0; i < SENSOR_COUNT; i++) {
-				state->temp[i] = get_temperature(i, config);
-				if (check_for_change(state->temp_prev[i], state->temp[i], 0.5)) {
-					log_msg(LOG_INFO, "sensor%d: Temperature change %.1fC --> %.1fC",
-						i+1,
-						state->temp_prev[i],
-						state->temp[i]);
-					state->temp_prev[i] = state->temp[i];
-				}
-			}
-
-			log_msg(LOG_DEBUG, "Update virtual sensors");
-			for (int i = 0; i < VSENSOR_COUNT; i++) {
-				state->vtemp[i] = get_vsensor(i, config, state);
-				if (check_for_change(state->vtemp_prev[i], state->vtemp[i], 0.5)) {
-					log_msg(LOG_INFO, "vsensor%d: Temperature change %.1fC --> %.1fC",
-						i+1,
-						state->vtemp_prev[i],
-						state->vtemp[i]);
-					state->vtemp_prev[i] = state->vtemp[i];
-				}
-			}
-		}
-
-		/* Read 1-Wire temperature sensors */
-		if (config->onewire_active && onewire_delay > 0) {
-			if (time_passed(&t_onewire_temp, onewire_delay)) {
-				onewire_delay = onewire_read_temps(config, state);
-			}
-		}
-
-		if (time_passed(&t_set_outputs, 500)) {
-			log_msg(LOG_DEBUG, "Updating output signals.");
-			update_outputs(state, config);
-		}
-
-		if (time_passed(&t_config, 1000)) {
-			/* Attempt to update config from core0 */
-			if (mutex_enter_timeout_us(config_mutex, 100)) {
-				memcpy(config, cfg, sizeof(*config));
-				mutex_exit(config_mutex);
-			} else {
-				log_msg(LOG_DEBUG, "failed to get config_mutex");
-			}
-		}
-		if (time_passed(&t_state, 500)) {
-			/* Attempt to update system state on core0 */
-			if (mutex_enter_timeout_us(state_mutex, 100)) {
-				memcpy(&transfer_state, state, sizeof(transfer_state));
-				mutex_exit(state_mutex);
-			} else {
-				log_msg(LOG_DEBUG, "failed to get state_mutex");
-			}
-		}
-
+		/* Sleep until next task is due (or interrupt occurs) */
+		best_effort_wfe_or_timeout(from_us_since_boot(next));
 	}
 }
 
 
 int main()
 {
-	absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(t_led, 0);
-	absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(t_network, 0);
-	absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(t_watchdog, 0);
-	absolute_time_t t_now, t_last, t_display, t_ram, t_i2c_temp, t_led_start;
-	uint8_t led_state = 0;
+	uint64_t t_start, next;
 	int64_t max_delta = 0;
-	int64_t led_max_delta = 0;
 	int64_t delta;
-	int c;
-	int i_ptr = 0;
-	int i2c_temp_delay =  1000;
 
 	set_binary_info(&system_settings);
-	clear_state(&system_state);
-	clear_state(&transfer_state);
+	clear_state(&system_state[0]);
+	clear_state(&system_state[1]);
+	clear_state(&transfer_state[0]);
+	seqlock_init(&transfer_lock, &transfer_state[0], &transfer_state[1],
+		sizeof(struct fanpico_state));
 #ifdef WIFI_SUPPORT
 	memset(&network_state, 0, sizeof(network_state));
 #endif
@@ -532,9 +819,14 @@ int main()
 	if (get_debug_level() >= 2)
 		print_mallinfo();
 
-	/* Start second core (core1)... */
-	memcpy(&core1_config, cfg, sizeof(core1_config));
-	memcpy(&core1_state, &system_state, sizeof(core1_state));
+	/* Setup control loop and start second core (core1)... */
+	mutex_enter_blocking(config_mutex);
+	get_control_config(&ctrl_config, cfg);
+	get_control_config_inputs(&ctrl_config, cfg);
+	ctrl_config_gen = control_config_generation();
+	mutex_exit(config_mutex);
+	memcpy(&ctrl_state, fanpico_state, sizeof(ctrl_state));
+	control_init(&control_ctx, &ctrl_state, &ctrl_config);
 	multicore_launch_core1(core1_main);
 
 #if WATCHDOG_ENABLED
@@ -542,112 +834,22 @@ int main()
 	log_msg(LOG_NOTICE, "Watchdog enabled.");
 #endif
 
-	t_last = get_absolute_time();
-	t_i2c_temp = t_ram = t_display = t_last;
+	core_sched_init(&core0_sched, 0);
 
 	while (1) {
-		t_now = get_absolute_time();
-		delta = absolute_time_diff_us(t_last, t_now);
-		t_last = t_now;
+		update_system_state();
+
+		t_start = time_us_64();
+		next = sched_run(&core0_sched);
+		delta = time_us_64() - t_start;
 
 		if (delta > max_delta) {
 			max_delta = delta;
 			log_msg(LOG_INFO, "core0: max_loop_time=%lld", max_delta);
 		}
 
-		if (time_passed(&t_network, 1)) {
-			network_poll();
-		}
-		if (time_passed(&t_ram, 1000)) {
-			log_msg(LOG_DEBUG, "update persistent mem start");
-			update_persistent_memory();
-			//log_msg(LOG_DEBUG, "update persistent mem end");
-		}
-
-		/* Toggle LED every 1000ms */
-		if (time_passed(&t_led, 1000)) {
-			uint8_t old_led_state = led_state;
-			if (cfg->led_mode == 0) {
-				/* Slow blinking */
-				led_state = (led_state > 0 ? 0 : 1);
-			} else if (cfg->led_mode == 1) {
-				/* Always on */
-				led_state = 1;
-			} else {
-				/* Always off */
-				led_state = 0;
-			}
-			if (led_state != old_led_state) {
-				log_msg(LOG_DEBUG, "toggle LED start: %u", led_state);
-				t_led_start = get_absolute_time();
-				if (rp2_is_picow()) {
-#ifdef LIB_PICO_CYW43_ARCH
-					cyw43_arch_lwip_begin();
-					cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, led_state);
-					cyw43_arch_lwip_end();
-#endif
-				} else {
-#if LED_PIN > 0
-					gpio_put(LED_PIN, led_state);
-#endif
-				}
-
-				t_now = get_absolute_time();
-				log_msg(LOG_DEBUG, "toggle LED end");
-				delta = absolute_time_diff_us(t_led_start, t_now);
-				if (delta > led_max_delta) {
-					led_max_delta = delta;
-					log_msg(LOG_INFO, "core0: max_led_gpio_time=%lld", led_max_delta);
-				}
-			}
-		}
-
-		/* Update display every 1000ms */
-		if (time_passed(&t_display, 1000)) {
-			log_msg(LOG_DEBUG, "update display start");
-			update_system_state();
-			display_status(fanpico_state, cfg);
-			log_msg(LOG_DEBUG, "update display end");
-		}
-
-		/* Poll I2C Temperature Sensors */
-		if (i2c_temp_delay > 0 && time_passed(&t_i2c_temp, i2c_temp_delay)) {
-			//log_msg(LOG_DEBUG, "I2C sensor poll start");
-			i2c_temp_delay = i2c_read_temps((struct fanpico_config*)cfg);
-			//log_msg(LOG_DEBUG, "I2C sensor poll end");
-		}
-
-		/* Process any (user) input */
-		while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
-			//log_msg(LOG_DEBUG, "character received: %02x", c);
-			if (c == 0xff || c == 0x00)
-				continue;
-			if (c == 0x7f || c == 0x08) {
-				if (i_ptr > 0) i_ptr--;
-				if (cfg->local_echo) printf("\b \b");
-				continue;
-			}
-			if (c == 10 || c == 13 || i_ptr >= sizeof(input_buf) - 1) {
-				if (cfg->local_echo) printf("\r\n");
-				input_buf[i_ptr] = 0;
-				if (i_ptr > 0) {
-					log_msg(LOG_DEBUG,"user command start");
-					update_system_state();
-					process_command(fanpico_state, (struct fanpico_config *)cfg, input_buf);
-					log_msg(LOG_DEBUG,"user command end");
-					i_ptr = 0;
-				}
-				continue;
-			}
-			input_buf[i_ptr++] = c;
-			if (cfg->local_echo) printf("%c", c);
-		}
-		if (time_passed(&t_watchdog, 1000)) {
-#if WATCHDOG_ENABLED
-			log_msg(LOG_DEBUG,"watchdog update");
-			watchdog_update();
-#endif
-		}
+		/* Sleep until next task is due (or interrupt occurs) */
+		best_effort_wfe_or_timeout(from_us_since_boot(next));
 	}
 }
 
@@ -24,6 +24,8 @@
 
 #include "config.h"
 #include "log.h"
+#include "scheduler.h"
+#include "fixedpoint.h"
 #include <time.h>
 #include "pico/mutex.h"
 #ifdef LIB_PICO_CYW43_ARCH
@@ -50,12 +52,17 @@
 
 #define ADC_REF_VOLTAGE 3.0
 #define FAN_TACHO_HYSTERESIS 1.0
+#define FAN_TACHO_PERIODS    8
+#define FAN_TACHO_TIMEOUT    1000
 #define FAN_PWM_HYSTERESIS 1.0
 #define ADC_MAX_VALUE   (1 << 12)
 #define ADC_AVG_WINDOW  10
+#define ADC_OVERSAMPLE  256
+#define ADC_MAX_OVERSAMPLE 1024
 
 #define MAX_NAME_LEN   64
 #define MAX_MAP_POINTS 32
+#define PWL_POOL_SIZE 256  /* map segments (points) in total */
 #define MAX_GPIO_PINS  32
 
 #define WIFI_SSID_MAX_LEN     32
@@ -69,6 +76,9 @@
 #define DEFAULT_MQTT_TEMP_INTERVAL    60
 #define DEFAULT_MQTT_RPM_INTERVAL     60
 #define DEFAULT_MQTT_DUTY_INTERVAL    60
+#define DEFAULT_MQTT_PERF_INTERVAL    300
+
+#define DEFAULT_HISTORY_INTERVAL      10
 
 #define HTTP_SERVER_DEFAULT_PORT      80
 #define HTTPS_SERVER_DEFAULT_PORT     443
@@ -108,8 +118,45 @@ enum signal_filter_types {
 	FILTER_NONE      = 0, /* No filtering */
 	FILTER_LOSSYPEAK = 1, /* "Lossy Peak Detector" with time decay */
 	FILTER_SMA       = 2, /* Simple moving average */
+	FILTER_EMA       = 3, /* Exponential moving average */
+	FILTER_MEDIAN    = 4, /* Rolling median */
+	FILTER_KALMAN    = 5, /* 1-D Kalman filter */
+};
+#define FILTER_ENUM_MAX 5
+
+#define FILTER_MAX_STAGES 4
+#define FILTER_MAX_ARGS   4
+
+struct filter_stage {
+	enum signal_filter_types filter;
+	float args[FILTER_MAX_ARGS];
+};
+
+/* Chain of filters, applied in order. This is configuration data only,
+ * filter state is owned by the core running the filters.
+ */
+struct filter_chain {
+	uint8_t stages;
+	struct filter_stage stage[FILTER_MAX_STAGES];
+};
+
+/* Filter input/output values: float, or Q16.16 when using fixed-point math. */
+#if FANPICO_FIXED_POINT
+typedef fx_t filter_val_t;
+#define FILTER_VAL(v)      fx_from_float((v), Q16_FRAC)
+#define FILTER_TO_FLOAT(v) fx_to_double((v), Q16_FRAC)
+#else
+typedef float filter_val_t;
+#define FILTER_VAL(v)      (v)
+#define FILTER_TO_FLOAT(v) (v)
+#endif
+
+enum filter_channel_types {
+	FILTER_CH_FAN     = 0,
+	FILTER_CH_MBFAN   = 1,
+	FILTER_CH_SENSOR  = 2,
+	FILTER_CH_VSENSOR = 3,
 };
-#define FILTER_ENUM_MAX 2
 
 enum tacho_source_types {
 	TACHO_FIXED  = 0,     /* Fixed speed set by s_id */
@@ -143,6 +190,13 @@ enum rpm_modes {
 };
 #define RPMMODE_ENUM_MAX 1
 
+enum fan_status {
+	FAN_STATUS_OK       = 0,
+	FAN_STATUS_STALL    = 1,  /* Fan is not rotating */
+	FAN_STATUS_DEGRADED = 2,  /* Fan is running slower than expected */
+	FAN_STATUS_FAULT    = 3,  /* Implausible tachometer signal (wiring fault) */
+};
+
 #ifdef WIFI_SUPPORT
 typedef struct acl_entry_t {
 	ip_addr_t ip;
@@ -158,6 +212,54 @@ struct ssh_public_key {
 	uint16_t pubkey_size;
 };
 
+/* Values in compiled maps (map_val_t), and map input/output values
+ * (map_calc_t): float/double, or fixed-point when using fixed-point
+ * math (see pwl_map.c).
+ */
+#if FANPICO_FIXED_POINT
+typedef fx_t map_val_t;
+typedef fx_t map_calc_t;
+#else
+typedef float map_val_t;
+typedef double map_calc_t;
+#endif
+
+/* Segment of compiled piecewise-linear map, starts at (x0, y0). */
+struct pwl_segment {
+	map_val_t x0;
+	map_val_t y0;
+	map_val_t slope;
+};
+
+/* Compiled piecewise-linear map: 'count' segments starting at 'start'
+ * in segment pool, last segment extends (flat) to the end of the range.
+ */
+struct pwl_map {
+	uint16_t start;
+	uint8_t count;
+};
+
+/* Compiled maps used by the control loop (see pwl_maps_compile()).
+ * Segments of all maps are allocated from shared pool, based on actual
+ * number of points in each map.
+ */
+struct pwl_maps {
+	struct pwl_map fans[FAN_MAX_COUNT];          /* PWM maps */
+	struct pwl_map mbfans[MBFAN_MAX_COUNT];      /* tacho maps */
+	struct pwl_map sensors[SENSOR_MAX_COUNT];    /* temp maps */
+	struct pwl_map vsensors[VSENSOR_MAX_COUNT];  /* temp maps */
+	uint16_t used;
+	struct pwl_segment seg[PWL_POOL_SIZE];
+};
+
+/* Compiled linear scaling: val * coefficient + offset, limited to [min, max]. */
+struct pwl_scale {
+	map_val_t coefficient;
+	map_val_t offset;
+	map_val_t min;
+	map_val_t max;
+};
+
 struct pwm_map {
 	uint8_t points;
 	uint8_t pwm[MAX_MAP_POINTS][2];
@@ -182,17 +284,20 @@ struct fan_output {
 	uint8_t min_pwm;
 	uint8_t max_pwm;
 	float pwm_coefficient;
+	float pwm_slew;
 	enum pwm_source_types s_type;
 	uint16_t s_id;
 	struct pwm_map map;
-	enum signal_filter_types filter;
-	void *filter_ctx;
+	struct pwl_scale scale;  /* compiled pwm_coefficient, min_pwm, max_pwm */
+	struct filter_chain filter;
 
 	/* input Tacho signal settings */
 	uint8_t rpm_mode;
 	uint8_t rpm_factor;
 	uint16_t lra_low;
 	uint16_t lra_high;
+	uint8_t tacho_periods;
+	uint16_t tacho_timeout;
 };
 
 struct mb_input {
@@ -210,10 +315,10 @@ struct mb_input {
 	uint16_t s_id;
 	uint8_t sources[FAN_MAX_COUNT];
 	struct tacho_map map;
+	struct pwl_scale scale;  /* compiled rpm_coefficient, min_rpm, max_rpm */
 
 	/* input PWM signal settings */
-	enum signal_filter_types filter;
-	void *filter_ctx;
+	struct filter_chain filter;
 };
 
 struct sensor_input {
@@ -225,8 +330,22 @@ struct sensor_input {
 	float temp_offset;
 	float temp_coefficient;
 	struct temp_map map;
-	enum signal_filter_types filter;
-	void *filter_ctx;
+	struct pwl_scale scale;  /* compiled temp_coefficient, temp_offset */
+	struct filter_chain filter;
+};
+
+/* Thermistor lookup table (raw ADC value to temperature), with one
+ * entry for every 8 ADC codes (~2KB per sensor). Table is built (in place)
+ * when configuration changes, see thermistor_lut_build().
+ */
+#define THERMISTOR_LUT_BITS  3
+#define THERMISTOR_LUT_SIZE  ((ADC_MAX_VALUE >> THERMISTOR_LUT_BITS) + 1)
+
+struct thermistor_lut {
+	float thermistor_nominal;
+	float temp_nominal;
+	float beta_coefficient;
+	map_val_t temp[THERMISTOR_LUT_SIZE];  /* Q16.16 with fixed-point math */
 };
 
 struct vsensor_input {
@@ -239,8 +358,7 @@ struct vsensor_input {
 	uint8_t i2c_type;
 	uint8_t i2c_addr;
 	struct temp_map map;
-	enum signal_filter_types filter;
-	void *filter_ctx;
+	struct filter_chain filter;
 };
 
 struct fanpico_config {
@@ -248,6 +366,7 @@ struct fanpico_config {
 	struct vsensor_input vsensors[VSENSOR_MAX_COUNT];
 	struct fan_output fans[FAN_MAX_COUNT];
 	struct mb_input mbfans[MBFAN_MAX_COUNT];
+	struct thermistor_lut thermistor_lut[SENSOR_MAX_COUNT];  /* compiled from sensors */
 	bool local_echo;
 	uint8_t led_mode;
 	char display_type[64];
@@ -261,6 +380,8 @@ struct fanpico_config {
 	bool onewire_active;
 	uint32_t i2c_speed;
 	float adc_vref;
+	uint16_t adc_oversample;
+	uint32_t history_interval;
 #ifdef WIFI_SUPPORT
 	char wifi_ssid[WIFI_SSID_MAX_LEN + 1];
 	char wifi_passwd[WIFI_PASSWD_MAX_LEN + 1];
@@ -302,10 +423,12 @@ struct fanpico_config {
 	char mqtt_fan_duty_topic[MQTT_MAX_TOPIC_LEN + 1];
 	char mqtt_mbfan_rpm_topic[MQTT_MAX_TOPIC_LEN + 1];
 	char mqtt_mbfan_duty_topic[MQTT_MAX_TOPIC_LEN + 1];
+	char mqtt_perf_topic[MQTT_MAX_TOPIC_LEN + 1];
 	uint32_t mqtt_temp_interval;
 	uint32_t mqtt_vsensor_interval;
 	uint32_t mqtt_rpm_interval;
 	uint32_t mqtt_duty_interval;
+	uint32_t mqtt_perf_interval;
 	char mqtt_ha_discovery_prefix[32 + 1];
 	bool telnet_active;
 	bool telnet_auth;
@@ -345,6 +468,33 @@ struct fanpico_config {
 	void *i2c_context[VSENSOR_MAX_COUNT];
 };
 
+/* Evaluation order of virtual sensors and fans (see control_graph.c) */
+struct control_graph {
+	uint8_t vsensor_order[VSENSOR_MAX_COUNT];
+	uint8_t fan_order[FAN_MAX_COUNT];
+	bool valid;
+};
+
+/* Subset of configuration used by the control loop (core1 by default).
+   Synchronized from fanpico_config only when it changes. */
+struct fanpico_control_config {
+	struct sensor_input sensors[SENSOR_MAX_COUNT];
+	struct vsensor_input vsensors[VSENSOR_MAX_COUNT];
+	struct fan_output fans[FAN_MAX_COUNT];
+	struct mb_input mbfans[MBFAN_MAX_COUNT];
+	struct thermistor_lut thermistor_lut[SENSOR_MAX_COUNT];
+	bool onewire_active;
+	float adc_vref;
+	uint16_t adc_oversample;
+	struct control_graph graph;
+	struct pwl_maps maps;
+	/* Non-config items (synchronized periodically) */
+	float vtemp[VSENSOR_MAX_COUNT];
+	float vhumidity[VSENSOR_MAX_COUNT];
+	float vpressure[VSENSOR_MAX_COUNT];
+	absolute_time_t vtemp_updated[VSENSOR_MAX_COUNT];
+};
+
 /* Firmware settings that can be modified with picotool */
 struct fanpico_fw_settings {
 	bool safemode;      /* Safe mode disables loading saved configuration during boot. */
@@ -373,14 +523,20 @@ struct fanpico_state {
 	/* inputs */
 	float mbfan_duty[MBFAN_MAX_COUNT];
 	float mbfan_duty_prev[MBFAN_MAX_COUNT];
+	absolute_time_t mbfan_duty_updated[MBFAN_MAX_COUNT];
+	float mbfan_pwm_freq[MBFAN_MAX_COUNT];
 	float fan_freq[FAN_MAX_COUNT];
 	float fan_freq_prev[FAN_MAX_COUNT];
+	absolute_time_t fan_freq_updated[FAN_MAX_COUNT];
+	uint8_t fan_status[FAN_MAX_COUNT];
 	float temp[SENSOR_MAX_COUNT];
 	float temp_prev[SENSOR_MAX_COUNT];
+	absolute_time_t temp_updated[SENSOR_MAX_COUNT];
 	float vtemp[VSENSOR_MAX_COUNT];
 	float vhumidity[VSENSOR_MAX_COUNT];
 	float vpressure[VSENSOR_MAX_COUNT];
 	absolute_time_t vtemp_updated[VSENSOR_MAX_COUNT];
+	absolute_time_t vtemp_sampled[VSENSOR_MAX_COUNT];
 	float vtemp_prev[VSENSOR_MAX_COUNT];
 	float onewire_temp[ONEWIRE_MAX_COUNT];
 	absolute_time_t onewire_temp_updated[VSENSOR_MAX_COUNT];
@@ -392,7 +548,48 @@ struct fanpico_state {
 	float mbfan_freq_prev[MBFAN_MAX_COUNT];
 };
 
+/* Inputs that have changed (crossed their hysteresis) since
+ * outputs were last updated.
+ */
+struct input_events {
+	uint32_t mbfan;         /* mbfan PWM inputs */
+	uint32_t sensor;        /* temperature sensors */
+	uint32_t vsensor;       /* virtual sensors */
+	uint32_t fan;           /* fan tacho inputs */
+	uint64_t t_first;       /* time first pending change was detected (us) */
+};
+
+/* Control loop state (passed to control loop tasks as context) */
+struct control_context {
+	struct fanpico_state *state;
+	struct fanpico_control_config *config;
+	struct input_events events;
+	struct sched_latency_stats output_latency;
+	uint16_t adc_oversample;   /* oversampling ADC sampler was started with */
+	uint64_t adc_retry;        /* next time to retry starting ADC sampler (us) */
+	uint64_t filter_next;      /* next time to sample filtered sensors (us) */
+};
+
 /* Memory structure that persists over soft resets */
+#define HISTORY_MAX_CHANNELS (2 * FAN_MAX_COUNT + 2 * MBFAN_MAX_COUNT + \
+				SENSOR_MAX_COUNT + VSENSOR_MAX_COUNT)
+
+struct history_iter {
+	uint32_t seq;         /* sequence number of current block */
+	uint16_t offset;      /* offset of next record in the block */
+	uint16_t index;       /* index of next record in the block */
+	uint64_t t;           /* timestamp of current record (ms since boot) */
+	int32_t values[HISTORY_MAX_CHANNELS];
+};
+
+struct history_query {
+	uint64_t start;       /* ms since boot */
+	uint64_t end;         /* ms since boot */
+	uint32_t step;        /* decimation factor */
+	uint32_t matched;     /* records matched so far */
+	struct history_iter it;
+};
+
 struct persistent_memory_block {
 	uint32_t id;
 	uint32_t len;
@@ -413,10 +610,13 @@ extern const struct fanpico_state *fanpico_state;
 extern struct fanpico_network_state *net_state;
 #endif
 extern bool rebooted_by_watchdog;
-extern mutex_t *state_mutex;
 void update_display_state();
 void update_persistent_memory();
 void update_persistent_memory_tz(const char *tz);
+scheduler_t *get_scheduler(uint8_t core);
+char* json_perf_stats(int core, bool pretty);
+struct sched_latency_stats* get_output_latency();
+void reset_perf_stats();
 
 /* bi_decl.c */
 void set_binary_info(struct fanpico_fw_settings *settings);
@@ -424,6 +624,7 @@ void set_binary_info(struct fanpico_fw_settings *settings);
 /* command.c */
 void process_command(const struct fanpico_state *state, struct fanpico_config *config, char *command);
 int last_command_status();
+struct sched_latency_stats* get_command_stats();
 
 /* config.c */
 extern mutex_t *config_mutex;
@@ -438,6 +639,10 @@ int valid_pwm_source_ref(enum pwm_source_types source, uint16_t s_id);
 int str2tacho_source(const char *s);
 const char* tacho_source2str(enum tacho_source_types source);
 int valid_tacho_source_ref(enum tacho_source_types source, uint16_t s_id);
+void update_control_config_generation();
+uint32_t control_config_generation();
+void get_control_config(struct fanpico_control_config *ctrl, const struct fanpico_config *config);
+void get_control_config_inputs(struct fanpico_control_config *ctrl, const struct fanpico_config *config);
 void read_config(bool use_default_config);
 void save_config();
 void delete_config();
@@ -477,6 +682,40 @@ int flash_list_directory(const char *path, bool recursive);
 void print_rp2040_flashinfo();
 
 
+/* benchmark.c */
+int run_benchmarks();
+
+/* history.c */
+void history_init();
+void history_clear();
+bool history_in_psram();
+void history_sample();
+uint history_channels();
+char* history_channel_name(uint ch, char *buf, size_t len);
+char* history_value_str(uint ch, int32_t val, char *buf, size_t len);
+void history_query_init(struct history_query *q, int32_t start, int32_t end, uint32_t step);
+bool history_query_next(struct history_query *q);
+void print_history_info();
+
+/* pwl_map.c */
+void pwl_maps_init(struct pwl_maps *maps);
+bool pwm_map_compile(struct pwl_maps *maps, struct pwl_map *out, const struct pwm_map *map);
+bool tacho_map_compile(struct pwl_maps *maps, struct pwl_map *out, const struct tacho_map *map);
+bool temp_map_compile(struct pwl_maps *maps, struct pwl_map *out, const struct temp_map *map);
+void pwl_maps_compile(struct pwl_maps *maps, const struct fanpico_control_config *config);
+map_calc_t pwl_eval(const struct pwl_maps *maps, const struct pwl_map *map, map_calc_t val);
+int map_points_total(const struct fanpico_config *config);
+bool map_points_fit(const struct fanpico_config *config, int old_points, int new_points);
+void pwl_scale_compile(struct pwl_scale *scale, double coefficient, double offset,
+		double min, double max, unsigned int frac);
+map_calc_t pwl_scale_eval(const struct pwl_scale *scale, map_calc_t val);
+void fan_output_compile(struct fan_output *fan);
+void mb_input_compile(struct mb_input *mbfan);
+void sensor_input_compile(struct sensor_input *sensor);
+double pwm_map(const struct pwm_map *map, double val);
+double tacho_map(const struct tacho_map *map, double val);
+double temp_map(const struct temp_map *map, double val);
+
 /* network.c */
 #if WIFI_SUPPORT
 bool wifi_get_auth_type(const char *name, uint32_t *type);
@@ -497,6 +736,7 @@ const char *network_ip();
 /* httpd.c */
 u16_t fanpico_ssi_handler(const char *tag, char *insert, int insertlen,
 			u16_t current_tag_part, u16_t *next_tag_part);
+void fanpico_set_cgi_handlers();
 
 /* mqtt.c */
 void fanpico_setup_mqtt_client();
@@ -507,6 +747,8 @@ void fanpico_mqtt_publish_temp();
 void fanpico_mqtt_publish_vsensor();
 void fanpico_mqtt_publish_rpm();
 void fanpico_mqtt_publish_duty();
+void fanpico_mqtt_publish_perf();
+void fanpico_mqtt_publish_perf_pending();
 void fanpico_mqtt_scpi_command();
 
 /* telnetd.c */
@@ -537,7 +779,7 @@ void fanpico_snmp_startup_trap(bool warmstart);
 
 /* onewire.c */
 void setup_onewire_bus();
-int onewire_read_temps(struct fanpico_config *config, struct fanpico_state *state);
+int onewire_read_temps(struct fanpico_control_config *config, struct fanpico_state *state);
 uint64_t onewire_address(uint sensor);
 
 /* i2c.c */
@@ -554,37 +796,61 @@ struct altcp_tls_config* tls_server_config();
 
 /* pwm.c */
 extern float mbfan_pwm_duty[MBFAN_MAX_COUNT];
+extern absolute_time_t mbfan_pwm_duty_updated;
+extern float mbfan_pwm_freq[MBFAN_MAX_COUNT];
 void setup_pwm_inputs();
 void setup_pwm_outputs();
 void set_pwm_duty_cycle(uint fan, float duty);
+bool update_pwm_outputs(const struct fanpico_control_config *config);
 float get_pwm_duty_cycle(uint fan);
-void get_pwm_duty_cycles(const struct fanpico_config *config);
-double pwm_map(const struct pwm_map *map, double val);
-double calculate_pwm_duty(struct fanpico_state *state, const struct fanpico_config *config, int i);
+bool get_pwm_duty_cycles(const struct fanpico_control_config *config);
+double calculate_pwm_duty(struct fanpico_state *state, const struct fanpico_control_config *config, int i);
+
+/* fan_monitor.c */
+uint32_t fan_monitor_update(struct fanpico_state *state, const struct fanpico_control_config *config);
+const char* fan_status2str(enum fan_status status);
 
 /* filters.c */
 int str2filter(const char *s);
 const char* filter2str(enum signal_filter_types source);
-void* filter_parse_args(enum signal_filter_types filter, char *args);
-char* filter_print_args(enum signal_filter_types filter, void *ctx);
-float filter(enum signal_filter_types filter, void *ctx, float input);
+int filter_parse_args(enum signal_filter_types filter, char *args, float *params);
+char* filter_print_args(enum signal_filter_types filter, const float *params);
+int filter_chain_add(struct filter_chain *chain, enum signal_filter_types filter, const char *args);
+int filter_chain_parse(struct filter_chain *chain, const char *str);
+int filter_chain_set(const struct fanpico_config *config, struct filter_chain *chain,
+		const char *str);
+int filter_config_check(struct fanpico_config *config);
+char* filter_chain_print(const struct filter_chain *chain);
+void filter_state_update(const struct fanpico_control_config *config);
+filter_val_t filter_channel(enum filter_channel_types type, uint i, filter_val_t input, uint64_t t);
+
+/* adc_sampler.c */
+bool adc_sampler_start(uint count);
+void adc_sampler_stop();
+bool adc_sampler_read(uint input, float *value);
+bool adc_sampler_warming_up();
 
 /* sensors.c */
-double get_temperature(uint8_t input, const struct fanpico_config *config);
+extern uint8_t sensor_adc_map[SENSOR_MAX_COUNT];
+double thermistor_temp(double raw, const struct sensor_input *sensor);
+bool thermistor_lut_build(struct thermistor_lut *lut, const struct sensor_input *sensor);
+double thermistor_lut_temp(const struct thermistor_lut *lut, float raw);
+double get_temperature(uint8_t input, const struct fanpico_control_config *config);
 double sensor_get_duty(const struct temp_map *map, double temp);
-double get_vsensor(uint8_t i, struct fanpico_config *config,
+double get_vsensor(uint8_t i, struct fanpico_control_config *config,
 		struct fanpico_state *state);
 
 /* tacho.c */
 void setup_tacho_inputs();
 void setup_tacho_input_interrupts();
 void setup_tacho_outputs();
-void read_tacho_inputs();
-void update_tacho_input_freq(struct fanpico_state *state);
+void read_tacho_inputs(const struct fanpico_control_config *config);
+uint32_t update_tacho_input_freq(struct fanpico_state *state, const struct fanpico_control_config *config);
+bool tacho_input_stalled(uint fan, uint64_t now, uint64_t timeout);
+const char* tacho_input_method(uint fan, char *buf, size_t len);
 void set_tacho_output_freq(uint fan, double frequency);
 void set_lra_output(uint fan, bool lra);
-double tacho_map(const struct tacho_map *map, double val);
-double calculate_tacho_freq(struct fanpico_state *state, const struct fanpico_config *config, int i);
+double calculate_tacho_freq(struct fanpico_state *state, const struct fanpico_control_config *config, int i);
 
 /* log.c */
 int str2log_priority(const char *pri);
@@ -592,6 +858,8 @@ const char* log_priority2str(int pri);
 int str2log_facility(const char *facility);
 const char* log_facility2str(int facility);
 void log_msg(int priority, const char *format, ...);
+int log_process_deferred(uint max_count);
+uint32_t log_deferred_dropped();
 int get_debug_level();
 void set_debug_level(int level);
 int get_log_level();
@@ -647,6 +915,23 @@ void rp2_set_sys_clock(uint32_t khz);
 int rp2_is_picow();
 
 
+/* control.c */
+void control_init(struct control_context *ctx, struct fanpico_state *state,
+		struct fanpico_control_config *config);
+void update_outputs(struct control_context *ctx);
+int control_read_tacho_task(void *arg);
+int control_tacho_freq_task(void *arg);
+int control_read_pwm_task(void *arg);
+int control_temp_task(void *arg);
+int control_outputs_task(void *arg);
+int control_fan_monitor_task(void *arg);
+int control_pwm_out_task(void *arg);
+
+/* control_graph.c */
+int build_control_graph(struct control_graph *graph, const struct vsensor_input *vsensors,
+			const struct fan_output *fans);
+bool check_control_graph(const struct fanpico_config *config);
+
 /* crc32.c */
 unsigned int xcrc32 (const unsigned char *buf, int len, unsigned int init);
 
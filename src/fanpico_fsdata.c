@@ -1210,6 +1210,86 @@ Pragma: no-cache
 0x3c,0x21,0x2d,0x2d,0x23,0x6a,0x73,0x6f,0x6e,0x73,0x74,0x61,0x74,0x2d,0x2d,0x3e,
 0x0a,};
 
+#if FSDATA_FILE_ALIGNMENT==1
+static const unsigned int dummy_align__perf_json = 7;
+#endif
+static const unsigned char FSDATA_ALIGN_PRE data__perf_json[] FSDATA_ALIGN_POST = {
+/* /perf.json (11 chars) */
+0x2f,0x70,0x65,0x72,0x66,0x2e,0x6a,0x73,0x6f,0x6e,0x00,0x00,
+
+/* HTTP header */
+/* "HTTP/1.0 200 OK
+" (17 bytes) */
+0x48,0x54,0x54,0x50,0x2f,0x31,0x2e,0x30,0x20,0x32,0x30,0x30,0x20,0x4f,0x4b,0x0d,
+0x0a,
+/* "Server: FanPico (https://github.com/tjko/fanpico)
+" (51 bytes) */
+0x53,0x65,0x72,0x76,0x65,0x72,0x3a,0x20,0x46,0x61,0x6e,0x50,0x69,0x63,0x6f,0x20,
+0x28,0x68,0x74,0x74,0x70,0x73,0x3a,0x2f,0x2f,0x67,0x69,0x74,0x68,0x75,0x62,0x2e,
+0x63,0x6f,0x6d,0x2f,0x74,0x6a,0x6b,0x6f,0x2f,0x66,0x61,0x6e,0x70,0x69,0x63,0x6f,
+0x29,0x0d,0x0a,
+/* "Last-Modified: Sun, 25 Sep 2022 20:03:36 GMT"
+" (46+ bytes) */
+0x4c,0x61,0x73,0x74,0x2d,0x4d,0x6f,0x64,0x69,0x66,0x69,0x65,0x64,0x3a,0x20,0x53,
+0x75,0x6e,0x2c,0x20,0x32,0x35,0x20,0x53,0x65,0x70,0x20,0x32,0x30,0x32,0x32,0x20,
+0x32,0x30,0x3a,0x30,0x33,0x3a,0x33,0x36,0x20,0x47,0x4d,0x54,0x0d,0x0a,
+/* "Expires: Fri, 10 Apr 2008 14:00:00 GMT
+Pragma: no-cache
+" (58 bytes) */
+0x45,0x78,0x70,0x69,0x72,0x65,0x73,0x3a,0x20,0x46,0x72,0x69,0x2c,0x20,0x31,0x30,
+0x20,0x41,0x70,0x72,0x20,0x32,0x30,0x30,0x38,0x20,0x31,0x34,0x3a,0x30,0x30,0x3a,
+0x30,0x30,0x20,0x47,0x4d,0x54,0x0d,0x0a,0x50,0x72,0x61,0x67,0x6d,0x61,0x3a,0x20,
+0x6e,0x6f,0x2d,0x63,0x61,0x63,0x68,0x65,0x0d,0x0a,
+/* "Content-Type: application/json
+
+" (34 bytes) */
+0x43,0x6f,0x6e,0x74,0x65,0x6e,0x74,0x2d,0x54,0x79,0x70,0x65,0x3a,0x20,0x61,0x70,
+0x70,0x6c,0x69,0x63,0x61,0x74,0x69,0x6f,0x6e,0x2f,0x6a,0x73,0x6f,0x6e,0x0d,0x0a,
+0x0d,0x0a,
+/* raw file data (17 bytes) */
+0x3c,0x21,0x2d,0x2d,0x23,0x6a,0x73,0x6f,0x6e,0x70,0x65,0x72,0x66,0x2d,0x2d,0x3e,
+0x0a,};
+
+#if FSDATA_FILE_ALIGNMENT==1
+static const unsigned int dummy_align__history_json = 6;
+#endif
+static const unsigned char FSDATA_ALIGN_PRE data__history_json[] FSDATA_ALIGN_POST = {
+/* /history.json (14 chars) */
+0x2f,0x68,0x69,0x73,0x74,0x6f,0x72,0x79,0x2e,0x6a,0x73,0x6f,0x6e,0x00,0x00,0x00,
+
+/* HTTP header */
+/* "HTTP/1.0 200 OK
+" (17 bytes) */
+0x48,0x54,0x54,0x50,0x2f,0x31,0x2e,0x30,0x20,0x32,0x30,0x30,0x20,0x4f,0x4b,0x0d,
+0x0a,
+/* "Server: FanPico (https://github.com/tjko/fanpico)
+" (51 bytes) */
+0x53,0x65,0x72,0x76,0x65,0x72,0x3a,0x20,0x46,0x61,0x6e,0x50,0x69,0x63,0x6f,0x20,
+0x28,0x68,0x74,0x74,0x70,0x73,0x3a,0x2f,0x2f,0x67,0x69,0x74,0x68,0x75,0x62,0x2e,
+0x63,0x6f,0x6d,0x2f,0x74,0x6a,0x6b,0x6f,0x2f,0x66,0x61,0x6e,0x70,0x69,0x63,0x6f,
+0x29,0x0d,0x0a,
+/* "Last-Modified: Sun, 25 Sep 2022 20:03:36 GMT"
+" (46+ bytes) */
+0x4c,0x61,0x73,0x74,0x2d,0x4d,0x6f,0x64,0x69,0x66,0x69,0x65,0x64,0x3a,0x20,0x53,
+0x75,0x6e,0x2c,0x20,0x32,0x35,0x20,0x53,0x65,0x70,0x20,0x32,0x30,0x32,0x32,0x20,
+0x32,0x30,0x3a,0x30,0x33,0x3a,0x33,0x36,0x20,0x47,0x4d,0x54,0x0d,0x0a,
+/* "Expires: Fri, 10 Apr 2008 14:00:00 GMT
+Pragma: no-cache
+" (58 bytes) */
+0x45,0x78,0x70,0x69,0x72,0x65,0x73,0x3a,0x20,0x46,0x72,0x69,0x2c,0x20,0x31,0x30,
+0x20,0x41,0x70,0x72,0x20,0x32,0x30,0x30,0x38,0x20,0x31,0x34,0x3a,0x30,0x30,0x3a,
+0x30,0x30,0x20,0x47,0x4d,0x54,0x0d,0x0a,0x50,0x72,0x61,0x67,0x6d,0x61,0x3a,0x20,
+0x6e,0x6f,0x2d,0x63,0x61,0x63,0x68,0x65,0x0d,0x0a,
+/* "Content-Type: application/json
+
+" (34 bytes) */
+0x43,0x6f,0x6e,0x74,0x65,0x6e,0x74,0x2d,0x54,0x79,0x70,0x65,0x3a,0x20,0x61,0x70,
+0x70,0x6c,0x69,0x63,0x61,0x74,0x69,0x6f,0x6e,0x2f,0x6a,0x73,0x6f,0x6e,0x0d,0x0a,
+0x0d,0x0a,
+/* raw file data (17 bytes) */
+0x3c,0x21,0x2d,0x2d,0x23,0x6a,0x73,0x6f,0x6e,0x68,0x69,0x73,0x74,0x2d,0x2d,0x3e,
+0x0a,};
+
 
 
 const struct fsdata_file file__img_fanpico_icon_png[] = { {
@@ -1268,6 +1348,22 @@ sizeof(data__status_json) - 16,
 FS_FILE_FLAGS_HEADER_INCLUDED | FS_FILE_FLAGS_SSI,
 }};
 
-#define FS_ROOT file__status_json
-#define FS_NUMFILES 7
+const struct fsdata_file file__perf_json[] = { {
+file__status_json,
+data__perf_json,
+data__perf_json + 12,
+sizeof(data__perf_json) - 12,
+FS_FILE_FLAGS_HEADER_INCLUDED | FS_FILE_FLAGS_SSI,
+}};
+
+const struct fsdata_file file__history_json[] = { {
+file__perf_json,
+data__history_json,
+data__history_json + 16,
+sizeof(data__history_json) - 16,
+FS_FILE_FLAGS_HEADER_INCLUDED | FS_FILE_FLAGS_SSI,
+}};
+
+#define FS_ROOT file__history_json
+#define FS_NUMFILES 9
 
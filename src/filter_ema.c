@@ -0,0 +1,102 @@
+/* filter_ema.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "pico/stdlib.h"
+
+#include "fanpico.h"
+#include "filters.h"
+
+
+/* Exponential moving average: y = y + alpha * (x - y) */
+
+typedef struct ema_context {
+	filter_val_t alpha;
+	filter_val_t value;
+	bool valid;
+} ema_context_t;
+
+
+int ema_parse_args(char *args, float *params)
+{
+	char *tok, *saveptr;
+	float alpha;
+
+	if (!args)
+		return 1;
+
+	/* alpha parameter (smoothing factor) */
+	if (!(tok = strtok_r(args, ",", &saveptr)))
+		return 1;
+	if (!str_to_float(tok, &alpha))
+		return 1;
+	if (alpha <= 0.0 || alpha > 1.0)
+		return 1;
+
+	params[0] = alpha;
+
+	return 0;
+}
+
+char* ema_print_args(const float *params)
+{
+	char buf[128];
+
+	snprintf(buf, sizeof(buf), "%f", params[0]);
+
+	return strdup(buf);
+}
+
+void* ema_new(const float *params)
+{
+	ema_context_t *c;
+
+	if (!(c = filter_ctx_alloc(sizeof(ema_context_t))))
+		return NULL;
+
+	c->alpha = FILTER_VAL(params[0]);
+	c->value = 0;
+	c->valid = false;
+
+	return c;
+}
+
+filter_val_t ema_filter(void *ctx, filter_val_t input, uint64_t t)
+{
+	ema_context_t *c = (ema_context_t*)ctx;
+
+	if (!c->valid) {
+		/* Start from first sample */
+		c->value = input;
+		c->valid = true;
+	} else {
+		c->value += FILTER_MUL(c->alpha, input - c->value);
+	}
+
+	return c->value;
+}
+
+
+/* eof :-) */
@@ -0,0 +1,153 @@
+/* filter_kalman.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "pico/stdlib.h"
+
+#include "fanpico.h"
+#include "filters.h"
+
+
+/* One dimensional Kalman filter (for a constant signal with noise).
+ *
+ * Gain (k) does not depend on the input, and converges to a constant
+ * after few samples. With FANPICO_FIXED_POINT estimate is kept in Q16.16
+ * and (float) variance is updated only until gain (in Q16.16) stops changing,
+ * after that filter uses integer arithmetic only.
+ */
+
+typedef struct kalman_context {
+	float q;  /* process noise variance */
+	float r;  /* measurement noise variance */
+	filter_val_t x;  /* estimate */
+	float p;  /* estimate error variance */
+#if FANPICO_FIXED_POINT
+	fx_t k;   /* gain */
+	bool converged;
+#endif
+	bool valid;
+} kalman_context_t;
+
+
+int kalman_parse_args(char *args, float *params)
+{
+	char *tok, *saveptr;
+	float q, r;
+
+	if (!args)
+		return 1;
+
+	/* process noise parameter */
+	if (!(tok = strtok_r(args, ",", &saveptr)))
+		return 1;
+	if (!str_to_float(tok, &q))
+		return 1;
+	if (q <= 0.0)
+		return 1;
+
+	/* measurement noise parameter */
+	if (!(tok = strtok_r(NULL, ",", &saveptr)))
+		return 1;
+	if (!str_to_float(tok, &r))
+		return 1;
+	if (r <= 0.0)
+		return 1;
+
+	params[0] = q;
+	params[1] = r;
+
+	return 0;
+}
+
+char* kalman_print_args(const float *params)
+{
+	char buf[128];
+
+	snprintf(buf, sizeof(buf), "%f,%f", params[0], params[1]);
+
+	return strdup(buf);
+}
+
+void* kalman_new(const float *params)
+{
+	kalman_context_t *c;
+
+	if (!(c = filter_ctx_alloc(sizeof(kalman_context_t))))
+		return NULL;
+
+	c->q = params[0];
+	c->r = params[1];
+	c->x = 0;
+	c->p = 0.0;
+#if FANPICO_FIXED_POINT
+	c->k = 0;
+	c->converged = false;
+#endif
+	c->valid = false;
+
+	return c;
+}
+
+filter_val_t kalman_filter(void *ctx, filter_val_t input, uint64_t t)
+{
+	kalman_context_t *c = (kalman_context_t*)ctx;
+	float k;
+
+	if (!c->valid) {
+		/* Initialize estimate from first measurement */
+		c->x = input;
+		c->p = c->r;
+		c->valid = true;
+		return c->x;
+	}
+
+#if FANPICO_FIXED_POINT
+	if (!c->converged) {
+		fx_t k_fx;
+
+		c->p += c->q;
+		k = c->p / (c->p + c->r);
+		c->p *= (1.0f - k);
+		k_fx = fx_from_float(k, Q16_FRAC);
+		if (k_fx == c->k)
+			c->converged = true;
+		c->k = k_fx;
+	}
+	c->x += fx_mul(c->k, input - c->x, Q16_FRAC);
+#else
+	/* Predict */
+	c->p += c->q;
+
+	/* Update */
+	k = c->p / (c->p + c->r);
+	c->x += k * (input - c->x);
+	c->p *= (1.0f - k);
+#endif
+
+	return c->x;
+}
+
+
+/* eof :-) */
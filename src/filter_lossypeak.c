@@ -27,72 +27,79 @@
 #include "pico/stdlib.h"
 
 #include "fanpico.h"
+#include "filters.h"
 
 
 typedef struct lossypeak_context {
-	float peak;
+	filter_val_t peak;
 	int64_t delay_us;
-	float decay;
-	absolute_time_t last_t;
-	absolute_time_t peak_t;
+	filter_val_t decay;  /* decay per second */
+	uint64_t last_t;  /* time of last sample (us) */
+	uint64_t peak_t;  /* time of current peak (us) */
 	uint8_t state;
 } lossypeak_context_t;
 
 
-void* lossy_peak_parse_args(char *args)
+int lossy_peak_parse_args(char *args, float *params)
 {
-	lossypeak_context_t *c;
 	char *tok, *saveptr;
 	float decay, delay;
 
 	if (!args)
-		return NULL;
+		return 1;
 
 	/* decay parameter (points per second) */
 	if (!(tok = strtok_r(args, ",", &saveptr)))
-		return NULL;
+		return 1;
 	if (!str_to_float(tok, &decay))
-		return NULL;
+		return 1;
 	if (decay < 0.0)
-		return NULL;
+		return 1;
 
 	/* delay parameter (seconds) */
 	if (!(tok = strtok_r(NULL, ",", &saveptr)))
-		return NULL;
+		return 1;
 	if (!str_to_float(tok, &delay))
-		return NULL;
+		return 1;
 	if (delay < 0.0)
-		return NULL;
-
+		return 1;
 
-	if (!(c = malloc(sizeof(lossypeak_context_t))))
-		return NULL;
-
-	c->peak = 0.0;
-	c->delay_us = delay * 1000000;
-	c->decay = decay;
-	c->last_t = get_absolute_time();
-	update_us_since_boot(&c->peak_t, 0);
-	c->state = 0;
+	params[0] = decay;
+	params[1] = delay;
 
-	return c;
+	return 0;
 }
 
-char* lossy_peak_print_args(void *ctx)
+char* lossy_peak_print_args(const float *params)
 {
-	lossypeak_context_t *c = (lossypeak_context_t*)ctx;
 	char buf[128];
 
-	snprintf(buf, sizeof(buf), "%f,%f", c->decay, (float)(c->delay_us / 1000000.0));
+	snprintf(buf, sizeof(buf), "%f,%f", params[0], params[1]);
 
 	return strdup(buf);
 }
 
-float lossy_peak_filter(void *ctx, float input)
+void* lossy_peak_new(const float *params)
+{
+	lossypeak_context_t *c;
+
+	if (!(c = filter_ctx_alloc(sizeof(lossypeak_context_t))))
+		return NULL;
+
+	c->peak = 0;
+	c->delay_us = params[1] * 1000000;
+	c->decay = FILTER_VAL(params[0]);
+	c->last_t = 0;
+	c->peak_t = 0;
+	c->state = 0;
+
+	return c;
+}
+
+filter_val_t lossy_peak_filter(void *ctx, filter_val_t input, uint64_t t_now)
 {
 	lossypeak_context_t *c = (lossypeak_context_t*)ctx;
-	absolute_time_t t_now = get_absolute_time();
-	int64_t t_d = absolute_time_diff_us(c->last_t, t_now);
+	int64_t t_d = (c->last_t > 0 ? (int64_t)(t_now - c->last_t) : 0);
 
 	if (input >= c->peak) {
 		c->peak = input;
@@ -101,7 +108,7 @@ float lossy_peak_filter(void *ctx, float input)
 	} else {
 		if (c->state == 0) {
 			if (c->delay_us > 0) {
-				t_d = absolute_time_diff_us(c->peak_t, t_now);
+				t_d = t_now - c->peak_t;
 				if (t_d > c->delay_us) {
 					c->state = 1;
 					t_d -= c->delay_us;
@@ -111,7 +118,11 @@ float lossy_peak_filter(void *ctx, float input)
 			}
 		}
 		if (c->state == 1) {
-			float decay = (t_d / 1000000.0) * c->decay;
+#if FANPICO_FIXED_POINT
+			filter_val_t decay = ((int64_t)c->decay * t_d) / 1000000;
+#else
+			float decay = (t_d / 1000000.0f) * c->decay;
+#endif
 			if (input > c->peak - decay) {
 				c->peak = input;
 			} else {
@@ -0,0 +1,167 @@
+/* filter_median.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "pico/stdlib.h"
+
+#include "fanpico.h"
+#include "filters.h"
+
+
+#define MEDIAN_WINDOW_MAX_SIZE 15
+
+/* Rolling median over a window of samples.
+ *
+ * Samples are kept both in a ring buffer (in arrival order) and in a
+ * sorted array. Once window is full, oldest sample is located in the
+ * sorted array (using binary search) and replaced by the new sample,
+ * which is then moved into its sorted position. This moves only the
+ * samples between the old and new value (typically few, for a slowly
+ * changing signal), at most window - 1 (14) values.
+ *
+ * With windows this small, this is faster than O(log n) pair of heaps
+ * (with position tracking). Benchmark in tests/test_filters.c (x86-64
+ * host, ns/sample for noisy/slowly changing input):
+ *
+ *   window   this     heaps
+ *     5      30/20    40/40
+ *    15      60/50    70/65
+ *
+ * Heaps would also need 140 bytes of context (vs. 124 bytes).
+ */
+
+typedef struct median_context {
+	filter_val_t data[MEDIAN_WINDOW_MAX_SIZE];
+	filter_val_t sorted[MEDIAN_WINDOW_MAX_SIZE];
+	uint8_t index;
+	uint8_t used;
+	uint8_t window;
+} median_context_t;
+
+
+int median_parse_args(char *args, float *params)
+{
+	char *tok, *saveptr;
+	int window;
+
+	if (!args)
+		return 1;
+
+	/* window parameter (samples) */
+	if (!(tok = strtok_r(args, ",", &saveptr)))
+		return 1;
+	if (!str_to_int(tok, &window, 10))
+		return 1;
+	if (window < 3 || window > MEDIAN_WINDOW_MAX_SIZE)
+		return 1;
+
+	params[0] = window;
+
+	return 0;
+}
+
+char* median_print_args(const float *params)
+{
+	char buf[128];
+
+	snprintf(buf, sizeof(buf), "%u", (uint)params[0]);
+
+	return strdup(buf);
+}
+
+void* median_new(const float *params)
+{
+	median_context_t *c;
+
+	if (!(c = filter_ctx_alloc(sizeof(median_context_t))))
+		return NULL;
+
+	c->index = 0;
+	c->used = 0;
+	c->window = params[0];
+
+	return c;
+}
+
+/* Return index of first value in sorted array that is >= val. */
+static int median_search(const filter_val_t *sorted, int count, filter_val_t val)
+{
+	int lo = 0;
+	int hi = count;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (sorted[mid] < val)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+filter_val_t median_filter(void *ctx, filter_val_t input, uint64_t t)
+{
+	median_context_t *c = (median_context_t*)ctx;
+	int pos;
+
+#if !FANPICO_FIXED_POINT
+	if (isnan(input))
+		return (c->used > 0 ? c->sorted[c->used / 2] : input);
+#endif
+
+	if (c->used < c->window) {
+		/* Ring buffer not yet full, insert new value into sorted array */
+		pos = median_search(c->sorted, c->used, input);
+		memmove(&c->sorted[pos + 1], &c->sorted[pos],
+			(c->used - pos) * sizeof(filter_val_t));
+		c->used++;
+	} else {
+		/* Ring buffer is full, replace oldest value in sorted array
+		   with the new value and move it into its place. */
+		pos = median_search(c->sorted, c->used, c->data[c->index]);
+		if (input > c->sorted[pos]) {
+			while (pos < c->used - 1 && c->sorted[pos + 1] < input) {
+				c->sorted[pos] = c->sorted[pos + 1];
+				pos++;
+			}
+		} else {
+			while (pos > 0 && c->sorted[pos - 1] > input) {
+				c->sorted[pos] = c->sorted[pos - 1];
+				pos--;
+			}
+		}
+	}
+	c->sorted[pos] = input;
+	c->data[c->index] = input;
+
+	/* Point index to next slot in the ring buffer. */
+	c->index = ((c->index + 1) % c->window);
+
+	return c->sorted[c->used / 2];
+}
+
+
+/* eof :-) */
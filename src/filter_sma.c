@@ -27,63 +27,78 @@
 #include "pico/stdlib.h"
 
 #include "fanpico.h"
+#include "filters.h"
 
 
 #define SMA_WINDOW_MAX_SIZE 32
 
+#if FANPICO_FIXED_POINT
+typedef int64_t sma_sum_t;
+#else
+typedef double sma_sum_t;
+#endif
+
 typedef struct sma_context {
-	float data[SMA_WINDOW_MAX_SIZE];
-	double sum;
+	filter_val_t data[SMA_WINDOW_MAX_SIZE];
+	sma_sum_t sum;
 	uint8_t index;
 	uint8_t used;
 	uint8_t window;
 } sma_context_t;
 
 
-void* sma_parse_args(char *args)
+int sma_parse_args(char *args, float *params)
 {
-	sma_context_t *c;
 	char *tok, *saveptr;
-	int window, i;
+	int window;
 
 	if (!args)
-		return NULL;
+		return 1;
 
 	/* window parameter (samples) */
 	if (!(tok = strtok_r(args, ",", &saveptr)))
-		return NULL;
+		return 1;
 	if (!str_to_int(tok, &window, 10))
-		return NULL;
+		return 1;
 	if (window < 2 || window > SMA_WINDOW_MAX_SIZE)
-		return NULL;
+		return 1;
 
-	if (!(c = malloc(sizeof(sma_context_t))))
-		return NULL;
+	params[0] = window;
 
-	c->index = 0;
-	c->used = 0;
-	c->window = window;
-	c->sum = 0.0;
-	for(i = 0; i < SMA_WINDOW_MAX_SIZE; i++)
-		c->data[i] = 0.0;
-
-	return c;
+	return 0;
 }
 
-char* sma_print_args(void *ctx)
+char* sma_print_args(const float *params)
 {
-	sma_context_t *c = (sma_context_t*)ctx;
 	char buf[128];
 
-	snprintf(buf, sizeof(buf), "%u", c->window);
+	snprintf(buf, sizeof(buf), "%u", (uint)params[0]);
 
 	return strdup(buf);
 }
 
-float sma_filter(void *ctx, float input)
+void* sma_new(const float *params)
+{
+	sma_context_t *c;
+	int i;
+
+	if (!(c = filter_ctx_alloc(sizeof(sma_context_t))))
+		return NULL;
+
+	c->index = 0;
+	c->used = 0;
+	c->window = params[0];
+	c->sum = 0;
+	for(i = 0; i < SMA_WINDOW_MAX_SIZE; i++)
+		c->data[i] = 0;
+
+	return c;
+}
+
+filter_val_t sma_filter(void *ctx, filter_val_t input, uint64_t t)
 {
 	sma_context_t *c = (sma_context_t*)ctx;
-	float output;
+	filter_val_t output;
 
 	if (c->used < c->window) {
 		/* Ring buffer not yet full */
@@ -31,13 +31,115 @@
 
 
 static const filter_entry_t filters[] = {
-	{ "none", NULL, NULL, NULL }, /* FILTER_NONE */
-	{ "lossypeak", lossy_peak_parse_args, lossy_peak_print_args, lossy_peak_filter }, /* FILTER_LOSSYPEAK */
-	{ "sma", sma_parse_args, sma_print_args, sma_filter }, /* FILTER_SMA */
-	{ NULL, NULL, NULL, NULL }
+	{ "none", NULL, NULL, NULL, NULL, FILTER_CTX_SMALL }, /* FILTER_NONE */
+	{ "lossypeak", lossy_peak_parse_args, lossy_peak_print_args, lossy_peak_new, lossy_peak_filter, FILTER_CTX_SMALL }, /* FILTER_LOSSYPEAK */
+	{ "sma", sma_parse_args, sma_print_args, sma_new, sma_filter, FILTER_CTX_LARGE }, /* FILTER_SMA */
+	{ "ema", ema_parse_args, ema_print_args, ema_new, ema_filter, FILTER_CTX_SMALL }, /* FILTER_EMA */
+	{ "median", median_parse_args, median_print_args, median_new, median_filter, FILTER_CTX_LARGE }, /* FILTER_MEDIAN */
+	{ "kalman", kalman_parse_args, kalman_print_args, kalman_new, kalman_filter, FILTER_CTX_SMALL }, /* FILTER_KALMAN */
+	{ NULL, NULL, NULL, NULL, NULL, FILTER_CTX_SMALL }
 };
 
 
+/* Filter state for a channel, built from filter chain configuration. */
+struct filter_chain_state {
+	struct filter_chain chain;  /* configuration the state was built from */
+	uint8_t stages;             /* number of active stages */
+	void *ctx[FILTER_MAX_STAGES];
+};
+
+/*
+ * Filter state is owned by the core running the control loop
+ * (FANPICO_CONTROL_CORE), and is only accessed from that core. State is
+ * (re)built from the configuration whenever configuration of a channel
+ * changes, so configuration itself is plain data that can be freely
+ * copied between the cores.
+ */
+static struct filter_chain_state fan_filter_state[FAN_MAX_COUNT];
+static struct filter_chain_state mbfan_filter_state[MBFAN_MAX_COUNT];
+static struct filter_chain_state sensor_filter_state[SENSOR_MAX_COUNT];
+static struct filter_chain_state vsensor_filter_state[VSENSOR_MAX_COUNT];
+
+/* Fixed pools of filter contexts (to avoid heap fragmentation),
+ * small filters get small contexts.
+ */
+static union {
+	uint8_t data[FILTER_CTX_SMALL_SIZE];
+	uint64_t align;
+} small_ctx[FILTER_POOL_SMALL];
+static union {
+	uint8_t data[FILTER_CTX_LARGE_SIZE];
+	uint64_t align;
+} large_ctx[FILTER_POOL_LARGE];
+
+struct filter_pool {
+	uint8_t *data;
+	uint16_t ctx_size;
+	uint8_t count;
+	uint32_t used;
+};
+
+static struct filter_pool filter_pool[FILTER_CTX_CLASSES] = {
+	{ small_ctx[0].data, sizeof(small_ctx[0]), FILTER_POOL_SMALL, 0 },
+	{ large_ctx[0].data, sizeof(large_ctx[0]), FILTER_POOL_LARGE, 0 },
+};
+
+static const char *ctx_class_names[] = { "small", "large" };
+
+
+/* Allocate filter context from the pool of smallest contexts that fit. */
+void* filter_ctx_alloc(size_t size)
+{
+	struct filter_pool *p;
+
+	if (size > FILTER_CTX_LARGE_SIZE)
+		return NULL;
+	p = &filter_pool[size > FILTER_CTX_SMALL_SIZE ? FILTER_CTX_LARGE : FILTER_CTX_SMALL];
+
+	for (int i = 0; i < p->count; i++) {
+		if (!(p->used & (1UL << i))) {
+			uint8_t *ctx = p->data + i * p->ctx_size;
+
+			p->used |= (1UL << i);
+			memset(ctx, 0, p->ctx_size);
+			return ctx;
+		}
+	}
+
+	log_msg(LOG_WARNING, "Filter context pool exhausted (%s contexts)",
+		ctx_class_names[p == &filter_pool[FILTER_CTX_LARGE]]);
+	return NULL;
+}
+
+
+void filter_ctx_free(void *ctx)
+{
+	if (!ctx)
+		return;
+
+	for (int c = 0; c < FILTER_CTX_CLASSES; c++) {
+		struct filter_pool *p = &filter_pool[c];
+		ptrdiff_t offset = (uint8_t*)ctx - p->data;
+
+		if (offset >= 0 && offset < p->count * p->ctx_size) {
+			assert(offset % p->ctx_size == 0);
+			p->used &= ~(1UL << (offset / p->ctx_size));
+			return;
+		}
+	}
+	assert(0);
+}
+
+
+/* Return class of context (pool) used by a filter. */
+enum filter_ctx_class filter_ctx_class(enum signal_filter_types filter)
+{
+	if (filter <= FILTER_ENUM_MAX)
+		return filters[filter].ctx_class;
+	return FILTER_CTX_SMALL;
+}
+
+
 int str2filter(const char *s)
 {
 	int ret = FILTER_NONE;
@@ -62,43 +164,309 @@ const char* filter2str(enum signal_filter_types source)
 }
 
 
-void* filter_parse_args(enum signal_filter_types filter, char *args)
+int filter_parse_args(enum signal_filter_types filter, char *args, float *params)
 {
-	void *ret = NULL;
+	int ret = 1;
 
 	if (filter <= FILTER_ENUM_MAX) {
 		if (filters[filter].parse_args_func)
-			ret = filters[filter].parse_args_func(args);
+			ret = filters[filter].parse_args_func(args, params);
 	}
 
 	return ret;
 }
 
 
-char* filter_print_args(enum signal_filter_types filter, void *ctx)
+char* filter_print_args(enum signal_filter_types filter, const float *params)
 {
 	char *ret = NULL;
 
-	if (filter <= FILTER_ENUM_MAX && ctx) {
+	if (filter <= FILTER_ENUM_MAX && params) {
 		if (filters[filter].print_args_func)
-			ret = filters[filter].print_args_func(ctx);
+			ret = filters[filter].print_args_func(params);
 	}
 
 	return ret;
 }
 
 
-float filter(enum signal_filter_types filter, void *ctx, float input)
+/* Append filter to the end of a chain. Returns 0 on success. */
+int filter_chain_add(struct filter_chain *chain, enum signal_filter_types filter, const char *args)
+{
+	struct filter_stage *s;
+	char *tmp;
+	int ret;
+
+	if (filter == FILTER_NONE)
+		return 0;
+	if (filter > FILTER_ENUM_MAX || chain->stages >= FILTER_MAX_STAGES)
+		return 1;
+	if (!(tmp = strdup(args ? args : "")))
+		return 2;
+
+	s = &chain->stage[chain->stages];
+	memset(s, 0, sizeof(*s));
+	ret = filter_parse_args(filter, tmp, s->args);
+	free(tmp);
+	if (ret)
+		return ret;
+
+	s->filter = filter;
+	chain->stages++;
+
+	return 0;
+}
+
+
+/* Parse filter chain definition (stages separated by '|'):
+ *
+ *    filter,arg_1,...,arg_n|filter,arg_1,...,arg_n|...
+ *
+ * Existing chain is replaced only if whole definition is valid.
+ * Returns 0 on success.
+ */
+int filter_chain_parse(struct filter_chain *chain, const char *str)
 {
-	float ret = input;
+	struct filter_chain new_chain;
+	char *buf, *stage, *saveptr, *args;
+	int ret = 0;
+
+	if (!(buf = strdup(str)))
+		return 2;
 
-	if (filter <= FILTER_ENUM_MAX && ctx) {
-		if (filters[filter].filter_func)
-			ret = filters[filter].filter_func(ctx, input);
+	memset(&new_chain, 0, sizeof(new_chain));
+	stage = strtok_r(buf, "|", &saveptr);
+	while (stage && !ret) {
+		stage = trim_str(stage);
+		if ((args = strchr(stage, ',')))
+			*args++ = 0;
+		if (*stage)
+			ret = filter_chain_add(&new_chain, str2filter(stage), args);
+		stage = strtok_r(NULL, "|", &saveptr);
 	}
+	free(buf);
+
+	if (!ret)
+		memcpy(chain, &new_chain, sizeof(*chain));
 
 	return ret;
 }
 
 
+/* Add number of filter stages in a chain (per context class) to 'count'. */
+static void chain_stages(const struct filter_chain *chain, int count[], int sign)
+{
+	for (int i = 0; i < chain->stages; i++)
+		count[filter_ctx_class(chain->stage[i].filter)] += sign;
+}
+
+
+/* Return total number of filter stages configured (over all channels)
+ * per context class.
+ */
+static void filter_stages_total(const struct fanpico_config *config, int total[])
+{
+	for (int c = 0; c < FILTER_CTX_CLASSES; c++)
+		total[c] = 0;
+	for (int i = 0; i < FAN_COUNT; i++)
+		chain_stages(&config->fans[i].filter, total, 1);
+	for (int i = 0; i < MBFAN_COUNT; i++)
+		chain_stages(&config->mbfans[i].filter, total, 1);
+	for (int i = 0; i < SENSOR_COUNT; i++)
+		chain_stages(&config->sensors[i].filter, total, 1);
+	for (int i = 0; i < VSENSOR_COUNT; i++)
+		chain_stages(&config->vsensors[i].filter, total, 1);
+}
+
+
+/* Parse filter chain definition (see filter_chain_parse()) for a channel
+ * in 'config'. Definition is rejected if there would not be enough
+ * filter contexts (in the pools) for all configured filter stages.
+ * Returns 0 on success.
+ */
+int filter_chain_set(const struct fanpico_config *config, struct filter_chain *chain,
+		const char *str)
+{
+	struct filter_chain new_chain;
+	int total[FILTER_CTX_CLASSES];
+	int ret;
+
+	if ((ret = filter_chain_parse(&new_chain, str)))
+		return ret;
+
+	filter_stages_total(config, total);
+	chain_stages(chain, total, -1);
+	chain_stages(&new_chain, total, 1);
+	for (int c = 0; c < FILTER_CTX_CLASSES; c++) {
+		if (total[c] > filter_pool[c].count) {
+			log_msg(LOG_NOTICE, "Too many filter stages using %s context: %d (max %d in total)",
+				ctx_class_names[c], total[c], filter_pool[c].count);
+			return 3;
+		}
+	}
+	memcpy(chain, &new_chain, sizeof(*chain));
+
+	return 0;
+}
+
+
+/* Drop filter stages that do not fit in the filter context pools
+ * (configuration loaded from flash). Chain is truncated at the first
+ * stage that does not fit. Returns number of stages dropped.
+ */
+int filter_config_check(struct fanpico_config *config)
+{
+	struct filter_chain *chains[FAN_MAX_COUNT + MBFAN_MAX_COUNT
+				+ SENSOR_MAX_COUNT + VSENSOR_MAX_COUNT];
+	int total[FILTER_CTX_CLASSES] = { 0 };
+	int count = 0, dropped = 0;
+
+	for (int i = 0; i < FAN_COUNT; i++)
+		chains[count++] = &config->fans[i].filter;
+	for (int i = 0; i < MBFAN_COUNT; i++)
+		chains[count++] = &config->mbfans[i].filter;
+	for (int i = 0; i < SENSOR_COUNT; i++)
+		chains[count++] = &config->sensors[i].filter;
+	for (int i = 0; i < VSENSOR_COUNT; i++)
+		chains[count++] = &config->vsensors[i].filter;
+
+	for (int i = 0; i < count; i++) {
+		struct filter_chain *chain = chains[i];
+		int keep;
+
+		for (keep = 0; keep < chain->stages; keep++) {
+			int c = filter_ctx_class(chain->stage[keep].filter);
+
+			if (total[c] >= filter_pool[c].count)
+				break;
+			total[c]++;
+		}
+		if (keep < chain->stages) {
+			dropped += chain->stages - keep;
+			memset(&chain->stage[keep], 0,
+				(chain->stages - keep) * sizeof(chain->stage[0]));
+			chain->stages = keep;
+		}
+	}
+	if (dropped > 0)
+		log_msg(LOG_ERR, "Too many filter stages (max %d small and %d large contexts): %d stage(s) ignored",
+			FILTER_POOL_SMALL, FILTER_POOL_LARGE, dropped);
+
+	return dropped;
+}
+
+
+/* Return (dynamically allocated) string describing filter chain. */
+char* filter_chain_print(const struct filter_chain *chain)
+{
+	char buf[256];
+	size_t len = 0;
+	char *args;
+
+	buf[0] = 0;
+	if (chain->stages == 0)
+		return strdup("none,");
+
+	for (int i = 0; i < chain->stages; i++) {
+		const struct filter_stage *s = &chain->stage[i];
+
+		args = filter_print_args(s->filter, s->args);
+		len += snprintf(buf + len, sizeof(buf) - len, "%s%s,%s",
+				(i > 0 ? "|" : ""), filter2str(s->filter),
+				(args ? args : ""));
+		if (args)
+			free(args);
+		if (len >= sizeof(buf))
+			break;
+	}
+
+	return strdup(buf);
+}
+
+
+static struct filter_chain_state* channel_state(enum filter_channel_types type, uint i)
+{
+	switch (type) {
+	case FILTER_CH_FAN:
+		return (i < FAN_MAX_COUNT ? &fan_filter_state[i] : NULL);
+	case FILTER_CH_MBFAN:
+		return (i < MBFAN_MAX_COUNT ? &mbfan_filter_state[i] : NULL);
+	case FILTER_CH_SENSOR:
+		return (i < SENSOR_MAX_COUNT ? &sensor_filter_state[i] : NULL);
+	case FILTER_CH_VSENSOR:
+		return (i < VSENSOR_MAX_COUNT ? &vsensor_filter_state[i] : NULL);
+	}
+	return NULL;
+}
+
+
+static const char *channel_names[] = { "fan", "mbfan", "sensor", "vsensor" };
+
+/* Rebuild filter state of a channel, if its configuration has changed. */
+static void update_chain_state(enum filter_channel_types type, uint idx,
+			const struct filter_chain *chain)
+{
+	struct filter_chain_state *st = channel_state(type, idx);
+
+	if (!memcmp(&st->chain, chain, sizeof(st->chain)))
+		return;
+
+	for (int i = 0; i < st->stages; i++)
+		filter_ctx_free(st->ctx[i]);
+	memset(st, 0, sizeof(*st));
+	memcpy(&st->chain, chain, sizeof(st->chain));
+
+	for (int i = 0; i < chain->stages; i++) {
+		const struct filter_stage *s = &chain->stage[i];
+
+		if (!(st->ctx[i] = filters[s->filter].new_func(s->args)))
+			break;
+		st->stages++;
+	}
+	if (st->stages < chain->stages)
+		log_msg(LOG_ERR, "%s%u: filter chain truncated: %u of %u stages active",
+			channel_names[type], idx + 1, st->stages, chain->stages);
+}
+
+
+/* Update filter state to match current configuration.
+ * Must be called only from the core running the filters.
+ */
+void filter_state_update(const struct fanpico_control_config *config)
+{
+	for (int i = 0; i < FAN_COUNT; i++)
+		update_chain_state(FILTER_CH_FAN, i, &config->fans[i].filter);
+	for (int i = 0; i < MBFAN_COUNT; i++)
+		update_chain_state(FILTER_CH_MBFAN, i, &config->mbfans[i].filter);
+	for (int i = 0; i < SENSOR_COUNT; i++)
+		update_chain_state(FILTER_CH_SENSOR, i, &config->sensors[i].filter);
+	for (int i = 0; i < VSENSOR_COUNT; i++)
+		update_chain_state(FILTER_CH_VSENSOR, i, &config->vsensors[i].filter);
+}
+
+
+/* Run input through all filters configured for a channel.
+ * Timestamp 't' (microseconds) is the time of the input sample.
+ */
+filter_val_t filter_channel(enum filter_channel_types type, uint i, filter_val_t input, uint64_t t)
+{
+	struct filter_chain_state *st = channel_state(type, i);
+	const struct filter_stage *s;
+
+	if (!st || st->stages == 0)
+		return input;
+
+	s = st->chain.stage;
+
+	/* Common case of a single filter */
+	if (st->stages == 1)
+		return filters[s->filter].filter_func(st->ctx[0], input, t);
+
+	for (int n = 0; n < st->stages; n++, s++)
+		input = filters[s->filter].filter_func(st->ctx[n], input, t);
+
+	return input;
+}
+
+
 /* eof :-) */
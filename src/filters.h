@@ -22,26 +22,78 @@
 #ifndef FANPICO_FILTERS_H
 #define FANPICO_FILTERS_H 1
 
-typedef void* (filter_parse_args_func_t)(char *args);
-typedef char* (filter_print_args_func_t)(void *ctx);
-typedef float (filter_func_t)(void *ctx, float input);
+typedef int (filter_parse_args_func_t)(char *args, float *params);
+typedef char* (filter_print_args_func_t)(const float *params);
+typedef void* (filter_new_func_t)(const float *params);
+typedef filter_val_t (filter_func_t)(void *ctx, filter_val_t input, uint64_t t);
+
+/* Filter state is kept in the same format as filter input/output
+ * (filter_val_t), parameters are converted using FILTER_VAL().
+ */
+#if FANPICO_FIXED_POINT
+#define FILTER_MUL(a, b)  fx_mul((a), (b), Q16_FRAC)
+#else
+#define FILTER_MUL(a, b)  ((a) * (b))
+#endif
+
+/* Filter contexts are allocated from two fixed pools: small contexts
+ * (filters with only a few state variables) and large contexts (filters
+ * keeping a window of samples).
+ */
+enum filter_ctx_class {
+	FILTER_CTX_SMALL = 0,
+	FILTER_CTX_LARGE = 1,
+};
+#define FILTER_CTX_CLASSES     2
+
+#define FILTER_POOL_SMALL      32   /* Number of small filter contexts in the pool */
+#define FILTER_POOL_LARGE      16   /* Number of large filter contexts in the pool */
+#define FILTER_CTX_SMALL_SIZE  48   /* Maximum size of a small filter context */
+#define FILTER_CTX_LARGE_SIZE  160  /* Maximum size of a filter context */
 
 typedef struct filter_entry {
 	const char* name;
 	filter_parse_args_func_t *parse_args_func;
 	filter_print_args_func_t *print_args_func;
+	filter_new_func_t *new_func;
 	filter_func_t *filter_func;
+	enum filter_ctx_class ctx_class;
 } filter_entry_t;
 
+/* filters.c */
+void* filter_ctx_alloc(size_t size);
+void filter_ctx_free(void *ctx);
+enum filter_ctx_class filter_ctx_class(enum signal_filter_types filter);
+
 /* filters_lossypeak.c */
-void* lossy_peak_parse_args(char *args);
-char* lossy_peak_print_args(void *ctx);
-float lossy_peak_filter(void *ctx, float input);
+int lossy_peak_parse_args(char *args, float *params);
+char* lossy_peak_print_args(const float *params);
+void* lossy_peak_new(const float *params);
+filter_val_t lossy_peak_filter(void *ctx, filter_val_t input, uint64_t t);
 
 /* filters_sma.c */
-void* sma_parse_args(char *args);
-char* sma_print_args(void *ctx);
-float sma_filter(void *ctx, float input);
+int sma_parse_args(char *args, float *params);
+char* sma_print_args(const float *params);
+void* sma_new(const float *params);
+filter_val_t sma_filter(void *ctx, filter_val_t input, uint64_t t);
+
+/* filters_ema.c */
+int ema_parse_args(char *args, float *params);
+char* ema_print_args(const float *params);
+void* ema_new(const float *params);
+filter_val_t ema_filter(void *ctx, filter_val_t input, uint64_t t);
+
+/* filters_median.c */
+int median_parse_args(char *args, float *params);
+char* median_print_args(const float *params);
+void* median_new(const float *params);
+filter_val_t median_filter(void *ctx, filter_val_t input, uint64_t t);
+
+/* filters_kalman.c */
+int kalman_parse_args(char *args, float *params);
+char* kalman_print_args(const float *params);
+void* kalman_new(const float *params);
+filter_val_t kalman_filter(void *ctx, filter_val_t input, uint64_t t);
 
 
 #endif /* FANPICO_FILTERS_H */
@@ -0,0 +1,73 @@
+/* fixedpoint.h
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FANPICO_FIXEDPOINT_H
+#define FANPICO_FIXEDPOINT_H 1
+
+#include <stdint.h>
+
+/* Signed 32bit fixed-point helpers for the control path.
+ *
+ * RP2040 has no FPU, so (soft) double math in the control loop is
+ * expensive. Values are stored in int32_t with 'frac' fractional bits:
+ *
+ *   Q16.16  duty cycles (%), temperatures and coefficients
+ *   Q20.12  RPM values (range up to 524287 RPM)
+ *
+ * Intermediate products are calculated using 64bit integers.
+ */
+
+typedef int32_t fx_t;
+
+#define Q16_FRAC  16
+#define Q12_FRAC  12
+
+
+static inline fx_t fx_from_int(int32_t v, unsigned int frac)
+{
+	return v * (1L << frac);
+}
+
+static inline fx_t fx_from_float(float v, unsigned int frac)
+{
+	float f = v * (float)(1L << frac);
+
+	return (fx_t)(f < 0 ? f - 0.5f : f + 0.5f);
+}
+
+static inline fx_t fx_from_double(double v, unsigned int frac)
+{
+	double d = v * (double)(1L << frac);
+
+	return (fx_t)(d < 0 ? d - 0.5 : d + 0.5);
+}
+
+static inline double fx_to_double(fx_t v, unsigned int frac)
+{
+	return v * (1.0 / (double)(1L << frac));
+}
+
+static inline fx_t fx_mul(fx_t a, fx_t b, unsigned int frac)
+{
+	return (fx_t)(((int64_t)a * b) >> frac);
+}
+
+#endif /* FANPICO_FIXEDPOINT_H */
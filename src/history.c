@@ -0,0 +1,457 @@
+/* history.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#include "fanpico.h"
+#include "psram.h"
+
+
+/*
+ * Time-series history of fan/sensor readings.
+ *
+ * History is stored in a ring of fixed size blocks. First record in
+ * each block is a "key frame" with absolute values, subsequent records
+ * in the block store only (zigzag + varint encoded) deltas from the
+ * previous record. When the buffer is full, oldest block is discarded.
+ *
+ * Each block has a running sequence number, this allows iterators to
+ * detect if the block they were reading has been discarded.
+ */
+
+#define HISTORY_BLOCK_SIZE  512
+#if PICO_RP2040
+#define HISTORY_SRAM_SIZE   (8 * 1024)
+#else
+#define HISTORY_SRAM_SIZE   (32 * 1024)
+#endif
+#define HISTORY_PSRAM_SIZE  (1024 * 1024)
+
+#define HISTORY_CHANNELS (2 * FAN_COUNT + 2 * MBFAN_COUNT + SENSOR_COUNT + VSENSOR_COUNT)
+#define HISTORY_RECORD_MAX (5 + 5 * HISTORY_CHANNELS)
+
+struct history_block {
+	uint64_t t_first;     /* timestamp of the first record (ms since boot) */
+	uint16_t len;         /* bytes used in data[] */
+	uint16_t count;       /* number of records in the block */
+	uint8_t data[HISTORY_BLOCK_SIZE - 12];
+};
+
+struct history_buffer {
+	struct history_block *blocks;
+	uint32_t size;        /* number of blocks allocated */
+	uint32_t first_seq;   /* sequence number of the oldest block */
+	uint32_t used;        /* number of blocks in use */
+	bool psram;
+	uint64_t last_t;
+	int32_t last[HISTORY_CHANNELS];
+};
+
+struct history_group {
+	const char *name;
+	const char *unit;
+	uint8_t count;
+	uint8_t scale;
+};
+
+/* Channels are stored in the order of these groups. */
+static const struct history_group history_groups[] = {
+	{ "fan",     "rpm",  FAN_COUNT,     1 },
+	{ "fan",     "pwm",  FAN_COUNT,     10 },
+	{ "mbfan",   "rpm",  MBFAN_COUNT,   1 },
+	{ "mbfan",   "pwm",  MBFAN_COUNT,   10 },
+	{ "sensor",  "temp", SENSOR_COUNT,  10 },
+	{ "vsensor", "temp", VSENSOR_COUNT, 10 },
+};
+#define HISTORY_GROUP_COUNT (sizeof(history_groups) / sizeof(history_groups[0]))
+
+static struct history_buffer history;
+
+#define HISTORY_BLOCK(seq) (&history.blocks[(seq) % history.size])
+
+
+static inline uint32_t zigzag_encode(int32_t v)
+{
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t zigzag_decode(uint32_t v)
+{
+	return (int32_t)((v >> 1) ^ -(v & 1));
+}
+
+static uint encode_varint(uint8_t *buf, uint32_t v)
+{
+	uint len = 0;
+
+	while (v >= 0x80) {
+		buf[len++] = (v & 0x7f) | 0x80;
+		v >>= 7;
+	}
+	buf[len++] = v;
+
+	return len;
+}
+
+static const uint8_t* decode_varint(const uint8_t *p, const uint8_t *end, uint32_t *v)
+{
+	uint32_t val = 0;
+	uint shift = 0;
+
+	while (p < end && shift < 35) {
+		val |= (uint32_t)(*p & 0x7f) << shift;
+		if (!(*p++ & 0x80)) {
+			*v = val;
+			return p;
+		}
+		shift += 7;
+	}
+
+	return NULL;
+}
+
+
+static const struct history_group* channel_group(uint ch, uint *index)
+{
+	for (int i = 0; i < HISTORY_GROUP_COUNT; i++) {
+		const struct history_group *g = &history_groups[i];
+
+		if (ch < g->count) {
+			if (index)
+				*index = ch;
+			return g;
+		}
+		ch -= g->count;
+	}
+
+	return NULL;
+}
+
+
+static inline int32_t quantize(float val, uint scale)
+{
+	if (isnan(val) || isinf(val))
+		return 0;
+	return roundf(val * scale);
+}
+
+
+static void get_history_values(int32_t *values)
+{
+	const struct fanpico_state *st = fanpico_state;
+	uint ch = 0;
+
+	for (int i = 0; i < FAN_COUNT; i++) {
+		float rpm = (cfg->fans[i].rpm_factor > 0 ?
+			st->fan_freq[i] * 60 / cfg->fans[i].rpm_factor : 0);
+		values[ch++] = quantize(rpm, 1);
+	}
+	for (int i = 0; i < FAN_COUNT; i++)
+		values[ch++] = quantize(st->fan_duty[i], 10);
+	for (int i = 0; i < MBFAN_COUNT; i++) {
+		float rpm = (cfg->mbfans[i].rpm_factor > 0 ?
+			st->mbfan_freq[i] * 60 / cfg->mbfans[i].rpm_factor : 0);
+		values[ch++] = quantize(rpm, 1);
+	}
+	for (int i = 0; i < MBFAN_COUNT; i++)
+		values[ch++] = quantize(st->mbfan_duty[i], 10);
+	for (int i = 0; i < SENSOR_COUNT; i++)
+		values[ch++] = quantize(st->temp[i], 10);
+	for (int i = 0; i < VSENSOR_COUNT; i++)
+		values[ch++] = quantize(st->vtemp[i], 10);
+}
+
+
+static uint encode_record(uint8_t *buf, uint64_t t, const int32_t *values, bool key)
+{
+	uint len = 0;
+
+	if (!key) {
+		uint64_t delta = t - history.last_t;
+		len += encode_varint(buf, (delta > UINT32_MAX ? UINT32_MAX : delta));
+	}
+	for (int i = 0; i < HISTORY_CHANNELS; i++) {
+		int32_t v = (key ? values[i] : values[i] - history.last[i]);
+		len += encode_varint(buf + len, zigzag_encode(v));
+	}
+
+	return len;
+}
+
+
+static void history_add(uint64_t t, const int32_t *values)
+{
+	uint8_t rec[HISTORY_RECORD_MAX];
+	struct history_block *b = NULL;
+	uint32_t irq;
+	uint len;
+
+	if (history.used > 0) {
+		b = HISTORY_BLOCK(history.first_seq + history.used - 1);
+		len = encode_record(rec, t, values, false);
+		if (b->len + len > sizeof(b->data))
+			b = NULL;
+	}
+	if (!b)
+		len = encode_record(rec, t, values, true);
+
+	/* Readers may run in interrupt context (HTTP server)... */
+	irq = save_and_disable_interrupts();
+	if (!b) {
+		if (history.used >= history.size) {
+			history.first_seq++;
+			history.used--;
+		}
+		b = HISTORY_BLOCK(history.first_seq + history.used);
+		b->t_first = t;
+		b->len = 0;
+		b->count = 0;
+		history.used++;
+	}
+	memcpy(b->data + b->len, rec, len);
+	b->len += len;
+	b->count++;
+	restore_interrupts(irq);
+
+	history.last_t = t;
+	memcpy(history.last, values, sizeof(history.last));
+}
+
+
+void history_init()
+{
+	size_t size = 0;
+
+	memset(&history, 0, sizeof(history));
+
+#if !PICO_RP2040
+	if (psram_size() > 0) {
+		size = (psram_size() < HISTORY_PSRAM_SIZE ? psram_size() : HISTORY_PSRAM_SIZE);
+		history.blocks = (struct history_block*)PSRAM_BASE;
+		history.psram = true;
+	}
+#endif
+	if (!history.blocks) {
+		size = HISTORY_SRAM_SIZE;
+		if (!(history.blocks = malloc(size))) {
+			log_msg(LOG_ERR, "history: failed to allocate buffer");
+			return;
+		}
+	}
+	history.size = size / sizeof(struct history_block);
+
+	log_msg(LOG_NOTICE, "History buffer: %u KB (%s)", size >> 10,
+		(history.psram ? "PSRAM" : "SRAM"));
+}
+
+
+void history_clear()
+{
+	uint32_t irq = save_and_disable_interrupts();
+
+	history.first_seq += history.used;
+	history.used = 0;
+	restore_interrupts(irq);
+}
+
+
+bool history_in_psram()
+{
+	return history.psram;
+}
+
+
+void history_sample()
+{
+	int32_t values[HISTORY_CHANNELS];
+
+	if (history.size < 1)
+		return;
+
+	get_history_values(values);
+	history_add(to_us_since_boot(get_absolute_time()) / 1000, values);
+}
+
+
+uint history_channels()
+{
+	return HISTORY_CHANNELS;
+}
+
+
+char* history_channel_name(uint ch, char *buf, size_t len)
+{
+	const struct history_group *g;
+	uint i;
+
+	if (!(g = channel_group(ch, &i)))
+		return NULL;
+
+	snprintf(buf, len, "%s%u_%s", g->name, i + 1, g->unit);
+	return buf;
+}
+
+
+char* history_value_str(uint ch, int32_t val, char *buf, size_t len)
+{
+	const struct history_group *g;
+
+	if (!(g = channel_group(ch, NULL)))
+		return NULL;
+
+	if (g->scale == 1)
+		snprintf(buf, len, "%ld", val);
+	else
+		snprintf(buf, len, "%0.1f", (double)val / g->scale);
+	return buf;
+}
+
+
+static void history_iter_init(struct history_iter *it, uint64_t start)
+{
+	memset(it, 0, sizeof(*it));
+	it->seq = history.first_seq;
+
+	/* Skip blocks that only contain records older than 'start' */
+	while (it->seq - history.first_seq + 1 < history.used
+		&& HISTORY_BLOCK(it->seq + 1)->t_first <= start)
+		it->seq++;
+}
+
+
+static bool history_iter_next(struct history_iter *it)
+{
+	const struct history_block *b;
+	const uint8_t *p, *end;
+	uint32_t v;
+
+	/* Check if block being read has been discarded... */
+	if ((int32_t)(it->seq - history.first_seq) < 0) {
+		it->seq = history.first_seq;
+		it->offset = 0;
+		it->index = 0;
+	}
+
+	while (it->seq - history.first_seq < history.used) {
+		b = HISTORY_BLOCK(it->seq);
+
+		if (it->index < b->count) {
+			p = b->data + it->offset;
+			end = b->data + b->len;
+			if (it->index == 0) {
+				it->t = b->t_first;
+			} else {
+				if (!(p = decode_varint(p, end, &v)))
+					return false;
+				it->t += v;
+			}
+			for (int i = 0; i < HISTORY_CHANNELS; i++) {
+				if (!(p = decode_varint(p, end, &v)))
+					return false;
+				it->values[i] = (it->index == 0 ? 0 : it->values[i]) + zigzag_decode(v);
+			}
+			it->offset = p - b->data;
+			it->index++;
+			return true;
+		}
+
+		/* Current (newest) block may still get more records later... */
+		if (it->seq - history.first_seq + 1 >= history.used)
+			break;
+		it->seq++;
+		it->offset = 0;
+		it->index = 0;
+	}
+
+	return false;
+}
+
+
+/* Initialize history query. Start and end are in seconds since boot,
+ * negative values are relative to current time, and end value of 0
+ * means current time.
+ */
+void history_query_init(struct history_query *q, int32_t start, int32_t end, uint32_t step)
+{
+	int64_t now = to_us_since_boot(get_absolute_time()) / 1000;
+	int64_t t;
+
+	t = (start < 0 ? now + (int64_t)start * 1000 : (int64_t)start * 1000);
+	q->start = (t < 0 ? 0 : t);
+	t = (end <= 0 ? now + (int64_t)end * 1000 : (int64_t)end * 1000);
+	q->end = (t < 0 ? 0 : t);
+	q->step = (step < 1 ? 1 : step);
+	q->matched = 0;
+
+	history_iter_init(&q->it, q->start);
+}
+
+
+/* Return next record (in q->it) matching the query. */
+bool history_query_next(struct history_query *q)
+{
+	while (history_iter_next(&q->it)) {
+		if (q->it.t < q->start)
+			continue;
+		if (q->it.t > q->end)
+			break;
+		if (q->matched++ % q->step == 0)
+			return true;
+	}
+
+	return false;
+}
+
+
+void print_history_info()
+{
+	uint64_t now = to_us_since_boot(get_absolute_time()) / 1000;
+	uint32_t records = 0;
+	uint32_t bytes = 0;
+
+	for (uint32_t i = 0; i < history.used; i++) {
+		const struct history_block *b = HISTORY_BLOCK(history.first_seq + i);
+		records += b->count;
+		bytes += b->len;
+	}
+
+	printf("Memory: %s\n", (history.size > 0 ?
+			(history.psram ? "PSRAM" : "SRAM") : "N/A"));
+	printf("Size: %lu bytes (%lu blocks)\n",
+		(uint32_t)(history.size * sizeof(struct history_block)), history.size);
+	printf("Used: %lu blocks\n", history.used);
+	printf("Channels: %u\n", HISTORY_CHANNELS);
+	printf("Records: %lu\n", records);
+	if (records > 0) {
+		printf("Bytes/record: %0.1f\n", (double)bytes / records);
+		printf("Oldest: %llu s ago\n",
+			(now - HISTORY_BLOCK(history.first_seq)->t_first) / 1000);
+	}
+	printf("Interval: %lu s\n", cfg->history_interval);
+}
+
+
+/* eof :-) */
@@ -24,6 +24,7 @@
 #include <time.h>
 #include <assert.h>
 #include "pico/stdlib.h"
+#include "lwip/apps/httpd.h"
 #include "cJSON.h"
 
 #include "fanpico.h"
@@ -150,6 +151,7 @@ u16_t json_stats(char *insert, int insertlen, u16_t current_tag_part, u16_t *nex
 			cJSON_AddItemToObject(o, "rpm", cJSON_CreateNumber(round_decimal(rpm, 0)));
 			cJSON_AddItemToObject(o, "frequency", cJSON_CreateNumber(round_decimal(st->fan_freq[i], 2)));
 			cJSON_AddItemToObject(o, "duty_cycle", cJSON_CreateNumber(round_decimal(st->fan_duty[i], 1)));
+			cJSON_AddItemToObject(o, "status", cJSON_CreateString(fan_status2str(st->fan_status[i])));
 			cJSON_AddItemToArray(array, o);
 		}
 		cJSON_AddItemToObject(json, "fans", array);
@@ -168,6 +170,7 @@ u16_t json_stats(char *insert, int insertlen, u16_t current_tag_part, u16_t *nex
 			cJSON_AddItemToObject(o, "rpm", cJSON_CreateNumber(round_decimal(rpm, 0)));
 			cJSON_AddItemToObject(o, "frequency", cJSON_CreateNumber(round_decimal(st->mbfan_freq[i], 2)));
 			cJSON_AddItemToObject(o, "duty_cycle", cJSON_CreateNumber(round_decimal(st->mbfan_duty[i], 1)));
+			cJSON_AddItemToObject(o, "pwm_frequency", cJSON_CreateNumber(round_decimal(st->mbfan_pwm_freq[i], 0)));
 			cJSON_AddItemToArray(array, o);
 		}
 		cJSON_AddItemToObject(json, "mbfans", array);
@@ -243,6 +246,152 @@ panic:
 }
 
 
+u16_t json_perf(char *insert, int insertlen, u16_t current_tag_part, u16_t *next_tag_part)
+{
+	static char *buf = NULL;
+	static char *p;
+	static u16_t part;
+	static size_t buf_left;
+	size_t printed, count;
+
+	if (current_tag_part == 0) {
+		/* Generate 'output' into a buffer that then will be fed in chunks to LwIP... */
+		if (!(buf = json_perf_stats(-1, true)))
+			return 0;
+
+		p = buf;
+		buf_left = strlen(buf);
+		part = 1;
+	}
+
+	/* Copy a part of the multi-part response into LwIP buffer ...*/
+	count = (buf_left < insertlen - 1 ? buf_left : insertlen - 1);
+	memcpy(insert, p, count);
+
+	p += count;
+	printed = count;
+	buf_left -= count;
+
+	if (buf_left > 0) {
+		*next_tag_part = part++;
+	} else {
+		free(buf);
+		buf = p = NULL;
+	}
+
+	return printed;
+}
+
+
+/* Query parameters for history.json (set by history_cgi()) */
+static int history_start = 0;
+static int history_end = 0;
+static int history_step = 1;
+
+u16_t json_history(char *insert, int insertlen, u16_t current_tag_part, u16_t *next_tag_part)
+{
+	static struct history_query q;
+	static char *buf = NULL;
+	static char *p;
+	static u16_t part;
+	static size_t buf_left;
+	static bool done;
+	char tmp[32], name[24];
+	uint channels = history_channels();
+	size_t printed, count;
+
+	if (current_tag_part == 0) {
+		if (buf)
+			free(buf);
+		if (!(buf = malloc(BUF_LEN)))
+			return 0;
+
+		history_query_init(&q, history_start, history_end, history_step);
+		snprintf(buf, BUF_LEN, "{\n\"interval\": %lu,\n\"now\": %llu,\n\"step\": %lu,\n\"channels\": [",
+			cfg->history_interval,
+			to_us_since_boot(get_absolute_time()) / 1000,
+			q.step);
+		for (uint ch = 0; ch < channels; ch++) {
+			snprintf(tmp, sizeof(tmp), "%s\"%s\"", (ch > 0 ? ", " : ""),
+				history_channel_name(ch, name, sizeof(name)));
+			strncatenate(buf, tmp, BUF_LEN);
+		}
+		strncatenate(buf, "],\n\"data\": [", BUF_LEN);
+
+		p = buf;
+		buf_left = strlen(buf);
+		part = 1;
+		done = false;
+	}
+
+	if (buf_left == 0 && !done) {
+		/* Generate next row of output... */
+		p = buf;
+		if (history_query_next(&q)) {
+			snprintf(buf, BUF_LEN, "%s\n[%llu", (q.matched > 1 ? "," : ""), q.it.t);
+			for (uint ch = 0; ch < channels; ch++) {
+				tmp[0] = ',';
+				history_value_str(ch, q.it.values[ch], tmp + 1, sizeof(tmp) - 1);
+				strncatenate(buf, tmp, BUF_LEN);
+			}
+			strncatenate(buf, "]", BUF_LEN);
+		} else {
+			snprintf(buf, BUF_LEN, "\n]\n}\n");
+			done = true;
+		}
+		buf_left = strlen(buf);
+	}
+
+	/* Copy a part of the multi-part response into LwIP buffer ...*/
+	count = (buf_left < insertlen - 1 ? buf_left : insertlen - 1);
+	memcpy(insert, p, count);
+
+	p += count;
+	printed = count;
+	buf_left -= count;
+
+	if (buf_left > 0 || !done) {
+		*next_tag_part = part++;
+	} else {
+		free(buf);
+		buf = p = NULL;
+	}
+
+	return printed;
+}
+
+
+static const char* history_cgi(int index, int num_params, char *param[], char *value[])
+{
+	history_start = 0;
+	history_end = 0;
+	history_step = 1;
+
+	for (int i = 0; i < num_params; i++) {
+		if (!strcmp(param[i], "start"))
+			str_to_int(value[i], &history_start, 10);
+		else if (!strcmp(param[i], "end"))
+			str_to_int(value[i], &history_end, 10);
+		else if (!strcmp(param[i], "step"))
+			str_to_int(value[i], &history_step, 10);
+	}
+	if (history_step < 1)
+		history_step = 1;
+
+	return "/history.json";
+}
+
+
+static const tCGI cgi_handlers[] = {
+	{ "/history.json", history_cgi },
+};
+
+void fanpico_set_cgi_handlers()
+{
+	http_set_cgi_handlers(cgi_handlers, sizeof(cgi_handlers) / sizeof(cgi_handlers[0]));
+}
+
+
 u16_t fanpico_ssi_handler(const char *tag, char *insert, int insertlen,
 			u16_t current_tag_part, u16_t *next_tag_part)
 {
@@ -349,6 +498,12 @@ u16_t fanpico_ssi_handler(const char *tag, char *insert, int insertlen,
 	else if (!strncmp(tag, "jsonstat", 8)) {
 		printed = json_stats(insert, insertlen, current_tag_part, next_tag_part);
 	}
+	else if (!strncmp(tag, "jsonperf", 8)) {
+		printed = json_perf(insert, insertlen, current_tag_part, next_tag_part);
+	}
+	else if (!strncmp(tag, "jsonhist", 8)) {
+		printed = json_history(insert, insertlen, current_tag_part, next_tag_part);
+	}
 	else if (!strncmp(tag, "refresh", 8)) {
 		/* generate "random" refresh time for a page, to help spread out the load... */
 		printed = snprintf(insert, insertlen, "%u", (uint)(30 + ((double)rand() / RAND_MAX) * 30));
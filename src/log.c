@@ -30,6 +30,7 @@
 #include <time.h>
 #include "pico/stdlib.h"
 #include "pico/mutex.h"
+#include "hardware/sync.h"
 #include "pico/unique_id.h"
 #include "pico/util/datetime.h"
 #include "hardware/watchdog.h"
@@ -183,21 +184,274 @@ void set_debug_level(int level)
 }
 
 
-void log_msg(int priority, const char *format, ...)
+/*
+ * Deferred logging for core1.
+ *
+ * Core1 must not block on (USB) console output or spend time formatting
+ * messages, so log_msg() on core1 only stores timestamp, priority,
+ * format string pointer and (raw) arguments into a lock-free ring buffer.
+ * Messages are then formatted and output on core0 by log_process_deferred().
+ *
+ * Format string must be a string literal (it is used after log_msg()
+ * has returned), string arguments are copied into the ring.
+ */
+
+#define LOG_RING_SIZE      32   /* must be power of two */
+#define LOG_ARGS_MAX_LEN   96
+
+struct log_entry {
+	uint64_t t;
+	const char *format;
+	uint8_t priority;
+	uint8_t len;
+	uint8_t args[LOG_ARGS_MAX_LEN];
+};
+
+struct log_ring {
+	volatile uint32_t head;  /* updated only by the writer (core1) */
+	volatile uint32_t tail;  /* updated only by the reader (core0) */
+	volatile uint32_t dropped;
+	uint32_t dropped_reported;
+	struct log_entry entries[LOG_RING_SIZE];
+};
+
+static struct log_ring core1_log;
+
+enum log_arg_types {
+	ARG_NONE = 0,
+	ARG_INT,
+	ARG_LONG,
+	ARG_LLONG,
+	ARG_DOUBLE,
+	ARG_STRING,
+	ARG_POINTER,
+};
+
+
+/* Parse next conversion specification from the format string.
+ * Returns pointer to character following the specification
+ * and stores argument type (and '*' width/precision counts).
+ */
+static const char* parse_conversion(const char *p, int *type, int *stars)
 {
-	va_list ap;
-	char buf[256];
-	int len;
-	uint64_t start, end;
-	uint core = get_core_num();
+	int l = 0;
+
+	*type = ARG_NONE;
+	*stars = 0;
+
+	/* flags */
+	while (*p && strchr("-+ #0", *p))
+		p++;
+	/* width */
+	if (*p == '*') {
+		(*stars)++;
+		p++;
+	}
+	while (*p >= '0' && *p <= '9')
+		p++;
+	/* precision */
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			(*stars)++;
+			p++;
+		}
+		while (*p >= '0' && *p <= '9')
+			p++;
+	}
+	/* length modifier */
+	while (*p && strchr("hlLqjzt", *p)) {
+		if (*p == 'l')
+			l++;
+		else if (*p == 'q' || *p == 'j')
+			l = 2;
+		else if (*p == 'z' || *p == 't')
+			l = (sizeof(size_t) > sizeof(int) ? 2 : 0);
+		p++;
+	}
 
-	if ((priority > global_log_level) && (priority > global_syslog_level))
-		return;
+	switch (*p) {
+	case 'd':
+	case 'i':
+	case 'u':
+	case 'x':
+	case 'X':
+	case 'o':
+	case 'c':
+		*type = (l >= 2 ? ARG_LLONG : (l == 1 ? ARG_LONG : ARG_INT));
+		break;
+	case 'f':
+	case 'F':
+	case 'e':
+	case 'E':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		*type = ARG_DOUBLE;
+		break;
+	case 's':
+		*type = ARG_STRING;
+		break;
+	case 'p':
+		*type = ARG_POINTER;
+		break;
+	case 0:
+		return p;
+	}
+
+	return p + 1;
+}
+
+
+#define PACK_ARG(var) {						\
+		if (len + sizeof(var) > LOG_ARGS_MAX_LEN)		\
+			return len;					\
+		memcpy(buf + len, &var, sizeof(var));			\
+		len += sizeof(var);					\
+	}
+
+/* Copy arguments needed by the format string into a buffer. */
+static uint pack_args(uint8_t *buf, const char *format, va_list ap)
+{
+	const char *p = format;
+	uint len = 0;
+	int type, stars;
+
+	while ((p = strchr(p, '%'))) {
+		if (*++p == '%') {
+			p++;
+			continue;
+		}
+		p = parse_conversion(p, &type, &stars);
+		while (stars-- > 0) {
+			int v = va_arg(ap, int);
+			PACK_ARG(v);
+		}
+
+		if (type == ARG_INT) {
+			int v = va_arg(ap, int);
+			PACK_ARG(v);
+		} else if (type == ARG_LONG) {
+			long v = va_arg(ap, long);
+			PACK_ARG(v);
+		} else if (type == ARG_LLONG) {
+			long long v = va_arg(ap, long long);
+			PACK_ARG(v);
+		} else if (type == ARG_DOUBLE) {
+			double v = va_arg(ap, double);
+			PACK_ARG(v);
+		} else if (type == ARG_POINTER) {
+			void *v = va_arg(ap, void*);
+			PACK_ARG(v);
+		} else if (type == ARG_STRING) {
+			const char *v = va_arg(ap, const char*);
+			size_t l;
+
+			if (!v)
+				v = "(null)";
+			if (len + 1 >= LOG_ARGS_MAX_LEN)
+				return len;
+			l = strnlen(v, LOG_ARGS_MAX_LEN - len - 1);
+			if (len + l + 1 > LOG_ARGS_MAX_LEN)
+				return len;
+			memcpy(buf + len, v, l);
+			buf[len + l] = 0;
+			len += l + 1;
+		}
+	}
+
+	return len;
+}
+
+
+#define UNPACK_ARG(var) {					\
+		if (pos + sizeof(var) > len)				\
+			goto truncated;					\
+		memcpy(&var, args + pos, sizeof(var));			\
+		pos += sizeof(var);					\
+	}
+
+/* Format message using arguments saved by pack_args(). */
+static void format_packed(char *out, size_t size, const char *format,
+			const uint8_t *args, uint len)
+{
+	const char *p = format;
+	const char *spec;
+	char fmt[32];
+	uint pos = 0;
+	size_t o = 0;
+	int type, stars;
+
+	out[0] = 0;
+	while (*p && o < size - 1) {
+		if (*p != '%') {
+			out[o++] = *p++;
+			continue;
+		}
+		if (p[1] == '%') {
+			out[o++] = '%';
+			p += 2;
+			continue;
+		}
+
+		spec = p++;
+		p = parse_conversion(p, &type, &stars);
+
+		/* Copy conversion specification, replacing '*' with actual value */
+		size_t f = 0;
+		for (const char *s = spec; s < p && f < sizeof(fmt) - 12; s++) {
+			if (*s == '*') {
+				int v;
+				UNPACK_ARG(v);
+				f += snprintf(fmt + f, sizeof(fmt) - f, "%d", v);
+			} else {
+				fmt[f++] = *s;
+			}
+		}
+		fmt[f] = 0;
+
+		if (type == ARG_INT) {
+			int v;
+			UNPACK_ARG(v);
+			snprintf(out + o, size - o, fmt, v);
+		} else if (type == ARG_LONG) {
+			long v;
+			UNPACK_ARG(v);
+			snprintf(out + o, size - o, fmt, v);
+		} else if (type == ARG_LLONG) {
+			long long v;
+			UNPACK_ARG(v);
+			snprintf(out + o, size - o, fmt, v);
+		} else if (type == ARG_DOUBLE) {
+			double v;
+			UNPACK_ARG(v);
+			snprintf(out + o, size - o, fmt, v);
+		} else if (type == ARG_POINTER) {
+			void *v;
+			UNPACK_ARG(v);
+			snprintf(out + o, size - o, fmt, v);
+		} else if (type == ARG_STRING) {
+			const char *v = (const char*)args + pos;
+			if (pos >= len)
+				goto truncated;
+			pos += strnlen(v, len - pos) + 1;
+			snprintf(out + o, size - o, fmt, v);
+		}
+		o += strnlen(out + o, size - o);
+	}
+	out[o] = 0;
+	return;
+
+truncated:
+	out[o] = 0;
+	strncatenate(out, "...", size);
+}
 
-	start = to_us_since_boot(get_absolute_time());
-	va_start(ap, format);
-	vsnprintf(buf, sizeof(buf), format, ap);
-	va_end(ap);
+
+static void log_output(uint64_t t, uint core, int priority, char *buf)
+{
+	int len;
 
 	if ((len = strlen(buf)) > 0) {
 		/* If string ends with \n, remove it. */
@@ -206,7 +460,6 @@ void log_msg(int priority, const char *format, ...)
 	}
 
 	if (priority <= global_log_level) {
-		uint64_t t = to_us_since_boot(get_absolute_time());
 		printf("[%6llu.%06llu][%u] %s\n", (t / 1000000), (t % 1000000), core, buf);
 	}
 
@@ -215,6 +468,94 @@ void log_msg(int priority, const char *format, ...)
 		syslog_msg(priority, "%s", buf);
 	}
 #endif
+}
+
+
+static void log_deferred(int priority, const char *format, va_list ap)
+{
+	struct log_ring *r = &core1_log;
+	struct log_entry *e;
+	uint32_t head, irq;
+
+	irq = save_and_disable_interrupts();
+	head = r->head;
+	if (head - r->tail >= LOG_RING_SIZE) {
+		r->dropped++;
+	} else {
+		e = &r->entries[head & (LOG_RING_SIZE - 1)];
+		e->t = to_us_since_boot(get_absolute_time());
+		e->format = format;
+		e->priority = priority;
+		e->len = pack_args(e->args, format, ap);
+		__dmb();
+		r->head = head + 1;
+	}
+	restore_interrupts(irq);
+}
+
+
+/* Output log messages queued by core1. Must be called only on core0.
+ * Returns number of messages processed.
+ */
+int log_process_deferred(uint max_count)
+{
+	struct log_ring *r = &core1_log;
+	struct log_entry *e;
+	char buf[256];
+	uint32_t tail = r->tail;
+	uint32_t dropped;
+	int count = 0;
+
+	while (tail != r->head && count < max_count) {
+		__dmb();
+		e = &r->entries[tail & (LOG_RING_SIZE - 1)];
+		format_packed(buf, sizeof(buf), e->format, e->args, e->len);
+		log_output(e->t, 1, e->priority, buf);
+		__dmb();
+		r->tail = ++tail;
+		count++;
+	}
+
+	if ((dropped = r->dropped) != r->dropped_reported) {
+		snprintf(buf, sizeof(buf), "core1: %lu log messages dropped (total %lu)",
+			dropped - r->dropped_reported, dropped);
+		log_output(to_us_since_boot(get_absolute_time()), 1, LOG_WARNING, buf);
+		r->dropped_reported = dropped;
+	}
+
+	return count;
+}
+
+
+uint32_t log_deferred_dropped()
+{
+	return core1_log.dropped;
+}
+
+
+void log_msg(int priority, const char *format, ...)
+{
+	va_list ap;
+	char buf[256];
+	uint64_t start, end;
+	uint core = get_core_num();
+
+	if ((priority > global_log_level) && (priority > global_syslog_level))
+		return;
+
+	if (core != 0) {
+		va_start(ap, format);
+		log_deferred(priority, format, ap);
+		va_end(ap);
+		return;
+	}
+
+	start = to_us_since_boot(get_absolute_time());
+	va_start(ap, format);
+	vsnprintf(buf, sizeof(buf), format, ap);
+	va_end(ap);
+
+	log_output(to_us_since_boot(get_absolute_time()), core, priority, buf);
 
 	end = to_us_since_boot(get_absolute_time());
 	if (end - start > 10000) {
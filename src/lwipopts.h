@@ -85,6 +85,7 @@ void pico_set_system_time(long int sec);
 #define LWIP_HTTPD_SSI_MULTIPART        1
 #define LWIP_HTTPD_SSI_INCLUDE_TAG      0
 #define LWIP_HTTPD_SSI_EXTENSIONS       ".shtml", ".xml", ".json", ".csv"
+#define LWIP_HTTPD_CGI                  1
 
 #define LWIP_SNMP                       1
 #define SNMP_LWIP_MIB2                  1
@@ -728,6 +728,7 @@ static char* json_status_message()
 		cJSON_AddItemToObject(o, "id", cJSON_CreateNumber(i + 1));
 		cJSON_AddItemToObject(o, "rpm", cJSON_CreateNumber(rpm));
 		cJSON_AddItemToObject(o, "pwm", cJSON_CreateNumber(st->mbfan_duty[i]));
+		cJSON_AddItemToObject(o, "pwm_freq", cJSON_CreateNumber(st->mbfan_pwm_freq[i]));
 		cJSON_AddItemToArray(l, o);
 	}
 
@@ -920,6 +921,60 @@ void fanpico_mqtt_publish_duty()
 	log_msg(LOG_DEBUG, "fanpico_mqtt_publish_duty(): end");
 }
 
+/* Performance statistics are published separately for each core, and
+ * only one message at a time, so that (about 3KB) messages do not
+ * exceed MQTT output buffer (MQTT_OUTPUT_RINGBUF_SIZE).
+ */
+#define MQTT_PERF_MAX_RETRIES 20
+
+static int8_t mqtt_perf_core = -1;
+static uint8_t mqtt_perf_retries = 0;
+
+void fanpico_mqtt_publish_perf()
+{
+	if (!mqtt_client || strlen(cfg->mqtt_perf_topic) < 1)
+		return;
+
+	if (mqtt_perf_core >= 0)
+		log_msg(LOG_NOTICE, "MQTT publish perf: previous update still pending");
+	mqtt_perf_core = 0;
+	mqtt_perf_retries = 0;
+	fanpico_mqtt_publish_perf_pending();
+}
+
+void fanpico_mqtt_publish_perf_pending()
+{
+	char topic[MQTT_MAX_TOPIC_LEN + 8];
+	char *buf;
+	int res;
+
+	if (!mqtt_client || mqtt_perf_core < 0)
+		return;
+
+	log_msg(LOG_DEBUG, "fanpico_mqtt_publish_perf_pending(): core%d", mqtt_perf_core);
+	if (!(buf = json_perf_stats(mqtt_perf_core, false))) {
+		log_msg(LOG_WARNING,"json_perf_stats(): failed");
+		mqtt_perf_core = -1;
+		return;
+	}
+	snprintf(topic, sizeof(topic), cfg->mqtt_perf_topic, mqtt_perf_core + 1);
+	if (strlen(buf) + strlen(topic) + 8 > MQTT_OUTPUT_RINGBUF_SIZE) {
+		log_msg(LOG_WARNING, "MQTT publish perf: message too large (%u bytes)", strlen(buf));
+		res = ERR_OK;
+	} else {
+		res = mqtt_publish_message(topic, buf, strlen(buf), mqtt_qos, 0,
+					cfg->mqtt_perf_topic);
+	}
+	free(buf);
+
+	/* Output buffer is full, try again later */
+	if (res == ERR_MEM && ++mqtt_perf_retries < MQTT_PERF_MAX_RETRIES)
+		return;
+
+	mqtt_perf_retries = 0;
+	mqtt_perf_core = (mqtt_perf_core < 1 ? mqtt_perf_core + 1 : -1);
+}
+
 void fanpico_mqtt_scpi_command()
 {
 	const struct fanpico_state *st = fanpico_state;
@@ -408,6 +408,7 @@ static void wifi_init()
 		}
 #endif
 		http_set_ssi_handler(fanpico_ssi_handler, NULL, 0);
+		fanpico_set_cgi_handlers();
 	}
 
 	/* Enable Telnet server */
@@ -496,6 +497,7 @@ static void wifi_poll()
 	static absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(publish_vsensor_t, 0);
 	static absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(publish_rpm_t, 0);
 	static absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(publish_duty_t, 0);
+	static absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(publish_perf_t, 0);
 	static absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(command_t, 0);
 	static absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(reconnect_t, 0);
 	static absolute_time_t ABSOLUTE_TIME_INITIALIZED_VAR(wifi_status_check_t, 0);
@@ -573,6 +575,13 @@ static void wifi_poll()
 				fanpico_mqtt_publish_duty();
 			}
 		}
+		if (cfg->mqtt_perf_interval > 0) {
+			if (time_passed(&publish_perf_t, cfg->mqtt_perf_interval * 1000)) {
+				fanpico_mqtt_publish_perf();
+			} else {
+				fanpico_mqtt_publish_perf_pending();
+			}
+		}
 
 		if (time_passed(&reconnect_t, 1000)) {
 			fanpico_mqtt_reconnect();
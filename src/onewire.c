@@ -102,7 +102,7 @@ void onewire_scan_bus()
 	}
 }
 
-int onewire_read_temps(struct fanpico_config *config, struct fanpico_state *state)
+int onewire_read_temps(struct fanpico_control_config *config, struct fanpico_state *state)
 {
 	static uint step = 0;
 	static uint sensor = 0;
@@ -21,6 +21,7 @@
 
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
+#include "hardware/sync.h"
 
 
 /*
@@ -91,6 +92,7 @@ uint64_t pulseIn(int gpio, int value, uint32_t timeout_ms)
 
 
 uint pulse_pin = 0;
+uint32_t pulse_target = 1;
 volatile uint32_t pulse_counter = 0;
 volatile bool measure_complete = false;
 absolute_time_t pulse_start;
@@ -98,22 +100,20 @@ absolute_time_t pulse_end;
 uint32_t pulse_events;
 
 
-/* Interrupt handler to measure pulse interval
+/* Interrupt handler to measure pulse interval(s)
  */
 void __time_critical_func(pulse_measure_callback)(uint gpio, uint32_t events)
 {
-	if (gpio != pulse_pin || pulse_counter > 1)
+	if (gpio != pulse_pin || pulse_counter > pulse_target)
 		return;
 
 	if (pulse_counter == 0) {
 		pulse_start = get_absolute_time();
-		pulse_counter++;
-	}
-	else if (pulse_counter == 1) {
+	} else {
 		pulse_end = get_absolute_time();
-		measure_complete = true;
-		pulse_counter++;
 	}
+	if (++pulse_counter > pulse_target)
+		measure_complete = true;
 }
 
 /* Setup a GPIO pin to be used for measurements */
@@ -121,6 +121,7 @@ void pulse_setup_interrupt(uint gpio, uint32_t events)
 {
 	pulse_pin = gpio;
 	pulse_events = events;
+	pulse_target = 1;
 	pulse_counter = 2;
 	measure_complete = false;
 
@@ -138,15 +139,22 @@ void pulse_enable_interrupt()
 	gpio_set_irq_enabled(pulse_pin, pulse_events, true);
 }
 
-/* Call to start measruement. */
-void pulse_start_measure()
+/* Call to start measurement of 'count' consecutive intervals. */
+void pulse_start_measure_count(uint count)
 {
 	pulse_disable_interrupt();
+	pulse_target = (count > 0 ? count : 1);
 	pulse_counter = 0;
 	measure_complete = false;
 	pulse_enable_interrupt();
 }
 
+/* Call to start measruement. */
+void pulse_start_measure()
+{
+	pulse_start_measure_count(1);
+}
+
 /* Call to check if a pulse has been measured yet. */
 uint64_t pulse_interval()
 {
@@ -161,5 +169,25 @@ uint64_t pulse_interval()
 	return delta;
 }
 
+/* Call to check how many intervals have been measured so far.
+ * Returns total length of the measured intervals (or 0 if none yet).
+ */
+uint64_t pulse_intervals(uint *count)
+{
+	uint32_t irq = save_and_disable_interrupts();
+	uint32_t counter = pulse_counter;
+	absolute_time_t start = pulse_start;
+	absolute_time_t end = pulse_end;
+	restore_interrupts(irq);
+
+	if (counter < 2) {
+		*count = 0;
+		return 0;
+	}
+
+	*count = counter - 1;
+	return absolute_time_diff_us(start, end);
+}
+
 
 /* eof :-) */
@@ -30,7 +30,9 @@ uint64_t pulseIn(int gpio, int value, uint32_t timeout_ms);
 void pulse_setup_interrupt(uint gpio, uint32_t events);
 void pulse_disable_interrupt();
 void pulse_start_measure();
+void pulse_start_measure_count(uint count);
 uint64_t pulse_interval();
+uint64_t pulse_intervals(uint *count);
 
 
 #endif /* PULSE_LEN_H */
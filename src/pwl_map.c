@@ -0,0 +1,356 @@
+/* pwl_map.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "pico/stdlib.h"
+
+#include "fanpico.h"
+
+
+/*
+ * Piecewise-linear map engine for PWM, tachometer and temperature maps.
+ *
+ * Maps are compiled into a common segment table (start point and slope
+ * of each segment, see struct pwl_maps in fanpico.h) whenever control
+ * loop configuration changes, so evaluating any map only needs a binary
+ * search for the segment and one multiplication. Segments of all maps
+ * share one pool (PWL_POOL_SIZE segments), first segment of the pool is
+ * a zero map used for maps without points.
+ *
+ * Configuration (struct fanpico_config) only has the map points,
+ * pwm_map(), tacho_map() and temp_map() evaluate maps directly from
+ * the points (for core0, like display and web interface).
+ *
+ * With fixed-point math, PWM and temperature maps use Q16.16 values and
+ * tachometer maps use Q20.12 values. Slopes are Q16.16, so
+ * fx_mul(slope, dx, Q16_FRAC) keeps the format of the X value.
+ *
+ * Coefficients, offsets and limits applied to map outputs are compiled
+ * the same way (struct pwl_scale), coefficients as Q16.16.
+ */
+
+#if FANPICO_FIXED_POINT
+#define TO_MAP_VAL(v, frac) fx_from_double((v), (frac))
+#define MAP_MUL(slope, dx)  fx_mul((slope), (dx), Q16_FRAC)
+#else
+#define TO_MAP_VAL(v, frac) (v)
+#define MAP_MUL(slope, dx)  ((slope) * (dx))
+#endif
+
+
+/* Slope of segment between points (x0,y0) and (x1,y1). */
+static map_val_t segment_slope(double x0, double y0, double x1, double y1)
+{
+	double dx = x1 - x0;
+	double slope = (dx != 0 ? (y1 - y0) / dx : 0.0);
+
+#if FANPICO_FIXED_POINT
+	/* Clamp to Q16.16 range. Segments this steep are too narrow
+	   (less than 1/32767 of the Y range) for the error to matter. */
+	return fx_from_double(fmin(fmax(slope, -32767.0), 32767.0), Q16_FRAC);
+#else
+	return slope;
+#endif
+}
+
+
+/* Convert limit (that may be outside of fixed-point range) to map value. */
+static map_val_t limit_val(double v, unsigned int frac)
+{
+#if FANPICO_FIXED_POINT
+	double max = (double)INT32_MAX / (1L << frac);
+
+	return fx_from_double(fmin(fmax(v, -max), max), frac);
+#else
+	return v;
+#endif
+}
+
+
+/* Map points converted to doubles. */
+static int pwm_map_points(const struct pwm_map *map, double x[], double y[])
+{
+	for (int i = 0; i < map->points; i++) {
+		x[i] = map->pwm[i][0];
+		y[i] = map->pwm[i][1];
+	}
+	return map->points;
+}
+
+static int tacho_map_points(const struct tacho_map *map, double x[], double y[])
+{
+	for (int i = 0; i < map->points; i++) {
+		x[i] = map->tacho[i][0];
+		y[i] = map->tacho[i][1];
+	}
+	return map->points;
+}
+
+static int temp_map_points(const struct temp_map *map, double x[], double y[])
+{
+	for (int i = 0; i < map->points; i++) {
+		x[i] = map->temp[i][0];
+		y[i] = map->temp[i][1];
+	}
+	return map->points;
+}
+
+
+/* Initialize (empty) segment pool. */
+void pwl_maps_init(struct pwl_maps *maps)
+{
+	memset(maps, 0, sizeof(*maps));
+	maps->used = 1;
+}
+
+
+/* Add segments for map points to the pool (frac is number of fractional
+ * bits used for X and Y values with fixed-point math). Map gets at most
+ * 'max' segments, extra points are dropped. Map without points (or if
+ * pool is full) becomes zero map. Returns false if points were dropped.
+ */
+static bool pwl_compile(struct pwl_maps *maps, struct pwl_map *map, const double x[],
+			const double y[], int points, unsigned int frac, int max)
+{
+	struct pwl_segment *seg;
+	int count = (points < max ? points : max);
+
+	if (count < 1) {
+		map->start = 0;
+		map->count = 1;
+		return (points < 1);
+	}
+
+	map->start = maps->used;
+	map->count = count;
+	seg = &maps->seg[map->start];
+	for (int i = 0; i < count; i++) {
+		seg[i].x0 = TO_MAP_VAL(x[i], frac);
+		seg[i].y0 = TO_MAP_VAL(y[i], frac);
+		seg[i].slope = (i < count - 1 ? segment_slope(x[i], y[i], x[i+1], y[i+1]) : 0);
+	}
+	maps->used += count;
+
+	return (count == points);
+}
+
+
+bool pwm_map_compile(struct pwl_maps *maps, struct pwl_map *out, const struct pwm_map *map)
+{
+	double x[MAX_MAP_POINTS], y[MAX_MAP_POINTS];
+	int points = pwm_map_points(map, x, y);
+
+	return pwl_compile(maps, out, x, y, points, Q16_FRAC, PWL_POOL_SIZE - maps->used);
+}
+
+bool tacho_map_compile(struct pwl_maps *maps, struct pwl_map *out, const struct tacho_map *map)
+{
+	double x[MAX_MAP_POINTS], y[MAX_MAP_POINTS];
+	int points = tacho_map_points(map, x, y);
+
+	return pwl_compile(maps, out, x, y, points, Q12_FRAC, PWL_POOL_SIZE - maps->used);
+}
+
+bool temp_map_compile(struct pwl_maps *maps, struct pwl_map *out, const struct temp_map *map)
+{
+	double x[MAX_MAP_POINTS], y[MAX_MAP_POINTS];
+	int points = temp_map_points(map, x, y);
+
+	return pwl_compile(maps, out, x, y, points, Q16_FRAC, PWL_POOL_SIZE - maps->used);
+}
+
+
+/* Compile all maps of control loop configuration, called whenever
+ * control loop configuration changes (see get_control_config()).
+ */
+void pwl_maps_compile(struct pwl_maps *maps, const struct fanpico_control_config *config)
+{
+	bool ok = true;
+
+	pwl_maps_init(maps);
+	for (int i = 0; i < FAN_COUNT; i++)
+		ok &= pwm_map_compile(maps, &maps->fans[i], &config->fans[i].map);
+	for (int i = 0; i < MBFAN_COUNT; i++)
+		ok &= tacho_map_compile(maps, &maps->mbfans[i], &config->mbfans[i].map);
+	for (int i = 0; i < SENSOR_COUNT; i++)
+		ok &= temp_map_compile(maps, &maps->sensors[i], &config->sensors[i].map);
+	for (int i = 0; i < VSENSOR_COUNT; i++)
+		ok &= temp_map_compile(maps, &maps->vsensors[i], &config->vsensors[i].map);
+
+	if (!ok)
+		log_msg(LOG_ERR, "Too many map points (max %d in total): maps truncated",
+			PWL_POOL_SIZE - 1);
+}
+
+
+/* Total number of map points in configuration. */
+int map_points_total(const struct fanpico_config *config)
+{
+	int total = 0;
+
+	for (int i = 0; i < FAN_COUNT; i++)
+		total += config->fans[i].map.points;
+	for (int i = 0; i < MBFAN_COUNT; i++)
+		total += config->mbfans[i].map.points;
+	for (int i = 0; i < SENSOR_COUNT; i++)
+		total += config->sensors[i].map.points;
+	for (int i = 0; i < VSENSOR_COUNT; i++)
+		total += config->vsensors[i].map.points;
+
+	return total;
+}
+
+
+/* Check if map with 'new_points' (replacing map with 'old_points')
+ * still fits in the segment pool.
+ */
+bool map_points_fit(const struct fanpico_config *config, int old_points, int new_points)
+{
+	int total = map_points_total(config) - old_points + new_points;
+
+	if (total > PWL_POOL_SIZE - 1) {
+		log_msg(LOG_NOTICE, "Too many map points: %d (max %d in total)",
+			total, PWL_POOL_SIZE - 1);
+		return false;
+	}
+	return true;
+}
+
+
+/* Compile scaling (frac is number of fractional bits of offset and
+ * limits, coefficient is always Q16.16 with fixed-point math).
+ */
+void pwl_scale_compile(struct pwl_scale *scale, double coefficient, double offset,
+		double min, double max, unsigned int frac)
+{
+	scale->coefficient = TO_MAP_VAL(coefficient, Q16_FRAC);
+	scale->offset = TO_MAP_VAL(offset, frac);
+	scale->min = limit_val(min, frac);
+	scale->max = limit_val(max, frac);
+}
+
+
+/* Compile scaling of outputs and sensors, called whenever
+ * configuration changes.
+ */
+void fan_output_compile(struct fan_output *fan)
+{
+	pwl_scale_compile(&fan->scale, fan->pwm_coefficient, 0.0,
+			fan->min_pwm, fan->max_pwm, Q16_FRAC);
+}
+
+void mb_input_compile(struct mb_input *mbfan)
+{
+	pwl_scale_compile(&mbfan->scale, mbfan->rpm_coefficient, 0.0,
+			mbfan->min_rpm, mbfan->max_rpm, Q12_FRAC);
+}
+
+void sensor_input_compile(struct sensor_input *sensor)
+{
+	pwl_scale_compile(&sensor->scale, sensor->temp_coefficient, sensor->temp_offset,
+			-HUGE_VAL, HUGE_VAL, Q16_FRAC);
+}
+
+
+/* Evaluate compiled map. */
+map_calc_t pwl_eval(const struct pwl_maps *maps, const struct pwl_map *map, map_calc_t val)
+{
+	const struct pwl_segment *seg = &maps->seg[map->start];
+	int last = (map->count > 1 ? map->count - 1 : 0);
+	int lo = 1, hi = last, mid;
+
+	/* Value is outside of map range */
+	if (val <= seg[0].x0)
+		return seg[0].y0;
+	if (val >= seg[last].x0)
+		return seg[last].y0;
+
+	/* Binary search for first point that is not smaller than the value,
+	   value is then on the segment starting from previous point. */
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (seg[mid].x0 < val)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	lo--;
+
+	return seg[lo].y0 + MAP_MUL(seg[lo].slope, val - seg[lo].x0);
+}
+
+
+/* Evaluate compiled scaling. */
+map_calc_t pwl_scale_eval(const struct pwl_scale *scale, map_calc_t val)
+{
+	val = MAP_MUL(val, scale->coefficient) + scale->offset;
+
+	if (val < scale->min)
+		return scale->min;
+	if (val > scale->max)
+		return scale->max;
+	return val;
+}
+
+
+/* Evaluate map directly from map points (same as compiled map, but
+ * without rounding to fixed-point).
+ */
+static double points_eval(const double x[], const double y[], int points, double val)
+{
+	if (points < 1)
+		return 0.0;
+	if (val <= x[0])
+		return y[0];
+
+	for (int i = 1; i < points; i++) {
+		if (x[i] >= val)
+			return y[i-1] + (y[i] - y[i-1]) * (val - x[i-1]) / (x[i] - x[i-1]);
+	}
+	return y[points - 1];
+}
+
+
+double pwm_map(const struct pwm_map *map, double val)
+{
+	double x[MAX_MAP_POINTS], y[MAX_MAP_POINTS];
+
+	return points_eval(x, y, pwm_map_points(map, x, y), val);
+}
+
+double tacho_map(const struct tacho_map *map, double val)
+{
+	double x[MAX_MAP_POINTS], y[MAX_MAP_POINTS];
+
+	return points_eval(x, y, tacho_map_points(map, x, y), val);
+}
+
+double temp_map(const struct temp_map *map, double val)
+{
+	double x[MAX_MAP_POINTS], y[MAX_MAP_POINTS];
+
+	return points_eval(x, y, temp_map_points(map, x, y), val);
+}
+
+
+/* eof :-) */
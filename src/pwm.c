@@ -24,12 +24,16 @@
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
 #include "hardware/pwm.h"
+#include "hardware/sync.h"
 #include "hardware/clocks.h"
 
 #include "fanpico.h"
 
-#define PWM_IN_CLOCK_DIVIDER 100
 #define PWM_IN_SAMPLE_INTERVAL 10 /* milliseconds */
+#define PWM_IN_DUTY_WINDOW 160 /* milliseconds */
+#define PWM_IN_FREQ_WINDOW 160 /* milliseconds */
+#define PWM_IN_FREQ_CYCLES 5   /* duty cycle windows between frequency windows */
+#define PWM_IN_WRAP_TIME 50     /* milliseconds (minimum time for 16bit counter to wrap) */
 
 
 /*
@@ -66,25 +70,140 @@ uint8_t mbfan_gpio_pwm_map[MBFAN_MAX_COUNT] = {
 /* Measured duty cycles from (motherboard) fan connectors.  */
 float mbfan_pwm_duty[MBFAN_MAX_COUNT];
 
+/* Time (end of measurement window) of the duty cycle measurements. */
+absolute_time_t mbfan_pwm_duty_updated;
+
+/* Measured frequencies (Hz) of PWM signals from (motherboard) fan connectors. */
+float mbfan_pwm_freq[MBFAN_MAX_COUNT];
+
 uint pwm_out_top = 0;
+static uint pwm_out_sync_timeout = 0; /* microseconds */
 float pwm_in_count_rate = 0;
+static uint pwm_in_clkdiv = 1;
+static uint pwm_in_max_read_interval = 0; /* microseconds */
+
+/* Requested and current (slew rate limited) output duty cycles. */
+static float pwm_out_target[FAN_MAX_COUNT];
+static float pwm_out_duty[FAN_MAX_COUNT];
+static uint64_t pwm_out_updated = 0;
+static uint pwm_out_slices[FAN_MAX_COUNT / 2];
+
+
+static uint pwm_duty_to_level(float duty)
+{
+	if (duty >= 100.0)
+		return pwm_out_top + 1;
+	if (duty > 0.0)
+		return (duty * (pwm_out_top + 1) / 100);
+	return 0;
+}
+
+
+/* Write output levels of all fans to PWM hardware.
+ *
+ * Compare (CC) registers are double buffered and all output slices run
+ * in sync, so new levels take effect simultaneously on all outputs
+ * at the start of next PWM period. To avoid new levels getting split
+ * over two PWM periods, registers are written right after the counter
+ * has wrapped (raw wrap interrupt flag of first output slice gets set,
+ * interrupt itself is not enabled). This normally waits at most one PWM
+ * period (40us at 25kHz) with interrupts disabled. Wait is bounded to
+ * two PWM periods (levels are written anyway if wrap is not seen), and
+ * is skipped if output slices are not running.
+ */
+static void __time_critical_func(commit_pwm_levels)()
+{
+	uint16_t level[FAN_MAX_COUNT];
+	uint32_t irq_status, t_start;
+	uint slice = pwm_out_slices[0];
+	bool timeout = false;
+	int i;
+
+	if (FAN_COUNT < 2)
+		return;
+
+	for (i = 0; i < FAN_COUNT; i++)
+		level[i] = pwm_duty_to_level(pwm_out_duty[i]);
+
+	irq_status = save_and_disable_interrupts();
+	if (pwm_hw->en & (1u << slice)) {
+		pwm_clear_irq(slice);
+		t_start = time_us_32();
+		while (!(pwm_hw->intr & (1u << slice))) {
+			if (time_us_32() - t_start > pwm_out_sync_timeout) {
+				timeout = true;
+				break;
+			}
+			tight_loop_contents();
+		}
+	}
+	for (i = 0; i < FAN_COUNT; i += 2) {
+		uint16_t a = level[i];
+		uint16_t b = level[i + 1];
+
+		if (pwm_gpio_to_channel(fan_gpio_pwm_map[i]) != PWM_CHAN_A) {
+			a = level[i + 1];
+			b = level[i];
+		}
+		pwm_set_both_levels(pwm_out_slices[i / 2], a, b);
+	}
+	restore_interrupts(irq_status);
+
+	if (timeout)
+		log_msg(LOG_DEBUG, "commit_pwm_levels(): timeout waiting for PWM wrap");
+}
+
 
 /* Set PMW output signal duty cycle.
+ * New duty cycle takes effect on next call to update_pwm_outputs().
  */
 void set_pwm_duty_cycle(uint fan, float duty)
 {
-	uint level, pin;
-
 	assert(fan < FAN_COUNT);
-	pin = fan_gpio_pwm_map[fan];
-	if (duty >= 100.0) {
-		level = pwm_out_top + 1;
-	} else if (duty > 0.0) {
-		level = (duty * (pwm_out_top + 1) / 100);
-	} else {
-		level = 0;
+	pwm_out_target[fan] = duty;
+}
+
+
+/* Update PWM output signals (all at once), applying slew rate
+ * limits (if configured). Returns true if any output is still
+ * moving towards its target duty cycle.
+ */
+bool update_pwm_outputs(const struct fanpico_control_config *config)
+{
+	uint64_t now = time_us_64();
+	float dt = (now - pwm_out_updated) / 1000000.0;
+	bool changed = false;
+	bool slewing = false;
+
+	if (dt > 1.0)
+		dt = 1.0;
+	pwm_out_updated = now;
+
+	for (int i = 0; i < FAN_COUNT; i++) {
+		float duty = pwm_out_target[i];
+		float slew = (config ? config->fans[i].pwm_slew : 0.0);
+
+		if (slew > 0.0) {
+			float step = slew * dt;
+
+			if (duty > pwm_out_duty[i] + step) {
+				duty = pwm_out_duty[i] + step;
+				slewing = true;
+			} else if (duty < pwm_out_duty[i] - step) {
+				duty = pwm_out_duty[i] - step;
+				slewing = true;
+			}
+		}
+		if (duty != pwm_out_duty[i]) {
+			pwm_out_duty[i] = duty;
+			changed = true;
+		}
 	}
-	pwm_set_gpio_level(pin, level);
+
+	if (changed)
+		commit_pwm_levels();
+
+	return slewing;
 }
 
 
@@ -120,71 +239,140 @@ float get_pwm_duty_cycle(uint fan)
 }
 
 
+/* Configure PWM slices for measuring input signals and start counters. */
+static uint64_t start_pwm_input_counters(const uint *slices, enum pwm_clkdiv_mode mode, float div)
+{
+	uint64_t t_start;
+	int i;
+
+	for (i = 0; i < MBFAN_COUNT; i++) {
+		pwm_set_enabled(slices[i], false);
+		pwm_set_clkdiv_mode(slices[i], mode);
+		pwm_set_clkdiv(slices[i], div);
+		pwm_set_counter(slices[i], 0);
+	}
+
+	t_start = to_us_since_boot(get_absolute_time());
+	for (i = 0; i < MBFAN_COUNT; i++) {
+		pwm_set_enabled(slices[i], true);
+	}
+
+	return t_start;
+}
+
+
 /* Read multiple PWM signals simultaneously using PWM hardware.
+ *
+ * Measurement is continuous: when a window ends, next window is started
+ * in the same call. Slices count (signal) high time for PWM_IN_DUTY_WINDOW,
+ * and after every PWM_IN_FREQ_CYCLES duty cycle windows, slices count
+ * rising edges for PWM_IN_FREQ_WINDOW (first window after startup
+ * measures frequency). Counters are read on every call and accumulated,
+ * so windows can be longer than 16bit counter would allow.
+ *
+ * Returns true when new measurements are available (in mbfan_pwm_duty[]
+ * and mbfan_pwm_freq[]).
  */
-void get_pwm_duty_cycles(const struct fanpico_config *config)
+bool get_pwm_duty_cycles(const struct fanpico_control_config *config)
 {
 	static uint state = 0;
+	static uint cycles = 0;
 	static uint64_t t_start = 0;
+	static uint64_t t_last = 0;
+	static bool overflow = false;
 	static uint slices[MBFAN_COUNT];
+	static uint16_t counters_last[MBFAN_COUNT];
+	static uint32_t counts[MBFAN_COUNT];
+	uint64_t t_now;
+	uint16_t counter;
+	bool done;
+	bool ready = false;
+	float duty;
 	int i;
 
 	if (MBFAN_COUNT < 1)
-		return;
+		return false;
 
 	if (state == 0) {
-		/* Reset counters on all PWM slices. */
 		for (i = 0; i < MBFAN_COUNT; i++) {
 			slices[i] = pwm_gpio_to_slice_num(mbfan_gpio_pwm_map[i]);
-			pwm_set_enabled(slices[i], false);
-			pwm_set_counter(slices[i], 0);
 		}
+	} else {
+		t_now = to_us_since_boot(get_absolute_time());
+		done = (t_now - t_start >= (state == 1 ? PWM_IN_DUTY_WINDOW : PWM_IN_FREQ_WINDOW) * 1000);
 
-		/* Turn on all PWM slices for short period of time... */
-		t_start = to_us_since_boot(get_absolute_time());
-		for (i = 0; i < MBFAN_COUNT; i++) {
-			pwm_set_enabled(slices[i], true);
+		if (done) {
+			for (i = 0; i < MBFAN_COUNT; i++) {
+				pwm_set_enabled(slices[i], false);
+			}
+			t_now = to_us_since_boot(get_absolute_time());
 		}
-		state = 1;
-	}
-	else if (state == 1) {
-		//busy_wait_ms(PWM_IN_SAMPLE_INTERVAL);
-		uint64_t t_end = to_us_since_boot(get_absolute_time());
-		if (t_end - t_start < PWM_IN_SAMPLE_INTERVAL * 1000)
-			return;
 
-		state = 0;
+		/* Accumulate counts since last read (counter wraps around at 16bit) */
+		if (t_now - t_last > pwm_in_max_read_interval)
+			overflow = true;
 		for (i = 0; i < MBFAN_COUNT; i++) {
-			pwm_set_enabled(slices[i], false);
-		}
-		t_end = to_us_since_boot(get_absolute_time());
-
-		float max_count = pwm_in_count_rate * ((t_end - t_start) / 1000000.0);
-		if (max_count >= 65535) {
-			log_msg(LOG_INFO, "get_pwm_duty_cycles(): counter overflow: %f (%llu)",
-				max_count, (t_end - t_start));
-			return;
+			counter = pwm_get_counter(slices[i]);
+			counts[i] += (uint16_t)(counter - counters_last[i]);
+			counters_last[i] = counter;
 		}
-
-		/* Calculate duty cycles based on measurements. */
-		for (i = 0; i < MBFAN_COUNT; i++) {
-			const struct mb_input *mbfan = &config->mbfans[i];
-			uint16_t counter = pwm_get_counter(slices[i]);
-			float duty = counter * 100 / max_count;
-
-			/* Apply filter */
-			if (mbfan->filter != FILTER_NONE) {
-				float duty_f = filter(mbfan->filter, mbfan->filter_ctx, duty);
-				if (duty_f != duty) {
-					log_msg(LOG_DEBUG, "filter mbfan%d: %lf -> %lf\n", i+1, duty, duty_f);
-					duty = duty_f;
+		t_last = t_now;
+
+		if (!done)
+			return false;
+
+		if (overflow) {
+			log_msg(LOG_INFO, "get_pwm_duty_cycles(): counter overflow (%llu)",
+				(t_now - t_start));
+		} else if (state == 1) {
+			float max_count = pwm_in_count_rate * ((t_now - t_start) / 1000000.0);
+
+			/* Calculate duty cycles based on measurements. */
+			for (i = 0; i < MBFAN_COUNT; i++) {
+				const struct mb_input *mbfan = &config->mbfans[i];
+				duty = counts[i] * 100 / max_count;
+
+				/* Apply filter */
+				if (mbfan->filter.stages > 0) {
+					float duty_f = FILTER_TO_FLOAT(filter_channel(FILTER_CH_MBFAN, i,
+										FILTER_VAL(duty), t_now));
+					if (duty_f != duty) {
+						log_msg(LOG_DEBUG, "filter mbfan%d: %lf -> %lf\n", i+1, duty, duty_f);
+						duty = duty_f;
+					}
 				}
-			}
 
-			mbfan_pwm_duty[i] = duty;
+				mbfan_pwm_duty[i] = duty;
+			}
+			mbfan_pwm_duty_updated = from_us_since_boot(t_now);
+			ready = true;
+		} else {
+			/* Calculate frequencies based on measurements. */
+			for (i = 0; i < MBFAN_COUNT; i++) {
+				mbfan_pwm_freq[i] = counts[i] / ((t_now - t_start) / 1000000.0);
+			}
 		}
+	}
 
+	/* Start next measurement window right away... */
+	if (state == 0 || (state == 1 && ++cycles >= PWM_IN_FREQ_CYCLES)) {
+		cycles = 0;
+		state = 2;
+	} else {
+		state = 1;
 	}
+	for (i = 0; i < MBFAN_COUNT; i++) {
+		counters_last[i] = 0;
+		counts[i] = 0;
+	}
+	overflow = false;
+	if (state == 1)
+		t_start = start_pwm_input_counters(slices, PWM_DIV_B_HIGH, pwm_in_clkdiv);
+	else
+		t_start = start_pwm_input_counters(slices, PWM_DIV_B_RISING, 1);
+	t_last = t_start;
+
+	return ready;
 }
 
 
@@ -195,6 +383,7 @@ void setup_pwm_outputs()
 	uint32_t sys_clock = clock_get_hz(clk_sys);
 	pwm_config config = pwm_get_default_config();
 	uint pwm_freq = 25000;
+	uint32_t slice_mask = 0;
 	uint slice_num;
 	int i;
 
@@ -202,6 +391,7 @@ void setup_pwm_outputs()
 	log_msg(LOG_NOTICE, "PWM Frequency: %0.2f kHz", pwm_freq / 1000.0);
 
 	pwm_out_top = (sys_clock / pwm_freq / 2) - 1;  /* for phase-correct PWM signal */
+	pwm_out_sync_timeout = 2 * 1000000 / pwm_freq + 1; /* two PWM periods */
 
 	pwm_config_set_clkdiv(&config, 1);
 	pwm_config_set_phase_correct(&config, 1);
@@ -218,9 +408,19 @@ void setup_pwm_outputs()
 		slice_num = pwm_gpio_to_slice_num(pin1);
 		/* two consecutive pins must belong to same PWM slice... */
 		assert(slice_num == pwm_gpio_to_slice_num(pin2));
-		pwm_init(slice_num, &config, true);
+		pwm_init(slice_num, &config, false);
+		pwm_out_slices[i / 2] = slice_num;
+		slice_mask |= (1UL << slice_num);
 	}
 
+	for (i = 0; i < FAN_COUNT; i++) {
+		pwm_out_target[i] = 0.0;
+		pwm_out_duty[i] = 0.0;
+	}
+
+	/* Start all output slices simultaneously to keep them in sync */
+	pwm_set_mask_enabled(pwm_hw->en | slice_mask);
+
 }
 
 
@@ -228,6 +428,7 @@ void setup_pwm_outputs()
  */
 void setup_pwm_inputs()
 {
+	uint32_t sys_clock = clock_get_hz(clk_sys);
 	pwm_config config = pwm_get_default_config();
 	uint slice_num;
 	int i;
@@ -237,14 +438,27 @@ void setup_pwm_inputs()
 
 	log_msg(LOG_NOTICE, "Initializing PWM Inputs...");
 
-	pwm_config_set_clkdiv_mode(&config, PWM_DIV_B_HIGH);
-	pwm_config_set_clkdiv(&config, PWM_IN_CLOCK_DIVIDER);
+	/* Pick clock divider so that (duty cycle) counters wrap around no
+	   sooner than PWM_IN_WRAP_TIME, regardless of system clock. */
+	pwm_in_clkdiv = ((uint64_t)sys_clock * PWM_IN_WRAP_TIME / 1000 + 65535) / 65536;
+	if (pwm_in_clkdiv < 1)
+		pwm_in_clkdiv = 1;
+	if (pwm_in_clkdiv > 255)
+		pwm_in_clkdiv = 255;
+	pwm_in_count_rate = (float)sys_clock / pwm_in_clkdiv;
+
+	/* Counters must be read before they wrap (leave 10% margin) */
+	pwm_in_max_read_interval = (uint64_t)65536 * pwm_in_clkdiv * 900000 / sys_clock;
+	log_msg(LOG_INFO, "PWM input clock divider: %u (max read interval %u us)",
+		pwm_in_clkdiv, pwm_in_max_read_interval);
 
-	pwm_in_count_rate = clock_get_hz(clk_sys) / PWM_IN_CLOCK_DIVIDER;
+	pwm_config_set_clkdiv_mode(&config, PWM_DIV_B_HIGH);
+	pwm_config_set_clkdiv(&config, pwm_in_clkdiv);
 
 	for (i = 0; i < MBFAN_COUNT; i++) {
 		uint pin = mbfan_gpio_pwm_map[i];
 		mbfan_pwm_duty[i] = 0.0;
+		mbfan_pwm_freq[i] = 0.0;
 
 		slice_num = pwm_gpio_to_slice_num(pin);
 		/* reading PWM signal must be done on B channel... */
@@ -256,33 +470,97 @@ void setup_pwm_inputs()
 }
 
 
-double pwm_map(const struct pwm_map *map, double val)
+/* Return time (us since boot) of the sample that source value of
+ * a fan output is based on.
+ */
+static uint64_t pwm_source_time(const struct fanpico_state *state, const struct fan_output *fan)
 {
-	int i;
-	double newval;
+	absolute_time_t t;
+
+	switch (fan->s_type) {
+	case PWM_MB:
+		t = state->mbfan_duty_updated[fan->s_id];
+		break;
+	case PWM_SENSOR:
+		t = state->temp_updated[fan->s_id];
+		break;
+	case PWM_VSENSOR:
+		t = state->vtemp_sampled[fan->s_id];
+		break;
+	case PWM_FAN:
+		/* Failed source fan is detected from its tachometer signal,
+		   otherwise source is output duty calculated now. */
+		if (state->fan_status[fan->s_id] != FAN_STATUS_OK) {
+			t = state->fan_freq_updated[fan->s_id];
+			break;
+		}
+		/* fall through */
+	default:
+		return time_us_64();
+	}
+
+	return to_us_since_boot(t);
+}
 
-	// value is equal or smaller than first map point
-	if (val <= map->pwm[0][0])
-		return map->pwm[0][1];
 
-	// find the map points that the value falls in between of...
-	i = 1;
-	while(i < map->points-1 && map->pwm[i][0] < val)
-		i++;
+#if FANPICO_FIXED_POINT
+#define PWM_FX(v) fx_from_int((v), Q16_FRAC)
 
-	// value is larger or equal than last map point
-	if (val >= map->pwm[i][0])
-		return map->pwm[i][1];
+double calculate_pwm_duty(struct fanpico_state *state, const struct fanpico_control_config *config, int i)
+{
+	const struct fan_output *fan;
+	fx_t val = 0;
+
+	fan = &config->fans[i];
+
+	/* Get source value (Q16.16) */
+	switch (fan->s_type) {
+	case PWM_FIXED:
+		val = PWM_FX(fan->s_id);
+		break;
+	case PWM_MB:
+		val = fx_from_float(state->mbfan_duty[fan->s_id], Q16_FRAC);
+		break;
+	case PWM_SENSOR:
+		val = pwl_eval(&config->maps, &config->maps.sensors[fan->s_id],
+					fx_from_float(state->temp[fan->s_id], Q16_FRAC));
+		break;
+	case PWM_VSENSOR:
+		val = pwl_eval(&config->maps, &config->maps.vsensors[fan->s_id],
+					fx_from_float(state->vtemp[fan->s_id], Q16_FRAC));
+		break;
+	case PWM_FAN:
+		/* Run at full speed if source fan has failed */
+		if (state->fan_status[fan->s_id] != FAN_STATUS_OK)
+			val = PWM_FX(100);
+		else
+			val = fx_from_float(state->fan_duty[fan->s_id], Q16_FRAC);
+		break;
+	}
+
+	/* Apply filter */
+	if (fan->filter.stages > 0) {
+		fx_t f_val = filter_channel(FILTER_CH_FAN, i, val,
+					pwm_source_time(state, fan));
+		if (f_val != val) {
+			log_msg(LOG_DEBUG, "filter fan%d: %f -> %f\n", i+1,
+				fx_to_double(val, Q16_FRAC), fx_to_double(f_val, Q16_FRAC));
+			val = f_val;
+		}
+	}
+
+	/* Apply mapping */
+	val = pwl_eval(&config->maps, &config->maps.fans[i], val);
 
-	// calculate mapping using the map points left (i-i) and right (i) of the value...
-	double a = (double)(map->pwm[i][1] - map->pwm[i-1][1]) / (double)(map->pwm[i][0] - map->pwm[i-1][0]);
-	newval = map->pwm[i-1][1] + a * (val - map->pwm[i-1][0]);
+	/* Apply coefficient and enforce min/max limits for output */
+	val = pwl_scale_eval(&fan->scale, val);
 
-	return newval;
+	return fx_to_double(val, Q16_FRAC);
 }
 
+#else
 
-double calculate_pwm_duty(struct fanpico_state *state, const struct fanpico_config *config, int i)
+double calculate_pwm_duty(struct fanpico_state *state, const struct fanpico_control_config *config, int i)
 {
 	const struct fan_output *fan;
 	double val = 0;
@@ -298,19 +576,27 @@ double calculate_pwm_duty(struct fanpico_state *state, const struct fanpico_conf
 		val = state->mbfan_duty[fan->s_id];
 		break;
 	case PWM_SENSOR:
-		val = sensor_get_duty(&config->sensors[fan->s_id].map, state->temp[fan->s_id]);
+		val = pwl_eval(&config->maps, &config->maps.sensors[fan->s_id],
+			state->temp[fan->s_id]);
 		break;
 	case PWM_VSENSOR:
-		val = sensor_get_duty(&config->vsensors[fan->s_id].map, state->vtemp[fan->s_id]);
+		val = pwl_eval(&config->maps, &config->maps.vsensors[fan->s_id],
+			state->vtemp[fan->s_id]);
 		break;
 	case PWM_FAN:
-		val = state->fan_duty[fan->s_id];
+		/* Run at full speed if source fan has failed */
+		if (state->fan_status[fan->s_id] != FAN_STATUS_OK)
+			val = 100.0;
+		else
+			val = state->fan_duty[fan->s_id];
 		break;
 	}
 
 	/* Apply filter */
-	if (fan->filter != FILTER_NONE) {
-		double f_val = filter(fan->filter, fan->filter_ctx, val);
+	if (fan->filter.stages > 0) {
+		double f_val = FILTER_TO_FLOAT(filter_channel(FILTER_CH_FAN, i,
+							FILTER_VAL(val),
+							pwm_source_time(state, fan)));
 		if (f_val != val) {
 			log_msg(LOG_DEBUG, "filter fan%d: %lf -> %lf\n", i+1, val, f_val);
 			val = f_val;
@@ -318,7 +604,7 @@ double calculate_pwm_duty(struct fanpico_state *state, const struct fanpico_conf
 	}
 
 	/* Apply mapping */
-	val = pwm_map(&fan->map, val);
+	val = pwl_eval(&config->maps, &config->maps.fans[i], val);
 
 	/* Apply coefficient */
 	val *= fan->pwm_coefficient;
@@ -329,5 +615,6 @@ double calculate_pwm_duty(struct fanpico_state *state, const struct fanpico_conf
 
 	return val;
 }
+#endif
 
 
@@ -0,0 +1,198 @@
+/* scheduler.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "scheduler.h"
+
+
+/*
+ * Simple deadline based scheduler for periodic tasks.
+ *
+ * This module does not depend on Pico SDK (time source is
+ * provided by the caller), so it can be built and tested on a host.
+ */
+
+
+static inline int hist_bucket(uint32_t us)
+{
+	int b = (us > 0 ? 32 - __builtin_clz(us) : 0);
+
+	return (b < SCHED_HIST_BUCKETS ? b : SCHED_HIST_BUCKETS - 1);
+}
+
+
+static void update_stats(struct sched_task_stats *st, uint32_t late, uint32_t exec)
+{
+	st->runs++;
+	st->exec_total += exec;
+	if (exec > st->exec_max)
+		st->exec_max = exec;
+	if (late > st->late_max)
+		st->late_max = late;
+	st->exec_hist[hist_bucket(exec)]++;
+	st->late_hist[hist_bucket(late)]++;
+}
+
+
+/* Return number of tasks (in task table) bound to given core. */
+int sched_task_count(const struct sched_task *tasks, uint32_t task_count, uint8_t core)
+{
+	int count = 0;
+
+	for (uint32_t i = 0; i < task_count; i++) {
+		if (tasks[i].core == core && tasks[i].func)
+			count++;
+	}
+
+	return count;
+}
+
+
+/* Initialize scheduler with tasks (from task table) assigned to given core.
+ * All tasks are scheduled to run immediately. Tasks beyond SCHED_MAX_TASKS
+ * are not scheduled (caller should compare return value against
+ * sched_task_count()).
+ *
+ * Returns number of tasks assigned to this scheduler.
+ */
+int sched_init(scheduler_t *s, const struct sched_task *tasks, uint32_t task_count,
+	uint8_t core, sched_clock_func_t clock)
+{
+	uint64_t now = clock();
+
+	memset(s, 0, sizeof(*s));
+	s->clock = clock;
+
+	for (uint32_t i = 0; i < task_count; i++) {
+		if (tasks[i].core != core || !tasks[i].func)
+			continue;
+		if (s->count >= SCHED_MAX_TASKS)
+			break;
+		s->tasks[s->count].task = &tasks[i];
+		s->tasks[s->count].next_run = now;
+		s->tasks[s->count].active = true;
+		s->count++;
+	}
+
+	return s->count;
+}
+
+
+/* Run all tasks whose deadline has passed (in order they appear
+ * in the task table).
+ *
+ * Returns next deadline (when scheduler needs to be run again).
+ */
+uint64_t sched_run(scheduler_t *s)
+{
+	uint64_t now = s->clock();
+	uint64_t next = SCHED_NO_DEADLINE;
+
+	if (s->reset_stats) {
+		for (int i = 0; i < s->count; i++)
+			memset(&s->tasks[i].stats, 0, sizeof(s->tasks[i].stats));
+		s->reset_stats = false;
+	}
+
+	for (int i = 0; i < s->count; i++) {
+		struct sched_task_state *t = &s->tasks[i];
+
+		if (!t->active)
+			continue;
+
+		if (now >= t->next_run) {
+			uint64_t start = now;
+			int res = t->task->func(t->task->ctx);
+
+			now = s->clock();
+			update_stats(&t->stats, start - t->next_run, now - start);
+
+			if (res < 0) {
+				t->active = false;
+				continue;
+			}
+			if (res > 0) {
+				/* Task requested specific delay until next run */
+				t->next_run = start + (uint64_t)res * 1000;
+			} else {
+				/* Keep fixed rate, unless we have fallen behind... */
+				t->next_run += (uint64_t)t->task->period * 1000;
+				if (t->next_run <= now)
+					t->next_run = now + (uint64_t)t->task->period * 1000;
+			}
+		}
+
+		if (t->next_run < next)
+			next = t->next_run;
+	}
+
+	return next;
+}
+
+
+uint64_t sched_next_deadline(const scheduler_t *s)
+{
+	uint64_t next = SCHED_NO_DEADLINE;
+
+	for (int i = 0; i < s->count; i++) {
+		if (s->tasks[i].active && s->tasks[i].next_run < next)
+			next = s->tasks[i].next_run;
+	}
+
+	return next;
+}
+
+
+/* Request task statistics (histograms) to be cleared. Statistics are
+ * cleared by the core running the scheduler (on next call to sched_run()),
+ * so this can be safely called from the other core.
+ */
+void sched_reset_stats(scheduler_t *s)
+{
+	s->reset_stats = true;
+}
+
+
+void sched_latency_add(struct sched_latency_stats *st, uint32_t us)
+{
+	st->count++;
+	st->last = us;
+	st->total += us;
+	if (us > st->max)
+		st->max = us;
+	st->hist[hist_bucket(us)]++;
+}
+
+
+/* Return upper limit (us) for a histogram bucket, or 0 for last bucket
+ * (that has no upper limit).
+ */
+uint32_t sched_hist_bucket_limit(int bucket)
+{
+	if (bucket < 0 || bucket >= SCHED_HIST_BUCKETS - 1)
+		return 0;
+	return (1UL << bucket);
+}
+
+
+/* eof :-) */
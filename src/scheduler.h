@@ -0,0 +1,97 @@
+/* scheduler.h
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FANPICO_SCHEDULER_H
+#define FANPICO_SCHEDULER_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Enough for all system tasks on one core (see FANPICO_CONTROL_CORE) */
+#define SCHED_MAX_TASKS 20
+#define SCHED_NO_DEADLINE UINT64_MAX
+#define SCHED_HIST_BUCKETS 18
+
+
+/* Task function return value:
+ *   0 = run again after default period
+ *  >0 = run again after given number of milliseconds
+ *  <0 = disable task
+ */
+typedef int (*sched_task_func_t)(void *ctx);
+
+struct sched_task {
+	const char *name;
+	uint8_t core;           /* core the task is bound to */
+	uint32_t period;        /* default period (ms) */
+	sched_task_func_t func;
+	void *ctx;
+};
+
+/* Histogram bucket 0 counts samples below 1us, bucket n (n > 0) counts
+ * samples in range [2^(n-1), 2^n) us. Last bucket counts everything above.
+ */
+struct sched_task_stats {
+	uint32_t runs;
+	uint32_t exec_max;      /* longest execution time (us) */
+	uint32_t late_max;      /* longest delay from deadline to start (us) */
+	uint64_t exec_total;    /* total execution time (us) */
+	uint32_t exec_hist[SCHED_HIST_BUCKETS];
+	uint32_t late_hist[SCHED_HIST_BUCKETS];
+};
+
+/* Latency statistics for events not tied to a single task. */
+struct sched_latency_stats {
+	uint32_t count;
+	uint32_t last;          /* latest measurement (us) */
+	uint32_t max;           /* longest latency (us) */
+	uint64_t total;         /* sum of all measurements (us) */
+	uint32_t hist[SCHED_HIST_BUCKETS];
+};
+
+struct sched_task_state {
+	const struct sched_task *task;
+	uint64_t next_run;      /* deadline (us) */
+	bool active;
+	struct sched_task_stats stats;
+};
+
+typedef uint64_t (*sched_clock_func_t)(void);
+
+typedef struct scheduler {
+	struct sched_task_state tasks[SCHED_MAX_TASKS];
+	uint8_t count;
+	sched_clock_func_t clock;
+	volatile bool reset_stats;  /* request to clear statistics */
+} scheduler_t;
+
+
+int sched_task_count(const struct sched_task *tasks, uint32_t task_count, uint8_t core);
+int sched_init(scheduler_t *s, const struct sched_task *tasks, uint32_t task_count,
+	uint8_t core, sched_clock_func_t clock);
+uint64_t sched_run(scheduler_t *s);
+uint64_t sched_next_deadline(const scheduler_t *s);
+void sched_reset_stats(scheduler_t *s);
+uint32_t sched_hist_bucket_limit(int bucket);
+void sched_latency_add(struct sched_latency_stats *st, uint32_t us);
+
+
+#endif /* FANPICO_SCHEDULER_H */
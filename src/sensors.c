@@ -20,6 +20,7 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <assert.h>
@@ -38,14 +39,167 @@ uint8_t sensor_adc_map[SENSOR_MAX_COUNT] = {
 };
 
 
-double get_temperature(uint8_t input, const struct fanpico_config *config)
+/* Calculate thermistor temperature using Beta equation. */
+double thermistor_temp(double raw, const struct sensor_input *sensor)
+{
+	double t, r;
+
+	r = SENSOR_SERIES_RESISTANCE / (((double)ADC_MAX_VALUE / raw) - 1);
+	t = log(r / sensor->thermistor_nominal);
+	t /= sensor->beta_coefficient;
+	t += 1.0 / (sensor->temp_nominal + 273.15);
+	t = 1.0 / t;
+	t -= 273.15;
+
+	return t;
+}
+
+
+static bool thermistor_lut_valid(const struct thermistor_lut *lut,
+				const struct sensor_input *sensor)
+{
+	return (lut->thermistor_nominal == sensor->thermistor_nominal
+		&& lut->temp_nominal == sensor->temp_nominal
+		&& lut->beta_coefficient == sensor->beta_coefficient);
+}
+
+
+/* (Re)build thermistor lookup table (if thermistor parameters of the
+ * sensor have changed). Linear interpolation between table entries keeps
+ * error below 0.01C in the normal (-20C..100C) range and below 0.1C near
+ * the ends of the ADC range (see tests/test_sensors.c).
+ *
+ * Called when configuration changes (see compile_control_config()),
+ * so that control loop only needs to do the lookup.
+ * Returns true if table was (re)built.
+ */
+bool thermistor_lut_build(struct thermistor_lut *lut, const struct sensor_input *sensor)
+{
+	int i, raw;
+
+	if (thermistor_lut_valid(lut, sensor))
+		return false;
+
+	lut->thermistor_nominal = sensor->thermistor_nominal;
+	lut->temp_nominal = sensor->temp_nominal;
+	lut->beta_coefficient = sensor->beta_coefficient;
+	for (i = 0; i < THERMISTOR_LUT_SIZE; i++) {
+		raw = i << THERMISTOR_LUT_BITS;
+		if (raw < 1)
+			raw = 1;
+		if (raw > ADC_MAX_VALUE - 1)
+			raw = ADC_MAX_VALUE - 1;
+#if FANPICO_FIXED_POINT
+		lut->temp[i] = fx_from_double(thermistor_temp(raw, sensor), Q16_FRAC);
+#else
+		lut->temp[i] = thermistor_temp(raw, sensor);
+#endif
+	}
+
+	return true;
+}
+
+
+#if FANPICO_FIXED_POINT
+
+/* Convert raw ADC value (Q16.16) to thermistor temperature (Q16.16)
+ * using lookup table.
+ */
+static fx_t thermistor_lut_temp_fx(const struct thermistor_lut *lut, fx_t raw)
+{
+	fx_t frac;
+	int i;
+
+	if (raw < 0)
+		raw = 0;
+	i = raw >> (Q16_FRAC + THERMISTOR_LUT_BITS);
+	if (i > THERMISTOR_LUT_SIZE - 2)
+		i = THERMISTOR_LUT_SIZE - 2;
+	frac = (raw >> THERMISTOR_LUT_BITS) - fx_from_int(i, Q16_FRAC);
+
+	return lut->temp[i] + fx_mul(lut->temp[i + 1] - lut->temp[i], frac, Q16_FRAC);
+}
+
+/* Convert raw ADC value to thermistor temperature using lookup table. */
+double thermistor_lut_temp(const struct thermistor_lut *lut, float raw)
+{
+	return fx_to_double(thermistor_lut_temp_fx(lut, fx_from_float(raw, Q16_FRAC)),
+			Q16_FRAC);
+}
+
+#else
+
+/* Convert raw ADC value to thermistor temperature using lookup table. */
+double thermistor_lut_temp(const struct thermistor_lut *lut, float raw)
+{
+	float pos, frac;
+	int i;
+
+	pos = raw / (1 << THERMISTOR_LUT_BITS);
+	i = pos;
+	if (i < 0)
+		i = 0;
+	if (i > THERMISTOR_LUT_SIZE - 2)
+		i = THERMISTOR_LUT_SIZE - 2;
+	frac = pos - i;
+
+	return lut->temp[i] + (lut->temp[i + 1] - lut->temp[i]) * frac;
+}
+
+#endif
+
+
+#if FANPICO_FIXED_POINT
+
+/* Return sensor temperature (Q16.16) from raw ADC value, with coefficient,
+ * offset and filter applied.
+ */
+static fx_t sensor_temp_fx(uint8_t input, const struct sensor_input *sensor,
+			const struct thermistor_lut *lut,
+			float raw, double volt, uint64_t t_sample)
+{
+	fx_t t;
+
+	if (sensor->type == TEMP_INTERNAL) {
+		t = fx_from_double(27.0 - ((volt - 0.706) / 0.001721), Q16_FRAC);
+		t = pwl_scale_eval(&sensor->scale, t);
+	} else {
+		if (volt > 0.1 && volt < ADC_REF_VOLTAGE - 0.1) {
+			if (thermistor_lut_valid(lut, sensor))
+				t = thermistor_lut_temp_fx(lut, fx_from_float(raw, Q16_FRAC));
+			else
+				t = fx_from_double(thermistor_temp(raw, sensor), Q16_FRAC);
+			t = pwl_scale_eval(&sensor->scale, t);
+		} else {
+			t = 0;
+		}
+	}
+
+	/* Apply filter */
+	if (sensor->filter.stages > 0) {
+		fx_t t_f = filter_channel(FILTER_CH_SENSOR, input, t, t_sample);
+		if (t_f != t) {
+			log_msg(LOG_DEBUG, "filter sensor%d: %lf -> %lf\n", input+1,
+				fx_to_double(t, Q16_FRAC), fx_to_double(t_f, Q16_FRAC));
+			t = t_f;
+		}
+	}
+
+	return t;
+}
+
+#endif
+
+
+double get_temperature(uint8_t input, const struct fanpico_control_config *config)
 {
 	uint8_t pin;
-	uint32_t raw = 0;
+	float raw = 0;
 	uint64_t start, end;
-	double t, r, volt;
+	double t, volt;
 	int i;
 	const struct sensor_input *sensor;
+	const struct thermistor_lut *lut;
 
 	if (input >= SENSOR_COUNT)
 		return 0.0;
@@ -53,26 +207,29 @@ double get_temperature(uint8_t input, const struct fanpico_config *config)
 	start = to_us_since_boot(get_absolute_time());
 
 	sensor = &config->sensors[input];
+	lut = &config->thermistor_lut[input];
 
 	pin = sensor_adc_map[input];
-	adc_select_input(pin);
-	for (i = 0; i < ADC_AVG_WINDOW; i++) {
-		raw += adc_read();
+	if (!adc_sampler_read(pin, &raw)) {
+		/* ADC sampling not running, read input directly... */
+		adc_select_input(pin);
+		for (i = 0; i < ADC_AVG_WINDOW; i++) {
+			raw += adc_read();
+		}
+		raw /= ADC_AVG_WINDOW;
 	}
-	raw /= ADC_AVG_WINDOW;
 	volt = raw * ((double)config->adc_vref / ADC_MAX_VALUE);
 
+#if FANPICO_FIXED_POINT
+	t = fx_to_double(sensor_temp_fx(input, sensor, lut, raw, volt, start), Q16_FRAC);
+#else
 	if (sensor->type == TEMP_INTERNAL) {
 		t = 27.0 - ((volt - 0.706) / 0.001721);
 		t = t * sensor->temp_coefficient + sensor->temp_offset;
 	} else {
 		if (volt > 0.1 && volt < ADC_REF_VOLTAGE - 0.1) {
-			r = SENSOR_SERIES_RESISTANCE / (((double)ADC_MAX_VALUE / raw) - 1);
-			t = log(r / sensor->thermistor_nominal);
-			t /= sensor->beta_coefficient;
-			t += 1.0 / (sensor->temp_nominal + 273.15);
-			t = 1.0 / t;
-			t -= 273.15;
+			t = (thermistor_lut_valid(lut, sensor) ? thermistor_lut_temp(lut, raw)
+				: thermistor_temp(raw, sensor));
 			t = t * sensor->temp_coefficient + sensor->temp_offset;
 		} else {
 			t = 0.0;
@@ -80,17 +237,18 @@ double get_temperature(uint8_t input, const struct fanpico_config *config)
 	}
 
 	/* Apply filter */
-	if (sensor->filter != FILTER_NONE) {
-		double t_f = filter(sensor->filter, sensor->filter_ctx, t);
+	if (sensor->filter.stages > 0) {
+		double t_f = filter_channel(FILTER_CH_SENSOR, input, t, start);
 		if (t_f != t) {
-			log_msg(LOG_DEBUG, "filter sensor%d: %lf -> %lf\n", i+1, t, t_f);
+			log_msg(LOG_DEBUG, "filter sensor%d: %lf -> %lf\n", input+1, t, t_f);
 			t = t_f;
 		}
 	}
+#endif
 
 	end = to_us_since_boot(get_absolute_time());
 
-	log_msg(LOG_DEBUG, "get_temperature(%d): sensor_type=%u, raw=%u,  volt=%lf, temp=%lf (duration=%llu)",
+	log_msg(LOG_DEBUG, "get_temperature(%d): sensor_type=%u, raw=%.1f,  volt=%lf, temp=%lf (duration=%llu)",
 		input, sensor->type, raw, volt, t, end - start);
 
 	return t;
@@ -99,31 +257,16 @@ double get_temperature(uint8_t input, const struct fanpico_config *config)
 
 double sensor_get_duty(const struct temp_map *map, double temp)
 {
-	int i;
-	double a, t;
-
-	t = temp;
-
-	if (t <= map->temp[0][0])
-		return map->temp[0][1];
-
-	i = 1;
-	while (i < map->points-1 && map->temp[i][0] < t)
-		i++;
-
-	if (t >= map->temp[i][0])
-		return map->temp[i][1];
-
-	a = (double)(map->temp[i][1] - map->temp[i-1][1]) / (double)(map->temp[i][0] - map->temp[i-1][0]);
-	return map->temp[i-1][1] + a * (t - map->temp[i-1][0]);
+	return temp_map(map, temp);
 }
 
 
-double get_vsensor(uint8_t i, struct fanpico_config *config,
+double get_vsensor(uint8_t i, struct fanpico_control_config *config,
 		struct fanpico_state *state)
 {
 	struct vsensor_input *s = &config->vsensors[i];
 	double t = state->vtemp[i];
+	absolute_time_t t_sample = get_absolute_time();
 
 	if (s->mode == VSMODE_MANUAL || s->mode == VSMODE_I2C) {
 		/* Copy over values from WRITE:VSENSORx commands ... */
@@ -134,12 +277,15 @@ double get_vsensor(uint8_t i, struct fanpico_config *config,
 			state->vhumidity[i] = config->vhumidity[i];
 		}
 		/* Check if should reset temperature back to default due to lack of updates... */
-		if (s->timeout > 0 && t != s->default_temp) {
-			if (absolute_time_diff_us(state->vtemp_updated[i], get_absolute_time())/1000000
-				> s->timeout) {
+		if (s->timeout > 0 && absolute_time_diff_us(state->vtemp_updated[i], t_sample)/1000000
+			> s->timeout) {
+			if (t != s->default_temp) {
 				log_msg(LOG_INFO,"sensor%d: timeout, temperature reset to default", i + 1);
 				t = s->default_temp;
 			}
+		} else {
+			/* Sample time is the time of last update */
+			t_sample = state->vtemp_updated[i];
 		}
 	} else if (s->mode == VSMODE_ONEWIRE) {
 		uint64_t a = 0;
@@ -153,6 +299,8 @@ double get_vsensor(uint8_t i, struct fanpico_config *config,
 			}
 		}
 		t = (idx >= 0 ? state->onewire_temp[idx] : 0.0);
+		if (idx >= 0)
+			t_sample = state->onewire_temp_updated[idx];
 	} else  {
 		int count = 0;
 		t = 0.0;
@@ -191,9 +339,12 @@ double get_vsensor(uint8_t i, struct fanpico_config *config,
 	}
 
 
+	state->vtemp_sampled[i] = t_sample;
+
 	/* Apply filter */
-	if (s->filter != FILTER_NONE) {
-		double t_f = filter(s->filter, s->filter_ctx, t);
+	if (s->filter.stages > 0) {
+		double t_f = FILTER_TO_FLOAT(filter_channel(FILTER_CH_VSENSOR, i, FILTER_VAL(t),
+								to_us_since_boot(t_sample)));
 		if (t_f != t) {
 			log_msg(LOG_DEBUG, "filter vsensor%d: %lf -> %lf\n", i+1, t, t_f);
 			t = t_f;
@@ -0,0 +1,83 @@
+/* seqlock.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#include "seqlock.h"
+
+
+/*
+ * Lock-free (double buffered) sequence lock.
+ *
+ * Sequence counter is incremented by two for every published
+ * update. Bit 0 of the counter is set while write is in progress.
+ * For a (even) sequence number 's', the currently published buffer is
+ * buf[(s >> 1) & 1] and the next write goes to the other buffer.
+ */
+
+
+void seqlock_init(seqlock_t *lock, void *buf0, void *buf1, size_t size)
+{
+	lock->seq = 0;
+	lock->size = size;
+	lock->buf[0] = buf0;
+	lock->buf[1] = buf1;
+
+	memcpy(buf1, buf0, size);
+	__dmb();
+}
+
+
+/* Publish new data (must be called only from the single writer). */
+void seqlock_write(seqlock_t *lock, const void *src)
+{
+	uint32_t s = lock->seq;
+	uint idx = ((s >> 1) + 1) & 1;
+
+	lock->seq = s + 1;
+	__dmb();
+	memcpy(lock->buf[idx], src, lock->size);
+	__dmb();
+	lock->seq = s + 2;
+}
+
+
+/* Read latest published data. Returns sequence number of the data read. */
+uint32_t seqlock_read(const seqlock_t *lock, void *dst)
+{
+	uint32_t s1, s2;
+
+	do {
+		s1 = lock->seq;
+		__dmb();
+		memcpy(dst, lock->buf[(s1 >> 1) & 1], lock->size);
+		__dmb();
+		s2 = lock->seq;
+		/* Retry only if writer has started to overwrite the buffer we read. */
+	} while (s2 - (s1 & ~1UL) > 2);
+
+	return s1 & ~1UL;
+}
+
+
+/* eof :-) */
@@ -0,0 +1,52 @@
+/* seqlock.h
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FANPICO_SEQLOCK_H
+#define FANPICO_SEQLOCK_H 1
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Double buffered sequence lock for passing data structures
+ * from one core (single writer) to another core (readers).
+ *
+ * Writer never blocks, it always writes to the buffer that is not
+ * currently published. Readers retry only if the writer wrapped around
+ * and started writing into the buffer being read.
+ */
+typedef struct seqlock {
+	volatile uint32_t seq;  /* even = idle, odd = write in progress */
+	size_t size;
+	void *buf[2];
+} seqlock_t;
+
+
+void seqlock_init(seqlock_t *lock, void *buf0, void *buf1, size_t size);
+void seqlock_write(seqlock_t *lock, const void *src);
+uint32_t seqlock_read(const seqlock_t *lock, void *dst);
+
+static inline uint32_t seqlock_sequence(const seqlock_t *lock)
+{
+	return lock->seq & ~1UL;
+}
+
+
+#endif /* FANPICO_SEQLOCK_H */
@@ -68,11 +68,17 @@ void square_wave_gen_enabled(PIO pio, uint sm, bool enabled)
 
 
 /* Function to set output signal 'period' of a Square Wave generator.
+ * This never blocks, any pending (not yet used) period values still in
+ * the FIFO are discarded, so only the latest value takes effect.
  */
 void square_wave_gen_set_period(PIO pio, uint sm, uint32_t period)
 {
+	/* State machine only reads TX FIFO, so clearing FIFOs is safe. */
+	if (!pio_sm_is_tx_fifo_empty(pio, sm))
+		pio_sm_clear_fifos(pio, sm);
+
 	/* Write 'period' to TX FIFO. State machine copies this into register X */
-	pio_sm_put_blocking(pio, sm, period);
+	pio_sm_put(pio, sm, period);
 }
 
 
@@ -80,20 +86,8 @@ void square_wave_gen_set_period(PIO pio, uint sm, uint32_t period)
  */
 void square_wave_gen_set_freq(PIO pio, uint sm, double freq)
 {
-	uint32_t sys_clock = clock_get_hz(clk_sys);
-	uint32_t period;
-
-	if (freq > 0) {
-		// Calculate 'period' needed to produce requested frequency square wave...
-		period = sys_clock / (freq * 2);
-		if (period > 5)
-			period -= 5;
-	} else {
-		// no output if frequency <= 0 ...
-		period = 0;
-	}
-
-	square_wave_gen_set_period(pio, sm, period);
+	square_wave_gen_set_period(pio, sm,
+				square_wave_gen_period(clock_get_hz(clk_sys), freq));
 }
 
 
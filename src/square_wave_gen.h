@@ -22,6 +22,8 @@
 #ifndef SQUARE_WAVE_GEN_H
 #define SQUARE_WAVE_GEN_H 1
 
+#include <stdint.h>
+
 
 uint square_wave_gen_load_program(PIO pio);
 void square_wave_gen_program_init(PIO pio, uint sm, uint offset, uint pin);
@@ -29,6 +31,27 @@ void square_wave_gen_enabled(PIO pio, uint sm, bool enabled);
 void square_wave_gen_set_period(PIO pio, uint sm, uint32_t period);
 void square_wave_gen_set_freq(PIO pio, uint sm, double freq);
 
+/* Function to calculate 'period' value for producing square wave of
+ * given frequency. Full cycle of the output signal is 2 * period + 10
+ * clock cycles, so the closest possible period is returned.
+ * Returns 0 (no output) if frequency <= 0.
+ */
+static inline uint32_t square_wave_gen_period(uint32_t sys_clock, double freq)
+{
+	double period;
+
+	if (freq <= 0)
+		return 0;
+
+	period = sys_clock / (freq * 2) - 5.0;
+	if (period < 1.0)
+		return 1;
+	if (period >= UINT32_MAX)
+		return UINT32_MAX;
+
+	return (uint32_t)(period + 0.5);
+}
+
 #endif /* SQUARE_WAVE_GEN_H */
 
 
@@ -27,6 +27,8 @@
 #include "hardware/gpio.h"
 #include "hardware/pio.h"
 #include "square_wave_gen.h"
+#include "tacho_capture.h"
+#include "tacho_estimator.h"
 #include "pulse_len.h"
 #include "fanpico.h"
 
@@ -65,44 +67,85 @@ uint8_t mbfan_gpio_tacho_map[MBFAN_MAX_COUNT] = {
 };
 
 
-/* Tachometer pulse counters updated by GPIO interrupt */
-volatile uint fan_tacho_counters[FAN_MAX_COUNT];
-
-uint fan_tacho_counters_last[FAN_MAX_COUNT];
-absolute_time_t fan_tacho_last_read;
+#if TACHO_READ_MULTIPLEX == 0
+#define TACHO_UPDATE_INTERVAL 100  /* ms */
 
+/* Tachometer frequency estimators, updated from edges captured by PIO */
+static struct tacho_estimator fan_tacho_est[FAN_MAX_COUNT];
+#endif
 
 
 /* Array holding calculated fan tachometer (input) frequencies.
  */
 float fan_tacho_freq[FAN_MAX_COUNT];
 
+/* Time of last frequency sample for each fan. */
+absolute_time_t fan_tacho_updated[FAN_MAX_COUNT];
+
 
 PIO pio = pio0;
 
-static uint8_t queue[FAN_MAX_COUNT] = { 0, 0, 0, 0, 0, 0 , 0, 0 };
-static uint8_t queue_pos[2] = { 0, 0 };
+#if TACHO_READ_MULTIPLEX > 0
+#define TACHO_MUX_PULSES     4    /* Number of intervals to measure per visit */
+#define TACHO_MUX_MIN_DWELL  100  /* ms, accept fewer intervals after this */
+#define TACHO_MUX_TIMEOUT    600  /* ms, no pulses means fan is stopped */
+
+/* Multiplexer scan state for each fan */
+struct tacho_scan {
+	uint64_t sampled;   /* time of last sample (us since boot) */
+	float rate;         /* rate of change (%/s) between last two samples */
+	bool stopped;
+};
 
+static struct tacho_scan fan_tacho_scan[FAN_MAX_COUNT];
 
-/* Get next fan in the given queue. */
-int next_in_queue(uint8_t q)
-{
-	assert(q < 2);
 
-	if (queue_pos[q] >= FAN_MAX_COUNT) {
-		queue_pos[q] = 0;
-		return -1;
-	}
+/* Select next fan to measure. Fans are prioritized by age of the last
+ * sample, weighted by recent rate of change. Stopped fans (that take
+ * longest to measure) get lower weight.
+ */
+static int tacho_scan_next(uint64_t now)
+{
+	float score, best = -1.0;
+	float w;
+	int next = 0;
 
-	while (queue[queue_pos[q]] != q) {
-		queue_pos[q]++;
-		if (queue_pos[q] >= FAN_MAX_COUNT) {
-			queue_pos[q] = 0;
-			return -1;
+	for (int i = 0; i < FAN_COUNT; i++) {
+		const struct tacho_scan *s = &fan_tacho_scan[i];
+
+		if (s->stopped)
+			w = 0.25;
+		else
+			w = 1.0 + fminf(s->rate, 100.0) / 25.0;
+		score = (now - s->sampled) / 1000.0 * w;
+		if (score > best) {
+			best = score;
+			next = i;
 		}
 	}
-	return queue_pos[q]++;
+
+	return next;
+}
+
+
+/* Record new frequency sample for a fan. */
+static void tacho_scan_update(int fan, float f, bool stopped, uint64_t now)
+{
+	struct tacho_scan *s = &fan_tacho_scan[fan];
+	float prev = fan_tacho_freq[fan];
+	float dt = (now - s->sampled) / 1000000.0;
+
+	if (s->sampled > 0 && dt > 0 && fmaxf(f, prev) > 0)
+		s->rate = fabsf(f - prev) * 100.0 / fmaxf(f, prev) / dt;
+	else
+		s->rate = 0;
+	s->stopped = stopped;
+	s->sampled = now;
+
+	fan_tacho_freq[fan] = f;
+	fan_tacho_updated[fan] = from_us_since_boot(now);
 }
+#endif
 
 
 /* Function to select active multiplexer port. */
@@ -114,154 +157,179 @@ void multiplexer_select(uint8_t port)
 }
 
 
-/* Interrupt handler to keep count on pulses received on fan tachometer pins...
+#if TACHO_READ_MULTIPLEX == 0
+/* Record (rising) edge captured by PIO on fan tachometer pin.
  */
-void __time_critical_func(fan_tacho_read_callback)(uint gpio, uint32_t events)
+static void fan_tacho_edge(uint fan, uint64_t t, void *ctx)
 {
-	uint fan = gpio_fan_tacho_map[(gpio & 0x1f)];
-	if (fan > 0) {
-		fan_tacho_counters[fan-1]++;
-	}
+	tacho_est_add_edge(&fan_tacho_est[fan], t);
 }
+#endif
 
 
 /* Function to update tachometer frequencies in fan_tacho_freq[]
  */
-void read_tacho_inputs()
+void read_tacho_inputs(const struct fanpico_control_config *config)
 #if TACHO_READ_MULTIPLEX == 0
 {
-	uint counters[FAN_COUNT];
-	int64_t delta;
-	double s;
-	uint pulses;
+	static absolute_time_t last_update;
+	const struct fan_output *fan;
+	struct tacho_estimator *e;
+	uint64_t now;
 	double f;
 	int i;
 
-	/* Read current counter values. */
-	for (i = 0; i < FAN_COUNT; i++) {
-		counters[i] = fan_tacho_counters[i];
+	/* Collect edges captured by PIO (before ring buffer wraps around). */
+	if (tacho_capture_read(fan_tacho_edge, NULL) < 0) {
+		/* Samples were lost, next edge does not end a full period */
+		for (i = 0; i < FAN_COUNT; i++)
+			fan_tacho_est[i].edge_seen = false;
 	}
-	absolute_time_t read_time = get_absolute_time();
 
-	/* Calculate new frequency values, if enough time has passed... */
-	delta = absolute_time_diff_us(fan_tacho_last_read, read_time);
-	if (delta < 1000000)
+	if (!time_passed(&last_update, TACHO_UPDATE_INTERVAL))
 		return;
 
-	s = delta / 1000000.0;
+	now = time_us_64();
 	for (i = 0; i < FAN_COUNT; i++) {
-		if (cfg->fans[i].rpm_mode == RMODE_TACHO) {
-			pulses = counters[i] - fan_tacho_counters_last[i];
-			f = pulses / s;
+		fan = &config->fans[i];
+		if (fan->rpm_mode == RMODE_TACHO) {
+			e = &fan_tacho_est[i];
+			if (e->window != fan->tacho_periods || e->timeout != fan->tacho_timeout * 1000)
+				tacho_est_init(e, fan->tacho_periods, fan->tacho_timeout);
+			f = tacho_est_freq(e, now);
 		} else {
 			bool lra = gpio_get(fan_gpio_tacho_map[i]);
-			f = lra ? cfg->fans[i].lra_high : cfg->fans[i].lra_low;
-			f = f / 60.0 * cfg->fans[i].rpm_factor;
+			f = lra ? fan->lra_high : fan->lra_low;
+			f = f / 60.0 * fan->rpm_factor;
 		}
 		fan_tacho_freq[i] = f;
+		fan_tacho_updated[i] = from_us_since_boot(now);
 	}
-
-	/* Save counter values for next time... */
-	for (i = 0; i < FAN_COUNT; i++) {
-		fan_tacho_counters_last[i] = counters[i];
-	}
-	fan_tacho_last_read = read_time;
 }
 #else
 {
 	static int state = 0;
-	static int q = 0;
-	static absolute_time_t start_t;
 	static int i;
+	static uint64_t start_t;
+	uint64_t now = time_us_64();
 	uint64_t t;
+	uint count;
 	double f;
-//	uint64_t start, end;
 
 	if (state == 0) {
-		/* Pick next fan to 'measure' from queues... */
-		i = next_in_queue(q);
-		if (i < 0) {
-			/* End of queue reached, go to next queue. */
-			if (++q >= 2)
-				q = 0;
-			return;
-		}
-
-		/* process only one entry from second queue at a time */
-		if (q == 1) {
-			log_msg(LOG_DEBUG, "queue2: fan%d: read", i+1);
-			q = 0;
-		}
+		/* Pick next fan to 'measure'... */
+		i = tacho_scan_next(now);
 
 		/* Switch multiplexer to the fan we want to measure from... */
 		multiplexer_select(fan_gpio_tacho_map[i]);
 		busy_wait_us(50);
-		pulse_start_measure();
-		start_t = get_absolute_time();
+
+		if (config->fans[i].rpm_mode != RMODE_TACHO) {
+			bool lra = gpio_get(FAN_TACHO_READ_PIN);
+			f = lra ? config->fans[i].lra_high : config->fans[i].lra_low;
+			f = f / 60.0 * config->fans[i].rpm_factor;
+			tacho_scan_update(i, f, false, now);
+			return;
+		}
+
+		pulse_start_measure_count(TACHO_MUX_PULSES);
+		start_t = now;
 		state++;
 	}
 	else if (state == 1) {
-		// Measure pulse up to 600ms (down to 50 RPM)...
-
-		if (cfg->fans[i].rpm_mode == RMODE_TACHO) {
-			t = pulse_interval();
-			if (t == 0) {
-				if (!time_passed(&start_t, 600))
-					return;
-			}
-
-			if (t > 0) {
-				/* Fan is spinning, make sure fan is in the first queue... */
-				if (queue[i] != 0)
-					queue[i] = 0;
-
-				f = 1 / (t / 1000000.0);
-			}
-			else {
-				/* Fan not spinning, put this fan into second queue */
-				if (queue[i] != 1)
-					queue[i] = 1;
-
-				f = 0;
-			}
-
-			log_msg(LOG_DEBUG + 0, "fan%d: pulse len=%llu", i+1, t);
-		} else {
-			bool lra = gpio_get(FAN_TACHO_READ_PIN);
-			f = lra ? cfg->fans[i].lra_high : cfg->fans[i].lra_low;
-			f = f / 60.0 * cfg->fans[i].rpm_factor;
+		/* Measure several intervals, but do not wait for all of them
+		   if signal is slow. Wait up to 600ms for a pulse (down to 50 RPM)... */
+		t = pulse_intervals(&count);
+		if (count < TACHO_MUX_PULSES) {
+			if (now - start_t < TACHO_MUX_MIN_DWELL * 1000)
+				return;
+			if (count == 0 && now - start_t < TACHO_MUX_TIMEOUT * 1000)
+				return;
 		}
 
-		fan_tacho_freq[i] = f;
+		f = (count > 0 && t > 0 ? count * 1000000.0 / t : 0);
+		log_msg(LOG_DEBUG + 0, "fan%d: pulses=%u, len=%llu", i+1, count, t);
+
+		tacho_scan_update(i, f, (f == 0), now);
 		state = 0;
 	}
 }
 #endif
 
 
-/* Function to calculate tachometer frequencies.
+/* Update tacho input frequencies in system state.
+ * Returns bitmask of fans whose frequency changed (more than hysteresis).
  */
-void update_tacho_input_freq(struct fanpico_state *st)
+uint32_t update_tacho_input_freq(struct fanpico_state *st, const struct fanpico_control_config *config)
 {
+	uint32_t changed = 0;
+
 	for (int i = 0; i < FAN_COUNT; i++) {
-		float hyst = cfg->fans[i].tacho_hyst;
+		float hyst = config->fans[i].tacho_hyst;
 		st->fan_freq[i] = roundf(fan_tacho_freq[i]*100)/100.0;
+		st->fan_freq_updated[i] = fan_tacho_updated[i];
 		if (check_for_change(st->fan_freq_prev[i], st->fan_freq[i], hyst)) {
 			log_msg(LOG_INFO, "fan%d: Input Tacho change %.2fHz --> %.2fHz",
 				i+1,
 				st->fan_freq_prev[i],
 				st->fan_freq[i]);
 			st->fan_freq_prev[i] = st->fan_freq[i];
+			changed |= (1UL << i);
 		}
 	}
+
+	return changed;
+}
+
+
+/* Check if no tachometer pulses have been received from a fan
+ * during last 'timeout' microseconds.
+ */
+bool tacho_input_stalled(uint fan, uint64_t now, uint64_t timeout)
+#if TACHO_READ_MULTIPLEX == 0
+{
+	return (now > fan_tacho_est[fan].last_edge + timeout);
+}
+#else
+{
+	/* Fans are only sampled periodically when using multiplexer,
+	   so use result of the last sample. */
+	return fan_tacho_scan[fan].stopped;
+}
+#endif
+
+
+/* Describe how tachometer signal from a fan is measured
+ * (PIO state machine shared by all fans, or multiplexer).
+ */
+const char* tacho_input_method(uint fan, char *buf, size_t len)
+{
+#if TACHO_READ_MULTIPLEX == 0
+	uint pio_idx, sm;
+
+	if (tacho_capture_info(&pio_idx, &sm))
+		snprintf(buf, len, "PIO%u:SM%u", pio_idx, sm);
+	else
+		snprintf(buf, len, "NONE");
+#else
+	snprintf(buf, len, "MUX");
+#endif
+	return buf;
 }
 
 
 /* Function to initialize inputs for reading tachometer signals.
+ *
+ * All fans are sampled by one PIO state machine (claimed after
+ * tachometer generators and WiFi have claimed theirs).
  */
 void setup_tacho_inputs()
 {
 	int i, pin;
+#if TACHO_READ_MULTIPLEX == 0
+	uint8_t pins[FAN_MAX_COUNT];
+	uint pio_idx, sm;
+#endif
 
 	log_msg(LOG_NOTICE, "Setting up Tacho Input pins...");
 
@@ -269,17 +337,27 @@ void setup_tacho_inputs()
 	memset(gpio_fan_tacho_map, 0, sizeof(gpio_fan_tacho_map));
 
 	for (i = 0; i < FAN_COUNT; i++) {
-		fan_tacho_counters[i] = 0;
-		fan_tacho_counters_last[i] = 0;
 		fan_tacho_freq[i] = 0.0;
+		fan_tacho_updated[i] = from_us_since_boot(0);
 		pin = fan_gpio_tacho_map[i];
 		gpio_fan_tacho_map[pin] = 1 + i;
 #if TACHO_READ_MULTIPLEX == 0
 		gpio_init(pin);
 		gpio_set_dir(pin, GPIO_IN);
+		tacho_est_init(&fan_tacho_est[i], cfg->fans[i].tacho_periods,
+			cfg->fans[i].tacho_timeout);
+		pins[i] = pin;
 #endif
 	}
 
+#if TACHO_READ_MULTIPLEX == 0
+	if (tacho_capture_start(pins, FAN_COUNT) && tacho_capture_info(&pio_idx, &sm)) {
+		log_msg(LOG_INFO, "Tacho inputs sampled using PIO%u SM%u", pio_idx, sm);
+	} else {
+		log_msg(LOG_ERR, "No PIO state machine (or DMA channels) available for tacho inputs");
+	}
+#endif
+
 #if TACHO_READ_MULTIPLEX > 0
 	// Setup multiplexer pins */
 	gpio_init(FAN_TACHO_READ_PIN);
@@ -292,8 +370,6 @@ void setup_tacho_inputs()
 	gpio_set_dir(FAN_TACHO_READ_S2_PIN, GPIO_OUT);
 	multiplexer_select(0);
 #endif
-
-	fan_tacho_last_read = get_absolute_time();
 }
 
 
@@ -303,14 +379,9 @@ void setup_tacho_input_interrupts()
 
 #if TACHO_READ_MULTIPLEX > 0
 	pulse_setup_interrupt(FAN_TACHO_READ_PIN, GPIO_IRQ_EDGE_RISE);
-#else
-	/* Enable interrupts on Fan Tacho input pins */
-	gpio_set_irq_enabled_with_callback(FAN1_TACHO_READ_PIN,	GPIO_IRQ_EDGE_RISE,
-					true, &fan_tacho_read_callback);
-	for (int i = 1; i < FAN_COUNT; i++) {
-		gpio_set_irq_enabled(fan_gpio_tacho_map[i], GPIO_IRQ_EDGE_RISE, true);
-	}
 #endif
+	/* Without multiplexer, tacho inputs are captured using PIO and DMA
+	   (no interrupts). */
 }
 
 
@@ -350,6 +421,7 @@ void setup_tacho_outputs()
 		if (cfg->mbfans[i].rpm_mode == RMODE_TACHO) {
 			/* Configure PIO square wave generator output... */
 			uint sm = i;
+			pio_sm_claim(pio, sm);
 			square_wave_gen_program_init(pio, sm, pio_program_addr, pin);
 			square_wave_gen_set_period(pio, sm, 0);
 			square_wave_gen_enabled(pio, sm, true);
@@ -364,33 +436,85 @@ void setup_tacho_outputs()
 }
 
 
-double tacho_map(const struct tacho_map *map, double val)
+#if FANPICO_FIXED_POINT
+#define RPM_FX(v) fx_from_int((v), Q12_FRAC)
+
+/* Return fan RPM (Q20.12) from measured tachometer frequency. */
+static inline fx_t fan_rpm_fx(const struct fanpico_state *state,
+			const struct fanpico_control_config *config, int fan)
 {
-	int i;
-	double newval;
+	uint8_t rpm_factor = config->fans[fan].rpm_factor;
+
+	if (rpm_factor < 1)
+		return 0;
 
-	/* Value is equal or smaller than first map point */
-	if (val <= map->tacho[0][0])
-		return map->tacho[0][1];
+	return ((int64_t)fx_from_float(state->fan_freq[fan], Q12_FRAC) * 60) / rpm_factor;
+}
 
-	/* Find the map points that the value falls in between of... */
-	i = 1;
-	while(i < map->points-1 && map->tacho[i][0] < val)
-		i++;
 
-	/* Value is larger or equal than last map point */
-	if (val >= map->tacho[i][0])
-		return map->tacho[i][1];
+double calculate_tacho_freq(struct fanpico_state *state, const struct fanpico_control_config *config, int i)
+{
+	const struct mb_input *mbfan;
+	int count = 0;
+	fx_t val = 0;
+	int64_t sum = 0;
 
-	/* Calculate mapping using the map points left (i-i) and right (i) of the value... */
-	double a = (double)(map->tacho[i][1] - map->tacho[i-1][1]) / (double)(map->tacho[i][0] - map->tacho[i-1][0]);
-	newval = map->tacho[i-1][1] + a * (val - map->tacho[i-1][0]);
+	mbfan = &config->mbfans[i];
 
-	return newval;
+	switch (mbfan->s_type) {
+	case TACHO_FIXED:
+		val = RPM_FX(mbfan->s_id);
+		break;
+	case TACHO_FAN:
+		val = fan_rpm_fx(state, config, mbfan->s_id);
+		break;
+	case TACHO_MIN:
+	case TACHO_MAX:
+	case TACHO_AVG:
+		for (int i = 0; i < FAN_COUNT; i++) {
+			if (mbfan->sources[i]) {
+				val = fan_rpm_fx(state, config, i);
+				if (count == 0) {
+					sum = val;
+				} else {
+					if (mbfan->s_type == TACHO_MIN) {
+						if (val < sum)
+							sum = val;
+					}
+					else if (mbfan->s_type == TACHO_MAX) {
+						if (val > sum)
+							sum = val;
+					}
+					else { /* average */
+						sum += val;
+					}
+				}
+				count++;
+			}
+		}
+		if (count >= 1) {
+			if (mbfan->s_type == TACHO_AVG) {
+				val = sum / count;
+			} else {
+				val = sum;
+			}
+		}
+		break;
+	}
+
+	/* apply mapping */
+	val = pwl_eval(&config->maps, &config->maps.mbfans[i], val);
+
+	/* apply coefficient and min/max limits */
+	val = pwl_scale_eval(&mbfan->scale, val);
+
+	/* convert RPM to frequency */
+	return fx_to_double(((int64_t)val * mbfan->rpm_factor) / 60, Q12_FRAC);
 }
 
+#else
 
-double calculate_tacho_freq(struct fanpico_state *state, const struct fanpico_config *config, int i)
+double calculate_tacho_freq(struct fanpico_state *state, const struct fanpico_control_config *config, int i)
 {
 	const struct mb_input *mbfan;
 	int count = 0;
@@ -442,7 +566,7 @@ double calculate_tacho_freq(struct fanpico_state *state, const struct fanpico_co
 
 
 	/* apply mapping */
-	val = tacho_map(&mbfan->map, val);
+	val = pwl_eval(&config->maps, &config->maps.mbfans[i], val);
 
 	/* apply coefficient */
 	val *= mbfan->rpm_coefficient;
@@ -455,5 +579,6 @@ double calculate_tacho_freq(struct fanpico_state *state, const struct fanpico_co
 
 	return val;
 }
+#endif
 
 
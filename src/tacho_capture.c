@@ -0,0 +1,296 @@
+/* tacho_capture.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+
+#include "tacho_capture.h"
+
+
+/*
+ * PIO based tachometer signal capture for all tachometer inputs.
+ *
+ * One state machine samples all tachometer input pins at a fixed rate
+ * (TACHO_CAPTURE_RATE) and packs state of the inputs into one byte per
+ * sample (4 samples per word). Two DMA channels copy the words from the
+ * RX FIFO into a ring buffer (data channel writes the buffer, control
+ * channel restarts data channel from start of the buffer), so no
+ * interrupts are used. Position of a sample in the stream is its
+ * timestamp. tacho_capture_read() scans new samples for rising edges;
+ * words without changes are skipped with one compare.
+ *
+ * Program is generated at runtime for the pins used (pins need not be
+ * consecutive). All pins are read into OSR, then bits of each run of
+ * consecutive input pins are copied into ISR, and pins between runs
+ * are discarded:
+ *
+ *     mov osr, pins      ; sample all pins (IN base is lowest input pin)
+ *     in osr, <run1>     ; copy first run of input pins
+ *     out null, <skip>   ; discard first run and pins up to next run
+ *     in osr, <run2>
+ *     ...
+ *     in null, <pad>     ; pad sample to 8 bits (autopush at 32 bits)
+ *
+ * Sample rate is set using the clock divider.
+ */
+
+#define BUFFER_LEN     2048  /* words (4 samples each, ~82ms) */
+#define SAMPLE_BITS    8
+#define MAX_PROGRAM    (2 + 2 * TACHO_CAPTURE_MAX_INPUTS)
+
+static uint16_t program_instr[MAX_PROGRAM];
+static struct pio_program program = {
+	.instructions = program_instr,
+	.length = 0,
+	.origin = -1,
+};
+
+static PIO capture_pio = NULL;
+static int capture_sm = -1;
+static int data_ch = -1;
+static int ctrl_ch = -1;
+static uint32_t buffer[BUFFER_LEN];
+static uint32_t *buffer_addr = buffer;
+static uint read_pos = 0;
+static uint8_t last_sample = 0xff;
+static uint8_t bit_input[SAMPLE_BITS];
+static double sample_period = 0;  /* us */
+static double t_next = 0;         /* time of next unread sample (us) */
+
+
+/* Generate program to sample given pins, and map sample bits to inputs.
+ * Returns lowest input pin (IN base).
+ */
+static uint build_program(const uint8_t *pins, uint count)
+{
+	uint32_t mask = 0;
+	int8_t bit_pos[32];
+	uint base, pos, p, n, bits = 0;
+
+	for (uint i = 0; i < count; i++)
+		mask |= (1UL << pins[i]);
+	base = __builtin_ctz(mask);
+	mask >>= base;
+	memset(bit_pos, -1, sizeof(bit_pos));
+
+	program.length = 0;
+	program_instr[program.length++] = pio_encode_mov(pio_osr, pio_pins);
+	pos = 0;
+	p = 0;
+	while (p < 32 - base) {
+		if (!(mask & (1UL << p))) {
+			p++;
+			continue;
+		}
+		for (n = 0; p + n < 32 - base && (mask & (1UL << (p + n))); n++)
+			;
+		if (p > pos)
+			program_instr[program.length++] = pio_encode_out(pio_null, p - pos);
+		program_instr[program.length++] = pio_encode_in(pio_osr, n);
+		/* Bits already in ISR are shifted left */
+		for (uint i = 0; i < 32; i++) {
+			if (bit_pos[i] >= 0)
+				bit_pos[i] += n;
+		}
+		for (uint i = 0; i < n; i++)
+			bit_pos[p + i] = i;
+		bits += n;
+		pos = p;
+		p += n;
+	}
+	if (bits < SAMPLE_BITS) {
+		program_instr[program.length++] = pio_encode_in(pio_null, SAMPLE_BITS - bits);
+		for (uint i = 0; i < 32; i++) {
+			if (bit_pos[i] >= 0)
+				bit_pos[i] += SAMPLE_BITS - bits;
+		}
+	}
+
+	memset(bit_input, 0, sizeof(bit_input));
+	for (uint i = 0; i < count; i++)
+		bit_input[bit_pos[pins[i] - base]] = i;
+
+	return base;
+}
+
+
+/* Start capturing tachometer signals from given pins
+ * (at most TACHO_CAPTURE_MAX_INPUTS).
+ *
+ * Returns false if no PIO state machine (or program space), or
+ * DMA channels are available.
+ */
+bool tacho_capture_start(const uint8_t *pins, uint count)
+{
+	pio_sm_config c;
+	dma_channel_config dc;
+	uint base, div, offset;
+	uint32_t sys_clock = clock_get_hz(clk_sys);
+
+	if (count < 1 || count > TACHO_CAPTURE_MAX_INPUTS || capture_sm >= 0)
+		return false;
+
+	base = build_program(pins, count);
+
+	for (uint i = 0; i < NUM_PIOS; i++) {
+		PIO pio = pio_get_instance(i);
+		int sm;
+
+		if (!pio_can_add_program(pio, &program))
+			continue;
+		if ((sm = pio_claim_unused_sm(pio, false)) < 0)
+			continue;
+		capture_pio = pio;
+		capture_sm = sm;
+		break;
+	}
+	if (capture_sm < 0)
+		return false;
+
+	data_ch = dma_claim_unused_channel(false);
+	ctrl_ch = dma_claim_unused_channel(false);
+	if (data_ch < 0 || ctrl_ch < 0) {
+		if (data_ch >= 0)
+			dma_channel_unclaim(data_ch);
+		if (ctrl_ch >= 0)
+			dma_channel_unclaim(ctrl_ch);
+		pio_sm_unclaim(capture_pio, capture_sm);
+		data_ch = ctrl_ch = capture_sm = -1;
+		return false;
+	}
+
+	offset = pio_add_program(capture_pio, &program);
+
+	/* Clock divider (in 1/256ths) for TACHO_CAPTURE_RATE samples/s */
+	div = ((uint64_t)sys_clock * 256) / ((uint64_t)program.length * TACHO_CAPTURE_RATE);
+	if (div < 256)
+		div = 256;
+	sample_period = (double)program.length * div / 256 * 1000000 / sys_clock;
+
+	c = pio_get_default_sm_config();
+	sm_config_set_wrap(&c, offset, offset + program.length - 1);
+	sm_config_set_in_pins(&c, base);
+	sm_config_set_in_shift(&c, false, true, 32);
+	sm_config_set_out_shift(&c, true, false, 32);
+	sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX);
+	sm_config_set_clkdiv(&c, div / 256.0f);  /* exact, div < 2^24 */
+	pio_sm_init(capture_pio, capture_sm, offset, &c);
+
+	/* Data channel: copy samples from RX FIFO into the buffer */
+	dc = dma_channel_get_default_config(data_ch);
+	channel_config_set_transfer_data_size(&dc, DMA_SIZE_32);
+	channel_config_set_read_increment(&dc, false);
+	channel_config_set_write_increment(&dc, true);
+	channel_config_set_dreq(&dc, pio_get_dreq(capture_pio, capture_sm, false));
+	channel_config_set_chain_to(&dc, ctrl_ch);
+	dma_channel_configure(data_ch, &dc, buffer, &capture_pio->rxf[capture_sm],
+			BUFFER_LEN, false);
+
+	/* Control channel: restart data channel from beginning of buffer */
+	dc = dma_channel_get_default_config(ctrl_ch);
+	channel_config_set_transfer_data_size(&dc, DMA_SIZE_32);
+	channel_config_set_read_increment(&dc, false);
+	channel_config_set_write_increment(&dc, false);
+	dma_channel_configure(ctrl_ch, &dc, &dma_hw->ch[data_ch].al2_write_addr_trig,
+			&buffer_addr, 1, false);
+
+	read_pos = 0;
+	last_sample = 0xff;  /* first edge is counted after input has been low */
+	dma_channel_start(data_ch);
+	t_next = time_us_64();
+	pio_sm_set_enabled(capture_pio, capture_sm, true);
+
+	return true;
+}
+
+
+/* Scan new samples for rising edges, calling 'func' for each edge.
+ * Must be called more often than every ~80ms.
+ *
+ * Returns number of edges found, or -1 if samples were lost (since
+ * last call), in which case time of the next edge must not be used
+ * to calculate signal period.
+ */
+int tacho_capture_read(tacho_capture_edge_func_t *func, void *ctx)
+{
+	uint64_t now = time_us_64();
+	uint8_t prev = last_sample;
+	uint write_pos;
+	int edges = 0;
+
+	if (capture_sm < 0)
+		return 0;
+
+	write_pos = (((uintptr_t)dma_hw->ch[data_ch].write_addr - (uintptr_t)buffer)
+		/ sizeof(uint32_t)) % BUFFER_LEN;
+
+	/* Buffer has been overwritten (leave margin for FIFO and ISR),
+	   skip to newest samples. */
+	if ((now - t_next) / sample_period > (BUFFER_LEN - 8) * 4.0) {
+		t_next = now;
+		read_pos = write_pos;
+		return -1;
+	}
+
+	while (read_pos != write_pos) {
+		uint32_t word = buffer[read_pos];
+
+		if (word != prev * 0x01010101UL) {
+			for (uint s = 0; s < 4; s++, word <<= 8) {
+				uint8_t sample = word >> 24;
+				uint8_t rising = sample & ~prev;
+
+				prev = sample;
+				while (rising) {
+					uint bit = __builtin_ctz(rising);
+
+					rising &= rising - 1;
+					func(bit_input[bit], t_next + s * sample_period, ctx);
+					edges++;
+				}
+			}
+		}
+		t_next += 4 * sample_period;
+		read_pos = (read_pos + 1) % BUFFER_LEN;
+	}
+	last_sample = prev;
+
+	return edges;
+}
+
+
+/* Return PIO and state machine used for capture. */
+bool tacho_capture_info(uint *pio, uint *sm)
+{
+	if (capture_sm < 0)
+		return false;
+	*pio = pio_get_index(capture_pio);
+	*sm = capture_sm;
+	return true;
+}
+
+
+/* eof :-) */
@@ -0,0 +1,37 @@
+/* tacho_capture.h
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TACHO_CAPTURE_H
+#define TACHO_CAPTURE_H 1
+
+#define TACHO_CAPTURE_MAX_INPUTS  8
+#define TACHO_CAPTURE_RATE        100000  /* samples/s (10us resolution) */
+
+/* Called for each rising edge on input (index to pins given to
+ * tacho_capture_start()), 't' is time of the edge (us since boot).
+ */
+typedef void (tacho_capture_edge_func_t)(uint input, uint64_t t, void *ctx);
+
+bool tacho_capture_start(const uint8_t *pins, uint count);
+int tacho_capture_read(tacho_capture_edge_func_t *func, void *ctx);
+bool tacho_capture_info(uint *pio, uint *sm);
+
+#endif /* TACHO_CAPTURE_H */
@@ -0,0 +1,123 @@
+/* tacho_estimator.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "tacho_estimator.h"
+
+
+/*
+ * Tachometer signal frequency estimator.
+ *
+ * Frequency is calculated from the last N signal periods, rejecting
+ * periods that differ too much from the median period (noise pulses
+ * and missed pulses). If no pulses are received within the timeout,
+ * frequency is reported as zero.
+ */
+
+
+void tacho_est_init(struct tacho_estimator *e, uint window, uint32_t timeout_ms)
+{
+	memset(e, 0, sizeof(*e));
+	if (window < 1)
+		window = 1;
+	if (window > TACHO_EST_MAX_PERIODS)
+		window = TACHO_EST_MAX_PERIODS;
+	e->window = window;
+	e->timeout = timeout_ms * 1000;
+}
+
+
+void tacho_est_reset(struct tacho_estimator *e)
+{
+	e->count = 0;
+	e->pos = 0;
+	e->edge_seen = false;
+}
+
+
+/* Record signal period (in microseconds) that ended at time 't'. */
+void __time_critical_func(tacho_est_add_period)(struct tacho_estimator *e, uint64_t t, uint32_t period)
+{
+	/* Ignore period that started before timeout (fan was stopped) */
+	if (period > 0 && period <= e->timeout) {
+		e->periods[e->pos] = period;
+		e->pos = (e->pos + 1) % e->window;
+		if (e->count < e->window)
+			e->count++;
+	}
+	e->last_edge = t;
+	e->edge_seen = true;
+}
+
+
+/* Return estimated signal frequency (Hz) at time 'now' (microseconds). */
+double tacho_est_freq(struct tacho_estimator *e, uint64_t now)
+{
+	uint32_t sorted[TACHO_EST_MAX_PERIODS];
+	uint32_t median, elapsed, min, max;
+	uint64_t sum = 0;
+	uint n = 0;
+	int i, j;
+
+	if (e->count < 1)
+		return 0.0;
+
+	elapsed = (now > e->last_edge ? now - e->last_edge : 0);
+	if (elapsed > e->timeout) {
+		/* No signal, fan has stopped... */
+		tacho_est_reset(e);
+		return 0.0;
+	}
+
+	/* Find median period (insertion sort) */
+	for (i = 0; i < e->count; i++) {
+		uint32_t v = e->periods[i];
+		for (j = i; j > 0 && sorted[j - 1] > v; j--)
+			sorted[j] = sorted[j - 1];
+		sorted[j] = v;
+	}
+	median = sorted[e->count / 2];
+
+	/* Average periods that are close enough to the median */
+	min = median - (uint64_t)median * TACHO_EST_MAX_DEVIATION / 100;
+	max = median + (uint64_t)median * TACHO_EST_MAX_DEVIATION / 100;
+	for (i = 0; i < e->count; i++) {
+		if (sorted[i] >= min && sorted[i] <= max) {
+			sum += sorted[i];
+			n++;
+		}
+	}
+	if (n < 1 || sum < 1)
+		return 0.0;
+
+	/* If fan is slowing down, current (incomplete) period can already be
+	   longer than any of the accepted periods. */
+	if (elapsed > max)
+		return 1000000.0 / elapsed;
+
+	return (double)n * 1000000.0 / sum;
+}
+
+
+/* eof :-) */
@@ -0,0 +1,58 @@
+/* tacho_estimator.h
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TACHO_ESTIMATOR_H
+#define TACHO_ESTIMATOR_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TACHO_EST_MAX_PERIODS   16
+#define TACHO_EST_MAX_DEVIATION 25   /* Max allowed deviation (%) from median period */
+
+/* Tachometer frequency estimator based on measured signal periods. */
+struct tacho_estimator {
+	uint32_t periods[TACHO_EST_MAX_PERIODS];  /* periods in microseconds */
+	uint8_t window;
+	uint8_t count;
+	uint8_t pos;
+	bool edge_seen;
+	uint32_t timeout;     /* timeout in microseconds */
+	uint64_t last_edge;   /* timestamp of last edge (or period) */
+};
+
+
+void tacho_est_init(struct tacho_estimator *e, uint window, uint32_t timeout_ms);
+void tacho_est_reset(struct tacho_estimator *e);
+void tacho_est_add_period(struct tacho_estimator *e, uint64_t t, uint32_t period);
+double tacho_est_freq(struct tacho_estimator *e, uint64_t now);
+
+/* Record signal (rising) edge at time 't' (microseconds). */
+static inline void tacho_est_add_edge(struct tacho_estimator *e, uint64_t t)
+{
+	if (e->edge_seen)
+		tacho_est_add_period(e, t, t - e->last_edge);
+	e->last_edge = t;
+	e->edge_seen = true;
+}
+
+
+#endif /* TACHO_ESTIMATOR_H */
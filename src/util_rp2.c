@@ -319,6 +319,11 @@ void rp2_memtest()
 #if !PICO_RP2040
 	/* PSRAM Tests */
 	if ((size = psram_size()) > 0) {
+		/* History buffer lives in PSRAM and is overwritten by the test */
+		if (history_in_psram()) {
+			history_clear();
+			printf("History buffer cleared (PSRAM test overwrites it)\n");
+		}
 		printf("Testing PSRAM: %lu bytes\n", size);
 		if (get_log_level() >= LOG_INFO) {
 			printf("M1_TIMING: %08lx\n", qmi_hw->m[1].timing);
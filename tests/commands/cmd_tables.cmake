@@ -0,0 +1,40 @@
+# Extract command tables (cmd_t arrays) from command.c for host tests.
+#
+# Command functions are replaced with CMD_FUNC(name) stubs (to be defined
+# by the test) and preprocessor conditionals are removed, so the tables
+# contain all commands (as in builds with all features enabled).
+#
+# Usage: cmake -DSOURCE=<command.c> -DOUTPUT=<file> -P cmd_tables.cmake
+
+file(READ ${SOURCE} src)
+
+string(FIND "${src}" "\nconst struct cmd_t " start)
+string(FIND "${src}" "\nconst struct cmd_t commands[] = {" root)
+if(start LESS 0 OR root LESS 0)
+  message(FATAL_ERROR "${SOURCE}: command tables not found")
+endif()
+string(SUBSTRING "${src}" ${root} -1 tail)
+string(FIND "${tail}" "\n};" end)
+math(EXPR len "${root} + ${end} + 3 - ${start}")
+string(SUBSTRING "${src}" ${start} ${len} tables)
+
+# Remove preprocessor conditionals
+string(REGEX REPLACE "\n#[^\n]*" "" tables "${tables}")
+
+# Stub for each command function
+string(REGEX MATCHALL ", *cmd_[A-Za-z0-9_]+ *}" matches "${tables}")
+set(funcs "")
+foreach(f ${matches})
+  string(REGEX REPLACE "[, }]" "" f "${f}")
+  list(APPEND funcs ${f})
+endforeach()
+list(REMOVE_DUPLICATES funcs)
+set(out "/* Generated from ${SOURCE} by cmd_tables.cmake */\n\n")
+foreach(f ${funcs})
+  string(APPEND out "CMD_FUNC(${f})\n")
+endforeach()
+string(APPEND out "${tables}\n")
+
+file(WRITE ${OUTPUT}.tmp "${out}")
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different ${OUTPUT}.tmp ${OUTPUT})
+file(REMOVE ${OUTPUT}.tmp)
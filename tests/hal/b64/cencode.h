@@ -0,0 +1,40 @@
+/* b64/cencode.h
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FAKE_B64_CENCODE_H
+#define FAKE_B64_CENCODE_H 1
+
+#include <stddef.h>
+
+/* libb64 is not part of the host build. Base64 helpers in util.c
+ * link against stubs in fake_hal.c (and are not used by host tests).
+ */
+typedef struct {
+	int step;
+} base64_encodestate;
+
+void base64_init_encodestate(base64_encodestate *state_in);
+size_t base64_encode_length(size_t plain_len, base64_encodestate *state_in);
+size_t base64_encode_block(const void *plaintext_in, const size_t length_in,
+			char *code_out, base64_encodestate *state_in);
+size_t base64_encode_blockend(char *code_out, base64_encodestate *state_in);
+
+#endif /* FAKE_B64_CENCODE_H */
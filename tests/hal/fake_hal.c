@@ -0,0 +1,752 @@
+/* fake_hal.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/pwm.h"
+#include "hardware/pio.h"
+#include "hardware/adc.h"
+#include "hardware/clocks.h"
+#include "b64/cencode.h"
+#include "b64/cdecode.h"
+#include "pico_sensor_lib.h"
+
+#include "fanpico.h"
+#include "square_wave_gen.h"
+#include "tacho_capture.h"
+#include "fake_hal.h"
+
+
+#define FAKE_GPIO_COUNT  32
+#define FAKE_SM_COUNT    8
+#define FAKE_MUX_PORTS   8
+#define FAKE_CAPTURE_LEN 256  /* edges buffered between tacho_capture_read() calls */
+#define TIGHT_LOOP_NS    8   /* one iteration of a busy-wait loop */
+
+struct fake_gpio {
+	bool level;
+	bool out;
+	uint32_t irq_events;
+	double freq;             /* input square wave frequency (Hz) */
+	uint64_t next_edge;      /* time of next rising edge (ns) */
+	uint32_t edges;          /* rising edges so far */
+};
+
+struct fake_pwm_slice {
+	bool enabled;
+	bool phase_correct;
+	enum pwm_clkdiv_mode mode;
+	float div;
+	uint16_t wrap;
+	uint16_t level[2];
+	uint64_t t_base;         /* time counter was last set (ns) */
+	double count_base;       /* counter value at t_base */
+	double in_duty;          /* input signal on B pin (%) */
+	double in_freq;          /* input signal frequency (Hz) */
+	uint64_t irq_period;     /* counter period when wrap IRQ was cleared */
+};
+
+static uint64_t now_ns = 0;
+static struct fake_gpio gpios[FAKE_GPIO_COUNT];
+static gpio_irq_callback_t gpio_callback = NULL;
+static struct fake_pwm_slice slices[NUM_PWM_SLICES];
+static pwm_hw_t fake_pwm_hw;
+pwm_hw_t *pwm_hw = &fake_pwm_hw;
+struct fake_pio fake_pio_inst[2] = { { 0, 0 }, { 1, 0 } };
+static float adc_value[NUM_ADC_CHANNELS];
+static uint adc_input = 0;
+static bool adc_sampler_running = false;
+static double sm_freq[FAKE_SM_COUNT];
+static double mux_freq[FAKE_MUX_PORTS];
+static int8_t capture_input[FAKE_GPIO_COUNT];
+static bool capture_running = false;
+static struct fake_edge {
+	uint input;
+	uint64_t t;
+} capture_edges[FAKE_CAPTURE_LEN];
+static uint capture_count = 0;
+static bool capture_lost = false;
+int fake_log_level = LOG_WARNING;
+
+
+void fake_hal_reset()
+{
+	now_ns = 0;
+	memset(gpios, 0, sizeof(gpios));
+	gpio_callback = NULL;
+	memset(slices, 0, sizeof(slices));
+	memset(&fake_pwm_hw, 0, sizeof(fake_pwm_hw));
+	memset(adc_value, 0, sizeof(adc_value));
+	adc_input = 0;
+	adc_sampler_running = false;
+	memset(sm_freq, 0, sizeof(sm_freq));
+	memset(mux_freq, 0, sizeof(mux_freq));
+	fake_pio_inst[0].sm_claimed = 0;
+	fake_pio_inst[1].sm_claimed = 0;
+	memset(capture_input, -1, sizeof(capture_input));
+	capture_running = false;
+	capture_count = 0;
+	capture_lost = false;
+}
+
+
+/* Time */
+
+uint64_t fake_time_ns()
+{
+	return now_ns;
+}
+
+void fake_time_advance_ns(uint64_t ns)
+{
+	now_ns += ns;
+}
+
+uint64_t time_us_64()
+{
+	return now_ns / 1000;
+}
+
+uint32_t time_us_32()
+{
+	return now_ns / 1000;
+}
+
+absolute_time_t get_absolute_time()
+{
+	return from_us_since_boot(time_us_64());
+}
+
+void busy_wait_us(uint64_t us)
+{
+	fake_run_until_us(time_us_64() + us);
+}
+
+void busy_wait_ms(uint32_t ms)
+{
+	busy_wait_us((uint64_t)ms * 1000);
+}
+
+void sleep_ms(uint32_t ms)
+{
+	busy_wait_us((uint64_t)ms * 1000);
+}
+
+static void pwm_update_irqs();
+
+void tight_loop_contents()
+{
+	now_ns += TIGHT_LOOP_NS;
+	pwm_update_irqs();
+}
+
+
+/* Advance time to 't' (us), delivering GPIO interrupts (in order)
+ * for all input edges occurring before that (edges on pins captured
+ * by tacho_capture are buffered for tacho_capture_read()).
+ */
+void fake_run_until_us(uint64_t t)
+{
+	uint64_t end = t * 1000;
+
+	while (1) {
+		struct fake_gpio *g = NULL;
+		uint pin = 0;
+
+		for (uint i = 0; i < FAKE_GPIO_COUNT; i++) {
+			if (gpios[i].freq > 0 && gpios[i].next_edge <= end
+				&& (!g || gpios[i].next_edge < g->next_edge)) {
+				g = &gpios[i];
+				pin = i;
+			}
+		}
+		if (!g)
+			break;
+
+		if (g->next_edge > now_ns)
+			now_ns = g->next_edge;
+		g->edges++;
+		g->next_edge += 1e9 / g->freq;
+		if ((g->irq_events & GPIO_IRQ_EDGE_RISE) && gpio_callback)
+			gpio_callback(pin, GPIO_IRQ_EDGE_RISE);
+		if (capture_running && capture_input[pin] >= 0) {
+			if (capture_count < FAKE_CAPTURE_LEN) {
+				capture_edges[capture_count].input = capture_input[pin];
+				capture_edges[capture_count].t = now_ns / 1000;
+				capture_count++;
+			} else {
+				capture_lost = true;
+			}
+		}
+	}
+	if (end > now_ns)
+		now_ns = end;
+}
+
+
+/* GPIO */
+
+void fake_gpio_set_freq(uint gpio, double freq)
+{
+	struct fake_gpio *g;
+
+	if (gpio >= FAKE_GPIO_COUNT)
+		return;
+	g = &gpios[gpio];
+
+	if (freq > 0) {
+		/* Keep phase continuous when frequency changes */
+		uint64_t next = (g->freq > 0 ? g->next_edge - 1e9 / g->freq : now_ns) + 1e9 / freq;
+		g->next_edge = (next > now_ns ? next : now_ns);
+	}
+	g->freq = freq;
+}
+
+void fake_gpio_set_level(uint gpio, bool level)
+{
+	if (gpio < FAKE_GPIO_COUNT)
+		gpios[gpio].level = level;
+}
+
+bool fake_gpio_level(uint gpio)
+{
+	return (gpio < FAKE_GPIO_COUNT ? gpios[gpio].level : false);
+}
+
+uint32_t fake_gpio_edge_count(uint gpio)
+{
+	return (gpio < FAKE_GPIO_COUNT ? gpios[gpio].edges : 0);
+}
+
+void gpio_init(uint gpio)
+{
+	if (gpio < FAKE_GPIO_COUNT) {
+		gpios[gpio].out = false;
+		gpios[gpio].level = false;
+		gpios[gpio].irq_events = 0;
+	}
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{
+	if (gpio < FAKE_GPIO_COUNT)
+		gpios[gpio].out = out;
+}
+
+/* Tacho signal multiplexer: input port selected using S0-S2 pins
+ * is connected to FAN_TACHO_READ_PIN.
+ */
+static void mux_update()
+{
+#if TACHO_READ_MULTIPLEX > 0
+	uint port = (gpios[FAN_TACHO_READ_S0_PIN].level ? 0x01 : 0)
+		| (gpios[FAN_TACHO_READ_S1_PIN].level ? 0x02 : 0)
+		| (gpios[FAN_TACHO_READ_S2_PIN].level ? 0x04 : 0);
+
+	fake_gpio_set_freq(FAN_TACHO_READ_PIN, mux_freq[port]);
+#endif
+}
+
+void fake_mux_set_freq(uint port, double freq)
+{
+	if (port < FAKE_MUX_PORTS) {
+		mux_freq[port] = freq;
+		mux_update();
+	}
+}
+
+void gpio_put(uint gpio, bool value)
+{
+	if (gpio >= FAKE_GPIO_COUNT)
+		return;
+	gpios[gpio].level = value;
+#if TACHO_READ_MULTIPLEX > 0
+	if (gpio == FAN_TACHO_READ_S0_PIN || gpio == FAN_TACHO_READ_S1_PIN
+		|| gpio == FAN_TACHO_READ_S2_PIN)
+		mux_update();
+#endif
+}
+
+bool gpio_get(uint gpio)
+{
+	return fake_gpio_level(gpio);
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn)
+{
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled)
+{
+	if (gpio >= FAKE_GPIO_COUNT)
+		return;
+	if (enabled)
+		gpios[gpio].irq_events |= events;
+	else
+		gpios[gpio].irq_events &= ~events;
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled,
+					gpio_irq_callback_t callback)
+{
+	gpio_callback = callback;
+	gpio_set_irq_enabled(gpio, events, enabled);
+}
+
+
+/* PWM */
+
+/* Time input signal has been high during [0, t] */
+static double input_high_time(const struct fake_pwm_slice *s, double t)
+{
+	double period = 1.0 / s->in_freq;
+	double high = period * s->in_duty / 100.0;
+
+	return floor(t / period) * high + fmin(fmod(t, period), high);
+}
+
+/* Counter value (not wrapped at 16 bits) at current time */
+static double pwm_count(const struct fake_pwm_slice *s)
+{
+	double t0 = s->t_base / 1e9;
+	double t1 = now_ns / 1e9;
+	double rate = FAKE_SYS_CLOCK_HZ / s->div;
+
+	if (!s->enabled)
+		return s->count_base;
+
+	switch (s->mode) {
+	case PWM_DIV_B_HIGH:
+		if (s->in_freq <= 0)
+			return s->count_base + (s->in_duty >= 100.0 ? (t1 - t0) * rate : 0);
+		return s->count_base + (input_high_time(s, t1) - input_high_time(s, t0)) * rate;
+	case PWM_DIV_B_RISING:
+		if (s->in_freq <= 0)
+			return s->count_base;
+		return s->count_base + (floor(t1 * s->in_freq) - floor(t0 * s->in_freq)) / s->div;
+	default:
+		return s->count_base + (t1 - t0) * rate;
+	}
+}
+
+static void pwm_rebase(struct fake_pwm_slice *s)
+{
+	s->count_base = pwm_count(s);
+	s->t_base = now_ns;
+}
+
+void pwm_init(uint slice_num, pwm_config *c, bool start)
+{
+	struct fake_pwm_slice *s = &slices[slice_num];
+
+	s->phase_correct = c->phase_correct;
+	s->mode = c->mode;
+	s->div = c->div;
+	s->wrap = c->wrap;
+	s->level[0] = s->level[1] = 0;
+	s->count_base = 0;
+	s->t_base = now_ns;
+	pwm_set_enabled(slice_num, start);
+}
+
+void pwm_set_enabled(uint slice_num, bool enabled)
+{
+	struct fake_pwm_slice *s = &slices[slice_num];
+
+	pwm_rebase(s);
+	s->enabled = enabled;
+	if (enabled)
+		pwm_hw->en |= (1u << slice_num);
+	else
+		pwm_hw->en &= ~(1u << slice_num);
+}
+
+void pwm_set_mask_enabled(uint32_t mask)
+{
+	for (uint i = 0; i < NUM_PWM_SLICES; i++)
+		pwm_set_enabled(i, (mask & (1u << i)) ? true : false);
+}
+
+void pwm_set_clkdiv_mode(uint slice_num, enum pwm_clkdiv_mode mode)
+{
+	pwm_rebase(&slices[slice_num]);
+	slices[slice_num].mode = mode;
+}
+
+void pwm_set_clkdiv(uint slice_num, float div)
+{
+	pwm_rebase(&slices[slice_num]);
+	slices[slice_num].div = div;
+}
+
+void pwm_set_counter(uint slice_num, uint16_t c)
+{
+	slices[slice_num].count_base = c;
+	slices[slice_num].t_base = now_ns;
+}
+
+uint16_t pwm_get_counter(uint slice_num)
+{
+	const struct fake_pwm_slice *s = &slices[slice_num];
+	uint64_t count = pwm_count(s);
+
+	if (s->mode == PWM_DIV_FREE_RUNNING) {
+		/* Counter wraps at 'wrap', phase correct counter counts up and down */
+		uint64_t top = (uint64_t)s->wrap + 1;
+
+		if (!s->phase_correct)
+			return count % top;
+		count %= 2 * top;
+		return (count < top ? count : 2 * top - 1 - count);
+	}
+	return (uint16_t)count;
+}
+
+/* Number of full counter periods (wraps) so far */
+static uint64_t pwm_periods(const struct fake_pwm_slice *s)
+{
+	uint64_t top = (uint64_t)s->wrap + 1;
+
+	return (uint64_t)pwm_count(s) / (s->phase_correct ? 2 * top : top);
+}
+
+/* Set (raw) wrap interrupt flags of slices that have wrapped since
+ * their flag was last cleared. */
+static void pwm_update_irqs()
+{
+	for (uint i = 0; i < NUM_PWM_SLICES; i++) {
+		const struct fake_pwm_slice *s = &slices[i];
+
+		if (s->enabled && s->mode == PWM_DIV_FREE_RUNNING
+			&& pwm_periods(s) > s->irq_period)
+			pwm_hw->intr |= (1u << i);
+	}
+}
+
+void pwm_clear_irq(uint slice_num)
+{
+	slices[slice_num].irq_period = pwm_periods(&slices[slice_num]);
+	pwm_hw->intr &= ~(1u << slice_num);
+}
+
+void pwm_set_both_levels(uint slice_num, uint16_t level_a, uint16_t level_b)
+{
+	slices[slice_num].level[0] = level_a;
+	slices[slice_num].level[1] = level_b;
+}
+
+void pwm_set_gpio_level(uint gpio, uint16_t level)
+{
+	slices[pwm_gpio_to_slice_num(gpio)].level[pwm_gpio_to_channel(gpio)] = level;
+}
+
+void fake_pwm_set_input(uint gpio, double duty, double freq)
+{
+	struct fake_pwm_slice *s = &slices[pwm_gpio_to_slice_num(gpio)];
+
+	pwm_rebase(s);
+	s->in_duty = duty;
+	s->in_freq = freq;
+}
+
+double fake_pwm_output_duty(uint gpio)
+{
+	const struct fake_pwm_slice *s = &slices[pwm_gpio_to_slice_num(gpio)];
+
+	return s->level[pwm_gpio_to_channel(gpio)] * 100.0 / (s->wrap + 1);
+}
+
+
+/* ADC */
+
+void fake_adc_set(uint input, float raw)
+{
+	if (input < NUM_ADC_CHANNELS)
+		adc_value[input] = raw;
+}
+
+void adc_select_input(uint input)
+{
+	adc_input = input;
+}
+
+uint16_t adc_read()
+{
+	return (adc_input < NUM_ADC_CHANNELS ? lroundf(adc_value[adc_input]) : 0);
+}
+
+
+/*
+ * Stand-ins for firmware modules that drive hardware not simulated
+ * here (PIO programs, 1-Wire).
+ */
+
+/* adc_sampler.c: averaged reading is the current simulated value */
+bool adc_sampler_start(uint count)
+{
+	adc_sampler_running = (count > 0);
+	return adc_sampler_running;
+}
+
+void adc_sampler_stop()
+{
+	adc_sampler_running = false;
+}
+
+bool adc_sampler_warming_up()
+{
+	return false;
+}
+
+bool adc_sampler_read(uint input, float *value)
+{
+	if (!adc_sampler_running || input >= NUM_ADC_CHANNELS)
+		return false;
+	*value = adc_value[input];
+	return true;
+}
+
+/* square_wave_gen.c: remember output frequency of each state machine */
+uint square_wave_gen_load_program(PIO pio)
+{
+	return 0;
+}
+
+void square_wave_gen_program_init(PIO pio, uint sm, uint offset, uint pin)
+{
+}
+
+void square_wave_gen_enabled(PIO pio, uint sm, bool enabled)
+{
+}
+
+void square_wave_gen_set_period(PIO pio, uint sm, uint32_t period)
+{
+	if (sm < FAKE_SM_COUNT && period == 0)
+		sm_freq[sm] = 0;
+}
+
+void square_wave_gen_set_freq(PIO pio, uint sm, double freq)
+{
+	if (sm < FAKE_SM_COUNT)
+		sm_freq[sm] = freq;
+}
+
+double fake_square_wave_freq(uint sm)
+{
+	return (sm < FAKE_SM_COUNT ? sm_freq[sm] : 0);
+}
+
+/* tacho_capture.c: edges on captured pins (with exact timestamps) */
+bool tacho_capture_start(const uint8_t *pins, uint count)
+{
+	if (count < 1 || count > TACHO_CAPTURE_MAX_INPUTS || capture_running)
+		return false;
+	for (uint i = 0; i < count; i++) {
+		if (pins[i] < FAKE_GPIO_COUNT)
+			capture_input[pins[i]] = i;
+	}
+	capture_running = true;
+	return true;
+}
+
+int tacho_capture_read(tacho_capture_edge_func_t *func, void *ctx)
+{
+	int edges = capture_count;
+
+	if (capture_lost) {
+		capture_count = 0;
+		capture_lost = false;
+		return -1;
+	}
+	for (uint i = 0; i < capture_count; i++)
+		func(capture_edges[i].input, capture_edges[i].t, ctx);
+	capture_count = 0;
+
+	return edges;
+}
+
+bool tacho_capture_info(uint *pio, uint *sm)
+{
+	if (!capture_running)
+		return false;
+	*pio = 1;
+	*sm = 0;
+	return true;
+}
+
+/* onewire.c: no 1-Wire sensors */
+uint64_t onewire_address(uint sensor)
+{
+	return 0;
+}
+
+/* util_rp2.c */
+int time_passed(absolute_time_t *t, uint32_t ms)
+{
+	absolute_time_t t_now = get_absolute_time();
+
+	if (t == NULL)
+		return -1;
+
+	if (to_us_since_boot(*t) == 0 ||
+	    to_us_since_boot(delayed_by_ms(*t, ms)) < to_us_since_boot(t_now)) {
+		*t = t_now;
+		return 1;
+	}
+
+	return 0;
+}
+
+/* log.c */
+void log_msg(int priority, const char *format, ...)
+{
+	va_list ap;
+
+	if (priority > fake_log_level)
+		return;
+
+	fprintf(stderr, "[%10.3f] ", now_ns / 1e9);
+	va_start(ap, format);
+	vfprintf(stderr, format, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+}
+
+/* Levels set from configuration are only stored (log_msg() uses fake_log_level) */
+static int debug_level = 0;
+static int log_level = LOG_NOTICE;
+static int syslog_level = LOG_ERR;
+
+int get_debug_level()
+{
+	return debug_level;
+}
+
+void set_debug_level(int level)
+{
+	debug_level = level;
+}
+
+int get_log_level()
+{
+	return log_level;
+}
+
+void set_log_level(int level)
+{
+	log_level = level;
+}
+
+int get_syslog_level()
+{
+	return syslog_level;
+}
+
+void set_syslog_level(int level)
+{
+	syslog_level = level;
+}
+
+void panic(const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "panic: ");
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	abort();
+}
+
+/* pico-sensor-lib (I2C sensors are not simulated) */
+int get_i2c_sensor_type(const char *name)
+{
+	return 0;
+}
+
+const char* i2c_sensor_type_str(int type)
+{
+	return "NONE";
+}
+
+/* Console input (there is no console) */
+int getstring_timeout_ms(char *str, uint32_t maxlen, uint32_t timeout)
+{
+	return -1;
+}
+
+/* libb64 (used by base64 helpers in util.c) */
+static void b64_missing()
+{
+	fprintf(stderr, "base64 functions not available in host build\n");
+	abort();
+}
+
+void base64_init_encodestate(base64_encodestate *state_in)
+{
+	b64_missing();
+}
+
+size_t base64_encode_length(size_t plain_len, base64_encodestate *state_in)
+{
+	b64_missing();
+	return 0;
+}
+
+size_t base64_encode_block(const void *plaintext_in, const size_t length_in,
+			char *code_out, base64_encodestate *state_in)
+{
+	b64_missing();
+	return 0;
+}
+
+size_t base64_encode_blockend(char *code_out, base64_encodestate *state_in)
+{
+	b64_missing();
+	return 0;
+}
+
+void base64_init_decodestate(base64_decodestate *state_in)
+{
+	b64_missing();
+}
+
+size_t base64_decode_maxlength(size_t encode_len)
+{
+	b64_missing();
+	return 0;
+}
+
+size_t base64_decode_block(const char *code_in, const size_t length_in,
+			void *plaintext_out, base64_decodestate *state_in)
+{
+	b64_missing();
+	return 0;
+}
+
+
+/* eof :-) */
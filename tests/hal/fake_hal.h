@@ -0,0 +1,64 @@
+/* fake_hal.h
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FAKE_HAL_H
+#define FAKE_HAL_H 1
+
+#include "pico/stdlib.h"
+
+/*
+ * Fake hardware for running FanPico control code on a host.
+ *
+ * Time is simulated (with nanosecond resolution) and only advances
+ * when explicitly advanced (or when code busy waits). Input signals
+ * are described by their parameters (frequency and duty cycle), and
+ * GPIO edges and PWM slice counters are derived from those as
+ * simulated time advances.
+ */
+
+void fake_hal_reset();
+uint64_t fake_time_ns();
+void fake_time_advance_ns(uint64_t ns);
+void fake_run_until_us(uint64_t t);
+
+/* GPIO inputs: square wave (rising edge interrupts) or static level */
+void fake_gpio_set_freq(uint gpio, double freq);
+void fake_gpio_set_level(uint gpio, bool level);
+bool fake_gpio_level(uint gpio);
+uint32_t fake_gpio_edge_count(uint gpio);
+
+/* Tacho signal multiplexer inputs (boards with TACHO_READ_MULTIPLEX) */
+void fake_mux_set_freq(uint port, double freq);
+
+/* PWM slices: input signal on B pin of a slice, output duty cycle */
+void fake_pwm_set_input(uint gpio, double duty, double freq);
+double fake_pwm_output_duty(uint gpio);
+
+/* ADC inputs (raw 12bit value, may be fractional for averaged reads) */
+void fake_adc_set(uint input, float raw);
+
+/* Tacho outputs generated by square_wave_gen (PIO) */
+double fake_square_wave_freq(uint sm);
+
+/* Log messages with priority up to this are printed (to stderr) */
+extern int fake_log_level;
+
+#endif /* FAKE_HAL_H */
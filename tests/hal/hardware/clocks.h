@@ -0,0 +1,38 @@
+/* hardware/clocks.h
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FAKE_HARDWARE_CLOCKS_H
+#define FAKE_HARDWARE_CLOCKS_H 1
+
+#include "pico/stdlib.h"
+
+#define FAKE_SYS_CLOCK_HZ 125000000
+
+enum clock_index {
+	clk_sys = 5,
+};
+
+static inline uint32_t clock_get_hz(enum clock_index clk)
+{
+	return FAKE_SYS_CLOCK_HZ;
+}
+
+#endif /* FAKE_HARDWARE_CLOCKS_H */
@@ -0,0 +1,57 @@
+/* hardware/gpio.h
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FAKE_HARDWARE_GPIO_H
+#define FAKE_HARDWARE_GPIO_H 1
+
+#include "pico/stdlib.h"
+
+#define NUM_BANK0_GPIOS 30
+
+#define GPIO_IN  false
+#define GPIO_OUT true
+
+enum gpio_function {
+	GPIO_FUNC_PWM  = 4,
+	GPIO_FUNC_SIO  = 5,
+	GPIO_FUNC_PIO0 = 6,
+	GPIO_FUNC_NULL = 0x1f,
+};
+
+enum gpio_irq_level {
+	GPIO_IRQ_LEVEL_LOW  = 0x1u,
+	GPIO_IRQ_LEVEL_HIGH = 0x2u,
+	GPIO_IRQ_EDGE_FALL  = 0x4u,
+	GPIO_IRQ_EDGE_RISE  = 0x8u,
+};
+
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled);
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled,
+					gpio_irq_callback_t callback);
+
+#endif /* FAKE_HARDWARE_GPIO_H */
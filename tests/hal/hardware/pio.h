@@ -0,0 +1,50 @@
+/* hardware/pio.h
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FAKE_HARDWARE_PIO_H
+#define FAKE_HARDWARE_PIO_H 1
+
+#include "pico/stdlib.h"
+
+/* PIO programs are not simulated, only state machine bookkeeping
+ * (see square_wave_gen and tacho_capture stand-ins in fake_hal.c).
+ */
+typedef struct fake_pio {
+	uint index;
+	uint32_t sm_claimed;
+} *PIO;
+
+extern struct fake_pio fake_pio_inst[2];
+
+#define pio0 (&fake_pio_inst[0])
+#define pio1 (&fake_pio_inst[1])
+
+static inline uint pio_get_index(PIO pio)
+{
+	return pio->index;
+}
+
+static inline void pio_sm_claim(PIO pio, uint sm)
+{
+	pio->sm_claimed |= (1u << sm);
+}
+
+#endif /* FAKE_HARDWARE_PIO_H */
@@ -0,0 +1,103 @@
+/* hardware/pwm.h
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FAKE_HARDWARE_PWM_H
+#define FAKE_HARDWARE_PWM_H 1
+
+#include "pico/stdlib.h"
+
+#define NUM_PWM_SLICES 8
+
+enum pwm_clkdiv_mode {
+	PWM_DIV_FREE_RUNNING = 0,
+	PWM_DIV_B_HIGH       = 1,
+	PWM_DIV_B_RISING     = 2,
+	PWM_DIV_B_FALLING    = 3,
+};
+
+enum pwm_chan {
+	PWM_CHAN_A = 0,
+	PWM_CHAN_B = 1,
+};
+
+typedef struct {
+	bool phase_correct;
+	enum pwm_clkdiv_mode mode;
+	float div;
+	uint16_t wrap;
+} pwm_config;
+
+typedef struct {
+	uint32_t en;
+	uint32_t intr;
+} pwm_hw_t;
+
+extern pwm_hw_t *pwm_hw;
+
+static inline uint pwm_gpio_to_slice_num(uint gpio)
+{
+	return (gpio >> 1) & 7;
+}
+
+static inline uint pwm_gpio_to_channel(uint gpio)
+{
+	return gpio & 1;
+}
+
+static inline pwm_config pwm_get_default_config()
+{
+	pwm_config c = { false, PWM_DIV_FREE_RUNNING, 1.0, 0xffff };
+
+	return c;
+}
+
+static inline void pwm_config_set_phase_correct(pwm_config *c, bool phase_correct)
+{
+	c->phase_correct = phase_correct;
+}
+
+static inline void pwm_config_set_clkdiv(pwm_config *c, float div)
+{
+	c->div = div;
+}
+
+static inline void pwm_config_set_clkdiv_mode(pwm_config *c, enum pwm_clkdiv_mode mode)
+{
+	c->mode = mode;
+}
+
+static inline void pwm_config_set_wrap(pwm_config *c, uint16_t wrap)
+{
+	c->wrap = wrap;
+}
+
+void pwm_init(uint slice_num, pwm_config *c, bool start);
+void pwm_set_enabled(uint slice_num, bool enabled);
+void pwm_set_mask_enabled(uint32_t mask);
+void pwm_set_clkdiv_mode(uint slice_num, enum pwm_clkdiv_mode mode);
+void pwm_set_clkdiv(uint slice_num, float div);
+void pwm_set_counter(uint slice_num, uint16_t c);
+uint16_t pwm_get_counter(uint slice_num);
+void pwm_set_both_levels(uint slice_num, uint16_t level_a, uint16_t level_b);
+void pwm_set_gpio_level(uint gpio, uint16_t level);
+void pwm_clear_irq(uint slice_num);
+
+#endif /* FAKE_HARDWARE_PWM_H */
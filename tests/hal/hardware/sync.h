@@ -0,0 +1,42 @@
+/* hardware/sync.h
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FAKE_HARDWARE_SYNC_H
+#define FAKE_HARDWARE_SYNC_H 1
+
+#include "pico/stdlib.h"
+
+/* Full memory barrier (DMB on Cortex-M) */
+#define __dmb() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+/* Simulated interrupts (GPIO edges) are only delivered between
+ * task runs, so there is nothing to disable.
+ */
+static inline uint32_t save_and_disable_interrupts()
+{
+	return 0;
+}
+
+static inline void restore_interrupts(uint32_t status)
+{
+}
+
+#endif /* FAKE_HARDWARE_SYNC_H */
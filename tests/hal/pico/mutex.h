@@ -0,0 +1,44 @@
+/* pico/mutex.h
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FAKE_PICO_MUTEX_H
+#define FAKE_PICO_MUTEX_H 1
+
+#include "pico/stdlib.h"
+
+/* Host builds are single threaded (mutexes are no-ops). */
+typedef struct mutex {
+	int owner;
+} mutex_t;
+
+#define auto_init_mutex(name) static mutex_t name
+
+static inline void mutex_enter_blocking(mutex_t *mtx)
+{
+	mtx->owner++;
+}
+
+static inline void mutex_exit(mutex_t *mtx)
+{
+	mtx->owner--;
+}
+
+#endif /* FAKE_PICO_MUTEX_H */
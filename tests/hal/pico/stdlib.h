@@ -0,0 +1,76 @@
+/* pico/stdlib.h
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Minimal stand-in for Pico SDK headers, for building FanPico
+ * modules on a (Linux) host. Time is simulated (see fake_hal.c).
+ */
+
+#ifndef FAKE_PICO_STDLIB_H
+#define FAKE_PICO_STDLIB_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <assert.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+#define PICO_ERROR_TIMEOUT -1
+
+#define __time_critical_func(f) f
+#define __not_in_flash_func(f) f
+
+void panic(const char *fmt, ...);
+uint64_t time_us_64();
+uint32_t time_us_32();
+absolute_time_t get_absolute_time();
+void busy_wait_us(uint64_t us);
+void busy_wait_ms(uint32_t ms);
+void sleep_ms(uint32_t ms);
+void tight_loop_contents();
+
+static inline uint64_t to_us_since_boot(absolute_time_t t)
+{
+	return t;
+}
+
+static inline absolute_time_t from_us_since_boot(uint64_t us)
+{
+	return us;
+}
+
+static inline absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms)
+{
+	return t + (uint64_t)ms * 1000;
+}
+
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to)
+{
+	return (int64_t)(to - from);
+}
+
+static inline void update_us_since_boot(absolute_time_t *t, uint64_t us)
+{
+	*t = us;
+}
+
+#endif /* FAKE_PICO_STDLIB_H */
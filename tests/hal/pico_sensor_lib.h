@@ -0,0 +1,31 @@
+/* pico_sensor_lib.h
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FAKE_PICO_SENSOR_LIB_H
+#define FAKE_PICO_SENSOR_LIB_H 1
+
+/* I2C sensors are not simulated (only sensor type names are needed
+ * for parsing configuration). */
+
+int get_i2c_sensor_type(const char *name);
+const char* i2c_sensor_type_str(int type);
+
+#endif /* FAKE_PICO_SENSOR_LIB_H */
@@ -0,0 +1,491 @@
+/* fanpico_sim.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "fanpico.h"
+#include "fake_hal.h"
+#include "test_util.h"
+
+
+/*
+ * Host simulation of FanPico control loop (core1).
+ *
+ * Runs the control loop tasks (using the firmware scheduler) on top of
+ * fake hardware (see fake_hal.c) with simulated time. Input signals are
+ * replayed from a CSV trace and resulting outputs (as seen on fake
+ * PWM slices and tacho generators) are written out as CSV.
+ *
+ * Trace format (first line is header, values are held until next row,
+ * empty value keeps previous value, last row marks end of the trace):
+ *
+ *   time_ms,sensor1,mbfan1,fan1,...
+ *
+ *   sensorN   temperature (C) seen by sensor
+ *   vsensorN  temperature (C) written to (manual) virtual sensor
+ *   mbfanN    duty cycle (%) of PWM signal from motherboard
+ *   fanN      fan speed (RPM)
+ *
+ * Output format (one row per output interval):
+ *
+ *   time_ms,fan1_duty,...,mbfan1_rpm,...[,fan1_status,...]
+ *
+ * Fan status (fan monitor) columns are included only with option -s.
+ *
+ * Configuration file is a (saved) JSON configuration, same as
+ * on the board (see sim_example.json). It is loaded using read_config()
+ * in config.c, so without configuration file the board default
+ * configuration (boards/<board>.json) is used.
+ */
+
+#define SIM_PWM_IN_FREQ  25000  /* Hz, frequency of motherboard PWM signals */
+#define SIM_MAX_COLUMNS  64
+
+extern uint8_t fan_gpio_pwm_map[FAN_MAX_COUNT];
+extern uint8_t mbfan_gpio_pwm_map[MBFAN_MAX_COUNT];
+extern uint8_t fan_gpio_tacho_map[FAN_MAX_COUNT];
+
+static struct fanpico_control_config ctrl_config;
+static struct fanpico_state ctrl_state;
+static struct control_context ctrl_ctx;
+static scheduler_t sched;
+static bool print_status = false;
+
+/* Control loop tasks, same periods as core1 tasks in fanpico.c
+ * (tasks that only deal with hardware not simulated are left out).
+ */
+static const struct sched_task sim_tasks[] = {
+	/* name,         core, period, func */
+	{ "tacho_read",     1,   10, control_read_tacho_task, &ctrl_ctx },
+	{ "pwm_read",       1,   10, control_read_pwm_task, &ctrl_ctx },
+	{ "tacho_freq",     1,  250, control_tacho_freq_task, &ctrl_ctx },
+	{ "temp",           1,  250, control_temp_task, &ctrl_ctx },
+	{ "outputs",        1,  500, control_outputs_task, &ctrl_ctx },
+	{ "pwm_out",        1,   20, control_pwm_out_task, &ctrl_ctx },
+	{ "fan_monitor",    1,   20, control_fan_monitor_task, &ctrl_ctx },
+};
+#define SIM_TASK_COUNT (sizeof(sim_tasks) / sizeof(sim_tasks[0]))
+
+enum column_types {
+	COL_SENSOR,
+	COL_VSENSOR,
+	COL_MBFAN,
+	COL_FAN,
+};
+
+struct trace_column {
+	enum column_types type;
+	uint idx;
+};
+
+struct trace {
+	FILE *fp;
+	uint columns;
+	struct trace_column col[SIM_MAX_COLUMNS];
+	uint line;
+	uint64_t t;                     /* time of next row (ms) */
+	char *value[SIM_MAX_COLUMNS];   /* values of next row */
+	char buf[4096];
+};
+
+
+/* Configuration "stored in flash" (config.c reads it as fanpico.cfg) */
+static const char *sim_config_file = NULL;
+
+
+int flash_read_file(char **bufptr, uint32_t *sizeptr, const char *filename)
+{
+	FILE *fp;
+	long size;
+	char *buf;
+
+	*bufptr = NULL;
+	*sizeptr = 0;
+	if (!sim_config_file || strcmp(filename, "fanpico.cfg"))
+		return -2;
+
+	if (!(fp = fopen(sim_config_file, "r"))) {
+		fprintf(stderr, "%s: cannot open file\n", sim_config_file);
+		return -1;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	rewind(fp);
+	if (size < 0 || !(buf = malloc(size + 1))) {
+		fclose(fp);
+		return -3;
+	}
+	if (fread(buf, 1, size, fp) != size) {
+		fclose(fp);
+		free(buf);
+		return -1;
+	}
+	buf[size] = 0;
+	fclose(fp);
+
+	*bufptr = buf;
+	*sizeptr = size;
+	return 0;
+}
+
+int flash_write_file(const char *buf, uint32_t size, const char *filename)
+{
+	return -1;
+}
+
+int flash_delete_file(const char *filename)
+{
+	return -1;
+}
+
+
+/* Simulated sensor input: raw ADC reading for given temperature */
+static float temp_to_adc(const struct sensor_input *s, float adc_vref, double temp)
+{
+	double volt, r, raw;
+
+	if (s->type == TEMP_INTERNAL) {
+		volt = 0.706 - (temp - 27.0) * 0.001721;
+		raw = volt / adc_vref * ADC_MAX_VALUE;
+	} else {
+		r = s->thermistor_nominal * exp(s->beta_coefficient
+			* (1.0 / (temp + 273.15) - 1.0 / (s->temp_nominal + 273.15)));
+		raw = ADC_MAX_VALUE * r / (r + SENSOR_SERIES_RESISTANCE);
+	}
+
+	return fmin(fmax(raw, 0), ADC_MAX_VALUE - 1);
+}
+
+
+static void apply_input(enum column_types type, uint i, double val)
+{
+	const struct fanpico_config *c = cfg;
+
+	switch (type) {
+	case COL_SENSOR:
+		fake_adc_set(sensor_adc_map[i], temp_to_adc(&c->sensors[i], c->adc_vref, val));
+		break;
+	case COL_VSENSOR:
+		/* Same as WRITE:VSENSORx command (and sync to core1) */
+		ctrl_config.vtemp[i] = val;
+		ctrl_config.vtemp_updated[i] = get_absolute_time();
+		break;
+	case COL_MBFAN:
+		fake_pwm_set_input(mbfan_gpio_pwm_map[i], val, SIM_PWM_IN_FREQ);
+		break;
+	case COL_FAN:
+#if TACHO_READ_MULTIPLEX > 0
+		fake_mux_set_freq(fan_gpio_tacho_map[i], val * c->fans[i].rpm_factor / 60.0);
+#else
+		fake_gpio_set_freq(fan_gpio_tacho_map[i], val * c->fans[i].rpm_factor / 60.0);
+#endif
+		break;
+	}
+}
+
+
+static int split_csv(char *line, char **fields, int max)
+{
+	int count = 0;
+	char *s = line;
+
+	line[strcspn(line, "\r\n")] = 0;
+	while (count < max) {
+		char *comma = strchr(s, ',');
+
+		fields[count++] = trim_str(s);
+		if (!comma)
+			break;
+		*comma = 0;
+		s = comma + 1;
+	}
+	return count;
+}
+
+
+static int trace_open(struct trace *tr, const char *filename)
+{
+	char *fields[SIM_MAX_COLUMNS + 1];
+	int count;
+
+	memset(tr, 0, sizeof(*tr));
+	if (!(tr->fp = fopen(filename, "r"))) {
+		fprintf(stderr, "%s: cannot open file\n", filename);
+		return -1;
+	}
+	if (!fgets(tr->buf, sizeof(tr->buf), tr->fp))
+		return -1;
+	tr->line = 1;
+	count = split_csv(tr->buf, fields, SIM_MAX_COLUMNS + 1);
+	if (count < 2 || strcmp(fields[0], "time_ms")) {
+		fprintf(stderr, "%s: invalid header (first column must be time_ms)\n", filename);
+		return -1;
+	}
+	tr->columns = count - 1;
+	for (int i = 1; i < count; i++) {
+		struct trace_column *col = &tr->col[i - 1];
+		uint n = 0;
+
+		if (sscanf(fields[i], "sensor%u", &n) == 1 && n >= 1 && n <= SENSOR_COUNT)
+			col->type = COL_SENSOR;
+		else if (sscanf(fields[i], "vsensor%u", &n) == 1 && n >= 1 && n <= VSENSOR_COUNT)
+			col->type = COL_VSENSOR;
+		else if (sscanf(fields[i], "mbfan%u", &n) == 1 && n >= 1 && n <= MBFAN_COUNT)
+			col->type = COL_MBFAN;
+		else if (sscanf(fields[i], "fan%u", &n) == 1 && n >= 1 && n <= FAN_COUNT)
+			col->type = COL_FAN;
+		else {
+			fprintf(stderr, "%s: unknown column: %s\n", filename, fields[i]);
+			return -1;
+		}
+		col->idx = n - 1;
+	}
+
+	return 0;
+}
+
+/* Read next row of trace, returns false at end of trace. */
+static bool trace_next(struct trace *tr)
+{
+	char *fields[SIM_MAX_COLUMNS + 1];
+	int count;
+
+	while (fgets(tr->buf, sizeof(tr->buf), tr->fp)) {
+		tr->line++;
+		count = split_csv(tr->buf, fields, SIM_MAX_COLUMNS + 1);
+		if (count == 1 && !*fields[0])
+			continue;
+		if (count != tr->columns + 1) {
+			fprintf(stderr, "trace line %u: expected %u columns\n",
+				tr->line, tr->columns + 1);
+			continue;
+		}
+		tr->t = strtoull(fields[0], NULL, 10);
+		for (int i = 0; i < tr->columns; i++)
+			tr->value[i] = fields[i + 1];
+		return true;
+	}
+	return false;
+}
+
+static void trace_apply(const struct trace *tr)
+{
+	for (int i = 0; i < tr->columns; i++) {
+		if (*tr->value[i])
+			apply_input(tr->col[i].type, tr->col[i].idx, atof(tr->value[i]));
+	}
+}
+
+
+static void print_header()
+{
+	printf("time_ms");
+	for (int i = 0; i < FAN_COUNT; i++)
+		printf(",fan%d_duty", i + 1);
+	for (int i = 0; i < MBFAN_COUNT; i++)
+		printf(",mbfan%d_rpm", i + 1);
+	for (int i = 0; print_status && i < FAN_COUNT; i++)
+		printf(",fan%d_status", i + 1);
+	printf("\n");
+}
+
+/* Print outputs as seen by "hardware" */
+static void print_outputs(uint64_t t)
+{
+	printf("%llu", (unsigned long long)t);
+	for (int i = 0; i < FAN_COUNT; i++)
+		printf(",%.1f", fake_pwm_output_duty(fan_gpio_pwm_map[i]));
+	for (int i = 0; i < MBFAN_COUNT; i++)
+		printf(",%.0f", fake_square_wave_freq(i) * 60.0 / cfg->mbfans[i].rpm_factor);
+	for (int i = 0; print_status && i < FAN_COUNT; i++)
+		printf(",%s", fan_status2str(ctrl_state.fan_status[i]));
+	printf("\n");
+}
+
+
+static uint64_t sim_clock()
+{
+	return time_us_64();
+}
+
+
+/* Benchmark full evaluation of all outputs (all fans and mbfans). */
+static void benchmark(uint64_t count)
+{
+	uint64_t t_start, t_end;
+	double t;
+
+	fake_log_level = -1;
+	t_start = test_time_ns();
+	for (uint64_t i = 0; i < count; i++) {
+		ctrl_state.fan_duty_prev[i % FAN_COUNT] = -100.0;  /* force output update */
+		update_outputs(&ctrl_ctx);
+	}
+	t_end = test_time_ns();
+
+	t = (t_end - t_start) / 1e9;
+	fprintf(stderr, "benchmark: %llu evaluations in %.3f s: %.0f evaluations/sec (%.0f ns/evaluation)\n",
+		(unsigned long long)count, t, count / t, (t_end - t_start) / (double)count);
+}
+
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-c <config>] [-i <interval ms>] [-e <end ms>]"
+		" [-b <count>] [-s] [-v] <trace.csv>\n", prog);
+}
+
+
+int main(int argc, char **argv)
+{
+	const char *config_file = NULL;
+	uint64_t interval = 1000;
+	uint64_t end = 0;
+	uint64_t bench = 0;
+	uint64_t t_start, t_end, runs = 0;
+	uint64_t next_task, next_out, now, t;
+	struct trace tr;
+	bool more;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "c:i:e:b:svh")) != -1) {
+		switch (opt) {
+		case 'c':
+			config_file = optarg;
+			break;
+		case 'i':
+			interval = strtoull(optarg, NULL, 10);
+			break;
+		case 'e':
+			end = strtoull(optarg, NULL, 10);
+			break;
+		case 'b':
+			bench = strtoull(optarg, NULL, 10);
+			break;
+		case 's':
+			print_status = true;
+			break;
+		case 'v':
+			fake_log_level++;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind >= argc || interval < 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (config_file && access(config_file, R_OK)) {
+		fprintf(stderr, "%s: cannot read file\n", config_file);
+		return 1;
+	}
+
+	fake_hal_reset();
+	sim_config_file = config_file;
+	read_config(false);
+	mutex_enter_blocking(config_mutex);
+	get_control_config(&ctrl_config, cfg);
+	get_control_config_inputs(&ctrl_config, cfg);
+	mutex_exit(config_mutex);
+	if (trace_open(&tr, argv[optind]))
+		return 1;
+
+	/* Same initialization as on the board (see setup() in fanpico.c) */
+	setup_pwm_outputs();
+	setup_pwm_inputs();
+	for (int i = 0; i < FAN_COUNT; i++)
+		set_pwm_duty_cycle(i, 0);
+	update_pwm_outputs(NULL);
+	setup_tacho_outputs();
+	setup_tacho_inputs();
+
+	memset(&ctrl_state, 0, sizeof(ctrl_state));
+	for (int i = 0; i < VSENSOR_MAX_COUNT; i++) {
+		ctrl_state.vpressure[i] = -1.0;
+		ctrl_state.vhumidity[i] = -1.0;
+	}
+	control_init(&ctrl_ctx, &ctrl_state, &ctrl_config);
+	setup_tacho_input_interrupts();
+	filter_state_update(&ctrl_config);
+	if (sched_init(&sched, sim_tasks, SIM_TASK_COUNT, 1, sim_clock)
+		< sched_task_count(sim_tasks, SIM_TASK_COUNT, 1)) {
+		fprintf(stderr, "too many tasks (max %d)\n", SCHED_MAX_TASKS);
+		return 1;
+	}
+
+	/* Replay trace (until end of trace, unless end time was given) */
+	more = trace_next(&tr);
+	next_out = 0;
+	print_header();
+	t_start = test_time_ns();
+
+	while (1) {
+		now = time_us_64() / 1000;
+
+		while (more && tr.t <= now) {
+			trace_apply(&tr);
+			more = trace_next(&tr);
+		}
+		if (now >= next_out) {
+			print_outputs(now);
+			next_out += interval;
+		}
+		if (end > 0 ? now >= end : !more)
+			break;
+
+		next_task = sched_run(&sched);
+		runs++;
+
+		/* Advance to next event (task, trace row or output sample) */
+		t = next_out * 1000;
+		if (next_task < t)
+			t = next_task;
+		if (more && tr.t * 1000 < t)
+			t = tr.t * 1000;
+		if (t > time_us_64())
+			fake_run_until_us(t);
+	}
+
+	t_end = test_time_ns();
+	fprintf(stderr, "simulated %.1f s in %.3f s (%.0fx real time), %llu scheduler runs\n",
+		now / 1000.0, (t_end - t_start) / 1e9,
+		now * 1e6 / (t_end - t_start + 1), (unsigned long long)runs);
+	for (int i = 0; i < sched.count; i++) {
+		const struct sched_task_state *ts = &sched.tasks[i];
+
+		fprintf(stderr, "  %-12s %8u runs\n", ts->task->name, ts->stats.runs);
+	}
+
+	if (bench > 0)
+		benchmark(bench);
+
+	return 0;
+}
+
+
+/* eof :-) */
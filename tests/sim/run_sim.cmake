@@ -0,0 +1,35 @@
+# Run fanpico_sim with trace and compare output to expected output.
+#
+# Usage: cmake -DSIM=<fanpico_sim> [-DCONFIG=<json>] -DTRACE=<csv>
+#              -DEXPECTED=<out> -DOUTPUT=<out> [-DINTERVAL=<ms>] [-DSTATUS=ON]
+#              -P run_sim.cmake
+#
+# Without CONFIG, default configuration of the board is used.
+# With STATUS, fan status columns are included in the output.
+
+if(NOT DEFINED INTERVAL)
+  set(INTERVAL 1000)
+endif()
+if(DEFINED CONFIG)
+  set(CONFIG_ARGS -c ${CONFIG})
+endif()
+if(STATUS)
+  list(APPEND CONFIG_ARGS -s)
+endif()
+
+execute_process(
+  COMMAND ${SIM} ${CONFIG_ARGS} -i ${INTERVAL} ${TRACE}
+  OUTPUT_FILE ${OUTPUT}
+  RESULT_VARIABLE res
+  )
+if(NOT res EQUAL 0)
+  message(FATAL_ERROR "fanpico_sim failed: ${res}")
+endif()
+
+execute_process(
+  COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT} ${EXPECTED}
+  RESULT_VARIABLE res
+  )
+if(NOT res EQUAL 0)
+  message(FATAL_ERROR "output differs from expected: ${OUTPUT} vs ${EXPECTED}")
+endif()
@@ -0,0 +1,228 @@
+/* test_commands.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "fanpico.h"
+#include "command_util.h"
+#include "fake_hal.h"
+#include "test_util.h"
+
+
+/*
+ * Tests for SCPI command lookup in command_util.c (run_cmd()), using
+ * command tables from command.c and a corpus of real commands, and
+ * benchmark of command parsing.
+ *
+ * Corpus file (tests/commands/corpus.txt) has one command line per
+ * line (commands separated by ';', as in process_command()), followed
+ * by TAB and names of the command functions expected to be called
+ * (or '-' for unknown command).
+ *
+ * Usage:
+ *   test_commands <corpus file>
+ *   test_commands -g <corpus file> > <new corpus file>
+ *
+ * With -g, expected functions are taken from current implementation.
+ */
+
+#define MAX_COMMANDS   512
+#define BENCH_COMMANDS 1000000
+
+static struct fanpico_config test_config;
+const struct fanpico_config *cfg = &test_config;
+
+static mutex_t config_mutex_inst;
+mutex_t *config_mutex = &config_mutex_inst;
+
+void update_control_config_generation()
+{
+}
+
+
+/* Command tables (command.c) with stub functions recording which
+ * function was called.
+ */
+static const char *called = NULL;
+
+#define CMD_FUNC(name)							\
+	int name(const char *cmd, const char *args, int query,		\
+			struct prev_cmd_t *prev_cmd)			\
+	{								\
+		called = #name;						\
+		return 0;						\
+	}
+
+#include "command_tables.inc"
+
+
+struct corpus_entry {
+	char cmd[256];
+	char expected[256];
+};
+
+static struct corpus_entry corpus[MAX_COMMANDS];
+static int corpus_count = 0;
+
+
+static int read_corpus(const char *filename)
+{
+	char line[512], *tab;
+	FILE *fp;
+
+	if (!(fp = fopen(filename, "r"))) {
+		fprintf(stderr, "%s: cannot open file\n", filename);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), fp) && corpus_count < MAX_COMMANDS) {
+		line[strcspn(line, "\r\n")] = 0;
+		if (line[0] == '#' || line[0] == 0)
+			continue;
+		if ((tab = strchr(line, '\t')))
+			*tab++ = 0;
+		snprintf(corpus[corpus_count].cmd, sizeof(corpus[0].cmd), "%s", line);
+		snprintf(corpus[corpus_count].expected, sizeof(corpus[0].expected), "%s",
+			(tab ? tab : ""));
+		corpus_count++;
+	}
+	fclose(fp);
+
+	return 0;
+}
+
+
+/* Process command line same way as process_command() in command.c.
+ * Names of the functions called are stored in 'result' (if not NULL).
+ */
+static void process_line(const char *line, char *result, size_t result_len)
+{
+	char buf[256], *saveptr, *cmd;
+	struct prev_cmd_t cmd_stack;
+	const struct cmd_t *cmd_level = commands;
+	int last_error_num;
+
+	if (result)
+		result[0] = 0;
+	strncpy(buf, line, sizeof(buf) - 1);
+	buf[sizeof(buf) - 1] = 0;
+
+	cmd = strtok_r(buf, ";", &saveptr);
+	while (cmd) {
+		cmd = trim_str(cmd);
+		if (cmd && strlen(cmd) > 0) {
+			cmd_stack.depth = 0;
+			cmd_stack.cmds[0] = NULL;
+			called = NULL;
+			cmd_level = run_cmd(cmd, commands, cmd_level, &cmd_stack,
+					&last_error_num);
+			if (result) {
+				size_t len = strlen(result);
+				snprintf(result + len, result_len - len, "%s%s",
+					(len > 0 ? " " : ""), (called ? called : "-"));
+			}
+		}
+		cmd = strtok_r(NULL, ";", &saveptr);
+	}
+}
+
+
+static void test_corpus()
+{
+	char result[256];
+	int unknown = 0;
+
+	for (int i = 0; i < corpus_count; i++) {
+		process_line(corpus[i].cmd, result, sizeof(result));
+		CHECK(!strcmp(result, corpus[i].expected), "'%s': called '%s', expected '%s'",
+			corpus[i].cmd, result, corpus[i].expected);
+		if (strchr(result, '-'))
+			unknown++;
+	}
+	printf("corpus: %d command lines (%d with unknown commands)\n",
+		corpus_count, unknown);
+}
+
+
+static void benchmark()
+{
+	int rounds = BENCH_COMMANDS / corpus_count + 1;
+	uint64_t t0, t1;
+
+	t0 = test_time_ns();
+	for (int r = 0; r < rounds; r++)
+		for (int i = 0; i < corpus_count; i++)
+			process_line(corpus[i].cmd, NULL, 0);
+	t1 = test_time_ns();
+
+#ifdef CMD_INDEX_MIN_ENTRIES
+	const char *lookup = "linear scan";
+#else
+	const char *lookup = "hashed index";
+#endif
+	printf("benchmark: command lookup (%s): %.1f ns/command line\n",
+		lookup, (t1 - t0) / (double)(rounds * corpus_count));
+}
+
+
+int main(int argc, char **argv)
+{
+	bool generate = false;
+	int opt;
+
+	fake_hal_reset();
+	fake_log_level = LOG_CRIT;
+
+	while ((opt = getopt(argc, argv, "g")) != -1) {
+		switch (opt) {
+		case 'g':
+			generate = true;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-g] <corpus file>\n", argv[0]);
+			return 2;
+		}
+	}
+	if (optind >= argc || read_corpus(argv[optind]) < 0 || corpus_count < 1) {
+		fprintf(stderr, "no commands in corpus\n");
+		return 2;
+	}
+
+	if (generate) {
+		char result[256];
+		for (int i = 0; i < corpus_count; i++) {
+			process_line(corpus[i].cmd, result, sizeof(result));
+			printf("%s\t%s\n", corpus[i].cmd, result);
+		}
+		return 0;
+	}
+
+	test_corpus();
+	benchmark();
+
+	return TEST_RESULT();
+}
+
+
+/* eof :-) */
@@ -0,0 +1,281 @@
+/* test_filter_vectors.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "fanpico.h"
+#include "filters.h"
+#include "fake_hal.h"
+#include "test_util.h"
+
+
+/*
+ * Golden vector tests for filters: run filter chain (through
+ * filter_channel(), same as firmware) against stored input samples
+ * and compare output to stored expected output. Also reports
+ * throughput of each filter chain.
+ *
+ * Vector files (in tests/filters):
+ *
+ *   # filter: <filter chain, as in CONF:SENSORx:FILTER>
+ *   time_us,input,expected
+ *   1000000,30.12,30.12
+ *   ...
+ *
+ * Usage:
+ *   test_filter_vectors <vector file>...
+ *   test_filter_vectors -g <filter chain> <vector file> > <new vector file>
+ *
+ * With -g, output of the current implementation is written as a new
+ * vector file (using time_us and input columns of the given file).
+ */
+
+#define MAX_SAMPLES     4096
+#define BENCH_SAMPLES   2000000
+
+/* Allowed difference from expected output (relative, or absolute
+ * for values smaller than 1.0). Stored values are exact for the build
+ * that generated them, tolerance allows for different compilers/FPUs.
+ * With fixed-point filters (Q16.16) the tolerance also covers rounding
+ * of input samples and filter state.
+ */
+#if FANPICO_FIXED_POINT
+#define TOLERANCE  2e-4
+#else
+#define TOLERANCE  1e-5
+#endif
+
+static struct fanpico_config test_config;
+const struct fanpico_config *cfg = &test_config;
+
+struct vector {
+	char filter[128];
+	int count;
+	uint64_t t[MAX_SAMPLES];
+	float input[MAX_SAMPLES];
+	float expected[MAX_SAMPLES];
+	bool has_expected;
+};
+
+static struct vector vec;
+static float output[MAX_SAMPLES];
+
+
+static int read_vector(const char *filename, struct vector *v)
+{
+	char line[256];
+	FILE *fp;
+	int lineno = 0;
+
+	if (!(fp = fopen(filename, "r"))) {
+		fprintf(stderr, "%s: cannot open file\n", filename);
+		return -1;
+	}
+
+	memset(v, 0, sizeof(*v));
+	v->has_expected = true;
+
+	while (fgets(line, sizeof(line), fp)) {
+		unsigned long long t;
+		float in, exp;
+		int n;
+
+		lineno++;
+		line[strcspn(line, "\r\n")] = 0;
+		if (!strncmp(line, "# filter:", 9)) {
+			const char *s = line + 9;
+			while (*s == ' ')
+				s++;
+			snprintf(v->filter, sizeof(v->filter), "%s", s);
+			continue;
+		}
+		if (line[0] == '#' || line[0] == 0 || !strncmp(line, "time_us", 7))
+			continue;
+
+		n = sscanf(line, "%llu,%f,%f", &t, &in, &exp);
+		if (n < 2 || v->count >= MAX_SAMPLES) {
+			fprintf(stderr, "%s:%d: invalid line: %s\n", filename, lineno, line);
+			fclose(fp);
+			return -1;
+		}
+		v->t[v->count] = t;
+		v->input[v->count] = in;
+		if (n == 3)
+			v->expected[v->count] = exp;
+		else
+			v->has_expected = false;
+		v->count++;
+	}
+	fclose(fp);
+
+	return 0;
+}
+
+
+/* Configure filter chain on sensor1 (with new filter state). */
+static int setup_filter(const char *filter)
+{
+	static struct fanpico_control_config ctrl;
+
+	memset(&ctrl, 0, sizeof(ctrl));
+	filter_state_update(&ctrl);
+	if (filter_chain_parse(&ctrl.sensors[0].filter, filter))
+		return -1;
+	filter_state_update(&ctrl);
+
+	return 0;
+}
+
+
+static void run_filter(const struct vector *v, float *out)
+{
+	for (int i = 0; i < v->count; i++)
+		out[i] = FILTER_TO_FLOAT(filter_channel(FILTER_CH_SENSOR, 0,
+						FILTER_VAL(v->input[i]), v->t[i]));
+}
+
+
+static void check_vector(const char *filename)
+{
+	double max_err = 0, sum = 0;
+	uint64_t t0, t1;
+	int errors = 0, rounds, samples;
+
+	if (read_vector(filename, &vec) < 0) {
+		CHECK(false, "%s: cannot read vector file", filename);
+		return;
+	}
+	if (!vec.has_expected || vec.count < 1 || !vec.filter[0]) {
+		CHECK(false, "%s: no filter or expected output", filename);
+		return;
+	}
+	if (setup_filter(vec.filter) < 0) {
+		CHECK(false, "%s: invalid filter: %s", filename, vec.filter);
+		return;
+	}
+
+	run_filter(&vec, output);
+	for (int i = 0; i < vec.count; i++) {
+		double err = fabs(output[i] - vec.expected[i]);
+		double tol = TOLERANCE * fmax(1.0, fabs(vec.expected[i]));
+
+		if (err > max_err)
+			max_err = err;
+		if (!(err <= tol) && errors++ < 5)
+			CHECK(false, "%s: sample %d (t=%llu): %.9g, expected %.9g",
+				vec.filter, i, vec.t[i], output[i], vec.expected[i]);
+	}
+	CHECK(errors == 0, "%s: %d of %d samples differ from expected output",
+		vec.filter, errors, vec.count);
+
+	/* Throughput over repeated runs of the vector (filter state is
+	   not reset between the rounds). */
+	rounds = (BENCH_SAMPLES + vec.count - 1) / vec.count;
+	samples = rounds * vec.count;
+	t0 = test_time_ns();
+	for (int r = 0; r < rounds; r++) {
+		run_filter(&vec, output);
+		sum += output[vec.count - 1];
+	}
+	t1 = test_time_ns();
+	test_sink = sum;
+
+	printf("%-24s %7d  %9.3g  %9.1f  %10.2f\n",
+		vec.filter, vec.count, max_err, (t1 - t0) / (double)samples,
+		samples * 1000.0 / (t1 - t0));
+}
+
+
+/* Shortest representation of a float that reads back exactly. */
+static const char* float_str(char *buf, size_t size, float val)
+{
+	for (int prec = 6; prec < 9; prec++) {
+		snprintf(buf, size, "%.*g", prec, val);
+		if (strtof(buf, NULL) == val)
+			return buf;
+	}
+	snprintf(buf, size, "%.9g", val);
+	return buf;
+}
+
+
+static int generate_vector(const char *filter, const char *filename)
+{
+	if (read_vector(filename, &vec) < 0)
+		return 1;
+	if (setup_filter(filter) < 0) {
+		fprintf(stderr, "invalid filter: %s\n", filter);
+		return 1;
+	}
+
+	run_filter(&vec, output);
+	printf("# filter: %s\n", filter);
+	printf("time_us,input,expected\n");
+	for (int i = 0; i < vec.count; i++) {
+		char in[32], out[32];
+		printf("%llu,%s,%s\n", vec.t[i], float_str(in, sizeof(in), vec.input[i]),
+			float_str(out, sizeof(out), output[i]));
+	}
+
+	return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+	const char *generate = NULL;
+	int opt;
+
+	fake_hal_reset();
+	fake_log_level = LOG_CRIT;
+
+	while ((opt = getopt(argc, argv, "g:")) != -1) {
+		switch (opt) {
+		case 'g':
+			generate = optarg;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-g <filter>] <vector file>...\n", argv[0]);
+			return 2;
+		}
+	}
+	if (optind >= argc) {
+		fprintf(stderr, "no vector files given\n");
+		return 2;
+	}
+
+	if (generate)
+		return generate_vector(generate, argv[optind]);
+
+	printf("%-24s %7s  %9s  %9s  %10s\n", "filter", "samples", "max error",
+		"ns/sample", "Msamples/s");
+	for (int i = optind; i < argc; i++)
+		check_vector(argv[i]);
+
+	return TEST_RESULT();
+}
+
+
+/* eof :-) */
@@ -0,0 +1,532 @@
+/* test_filters.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fanpico.h"
+#include "filters.h"
+#include "fake_hal.h"
+#include "test_util.h"
+
+
+/*
+ * Tests for filters.c (filter chains and filter context pool) and
+ * filter implementations, and benchmark of the filters.
+ */
+
+static struct fanpico_config test_config;
+const struct fanpico_config *cfg = &test_config;
+
+/* Size of last filter context allocated (linked with --wrap=filter_ctx_alloc) */
+static size_t last_ctx_size = 0;
+
+void* __real_filter_ctx_alloc(size_t size);
+
+void* __wrap_filter_ctx_alloc(size_t size)
+{
+	last_ctx_size = size;
+	return __real_filter_ctx_alloc(size);
+}
+
+
+static double rand_range(double lo, double hi)
+{
+	return lo + (hi - lo) * (rand() / (double)RAND_MAX);
+}
+
+
+static int cmp_float(const void *a, const void *b)
+{
+	float x = *(const float*)a, y = *(const float*)b;
+
+	return (x < y ? -1 : (x > y ? 1 : 0));
+}
+
+
+/* Return number of free contexts in the filter context pool of
+ * given class.
+ */
+static int pool_free(enum filter_ctx_class class)
+{
+	void *ctx[FILTER_POOL_SMALL + FILTER_POOL_LARGE];
+	size_t size = (class == FILTER_CTX_LARGE ? FILTER_CTX_LARGE_SIZE : 16);
+	int n = 0;
+
+	while (n < FILTER_POOL_SMALL + FILTER_POOL_LARGE && (ctx[n] = filter_ctx_alloc(size)))
+		n++;
+	for (int i = 0; i < n; i++)
+		filter_ctx_free(ctx[i]);
+
+	return n;
+}
+
+
+/* Filter chains are rejected (when configured) if there would not be
+ * enough filter contexts (of the right size) for all stages.
+ */
+static void test_pool_limit()
+{
+	static struct fanpico_config config;
+	static struct fanpico_control_config ctrl;
+	const char *chain4 = "sma,2|ema,0.5|median,3|kalman,1,1";  /* 2 large, 2 small */
+	int large = 0, small = 0, ret;
+
+	memset(&config, 0, sizeof(config));
+
+	/* Fill channels with 4 stage chains until large context pool is full */
+	for (int i = 0; i < FAN_COUNT; i++) {
+		ret = filter_chain_set(&config, &config.fans[i].filter, chain4);
+		if (large + 2 <= FILTER_POOL_LARGE) {
+			CHECK(ret == 0, "fan%d: chain rejected (large %d)", i + 1, large);
+			large += 2;
+			small += 2;
+		} else {
+			CHECK(ret != 0, "fan%d: chain accepted (large %d)", i + 1, large);
+		}
+	}
+	for (int i = 0; i < VSENSOR_COUNT; i++) {
+		ret = filter_chain_set(&config, &config.vsensors[i].filter, chain4);
+		if (large + 2 <= FILTER_POOL_LARGE) {
+			CHECK(ret == 0, "vsensor%d: chain rejected (large %d)", i + 1, large);
+			large += 2;
+			small += 2;
+		} else {
+			CHECK(ret != 0, "vsensor%d: chain accepted (large %d)", i + 1, large);
+			CHECK(config.vsensors[i].filter.stages == 0,
+				"vsensor%d: rejected chain was applied", i + 1);
+		}
+	}
+	CHECK(large == FILTER_POOL_LARGE, "large context pool not filled: %d", large);
+
+	/* Replacing a chain counts its current stages as free */
+	CHECK(filter_chain_set(&config, &config.fans[0].filter, "ema,0.2") == 0,
+		"replacing chain with shorter one rejected");
+	CHECK(filter_chain_set(&config, &config.fans[0].filter, chain4) == 0,
+		"replacing chain with same size rejected");
+	CHECK(filter_chain_set(&config, &config.sensors[0].filter, "sma,3") != 0,
+		"chain that does not fit accepted");
+	/* Small filters do not use large contexts */
+	CHECK(filter_chain_set(&config, &config.sensors[0].filter, "ema,0.2|kalman,1,1") == 0,
+		"chain of small filters rejected");
+	small += 2;
+	CHECK(filter_chain_set(&config, &config.fans[0].filter, "none") == 0,
+		"removing chain rejected");
+	large -= 2;
+	small -= 2;
+	CHECK(filter_chain_set(&config, &config.mbfans[0].filter, "median,5|sma,3") == 0,
+		"chain that fits rejected");
+	large += 2;
+
+	/* All configured stages get a filter context */
+	memcpy(ctrl.fans, config.fans, sizeof(ctrl.fans));
+	memcpy(ctrl.mbfans, config.mbfans, sizeof(ctrl.mbfans));
+	memcpy(ctrl.sensors, config.sensors, sizeof(ctrl.sensors));
+	memcpy(ctrl.vsensors, config.vsensors, sizeof(ctrl.vsensors));
+	filter_state_update(&ctrl);
+	CHECK(pool_free(FILTER_CTX_LARGE) == FILTER_POOL_LARGE - large,
+		"%d large filter contexts free, expected %d",
+		pool_free(FILTER_CTX_LARGE), FILTER_POOL_LARGE - large);
+	CHECK(pool_free(FILTER_CTX_SMALL) == FILTER_POOL_SMALL - small,
+		"%d small filter contexts free, expected %d",
+		pool_free(FILTER_CTX_SMALL), FILTER_POOL_SMALL - small);
+
+	/* Release everything */
+	memset(&ctrl, 0, sizeof(ctrl));
+	filter_state_update(&ctrl);
+	CHECK(pool_free(FILTER_CTX_LARGE) == FILTER_POOL_LARGE,
+		"large filter contexts leaked: %d free", pool_free(FILTER_CTX_LARGE));
+	CHECK(pool_free(FILTER_CTX_SMALL) == FILTER_POOL_SMALL,
+		"small filter contexts leaked: %d free", pool_free(FILTER_CTX_SMALL));
+
+	/* Small context pool fills up independently */
+	memset(&config, 0, sizeof(config));
+	small = 0;
+	for (int i = 0; i < FAN_COUNT; i++) {
+		ret = filter_chain_set(&config, &config.fans[i].filter,
+				"ema,0.1|ema,0.2|kalman,1,1|lossypeak,1,30");
+		if (small + 4 <= FILTER_POOL_SMALL) {
+			CHECK(ret == 0, "fan%d: chain rejected (small %d)", i + 1, small);
+			small += 4;
+		} else {
+			CHECK(ret != 0, "fan%d: chain accepted (small %d)", i + 1, small);
+		}
+	}
+	CHECK(small == FILTER_POOL_SMALL, "small context pool not filled: %d", small);
+	CHECK(filter_chain_set(&config, &config.sensors[0].filter, "ema,0.2") != 0,
+		"small filter accepted when small context pool is full");
+	CHECK(filter_chain_set(&config, &config.sensors[1].filter, "sma,3") == 0,
+		"large filter rejected when small context pool is full");
+}
+
+
+/* Configuration loaded from flash is truncated to fit in the pools,
+ * chain is truncated at the first stage that does not fit.
+ */
+static void test_config_check()
+{
+	static struct fanpico_config config;
+	int stages = 0;
+
+	memset(&config, 0, sizeof(config));
+	for (int i = 0; i < FAN_COUNT; i++)
+		filter_chain_parse(&config.fans[i].filter, "sma,2|ema,0.5|median,3|kalman,1,1");
+	for (int i = 0; i < VSENSOR_COUNT; i++)
+		filter_chain_parse(&config.vsensors[i].filter, "ema,0.5|sma,2|median,3");
+
+	/* Fans use up all large contexts, so vsensor chains get truncated
+	 * after the (small) ema stage. */
+	CHECK(FAN_COUNT * 2 == FILTER_POOL_LARGE, "unexpected pool size: %d", FILTER_POOL_LARGE);
+	int dropped = filter_config_check(&config);
+	CHECK(dropped == VSENSOR_COUNT * 2, "filter_config_check() dropped %d stages", dropped);
+	for (int i = 0; i < VSENSOR_COUNT; i++)
+		CHECK(config.vsensors[i].filter.stages == 1, "vsensor%d: %d stages", i + 1,
+			config.vsensors[i].filter.stages);
+
+	for (int i = 0; i < FAN_COUNT; i++)
+		stages += config.fans[i].filter.stages;
+	for (int i = 0; i < VSENSOR_COUNT; i++)
+		stages += config.vsensors[i].filter.stages;
+	CHECK(stages == FAN_COUNT * 4 + VSENSOR_COUNT * 3 - dropped,
+		"%d stages after filter_config_check()", stages);
+	CHECK(filter_config_check(&config) == 0, "second filter_config_check() dropped stages");
+}
+
+
+/* Previous rolling median implementation (remove oldest value from
+ * sorted array, then insert new value), for comparison.
+ */
+struct median_ref {
+	float data[15], sorted[15];
+	int index, used, window;
+};
+
+static int search_ref(const float *sorted, int count, float val)
+{
+	int lo = 0, hi = count;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (sorted[mid] < val)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static float median_ref_filter(struct median_ref *c, float input)
+{
+	int pos;
+
+	if (c->used < c->window) {
+		c->used++;
+	} else {
+		pos = search_ref(c->sorted, c->used, c->data[c->index]);
+		memmove(&c->sorted[pos], &c->sorted[pos + 1], (c->used - pos - 1) * sizeof(float));
+	}
+	c->data[c->index] = input;
+	pos = search_ref(c->sorted, c->used - 1, input);
+	memmove(&c->sorted[pos + 1], &c->sorted[pos], (c->used - pos - 1) * sizeof(float));
+	c->sorted[pos] = input;
+	c->index = (c->index + 1) % c->window;
+
+	return c->sorted[c->used / 2];
+}
+
+
+/* O(log n) rolling median using pair of heaps (max-heap for lower half,
+ * min-heap for upper half) with position tracking, so that oldest sample
+ * can be replaced in place. For comparison with median_filter().
+ */
+struct median_heap {
+	float val[15];             /* samples (ring buffer) */
+	uint8_t heap[15], pos[15]; /* heap and position of each sample */
+	uint8_t slot[2][15];       /* heap 0: lower half (max), 1: upper half (min) */
+	int n[2];
+	int index, used, window;
+};
+
+static bool heap_before(struct median_heap *m, int k, int a, int b)
+{
+	return (k ? m->val[a] < m->val[b] : m->val[a] > m->val[b]);
+}
+
+static void heap_set(struct median_heap *m, int k, int i, int s)
+{
+	m->slot[k][i] = s;
+	m->heap[s] = k;
+	m->pos[s] = i;
+}
+
+static void heap_swap(struct median_heap *m, int k, int i, int j)
+{
+	int s = m->slot[k][i];
+
+	heap_set(m, k, i, m->slot[k][j]);
+	heap_set(m, k, j, s);
+}
+
+static int heap_up(struct median_heap *m, int k, int i)
+{
+	while (i > 0 && heap_before(m, k, m->slot[k][i], m->slot[k][(i - 1) / 2])) {
+		heap_swap(m, k, i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+	return i;
+}
+
+static void heap_down(struct median_heap *m, int k, int i)
+{
+	for (;;) {
+		int c = 2 * i + 1;
+		if (c >= m->n[k])
+			break;
+		if (c + 1 < m->n[k] && heap_before(m, k, m->slot[k][c + 1], m->slot[k][c]))
+			c++;
+		if (!heap_before(m, k, m->slot[k][c], m->slot[k][i]))
+			break;
+		heap_swap(m, k, i, c);
+		i = c;
+	}
+}
+
+static void heap_push(struct median_heap *m, int k, int s)
+{
+	heap_set(m, k, m->n[k]++, s);
+	heap_up(m, k, m->n[k] - 1);
+}
+
+static int heap_pop(struct median_heap *m, int k)
+{
+	int s = m->slot[k][0];
+
+	if (--m->n[k] > 0) {
+		heap_set(m, k, 0, m->slot[k][m->n[k]]);
+		heap_down(m, k, 0);
+	}
+	return s;
+}
+
+static float median_heap_filter(struct median_heap *m, float input)
+{
+	int s = m->index;
+
+	m->val[s] = input;
+	if (m->used < m->window) {
+		m->used++;
+		heap_push(m, (m->n[1] > 0 && input < m->val[m->slot[1][0]] ? 0 : 1), s);
+		while (m->n[0] > m->used / 2)
+			heap_push(m, 1, heap_pop(m, 0));
+		while (m->n[0] < m->used / 2)
+			heap_push(m, 0, heap_pop(m, 1));
+	} else {
+		int k = m->heap[s];
+		heap_down(m, k, heap_up(m, k, m->pos[s]));
+		if (m->n[0] > 0 && m->val[m->slot[0][0]] > m->val[m->slot[1][0]]) {
+			int lo = m->slot[0][0];
+			heap_set(m, 0, 0, m->slot[1][0]);
+			heap_set(m, 1, 0, lo);
+			heap_down(m, 0, 0);
+			heap_down(m, 1, 0);
+		}
+	}
+	m->index = (m->index + 1) % m->window;
+
+	return m->val[m->slot[1][0]];
+}
+
+
+/* Rolling median against sorting the window, for random signals
+ * (with lots of repeated values) and slowly changing signals.
+ */
+static void test_median()
+{
+	float window[32], sorted[32], data[2000];
+	int errors = 0;
+
+	for (int w = 3; w <= 15; w++) {
+		float params[FILTER_MAX_ARGS] = { w };
+
+		for (int type = 0; type < 3; type++) {
+			void *ctx = median_new(params);
+			struct median_heap heap = { .window = w };
+			float v = 50;
+
+			for (int n = 0; n < 2000; n++) {
+				if (type == 0)
+					v = rand() % 10;
+				else if (type == 1)
+					v = rand_range(-100, 100);
+				else
+					v += rand_range(-1, 1);
+				data[n] = v;
+
+				float res = median_filter(ctx, v, n * 1000);
+				int count = (n + 1 < w ? n + 1 : w);
+				memcpy(window, &data[n + 1 - count], count * sizeof(float));
+				memcpy(sorted, window, count * sizeof(float));
+				qsort(sorted, count, sizeof(float), cmp_float);
+				if (res != sorted[count / 2] && errors++ < 10)
+					CHECK(false, "median,%d: sample %d: %f, expected %f",
+						w, n, res, sorted[count / 2]);
+				res = median_heap_filter(&heap, v);
+				if (res != sorted[count / 2] && errors++ < 10)
+					CHECK(false, "median,%d (heap): sample %d: %f, expected %f",
+						w, n, res, sorted[count / 2]);
+			}
+			/* NaN input is ignored */
+			float prev = median_filter(ctx, data[1999], 0);
+			CHECK(median_filter(ctx, NAN, 0) == prev, "median,%d: NaN changed output", w);
+			filter_ctx_free(ctx);
+		}
+	}
+	CHECK(errors == 0, "median: %d errors", errors);
+}
+
+
+#define BENCH_SAMPLES 4096
+
+struct filter_bench {
+	const char *name;
+	enum signal_filter_types type;
+	void* (*new_func)(const float *params);
+	float (*filter_func)(void *ctx, float input, uint64_t t);
+	float params[FILTER_MAX_ARGS];
+};
+
+static const struct filter_bench bench_filters[] = {
+	{ "lossypeak,1,30", FILTER_LOSSYPEAK, lossy_peak_new, lossy_peak_filter, { 1.0, 30.0 } },
+	{ "sma,5", FILTER_SMA, sma_new, sma_filter, { 5 } },
+	{ "sma,32", FILTER_SMA, sma_new, sma_filter, { 32 } },
+	{ "ema,0.2", FILTER_EMA, ema_new, ema_filter, { 0.2 } },
+	{ "median,5", FILTER_MEDIAN, median_new, median_filter, { 5 } },
+	{ "median,15", FILTER_MEDIAN, median_new, median_filter, { 15 } },
+	{ "kalman,0.01,0.5", FILTER_KALMAN, kalman_new, kalman_filter, { 0.01, 0.5 } },
+};
+
+
+/* Time per sample (and memory per instance) of each filter, using noisy
+ * (random) and slowly changing input signals.
+ */
+static void benchmark()
+{
+	static float noisy[BENCH_SAMPLES], slow[BENCH_SAMPLES];
+	const int rounds = 500;
+	uint64_t t0, t1, t2;
+	double sum = 0, v = 40;
+
+	for (int i = 0; i < BENCH_SAMPLES; i++) {
+		noisy[i] = rand_range(20, 80);
+		v += rand_range(-0.2, 0.2);
+		slow[i] = v;
+	}
+
+	printf("benchmark: filter              noisy    slow  (ns/sample)  context  pool slot\n");
+	for (int f = 0; f < sizeof(bench_filters) / sizeof(bench_filters[0]); f++) {
+		const struct filter_bench *b = &bench_filters[f];
+		size_t slot = (filter_ctx_class(b->type) == FILTER_CTX_LARGE ?
+			FILTER_CTX_LARGE_SIZE : FILTER_CTX_SMALL_SIZE);
+		void *ctx;
+
+		last_ctx_size = 0;
+		ctx = b->new_func(b->params);
+		t0 = test_time_ns();
+		for (int r = 0; r < rounds; r++)
+			for (int i = 0; i < BENCH_SAMPLES; i++)
+				sum += b->filter_func(ctx, noisy[i], i * 1000);
+		t1 = test_time_ns();
+		for (int r = 0; r < rounds; r++)
+			for (int i = 0; i < BENCH_SAMPLES; i++)
+				sum += b->filter_func(ctx, slow[i], i * 1000);
+		t2 = test_time_ns();
+		filter_ctx_free(ctx);
+		CHECK(ctx && last_ctx_size <= slot, "%s: context (%zu B) does not fit in %s slot",
+			b->name, last_ctx_size, filter_ctx_class(b->type) ? "large" : "small");
+
+		printf("benchmark: %-18s %6.1f  %6.1f               %4zu B    %4zu B\n", b->name,
+			(t1 - t0) / (double)(rounds * BENCH_SAMPLES),
+			(t2 - t1) / (double)(rounds * BENCH_SAMPLES),
+			last_ctx_size, slot);
+	}
+
+	/* Previous median implementation */
+	for (int w = 5; w <= 15; w += 10) {
+		struct median_ref c = { .window = w };
+		char name[32];
+
+		t0 = test_time_ns();
+		for (int r = 0; r < rounds; r++)
+			for (int i = 0; i < BENCH_SAMPLES; i++)
+				sum += median_ref_filter(&c, noisy[i]);
+		t1 = test_time_ns();
+		for (int r = 0; r < rounds; r++)
+			for (int i = 0; i < BENCH_SAMPLES; i++)
+				sum += median_ref_filter(&c, slow[i]);
+		t2 = test_time_ns();
+		snprintf(name, sizeof(name), "median,%d (prev)", w);
+		printf("benchmark: %-18s %6.1f  %6.1f\n", name,
+			(t1 - t0) / (double)(rounds * BENCH_SAMPLES),
+			(t2 - t1) / (double)(rounds * BENCH_SAMPLES));
+	}
+
+	/* O(log n) median using pair of heaps */
+	for (int w = 5; w <= 15; w += 10) {
+		struct median_heap m = { .window = w };
+		char name[32];
+
+		t0 = test_time_ns();
+		for (int r = 0; r < rounds; r++)
+			for (int i = 0; i < BENCH_SAMPLES; i++)
+				sum += median_heap_filter(&m, noisy[i]);
+		t1 = test_time_ns();
+		for (int r = 0; r < rounds; r++)
+			for (int i = 0; i < BENCH_SAMPLES; i++)
+				sum += median_heap_filter(&m, slow[i]);
+		t2 = test_time_ns();
+		snprintf(name, sizeof(name), "median,%d (heap)", w);
+		printf("benchmark: %-18s %6.1f  %6.1f               %4zu B\n", name,
+			(t1 - t0) / (double)(rounds * BENCH_SAMPLES),
+			(t2 - t1) / (double)(rounds * BENCH_SAMPLES),
+			sizeof(m));
+	}
+	test_sink = sum;
+}
+
+
+int main(int argc, char **argv)
+{
+	fake_hal_reset();
+	fake_log_level = LOG_CRIT;
+
+	srand(1);
+	test_pool_limit();
+	test_config_check();
+	test_median();
+	benchmark();
+
+	return TEST_RESULT();
+}
+
+
+/* eof :-) */
@@ -0,0 +1,404 @@
+/* test_fixedpoint.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fanpico.h"
+#include "test_util.h"
+
+
+/*
+ * Tolerance tests for fixed-point (FANPICO_FIXED_POINT=1) control loop
+ * math: fixedpoint.h helpers, maps, calculate_pwm_duty() and
+ * calculate_tacho_freq() are compared against the floating-point path
+ * (calculated here in double).
+ */
+
+#define RANDOM_MAPS     1000
+#define RANDOM_VALUES   200
+#define HELPER_VALUES   1000000
+
+/* Maximum allowed errors (for maps with points at least 1 unit apart) */
+#define PWM_TOLERANCE   0.01   /* % */
+#define RPM_TOLERANCE   0.1    /* RPM */
+#define TEMP_TOLERANCE  0.01   /* % */
+
+#if !FANPICO_FIXED_POINT
+#error "test_fixedpoint must be built with FANPICO_FIXED_POINT=1"
+#endif
+
+static struct fanpico_config test_config;
+const struct fanpico_config *cfg = &test_config;
+
+static double max_err_pwm, max_err_rpm, max_err_temp, max_err_duty, max_err_freq;
+static struct pwl_maps maps;
+
+
+/* Floating-point map (same as pwm_map() etc. in floating-point build). */
+static double ref_map(const double xy[][2], int points, double val)
+{
+	int i;
+
+	if (val <= xy[0][0] || points < 2)
+		return xy[0][1];
+
+	i = 1;
+	while (i < points - 1 && xy[i][0] < val)
+		i++;
+
+	if (val >= xy[i][0])
+		return xy[i][1];
+
+	return xy[i-1][1] + (xy[i][1] - xy[i-1][1]) / (xy[i][0] - xy[i-1][0])
+		* (val - xy[i-1][0]);
+}
+
+
+static double rand_range(double lo, double hi)
+{
+	return lo + (hi - lo) * (rand() / (double)RAND_MAX);
+}
+
+
+static void test_conversions()
+{
+	/* Conversions round to nearest (away from zero on ties) */
+	CHECK(fx_from_int(100, Q16_FRAC) == 100 << 16, "fx_from_int(100)");
+	CHECK(fx_from_int(-3, Q12_FRAC) == -3 * 4096, "fx_from_int(-3)");
+	CHECK(fx_from_double(0.5 / 65536, Q16_FRAC) == 1, "round up");
+	CHECK(fx_from_double(-0.5 / 65536, Q16_FRAC) == -1, "round down");
+	CHECK(fx_from_float(12.25f, Q16_FRAC) == 12 * 65536 + 16384, "fx_from_float(12.25)");
+	CHECK(fx_to_double(-98304, Q16_FRAC) == -1.5, "fx_to_double(-1.5)");
+
+	for (int n = 0; n < HELPER_VALUES; n++) {
+		double v = rand_range(-30000, 30000);
+		double err = fabs(fx_to_double(fx_from_double(v, Q16_FRAC), Q16_FRAC) - v);
+		CHECK(err <= ldexp(1.0, -17), "Q16.16 round trip %f: error %g", v, err);
+
+		v = rand_range(-500000, 500000);
+		err = fabs(fx_to_double(fx_from_double(v, Q12_FRAC), Q12_FRAC) - v);
+		CHECK(err <= ldexp(1.0, -13), "Q20.12 round trip %f: error %g", v, err);
+	}
+}
+
+
+static void test_mul()
+{
+	double max_err = 0;
+
+	for (int n = 0; n < HELPER_VALUES; n++) {
+		/* Duty cycle (or RPM) times coefficient */
+		fx_t a = fx_from_double(rand_range(0, 100), Q16_FRAC);
+		fx_t b = fx_from_double(rand_range(0, 2), Q16_FRAC);
+		double ref = fx_to_double(a, Q16_FRAC) * fx_to_double(b, Q16_FRAC);
+		double err = fabs(fx_to_double(fx_mul(a, b, Q16_FRAC), Q16_FRAC) - ref);
+
+		max_err = fmax(max_err, err);
+		CHECK(err <= ldexp(1.0, -16), "fx_mul: error %g", err);
+
+		a = fx_from_double(rand_range(0, 20000), Q12_FRAC);
+		ref = fx_to_double(a, Q12_FRAC) * fx_to_double(b, Q16_FRAC);
+		err = fabs(fx_to_double(fx_mul(a, b, Q16_FRAC), Q12_FRAC) - ref);
+		CHECK(err <= ldexp(1.0, -12), "fx_mul (Q20.12 x Q16.16): error %g", err);
+	}
+	printf("max error: fx_mul (Q16.16) %g\n", max_err);
+}
+
+
+/* Random map with increasing X values (at least 'min_dx' apart). */
+static int random_map(double xy[][2], double max_x, double max_y, double min_dx)
+{
+	int points = 2 + rand() % (MAX_MAP_POINTS - 1);
+	double x = rand_range(0, max_x / 4);
+
+	for (int i = 0; i < points; i++) {
+		xy[i][0] = floor(x / min_dx) * min_dx;
+		xy[i][1] = floor(rand_range(0, max_y));
+		x = xy[i][0] + min_dx + rand_range(0, (max_x - x) / (points - i));
+	}
+	return points;
+}
+
+
+/* Steepest slope of a map (errors in input get multiplied by this). */
+static double max_slope(const double xy[][2], int points)
+{
+	double max = 0;
+
+	for (int i = 1; i < points; i++)
+		max = fmax(max, fabs((xy[i][1] - xy[i-1][1]) / (xy[i][0] - xy[i-1][0])));
+	return max;
+}
+
+
+static void pwm_map_from(struct pwm_map *m, const double xy[][2], int points)
+{
+	m->points = points;
+	for (int i = 0; i < points; i++) {
+		m->pwm[i][0] = xy[i][0];
+		m->pwm[i][1] = xy[i][1];
+	}
+}
+
+static void tacho_map_from(struct tacho_map *m, const double xy[][2], int points)
+{
+	m->points = points;
+	for (int i = 0; i < points; i++) {
+		m->tacho[i][0] = xy[i][0];
+		m->tacho[i][1] = xy[i][1];
+	}
+}
+
+static void temp_map_from(struct temp_map *m, const double xy[][2], int points)
+{
+	m->points = points;
+	for (int i = 0; i < points; i++) {
+		m->temp[i][0] = xy[i][0];
+		m->temp[i][1] = xy[i][1];
+	}
+}
+
+
+/* Evaluate compiled map (frac is number of fractional bits of values). */
+static double eval_map(const struct pwl_map *m, double x, unsigned int frac)
+{
+	return fx_to_double(pwl_eval(&maps, m, fx_from_double(x, frac)), frac);
+}
+
+
+static void test_maps()
+{
+	double xy[MAX_MAP_POINTS][2];
+	struct pwm_map pm;
+	struct tacho_map tm;
+	struct temp_map sm;
+	struct pwl_map m;
+	double x, err;
+	int points;
+
+	for (int n = 0; n < RANDOM_MAPS; n++) {
+		pwl_maps_init(&maps);
+		points = random_map(xy, 100, 100, 1.0);
+		if (xy[points-1][0] > 255)
+			continue;
+		pwm_map_from(&pm, xy, points);
+		pwm_map_compile(&maps, &m, &pm);
+		for (int k = 0; k < RANDOM_VALUES; k++) {
+			x = rand_range(-5, 105);
+			err = fabs(eval_map(&m, x, Q16_FRAC) - ref_map(xy, points, x));
+			max_err_pwm = fmax(max_err_pwm, err);
+			CHECK(err <= PWM_TOLERANCE, "pwm_map(%f) error %f", x, err);
+		}
+
+		points = random_map(xy, 10000, 10000, 100.0);
+		tacho_map_from(&tm, xy, points);
+		tacho_map_compile(&maps, &m, &tm);
+		for (int k = 0; k < RANDOM_VALUES; k++) {
+			x = rand_range(0, 12000);
+			err = fabs(eval_map(&m, x, Q12_FRAC) - ref_map(xy, points, x));
+			max_err_rpm = fmax(max_err_rpm, err);
+			CHECK(err <= RPM_TOLERANCE, "tacho_map(%f) error %f", x, err);
+		}
+
+		points = random_map(xy, 120, 100, 0.5);
+		for (int i = 0; i < points; i++)
+			xy[i][0] -= 20;
+		temp_map_from(&sm, xy, points);
+		temp_map_compile(&maps, &m, &sm);
+		for (int k = 0; k < RANDOM_VALUES; k++) {
+			x = rand_range(-30, 110);
+			err = fabs(eval_map(&m, x, Q16_FRAC) - ref_map(xy, points, x));
+			max_err_temp = fmax(max_err_temp, err);
+			CHECK(err <= TEMP_TOLERANCE, "temp_map(%f) error %f", x, err);
+		}
+	}
+}
+
+
+/* Floating-point calculate_pwm_duty() for (unfiltered) sensor source */
+static double ref_pwm_duty(const struct fan_output *fan, const double sxy[][2], int spoints,
+			const double pxy[][2], int ppoints, double temp)
+{
+	double val = ref_map(sxy, spoints, temp);
+
+	val = ref_map(pxy, ppoints, val);
+	val *= fan->pwm_coefficient;
+	if (val < fan->min_pwm) val = fan->min_pwm;
+	if (val > fan->max_pwm) val = fan->max_pwm;
+	return val;
+}
+
+/* Floating-point calculate_tacho_freq() for (average of) fan sources */
+static double ref_tacho_freq(const struct mb_input *mbfan, const struct fanpico_state *st,
+			const struct fanpico_control_config *config,
+			const double xy[][2], int points)
+{
+	double sum = 0, val;
+	int count = 0;
+
+	for (int i = 0; i < FAN_COUNT; i++) {
+		if (mbfan->sources[i]) {
+			sum += st->fan_freq[i] * 60.0 / config->fans[i].rpm_factor;
+			count++;
+		}
+	}
+	val = ref_map(xy, points, sum / count);
+	val *= mbfan->rpm_coefficient;
+	if (val < mbfan->min_rpm) val = mbfan->min_rpm;
+	if (val > mbfan->max_rpm) val = mbfan->max_rpm;
+	return val / 60.0 * mbfan->rpm_factor;
+}
+
+
+static void test_calculate()
+{
+	static struct fanpico_control_config config;
+	static struct fanpico_state st;
+	double sxy[MAX_MAP_POINTS][2], pxy[MAX_MAP_POINTS][2], txy[MAX_MAP_POINTS][2];
+	int spoints, ppoints, tpoints;
+	double ref, res, err, tol;
+
+	for (int n = 0; n < RANDOM_MAPS; n++) {
+		struct fan_output *fan = &config.fans[0];
+		struct mb_input *mbfan = &config.mbfans[0];
+
+		memset(&config, 0, sizeof(config));
+		memset(&st, 0, sizeof(st));
+
+		/* fan1 follows sensor1 */
+		spoints = random_map(sxy, 80, 100, 0.5);
+		temp_map_from(&config.sensors[0].map, sxy, spoints);
+		ppoints = random_map(pxy, 100, 100, 1.0);
+		pwm_map_from(&fan->map, pxy, ppoints);
+		fan->s_type = PWM_SENSOR;
+		fan->s_id = 0;
+		fan->pwm_coefficient = rand_range(0.5, 1.5);
+		fan->min_pwm = rand() % 30;
+		fan->max_pwm = 70 + rand() % 31;
+
+		/* mbfan1 reports average of fans 1-4 */
+		tpoints = random_map(txy, 6000, 6000, 100.0);
+		tacho_map_from(&mbfan->map, txy, tpoints);
+		mbfan->s_type = TACHO_AVG;
+		for (int i = 0; i < 4; i++) {
+			mbfan->sources[i] = 1;
+			config.fans[i].rpm_factor = 1 + rand() % 4;
+		}
+		mbfan->rpm_coefficient = rand_range(0.5, 1.5);
+		mbfan->rpm_factor = 2;
+		mbfan->min_rpm = rand() % 500;
+		mbfan->max_rpm = 5000 + rand() % 5000;
+		fan_output_compile(fan);
+		mb_input_compile(mbfan);
+		pwl_maps_compile(&config.maps, &config);
+
+		for (int k = 0; k < RANDOM_VALUES / 10; k++) {
+			st.temp[0] = rand_range(0, 80);
+			ref = ref_pwm_duty(fan, sxy, spoints, pxy, ppoints, st.temp[0]);
+			res = calculate_pwm_duty(&st, &config, 0);
+			err = fabs(res - ref);
+			max_err_duty = fmax(max_err_duty, err);
+			/* Rounding error of intermediate value (Q16.16) is amplified by pwm map */
+			tol = (PWM_TOLERANCE + ldexp(TEMP_TOLERANCE, 0) * max_slope(pxy, ppoints))
+				* fan->pwm_coefficient;
+			CHECK(err <= tol, "calculate_pwm_duty(%f): %f, expected %f",
+				st.temp[0], res, ref);
+
+			for (int i = 0; i < 4; i++)
+				st.fan_freq[i] = rand_range(0, 200);
+			ref = ref_tacho_freq(mbfan, &st, &config, txy, tpoints);
+			res = calculate_tacho_freq(&st, &config, 0);
+			err = fabs(res - ref);
+			max_err_freq = fmax(max_err_freq, err);
+			/* Fan frequencies are rounded to Q20.12 (and multiplied by 60)
+			   before tacho map, and coefficient (Q16.16) adds relative error */
+			tol = (RPM_TOLERANCE + ldexp(60.0, -13) * max_slope(txy, tpoints))
+				* mbfan->rpm_coefficient / 60.0 * mbfan->rpm_factor
+				+ ref * ldexp(1.0, -15);
+			CHECK(err <= tol, "calculate_tacho_freq(): %f, expected %f", res, ref);
+		}
+	}
+
+	printf("max error: pwm_map %.5f%%, tacho_map %.4f RPM, temp_map %.5f%%\n",
+		max_err_pwm, max_err_rpm, max_err_temp);
+	printf("max error: calculate_pwm_duty %.5f%%, calculate_tacho_freq %.5f Hz\n",
+		max_err_duty, max_err_freq);
+}
+
+
+/* Time fixed-point calculations against the floating-point reference.
+ * (This host has an FPU, so this mostly shows that fixed-point is not
+ * slower; on RP2040 double math is done in software.)
+ */
+static void benchmark()
+{
+	static struct fanpico_control_config config;
+	static struct fanpico_state st;
+	double sxy[4][2] = { {20, 0}, {30, 20}, {40, 60}, {50, 100} };
+	double pxy[2][2] = { {0, 0}, {100, 100} };
+	struct fan_output *fan = &config.fans[0];
+	const int count = 2000000;
+	uint64_t t0, t1, t2;
+	double sum = 0;
+
+	memset(&config, 0, sizeof(config));
+	memset(&st, 0, sizeof(st));
+	temp_map_from(&config.sensors[0].map, sxy, 4);
+	pwm_map_from(&fan->map, pxy, 2);
+	fan->s_type = PWM_SENSOR;
+	fan->pwm_coefficient = 1.0;
+	fan->max_pwm = 100;
+	fan_output_compile(fan);
+	pwl_maps_compile(&config.maps, &config);
+
+	t0 = test_time_ns();
+	for (int n = 0; n < count; n++) {
+		st.temp[0] = 15.0 + (n % 400) * 0.1;
+		sum += calculate_pwm_duty(&st, &config, 0);
+	}
+	t1 = test_time_ns();
+	for (int n = 0; n < count; n++)
+		sum += ref_pwm_duty(fan, sxy, 4, pxy, 2, 15.0 + (n % 400) * 0.1);
+	t2 = test_time_ns();
+	test_sink = sum;
+
+	printf("benchmark: calculate_pwm_duty: fixed-point %.1f ns/call, floating-point %.1f ns/call\n",
+		(t1 - t0) / (double)count, (t2 - t1) / (double)count);
+}
+
+
+int main(int argc, char **argv)
+{
+	srand(1);
+	test_conversions();
+	test_mul();
+	test_maps();
+	test_calculate();
+	benchmark();
+
+	return TEST_RESULT();
+}
+
+
+/* eof :-) */
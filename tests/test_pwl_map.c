@@ -0,0 +1,315 @@
+/* test_pwl_map.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fanpico.h"
+#include "test_util.h"
+
+
+/*
+ * Property tests for pwl_map.c: compiled maps (binary search + slope)
+ * and maps evaluated directly from the points must give same results
+ * as the linear scan used before, for random maps (including repeated
+ * X values) and random inputs.
+ */
+
+#define RANDOM_MAPS     2000
+#define RANDOM_VALUES   200
+
+static struct pwl_maps maps;
+
+
+/* Linear scan with interpolation (the original pwm_map() implementation),
+ * on map converted to doubles. Single point maps are handled explicitly,
+ * original read past the last point for those.
+ */
+static double scan_map(const double xy[][2], int points, double val)
+{
+	int i;
+
+	if (val <= xy[0][0] || points < 2)
+		return xy[0][1];
+
+	i = 1;
+	while (i < points - 1 && xy[i][0] < val)
+		i++;
+
+	if (val >= xy[i][0])
+		return xy[i][1];
+
+	return xy[i-1][1] + (xy[i][1] - xy[i-1][1]) / (xy[i][0] - xy[i-1][0])
+		* (val - xy[i-1][0]);
+}
+
+
+static double rand_range(double lo, double hi)
+{
+	return lo + (hi - lo) * (rand() / (double)RAND_MAX);
+}
+
+
+/* Random map with non-decreasing X values (some repeated). */
+static int random_map(double xy[][2], double max_x, double max_y, bool integer)
+{
+	int points = 1 + rand() % MAX_MAP_POINTS;
+	double x = rand_range(0, max_x / 4);
+
+	for (int i = 0; i < points; i++) {
+		if (i > 0 && rand() % 8)
+			x += rand_range(0, (max_x - x) / (points - i));
+		xy[i][0] = (integer ? floor(x) : x);
+		xy[i][1] = rand_range(0, max_y);
+		if (integer)
+			xy[i][1] = floor(xy[i][1]);
+	}
+	return points;
+}
+
+
+static void check_properties(const char *name, const double xy[][2], int points,
+			double (*eval)(const void *, double), const void *map)
+{
+	double ymin = xy[0][1], ymax = xy[0][1];
+	double tol;
+
+	for (int i = 1; i < points; i++) {
+		ymin = fmin(ymin, xy[i][1]);
+		ymax = fmax(ymax, xy[i][1]);
+	}
+	/* Slopes are stored as floats */
+	tol = 1e-5 * (1.0 + ymax);
+
+	/* Random values (including outside of map range) */
+	for (int n = 0; n < RANDOM_VALUES; n++) {
+		double x = rand_range(xy[0][0] - 10, xy[points-1][0] + 10);
+		double ref = scan_map(xy, points, x);
+		double y = eval(map, x);
+
+		CHECK(fabs(y - ref) <= tol, "%s: %d points, f(%f) = %f, expected %f",
+			name, points, x, y, ref);
+		CHECK(y >= ymin - tol && y <= ymax + tol, "%s: f(%f) = %f out of range",
+			name, x, y);
+	}
+
+	/* Map points (with unique X value) map exactly */
+	for (int i = 0; i < points; i++) {
+		if ((i > 0 && xy[i-1][0] == xy[i][0])
+			|| (i < points - 1 && xy[i+1][0] == xy[i][0]))
+			continue;
+		double y = eval(map, xy[i][0]);
+		CHECK(fabs(y - xy[i][1]) <= tol, "%s: f(%f) = %f, expected map point %f",
+			name, xy[i][0], y, xy[i][1]);
+	}
+}
+
+
+static double eval_compiled(const void *map, double val)
+{
+	return pwl_eval(&maps, map, val);
+}
+
+static double eval_pwm(const void *map, double val)
+{
+	return pwm_map(map, val);
+}
+
+static double eval_tacho(const void *map, double val)
+{
+	return tacho_map(map, val);
+}
+
+static double eval_temp(const void *map, double val)
+{
+	return temp_map(map, val);
+}
+
+
+static void test_random_maps()
+{
+	double xy[MAX_MAP_POINTS][2];
+	struct pwm_map pm;
+	struct tacho_map tm;
+	struct temp_map sm;
+	struct pwl_map m;
+	int points;
+
+	for (int n = 0; n < RANDOM_MAPS; n++) {
+		pwl_maps_init(&maps);
+		points = random_map(xy, 100, 100, true);
+		pm.points = points;
+		for (int i = 0; i < points; i++) {
+			pm.pwm[i][0] = xy[i][0];
+			pm.pwm[i][1] = xy[i][1];
+		}
+		CHECK(pwm_map_compile(&maps, &m, &pm), "pwm_map_compile() failed");
+		check_properties("pwm_map (compiled)", xy, points, eval_compiled, &m);
+		check_properties("pwm_map", xy, points, eval_pwm, &pm);
+
+		points = random_map(xy, 10000, 20000, true);
+		tm.points = points;
+		for (int i = 0; i < points; i++) {
+			tm.tacho[i][0] = xy[i][0];
+			tm.tacho[i][1] = xy[i][1];
+		}
+		CHECK(tacho_map_compile(&maps, &m, &tm), "tacho_map_compile() failed");
+		check_properties("tacho_map (compiled)", xy, points, eval_compiled, &m);
+		check_properties("tacho_map", xy, points, eval_tacho, &tm);
+
+		points = random_map(xy, 120, 100, false);
+		sm.points = points;
+		for (int i = 0; i < points; i++) {
+			sm.temp[i][0] = xy[i][0] - 20;
+			sm.temp[i][1] = xy[i][1];
+		}
+		/* Reference uses same (float) points as the map */
+		for (int i = 0; i < points; i++) {
+			xy[i][0] = sm.temp[i][0];
+			xy[i][1] = sm.temp[i][1];
+		}
+		CHECK(temp_map_compile(&maps, &m, &sm), "temp_map_compile() failed");
+		check_properties("temp_map (compiled)", xy, points, eval_compiled, &m);
+		check_properties("temp_map", xy, points, eval_temp, &sm);
+	}
+}
+
+
+static void test_monotonic()
+{
+	struct pwm_map pm = { .points = 4, .pwm = { {20, 0}, {40, 30}, {60, 30}, {80, 100} } };
+	struct pwl_map m;
+	double prev = -1;
+
+	pwl_maps_init(&maps);
+	pwm_map_compile(&maps, &m, &pm);
+	for (double x = 0; x <= 100; x += 0.01) {
+		double y = pwl_eval(&maps, &m, x);
+		CHECK(y >= prev, "pwm_map not monotonic at %f: %f < %f", x, y, prev);
+		prev = y;
+	}
+	CHECK(pwl_eval(&maps, &m, 50) == 30, "flat segment: %f", pwl_eval(&maps, &m, 50));
+	CHECK(fabs(pwl_eval(&maps, &m, 70) - 65) < 1e-5, "f(70) = %f", pwl_eval(&maps, &m, 70));
+}
+
+
+static void test_single_point()
+{
+	struct temp_map sm = { .points = 1, .temp = { {25.0, 42.0} } };
+	struct pwl_map m;
+
+	pwl_maps_init(&maps);
+	temp_map_compile(&maps, &m, &sm);
+	CHECK(pwl_eval(&maps, &m, -10) == 42.0, "single point map (below)");
+	CHECK(pwl_eval(&maps, &m, 25) == 42.0, "single point map (at)");
+	CHECK(pwl_eval(&maps, &m, 100) == 42.0, "single point map (above)");
+	CHECK(temp_map(&sm, 100) == 42.0, "single point map (points)");
+}
+
+
+/* Maps share segment pool: segments are allocated based on number of
+ * points, map without points is zero map, and maps that do not fit in
+ * the pool are truncated.
+ */
+static void test_pool()
+{
+	static struct fanpico_control_config config;
+	struct temp_map sm = { .points = MAX_MAP_POINTS };
+	struct pwl_map m;
+	int count = 0;
+
+	memset(&config, 0, sizeof(config));
+	config.fans[0].map = (struct pwm_map){ .points = 2, .pwm = { {0, 0}, {100, 100} } };
+	config.sensors[0].map = (struct temp_map){ .points = 3, .temp = { {20, 0}, {40, 50}, {60, 100} } };
+	pwl_maps_compile(&config.maps, &config);
+	CHECK(config.maps.used == 1 + 2 + 3, "pool used: %u", config.maps.used);
+	CHECK(pwl_eval(&config.maps, &config.maps.fans[0], 42) == 42, "fan1 map");
+	CHECK(pwl_eval(&config.maps, &config.maps.sensors[0], 30) == 25, "sensor1 map");
+	CHECK(pwl_eval(&config.maps, &config.maps.fans[1], 42) == 0, "empty map");
+
+	for (int i = 0; i < MAX_MAP_POINTS; i++) {
+		sm.temp[i][0] = i;
+		sm.temp[i][1] = i;
+	}
+	pwl_maps_init(&maps);
+	while (temp_map_compile(&maps, &m, &sm))
+		count++;
+	CHECK(count == (PWL_POOL_SIZE - 1) / MAX_MAP_POINTS, "%d full maps fit in pool", count);
+	CHECK(m.count == (PWL_POOL_SIZE - 1) % MAX_MAP_POINTS, "truncated map: %u", m.count);
+	CHECK(maps.used == PWL_POOL_SIZE, "pool used: %u", maps.used);
+	CHECK(!temp_map_compile(&maps, &m, &sm), "full pool");
+	CHECK(pwl_eval(&maps, &m, 10) == 0, "map not fitting in pool");
+}
+
+
+/* Compare evaluation speed of compiled map against linear scan. */
+static void benchmark()
+{
+	const int sizes[] = { 2, 8, 32 };
+	const int count = 2000000;
+	double xy[MAX_MAP_POINTS][2];
+	struct temp_map sm;
+	struct pwl_map m;
+	uint64_t t0, t1, t2;
+	double sum = 0;
+
+	for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		int points = sizes[s];
+
+		sm.points = points;
+		for (int i = 0; i < points; i++) {
+			sm.temp[i][0] = xy[i][0] = 20.0 + i * 60.0 / points;
+			sm.temp[i][1] = xy[i][1] = i * 100.0 / points;
+		}
+		pwl_maps_init(&maps);
+		temp_map_compile(&maps, &m, &sm);
+
+		t0 = test_time_ns();
+		for (int n = 0; n < count; n++)
+			sum += scan_map(xy, points, 15.0 + (n % 700) * 0.1);
+		t1 = test_time_ns();
+		for (int n = 0; n < count; n++)
+			sum += pwl_eval(&maps, &m, 15.0 + (n % 700) * 0.1);
+		t2 = test_time_ns();
+
+		printf("benchmark: %2d points: linear scan %.1f ns/eval, compiled map %.1f ns/eval\n",
+			points, (t1 - t0) / (double)count, (t2 - t1) / (double)count);
+	}
+	test_sink = sum;
+}
+
+
+int main(int argc, char **argv)
+{
+	srand(1);
+	test_random_maps();
+	test_monotonic();
+	test_single_point();
+	test_pool();
+	benchmark();
+
+	return TEST_RESULT();
+}
+
+
+/* eof :-) */
@@ -0,0 +1,275 @@
+/* test_scheduler.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "scheduler.h"
+#include "test_util.h"
+
+
+/*
+ * Tests for scheduler.c using a simulated clock. Tasks advance the
+ * clock to simulate their execution time.
+ */
+
+static uint64_t sim_now = 0;
+
+static uint64_t sim_clock()
+{
+	return sim_now;
+}
+
+
+struct task_ctx {
+	uint32_t exec_us;       /* simulated execution time */
+	int ret;                /* value to return */
+	int calls;
+	uint64_t last_start;
+	char tag;
+};
+
+static char run_log[256];
+static int run_log_len = 0;
+
+
+static int sim_task(void *arg)
+{
+	struct task_ctx *c = arg;
+
+	c->calls++;
+	c->last_start = sim_now;
+	if (run_log_len < sizeof(run_log) - 1)
+		run_log[run_log_len++] = c->tag;
+	sim_now += c->exec_us;
+
+	return c->ret;
+}
+
+
+/* Run scheduler until given time, jumping directly to next deadline
+ * (like the firmware does when sleeping with WFE).
+ */
+static int run_until(scheduler_t *s, uint64_t end)
+{
+	int loops = 0;
+
+	while (sim_now < end) {
+		uint64_t next = sched_run(s);
+		loops++;
+		if (next == SCHED_NO_DEADLINE || next >= end) {
+			sim_now = end;
+			break;
+		}
+		if (next > sim_now)
+			sim_now = next;
+	}
+
+	return loops;
+}
+
+
+static void test_core_assignment()
+{
+	struct task_ctx a = { .tag = 'a' }, b = { .tag = 'b' };
+	const struct sched_task tasks[] = {
+		{ "a", 0, 10, sim_task, &a },
+		{ "b", 1, 10, sim_task, &b },
+		{ "c", 1, 10, NULL, NULL },
+	};
+	scheduler_t s0, s1;
+
+	sim_now = 1000;
+	CHECK(sched_init(&s0, tasks, 3, 0, sim_clock) == 1, "core0 task count");
+	CHECK(sched_init(&s1, tasks, 3, 1, sim_clock) == 1, "core1 task count (NULL func skipped)");
+	CHECK(s0.tasks[0].task == &tasks[0] && s1.tasks[0].task == &tasks[1], "wrong tasks assigned");
+	CHECK(sched_next_deadline(&s0) == 1000, "tasks should be due immediately");
+}
+
+
+static void test_max_tasks()
+{
+	struct sched_task tasks[SCHED_MAX_TASKS + 3];
+	struct task_ctx c = { .tag = 'x' };
+	scheduler_t s;
+
+	for (int i = 0; i < SCHED_MAX_TASKS + 3; i++)
+		tasks[i] = (struct sched_task){ "x", 0, 10, sim_task, &c };
+	sim_now = 0;
+	CHECK(sched_init(&s, tasks, SCHED_MAX_TASKS + 3, 0, sim_clock) == SCHED_MAX_TASKS,
+		"task count should be limited to SCHED_MAX_TASKS");
+	CHECK(sched_task_count(tasks, SCHED_MAX_TASKS + 3, 0) == SCHED_MAX_TASKS + 3,
+		"sched_task_count() should count all tasks");
+	CHECK(sched_task_count(tasks, SCHED_MAX_TASKS + 3, 1) == 0, "no tasks on core1");
+}
+
+
+static void test_order_and_period()
+{
+	struct task_ctx a = { .tag = 'a', .exec_us = 100 };
+	struct task_ctx b = { .tag = 'b', .exec_us = 200 };
+	const struct sched_task tasks[] = {
+		{ "a", 0, 10, sim_task, &a },
+		{ "b", 0, 25, sim_task, &b },
+	};
+	scheduler_t s;
+	int loops;
+
+	sim_now = 0;
+	run_log_len = 0;
+	sched_init(&s, tasks, 2, 0, sim_clock);
+	loops = run_until(&s, 100000);
+	run_log[run_log_len] = 0;
+
+	/* Fixed rate: a runs at 0,10,...,90ms and b at 0,25,50,75ms */
+	CHECK(a.calls == 10, "task a calls: %d", a.calls);
+	CHECK(b.calls == 4, "task b calls: %d", b.calls);
+	CHECK(strncmp(run_log, "abaab", 5) == 0, "unexpected run order: %s", run_log);
+	/* Scheduler should only wake up when a task is due */
+	CHECK(loops <= 15, "too many scheduler iterations: %d", loops);
+
+	/* b runs after a at t=0, so it started 100us late */
+	CHECK(s.tasks[1].stats.late_max >= 100, "late_max for b: %u", s.tasks[1].stats.late_max);
+	CHECK(s.tasks[0].stats.exec_max == 100 && s.tasks[1].stats.exec_max == 200,
+		"exec_max: %u %u", s.tasks[0].stats.exec_max, s.tasks[1].stats.exec_max);
+	CHECK(s.tasks[0].stats.exec_total == 1000, "exec_total: %llu",
+		(unsigned long long)s.tasks[0].stats.exec_total);
+	CHECK(s.tasks[0].stats.runs == 10, "runs: %u", s.tasks[0].stats.runs);
+	/* 100us falls into bucket [64, 128) */
+	CHECK(s.tasks[0].stats.exec_hist[7] == 10, "exec histogram bucket: %u",
+		s.tasks[0].stats.exec_hist[7]);
+
+	/* Reset is done by the scheduler itself on next run */
+	sched_reset_stats(&s);
+	CHECK(s.tasks[0].stats.runs == 10, "stats reset too early");
+	sim_now = 100000;
+	sched_run(&s);
+	CHECK(s.tasks[0].stats.runs == 1 && s.tasks[0].stats.exec_total == 100,
+		"stats not reset: %u", s.tasks[0].stats.runs);
+}
+
+
+static void test_return_values()
+{
+	struct task_ctx a = { .tag = 'a', .ret = 50 };
+	struct task_ctx b = { .tag = 'b', .ret = -1 };
+	const struct sched_task tasks[] = {
+		{ "a", 0, 10, sim_task, &a },
+		{ "b", 0, 10, sim_task, &b },
+	};
+	scheduler_t s;
+
+	sim_now = 0;
+	sched_init(&s, tasks, 2, 0, sim_clock);
+	run_until(&s, 120000);
+
+	/* a requested 50ms delay: runs at 0, 50, 100ms */
+	CHECK(a.calls == 3 && a.last_start == 100000, "delay override: calls=%d last=%llu",
+		a.calls, (unsigned long long)a.last_start);
+	/* b disabled itself after first run */
+	CHECK(b.calls == 1 && !s.tasks[1].active, "disable: calls=%d", b.calls);
+	CHECK(sched_next_deadline(&s) == 150000, "next deadline: %llu",
+		(unsigned long long)sched_next_deadline(&s));
+}
+
+
+static void test_overrun()
+{
+	/* Task that takes longer than its period should not try to
+	   catch up by running back-to-back. */
+	struct task_ctx a = { .tag = 'a', .exec_us = 35000 };
+	const struct sched_task tasks[] = {
+		{ "a", 0, 10, sim_task, &a },
+	};
+	scheduler_t s;
+
+	sim_now = 0;
+	sched_init(&s, tasks, 1, 0, sim_clock);
+	sched_run(&s);
+	CHECK(s.tasks[0].next_run == 45000, "next run after overrun: %llu",
+		(unsigned long long)s.tasks[0].next_run);
+
+	/* Start late: lateness is recorded */
+	sim_now = 52000;
+	sched_run(&s);
+	CHECK(s.tasks[0].stats.late_max == 7000, "late_max: %u", s.tasks[0].stats.late_max);
+}
+
+
+static void test_long_run()
+{
+	/* Simulate a day of the core1 task table timing (periods only) */
+	struct task_ctx c[6];
+	const uint32_t periods[6] = { 10, 10, 250, 500, 1000, 20 };
+	struct sched_task tasks[6];
+	scheduler_t s;
+
+	for (int i = 0; i < 6; i++) {
+		memset(&c[i], 0, sizeof(c[i]));
+		c[i].exec_us = 50;
+		c[i].tag = '0' + i;
+		tasks[i] = (struct sched_task){ "t", 1, periods[i], sim_task, &c[i] };
+	}
+	sim_now = 0;
+	sched_init(&s, tasks, 6, 1, sim_clock);
+	run_until(&s, 86400ULL * 1000000);
+	for (int i = 0; i < 6; i++) {
+		uint64_t expected = 86400ULL * 1000 / periods[i];
+		CHECK(c[i].calls >= expected - 1 && c[i].calls <= expected + 1,
+			"task%d: calls=%d expected=%llu", i, c[i].calls,
+			(unsigned long long)expected);
+	}
+}
+
+
+static void test_latency_stats()
+{
+	struct sched_latency_stats l;
+
+	memset(&l, 0, sizeof(l));
+	sched_latency_add(&l, 0);
+	sched_latency_add(&l, 1);
+	sched_latency_add(&l, 1000);
+	sched_latency_add(&l, 0xffffffff);
+	CHECK(l.count == 4 && l.last == 0xffffffff && l.max == 0xffffffff, "latency stats");
+	CHECK(l.hist[0] == 1 && l.hist[1] == 1 && l.hist[10] == 1
+		&& l.hist[SCHED_HIST_BUCKETS - 1] == 1, "latency histogram");
+	CHECK(sched_hist_bucket_limit(0) == 1 && sched_hist_bucket_limit(10) == 1024,
+		"bucket limits");
+	CHECK(sched_hist_bucket_limit(SCHED_HIST_BUCKETS - 1) == 0, "last bucket has no limit");
+}
+
+
+int main(int argc, char **argv)
+{
+	test_core_assignment();
+	test_max_tasks();
+	test_order_and_period();
+	test_return_values();
+	test_overrun();
+	test_long_run();
+	test_latency_stats();
+
+	return TEST_RESULT();
+}
+
+
+/* eof :-) */
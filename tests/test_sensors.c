@@ -0,0 +1,224 @@
+/* test_sensors.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fanpico.h"
+#include "fake_hal.h"
+#include "test_util.h"
+
+
+/*
+ * Tests for thermistor temperature conversion in sensors.c: lookup table
+ * (with linear interpolation) against exact Beta equation, for every
+ * ADC code (and for fractional, oversampled, values).
+ */
+
+/* Maximum allowed errors (C) in the normal (-20C..100C) range and
+ * near the ends of the (usable) ADC range. */
+#define NORMAL_TOLERANCE  0.01
+#define END_TOLERANCE     0.1
+#define NORMAL_MIN_TEMP   -20.0
+#define NORMAL_MAX_TEMP   100.0
+
+static struct fanpico_config test_config;
+const struct fanpico_config *cfg = &test_config;
+
+struct thermistor {
+	float nominal;
+	float temp_nominal;
+	float beta;
+};
+
+static const struct thermistor thermistors[] = {
+	{ 10000.0, 25.0, 3950.0 },  /* default */
+	{ 10000.0, 25.0, 3435.0 },
+	{ 100000.0, 25.0, 4250.0 },
+	{ 47000.0, 25.0, 4050.0 },
+};
+
+
+/* Beta equation, same as thermistor_temp() in sensors.c. */
+static double beta_temp(double raw, const struct thermistor *th)
+{
+	double r = SENSOR_SERIES_RESISTANCE / ((double)ADC_MAX_VALUE / raw - 1);
+
+	return 1.0 / (log(r / th->nominal) / th->beta
+		+ 1.0 / (th->temp_nominal + 273.15)) - 273.15;
+}
+
+
+static void setup(struct fanpico_control_config *config, const struct thermistor *th)
+{
+	struct sensor_input *s = &config->sensors[0];
+
+	memset(config, 0, sizeof(*config));
+	config->adc_vref = ADC_REF_VOLTAGE;
+	s->type = TEMP_EXTERNAL;
+	s->thermistor_nominal = th->nominal;
+	s->temp_nominal = th->temp_nominal;
+	s->beta_coefficient = th->beta;
+	s->temp_coefficient = 1.0;
+	s->temp_offset = 0.0;
+	sensor_input_compile(s);
+	thermistor_lut_build(&config->thermistor_lut[0], s);
+}
+
+
+static bool usable_code(double raw)
+{
+	double volt = raw * (ADC_REF_VOLTAGE / ADC_MAX_VALUE);
+
+	return (volt > 0.1 && volt < ADC_REF_VOLTAGE - 0.1);
+}
+
+
+static void test_lut(const struct thermistor *th, double step)
+{
+	static struct fanpico_control_config config;
+	double max_normal = 0, max_end = 0, at_normal = 0, at_end = 0;
+
+	setup(&config, th);
+
+	for (double raw = 0; raw < ADC_MAX_VALUE; raw += step) {
+		fake_adc_set(SENSOR1_READ_ADC, raw);
+		double t = get_temperature(0, &config);
+
+		if (!usable_code(raw)) {
+			CHECK(t == 0.0, "raw=%.2f outside usable range: %f", raw, t);
+			continue;
+		}
+
+		double ref = beta_temp(raw, th);
+		double err = fabs(t - ref);
+		if (ref >= NORMAL_MIN_TEMP && ref <= NORMAL_MAX_TEMP) {
+			if (err > max_normal) {
+				max_normal = err;
+				at_normal = raw;
+			}
+			CHECK(err <= NORMAL_TOLERANCE, "%.0f/%.0f: raw=%.2f: %f, expected %f",
+				th->nominal, th->beta, raw, t, ref);
+		} else {
+			if (err > max_end) {
+				max_end = err;
+				at_end = raw;
+			}
+			CHECK(err <= END_TOLERANCE, "%.0f/%.0f: raw=%.2f: %f, expected %f",
+				th->nominal, th->beta, raw, t, ref);
+		}
+	}
+
+	printf("thermistor %6.0f/%4.0f (step %.2f): max error %.5fC (raw=%.2f) in normal range, %.5fC (raw=%.2f) near ends\n",
+		th->nominal, th->beta, step, max_normal, at_normal, max_end, at_end);
+}
+
+
+/* Lookup table is only rebuilt when thermistor parameters change, and
+ * Beta equation is used if table does not match sensor configuration.
+ */
+static void test_lut_build()
+{
+	static struct fanpico_control_config config;
+	struct sensor_input *s = &config.sensors[0];
+	double t;
+
+	setup(&config, &thermistors[0]);
+	CHECK(!thermistor_lut_build(&config.thermistor_lut[0], s),
+		"table rebuilt without parameter change");
+
+	s->beta_coefficient = thermistors[1].beta;
+	fake_adc_set(SENSOR1_READ_ADC, 1500);
+	t = get_temperature(0, &config);
+	CHECK(fabs(t - thermistor_temp(1500, s)) < 0.0001, "stale table used: %f", t);
+
+	CHECK(thermistor_lut_build(&config.thermistor_lut[0], s),
+		"table not rebuilt after parameter change");
+	t = get_temperature(0, &config);
+	CHECK(fabs(t - beta_temp(1500, &thermistors[1])) <= NORMAL_TOLERANCE,
+		"rebuilt table: %f", t);
+}
+
+
+/* Compare thermistor_lut_temp() (lookup table) against thermistor_temp()
+ * (Beta equation). Internal sensor (no thermistor conversion) shows the
+ * fixed overhead of get_temperature().
+ *
+ * Note, on host (with FPU) this only shows relative cost, on target
+ * SYS:BENCH? reports CPU cycles of the same functions.
+ */
+static void benchmark()
+{
+	static struct fanpico_control_config config;
+	const struct thermistor_lut *lut = &config.thermistor_lut[0];
+	const int count = 2000000;
+	uint64_t t0, t1, t2, t3;
+	double sum = 0;
+
+	setup(&config, &thermistors[0]);
+
+	t0 = test_time_ns();
+	for (int n = 0; n < count; n++)
+		sum += thermistor_temp(200 + (n & 2047), &config.sensors[0]);
+	t1 = test_time_ns();
+	for (int n = 0; n < count; n++)
+		sum += thermistor_lut_temp(lut, 200 + (n & 2047));
+	t2 = test_time_ns();
+	config.sensors[0].type = TEMP_INTERNAL;
+	for (int n = 0; n < count; n++) {
+		fake_adc_set(SENSOR1_READ_ADC, 200 + (n & 2047));
+		sum += get_temperature(0, &config);
+	}
+	t3 = test_time_ns();
+
+	printf("benchmark: thermistor_temp() %.1f ns/conversion, thermistor_lut_temp() %.1f ns, get_temperature() (internal sensor) %.1f ns\n",
+		(t1 - t0) / (double)count, (t2 - t1) / (double)count,
+		(t3 - t2) / (double)count);
+	test_sink = sum;
+}
+
+
+int main(int argc, char **argv)
+{
+	fake_hal_reset();
+	fake_log_level = LOG_ERR;
+
+	/* Oversampled (fractional) readings via ADC sampler */
+	adc_sampler_start(ADC_OVERSAMPLE);
+	for (int i = 0; i < sizeof(thermistors) / sizeof(thermistors[0]); i++) {
+		test_lut(&thermistors[i], 1.0);
+		test_lut(&thermistors[i], 0.125);
+	}
+
+	/* Direct (averaged) ADC reads */
+	adc_sampler_stop();
+	test_lut(&thermistors[0], 1.0);
+	test_lut_build();
+
+	benchmark();
+
+	return TEST_RESULT();
+}
+
+
+/* eof :-) */
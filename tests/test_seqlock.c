@@ -0,0 +1,142 @@
+/* test_seqlock.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "seqlock.h"
+#include "test_util.h"
+
+
+/*
+ * Stress test for seqlock: one writer thread keeps publishing snapshots
+ * where every word holds the same (increasing) value, while reader
+ * threads verify that every snapshot they get is consistent (no torn
+ * reads) and that snapshots never go backwards in time.
+ */
+
+#define SNAPSHOT_WORDS  128  /* about size of struct fanpico_state */
+#define READERS         3
+#define WRITES          2000000
+
+struct snapshot {
+	uint32_t value[SNAPSHOT_WORDS];
+};
+
+struct reader_result {
+	uint64_t reads;
+	uint64_t torn;
+	uint64_t backwards;
+	uint64_t seq_mismatch;
+};
+
+static struct snapshot buf[2];
+static seqlock_t lock;
+static volatile int writer_done = 0;
+
+
+static void* writer_thread(void *arg)
+{
+	struct snapshot s;
+
+	for (uint32_t n = 1; n <= WRITES; n++) {
+		for (int i = 0; i < SNAPSHOT_WORDS; i++)
+			s.value[i] = n;
+		seqlock_write(&lock, &s);
+	}
+	__atomic_store_n(&writer_done, 1, __ATOMIC_SEQ_CST);
+
+	return NULL;
+}
+
+
+static void* reader_thread(void *arg)
+{
+	struct reader_result *res = arg;
+	struct snapshot s;
+	uint32_t last = 0;
+
+	memset(res, 0, sizeof(*res));
+
+	while (!__atomic_load_n(&writer_done, __ATOMIC_SEQ_CST)) {
+		uint32_t seq = seqlock_read(&lock, &s);
+		uint32_t v = s.value[0];
+
+		res->reads++;
+		for (int i = 1; i < SNAPSHOT_WORDS; i++) {
+			if (s.value[i] != v) {
+				res->torn++;
+				break;
+			}
+		}
+		if (v < last)
+			res->backwards++;
+		/* Snapshot 'n' is published with sequence number 2*n */
+		if (seq != v * 2)
+			res->seq_mismatch++;
+		last = v;
+	}
+
+	return NULL;
+}
+
+
+int main(int argc, char **argv)
+{
+	pthread_t writer, readers[READERS];
+	struct reader_result res[READERS];
+	uint64_t total = 0;
+
+	memset(buf, 0, sizeof(buf));
+	seqlock_init(&lock, &buf[0], &buf[1], sizeof(struct snapshot));
+
+	for (int i = 0; i < READERS; i++)
+		pthread_create(&readers[i], NULL, reader_thread, &res[i]);
+	pthread_create(&writer, NULL, writer_thread, NULL);
+
+	pthread_join(writer, NULL);
+	for (int i = 0; i < READERS; i++) {
+		pthread_join(readers[i], NULL);
+		printf("reader%d: reads=%llu torn=%llu backwards=%llu seq_mismatch=%llu\n",
+			i, (unsigned long long)res[i].reads,
+			(unsigned long long)res[i].torn,
+			(unsigned long long)res[i].backwards,
+			(unsigned long long)res[i].seq_mismatch);
+		CHECK(res[i].torn == 0, "reader%d: torn reads", i);
+		CHECK(res[i].backwards == 0, "reader%d: snapshot went backwards", i);
+		CHECK(res[i].seq_mismatch == 0, "reader%d: sequence does not match data", i);
+		total += res[i].reads;
+	}
+	CHECK(total > 0, "readers did not get to run");
+
+	/* Final state must be the last published snapshot */
+	struct snapshot s;
+	uint32_t seq = seqlock_read(&lock, &s);
+	CHECK(seq == 2 * WRITES && s.value[0] == WRITES && s.value[SNAPSHOT_WORDS - 1] == WRITES,
+		"final snapshot mismatch (seq=%u value=%u)", seq, s.value[0]);
+
+	return TEST_RESULT();
+}
+
+
+/* eof :-) */
@@ -0,0 +1,120 @@
+/* test_square_wave_gen.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "square_wave_gen.h"
+#include "test_util.h"
+
+
+/*
+ * Tests for square_wave_gen_period(): frequency error of the generated
+ * tacho output signal (full cycle is 2 * period + 10 system clock cycles).
+ */
+
+/* Frequency range used for tacho output signals (0.5Hz..2kHz) and
+ * maximum allowed frequency error within it. */
+#define MIN_FREQ     0.5
+#define MAX_FREQ     2000.0
+#define MAX_ERR_PPM  20.0
+
+static const uint32_t sys_clocks[] = { 125000000, 133000000, 150000000, 200000000 };
+
+
+static double output_freq(uint32_t sys_clock, uint32_t period)
+{
+	return sys_clock / (2.0 * period + 10.0);
+}
+
+
+static void test_freq_error(uint32_t sys_clock)
+{
+	double max_err = 0, at = 0;
+
+	for (double freq = MIN_FREQ; freq <= MAX_FREQ; freq *= 1.001) {
+		uint32_t period = square_wave_gen_period(sys_clock, freq);
+		double err = fabs(output_freq(sys_clock, period) - freq) / freq;
+
+		/* Rounded period should be the best one available */
+		CHECK(err <= fabs(output_freq(sys_clock, period + 1) - freq) / freq
+			&& err <= fabs(output_freq(sys_clock, period - 1) - freq) / freq,
+			"%u Hz clock: %f Hz: period %u is not the closest", sys_clock, freq, period);
+		/* ...which is within half a clock cycle (per half period) */
+		CHECK(err <= 1.0 / (2.0 * period + 10.0) + 1e-12,
+			"%u Hz clock: %f Hz: error %e", sys_clock, freq, err);
+		CHECK(err * 1e6 <= MAX_ERR_PPM, "%u Hz clock: %f Hz: error %.2f ppm",
+			sys_clock, freq, err * 1e6);
+		if (err > max_err) {
+			max_err = err;
+			at = freq;
+		}
+	}
+
+	printf("sys_clock %u Hz: max frequency error %.3f ppm (at %.2f Hz) over %.1f..%.0f Hz\n",
+		sys_clock, max_err * 1e6, at, MIN_FREQ, MAX_FREQ);
+}
+
+
+static void test_limits()
+{
+	CHECK(square_wave_gen_period(125000000, 0) == 0, "zero frequency");
+	CHECK(square_wave_gen_period(125000000, -10) == 0, "negative frequency");
+	CHECK(square_wave_gen_period(125000000, 1e9) == 1, "too high frequency");
+	CHECK(square_wave_gen_period(125000000, 1e-6) == UINT32_MAX, "too low frequency");
+	/* 125MHz / (2 * 62495 + 10) = 1kHz exactly */
+	CHECK(square_wave_gen_period(125000000, 1000.0) == 62495, "1kHz: %u",
+		square_wave_gen_period(125000000, 1000.0));
+}
+
+
+static void benchmark()
+{
+	const int count = 10000000;
+	uint64_t t0, t1;
+	double sum = 0;
+
+	t0 = test_time_ns();
+	for (int n = 0; n < count; n++)
+		sum += square_wave_gen_period(125000000, 1.0 + (n & 1023));
+	t1 = test_time_ns();
+
+	printf("benchmark: square_wave_gen_period() %.1f ns/call\n",
+		(t1 - t0) / (double)count);
+	test_sink = sum;
+}
+
+
+int main(int argc, char **argv)
+{
+	for (int i = 0; i < sizeof(sys_clocks) / sizeof(sys_clocks[0]); i++)
+		test_freq_error(sys_clocks[i]);
+	test_limits();
+	benchmark();
+
+	return TEST_RESULT();
+}
+
+
+/* eof :-) */
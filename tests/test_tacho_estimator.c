@@ -0,0 +1,223 @@
+/* test_tacho_estimator.c
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "pico/stdlib.h"
+#include "tacho_estimator.h"
+#include "test_util.h"
+
+
+/*
+ * Tests for tacho_estimator.c using synthetic tachometer pulse trains
+ * (with jitter, noise pulses and missed pulses).
+ */
+
+#define WINDOW      8
+#define TIMEOUT_MS  2000
+
+
+static double rand_range(double lo, double hi)
+{
+	return lo + (hi - lo) * (rand() / (double)RAND_MAX);
+}
+
+
+/* Feed pulse train of given frequency (with random jitter in percent of
+ * the period) to estimator, starting at time 't'. Returns time of last edge.
+ */
+static uint64_t pulse_train(struct tacho_estimator *e, uint64_t t, double freq,
+			double jitter, int pulses)
+{
+	double period = 1000000.0 / freq;
+
+	for (int i = 0; i < pulses; i++) {
+		t += llround(period * (1.0 + rand_range(-jitter, jitter) / 100.0));
+		tacho_est_add_edge(e, t);
+	}
+	return t;
+}
+
+
+static void test_steady()
+{
+	struct tacho_estimator e;
+	uint64_t t;
+
+	for (double freq = 10.0; freq <= 500.0; freq *= 1.25) {
+		tacho_est_init(&e, WINDOW, TIMEOUT_MS);
+		t = pulse_train(&e, 1000000, freq, 0.0, 2 * WINDOW);
+		double f = tacho_est_freq(&e, t);
+		/* Periods are in whole microseconds */
+		CHECK(fabs(f - freq) <= freq * freq * 1e-6,
+			"steady %.2f Hz: estimate %.4f Hz", freq, f);
+
+		/* 5% jitter, averaged over the window */
+		tacho_est_init(&e, WINDOW, TIMEOUT_MS);
+		t = pulse_train(&e, 1000000, freq, 5.0, 2 * WINDOW);
+		f = tacho_est_freq(&e, t);
+		CHECK(fabs(f - freq) <= freq * 0.03,
+			"jitter %.2f Hz: estimate %.4f Hz", freq, f);
+	}
+}
+
+
+/* Extra (noise) pulse in the middle of a period splits it into two short
+ * periods, both of which should be rejected.
+ */
+static void test_noise_pulses()
+{
+	struct tacho_estimator e;
+	double freq = 100.0, period = 1000000.0 / freq;
+	uint64_t t;
+
+	tacho_est_init(&e, WINDOW, TIMEOUT_MS);
+	t = pulse_train(&e, 1000000, freq, 1.0, WINDOW);
+	for (int i = 0; i < 3; i++) {
+		tacho_est_add_edge(&e, t + period * 0.3);
+		t += period;
+		tacho_est_add_edge(&e, t);
+		t = pulse_train(&e, t, freq, 1.0, 3);
+	}
+	double f = tacho_est_freq(&e, t);
+	CHECK(fabs(f - freq) <= freq * 0.02, "noise pulses: estimate %.4f Hz", f);
+}
+
+
+/* Missed pulse doubles a period, which should be rejected. */
+static void test_missed_pulses()
+{
+	struct tacho_estimator e;
+	double freq = 60.0, period = 1000000.0 / freq;
+	uint64_t t;
+
+	tacho_est_init(&e, WINDOW, TIMEOUT_MS);
+	t = pulse_train(&e, 1000000, freq, 1.0, WINDOW);
+	for (int i = 0; i < 2; i++) {
+		t += 2 * period;
+		tacho_est_add_edge(&e, t);
+		t = pulse_train(&e, t, freq, 1.0, 1);
+	}
+	double f = tacho_est_freq(&e, t);
+	CHECK(fabs(f - freq) <= freq * 0.02, "missed pulses: estimate %.4f Hz", f);
+}
+
+
+/* Signal stops: frequency follows 1/elapsed until timeout, then zero. */
+static void test_stop()
+{
+	struct tacho_estimator e;
+	double freq = 50.0;
+	uint64_t t;
+
+	tacho_est_init(&e, WINDOW, TIMEOUT_MS);
+	t = pulse_train(&e, 1000000, freq, 0.0, WINDOW);
+
+	double f = tacho_est_freq(&e, t + 100000);
+	CHECK(fabs(f - 10.0) < 1e-9, "slowdown: estimate %.4f Hz (expected 10 Hz)", f);
+	f = tacho_est_freq(&e, t + 1000000);
+	CHECK(fabs(f - 1.0) < 1e-9, "slowdown: estimate %.4f Hz (expected 1 Hz)", f);
+	f = tacho_est_freq(&e, t + TIMEOUT_MS * 1000 + 1);
+	CHECK(f == 0.0, "timeout: estimate %.4f Hz (expected 0)", f);
+
+	/* Estimator was reset, first period after restart is ignored */
+	t += 10000000;
+	tacho_est_add_edge(&e, t);
+	CHECK(tacho_est_freq(&e, t) == 0.0, "restart: single edge gives frequency");
+	t = pulse_train(&e, t, freq, 0.0, 1);
+	f = tacho_est_freq(&e, t);
+	CHECK(fabs(f - freq) < 0.01, "restart: estimate %.4f Hz", f);
+
+	/* No edges at all */
+	tacho_est_init(&e, WINDOW, TIMEOUT_MS);
+	CHECK(tacho_est_freq(&e, 12345678) == 0.0, "no signal gives frequency");
+}
+
+
+/* Frequency step: estimate should converge to the new frequency within
+ * (about) half the window, as soon as new periods are the majority.
+ */
+static void test_step()
+{
+	struct tacho_estimator e;
+	double f1 = 40.0, f2 = 200.0;
+	uint64_t t;
+	int n;
+
+	for (int dir = 0; dir < 2; dir++) {
+		double from = (dir ? f2 : f1), to = (dir ? f1 : f2);
+
+		tacho_est_init(&e, WINDOW, TIMEOUT_MS);
+		t = pulse_train(&e, 1000000, from, 1.0, 2 * WINDOW);
+		for (n = 1; n <= WINDOW; n++) {
+			t = pulse_train(&e, t, to, 1.0, 1);
+			if (fabs(tacho_est_freq(&e, t) - to) <= to * 0.02)
+				break;
+		}
+		CHECK(n <= WINDOW / 2 + 1, "step %.0f -> %.0f Hz: converged after %d pulses",
+			from, to, n);
+	}
+}
+
+
+static void benchmark()
+{
+	const int count = 5000000;
+	struct tacho_estimator e;
+	uint64_t t = 0, t0, t1, t2;
+	double sum = 0;
+
+	tacho_est_init(&e, WINDOW, TIMEOUT_MS);
+	t0 = test_time_ns();
+	for (int n = 0; n < count; n++) {
+		t += 10000 + (n & 63);
+		tacho_est_add_edge(&e, t);
+	}
+	t1 = test_time_ns();
+	for (int n = 0; n < count / 10; n++)
+		sum += tacho_est_freq(&e, t + (n & 1023));
+	t2 = test_time_ns();
+
+	printf("benchmark: window %d: add_edge %.1f ns/edge, freq %.1f ns/call, %zu bytes/fan\n",
+		WINDOW, (t1 - t0) / (double)count, (t2 - t1) / (double)(count / 10),
+		sizeof(e));
+	test_sink = sum;
+}
+
+
+int main(int argc, char **argv)
+{
+	srand(1);
+	test_steady();
+	test_noise_pulses();
+	test_missed_pulses();
+	test_stop();
+	test_step();
+	benchmark();
+
+	return TEST_RESULT();
+}
+
+
+/* eof :-) */
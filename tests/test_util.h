@@ -0,0 +1,65 @@
+/* test_util.h
+   Copyright (C) 2026 Timo Kokkonen <tjko@iki.fi>
+
+   SPDX-License-Identifier: GPL-3.0-or-later
+
+   This file is part of FanPico.
+
+   FanPico is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   FanPico is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with FanPico. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FANPICO_TEST_UTIL_H
+#define FANPICO_TEST_UTIL_H 1
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Helpers shared by the host tests. Each test program returns
+ * non-zero exit code if any check failed.
+ */
+
+static int test_failures __attribute__((unused)) = 0;
+
+#define CHECK(cond, ...)						\
+	do {								\
+		if (!(cond)) {						\
+			printf("FAIL %s:%d: ", __FILE__, __LINE__);	\
+			printf(__VA_ARGS__);				\
+			printf("\n");					\
+			test_failures++;				\
+		}							\
+	} while (0)
+
+#define TEST_RESULT()							\
+	(printf("%s: %s (%d failures)\n", __FILE__,			\
+		(test_failures ? "FAILED" : "OK"), test_failures),	\
+		(test_failures ? 1 : 0))
+
+
+/* Monotonic (wall) clock in nanoseconds, for benchmarks. */
+static inline uint64_t test_time_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/* Keep compiler from optimizing away benchmark results. */
+static volatile double test_sink;
+
+
+#endif /* FANPICO_TEST_UTIL_H */